@@ -1,12 +1,53 @@
 #version 330 core
 
+// Feature flags (picked by LitMaterial::selectVariant)
+// - HAS_SPECULAR, HAS_ROUGHNESS, HAS_AO, HAS_EMISSION, HAS_METALLIC: the map is sampled, otherwise the value of the default map is used
+// - MAX_LIGHTS: the size of the lights array (the light count bucket)
+// - BLOOM: the bright color is written for the bloom pass
+// - USE_TEXTURE_ARRAY: every map is a layer of a texture array (see TextureArrayPool)
+// Without LIT_FEATURES (i.e. compiled with no defines), the shader samples every map
+#ifndef LIT_FEATURES
+#define HAS_SPECULAR
+#define HAS_ROUGHNESS
+#define HAS_AO
+#define HAS_EMISSION
+#define HAS_METALLIC
+#define BLOOM
+#endif
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 8
+#endif
+
 // Uniforms
-uniform sampler2D albedoMap;
-uniform sampler2D specularMap;
-uniform sampler2D roughnessMap;
-uniform sampler2D ambient_occlusionMap;
-uniform sampler2D emissionMap;
-uniform sampler2D metallicMap;
+#ifdef USE_TEXTURE_ARRAY
+#define MAP_SAMPLER sampler2DArray
+#define SAMPLE(map, layer) texture(map, vec3(fs_in.TexCoord, layer))
+uniform int albedoLayer;
+uniform int specularLayer;
+uniform int roughnessLayer;
+uniform int ambient_occlusionLayer;
+uniform int emissionLayer;
+uniform int metallicLayer;
+#else
+#define MAP_SAMPLER sampler2D
+#define SAMPLE(map, layer) texture(map, fs_in.TexCoord)
+#endif
+uniform MAP_SAMPLER albedoMap;
+#ifdef HAS_SPECULAR
+uniform MAP_SAMPLER specularMap;
+#endif
+#ifdef HAS_ROUGHNESS
+uniform MAP_SAMPLER roughnessMap;
+#endif
+#ifdef HAS_AO
+uniform MAP_SAMPLER ambient_occlusionMap;
+#endif
+#ifdef HAS_EMISSION
+uniform MAP_SAMPLER emissionMap;
+#endif
+#ifdef HAS_METALLIC
+uniform MAP_SAMPLER metallicMap;
+#endif
 
 #define DIRECTIONAL 0
 #define POINT 1
@@ -28,7 +69,7 @@ in Varyings {
     vec2 TexCoord;
 } fs_in;
 
-uniform Light lights[8];
+uniform Light lights[MAX_LIGHTS];
 uniform int numLights;
 uniform float alphaThreshold;
 uniform vec3 viewPos;
@@ -80,13 +121,33 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0) {
 // ----------------------------------------------------------------------------
 
 void main() {
-    if(texture(albedoMap, fs_in.TexCoord).a < alphaThreshold) discard; // Discard the fragment if the alpha value of the albedo map is less than 0.1 (transparent)
-    vec3 albedo = texture(albedoMap, fs_in.TexCoord).rgb; // Retrieve the albedo (color) of the material from the albedo map
-    vec3 specular = texture(specularMap, fs_in.TexCoord).rgb; // Retrieve the specular reflection color from the specular map
-    float roughness = texture(roughnessMap, fs_in.TexCoord).r; // Retrieve the roughness value from the roughness map
-    vec3 ao = texture(ambient_occlusionMap, fs_in.TexCoord).rgb; // Retrieve the ambient occlusion value from the ambient occlusion map
-    vec3 emission = texture(emissionMap, fs_in.TexCoord).rgb; // Retrieve the emission color from the emission map
-    float metallic = texture(metallicMap, fs_in.TexCoord).r; // Retrieve the metallic value from the metallic map
+    vec4 albedoSample = SAMPLE(albedoMap, albedoLayer);
+    if(albedoSample.a < alphaThreshold) discard; // Discard the fragment if the alpha value of the albedo map is less than 0.1 (transparent)
+    vec3 albedo = albedoSample.rgb; // Retrieve the albedo (color) of the material from the albedo map
+    // The constants match the default maps (default_*.jpg) used by materials that don't have these maps
+#ifdef HAS_SPECULAR
+    vec3 specular = SAMPLE(specularMap, specularLayer).rgb; // Retrieve the specular reflection color from the specular map
+#endif
+#ifdef HAS_ROUGHNESS
+    float roughness = SAMPLE(roughnessMap, roughnessLayer).r; // Retrieve the roughness value from the roughness map
+#else
+    float roughness = 127.0 / 255.0;
+#endif
+#ifdef HAS_AO
+    vec3 ao = SAMPLE(ambient_occlusionMap, ambient_occlusionLayer).rgb; // Retrieve the ambient occlusion value from the ambient occlusion map
+#else
+    vec3 ao = vec3(1.0);
+#endif
+#ifdef HAS_EMISSION
+    vec3 emission = SAMPLE(emissionMap, emissionLayer).rgb; // Retrieve the emission color from the emission map
+#else
+    vec3 emission = vec3(0.0);
+#endif
+#ifdef HAS_METALLIC
+    float metallic = SAMPLE(metallicMap, metallicLayer).r; // Retrieve the metallic value from the metallic map
+#else
+    float metallic = 0.0;
+#endif
     
     vec3 N = normalize(fs_in.Normal); // Normalize the surface normal
     vec3 V = normalize(viewPos - fs_in.FragPos); // Calculate the view vector
@@ -96,7 +157,7 @@ void main() {
     F0 = mix(F0, albedo, metallic); // (Optional) Mix the base reflectance with the albedo based on a metallic value
 
     vec3 Lo = vec3(0.0); // Initialize the outgoing light color
-    for(int i = 0; i < numLights; ++i) // Loop through each light source
+    for(int i = 0; i < MAX_LIGHTS && i < numLights; ++i) // Loop through each light source
     {
         Light light = lights[i]; // Get the current light source
         vec3 L;
@@ -143,16 +204,18 @@ void main() {
     vec3 color = ambient + Lo + emission; // Calculate the final color by adding the ambient light, outgoing light, and emission color
 
     BrightColor = vec4(0.0, 0.0, 0.0, 0.0);
+#ifdef BLOOM
     if (bloom) {
         float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
         if(brightness > bloomThreshold){
-            BrightColor = vec4(color, texture(albedoMap, fs_in.TexCoord).a);
+            BrightColor = vec4(color, albedoSample.a);
         }
         else{
-            BrightColor = vec4(0.0, 0.0, 0.0, texture(albedoMap, fs_in.TexCoord).a);
+            BrightColor = vec4(0.0, 0.0, 0.0, albedoSample.a);
         }
     }
+#endif
 
-    frag_color = vec4(color, texture(albedoMap, fs_in.TexCoord).a); // Set the fragment color to the final color
+    frag_color = vec4(color, albedoSample.a); // Set the fragment color to the final color
 }
     
\ No newline at end of file
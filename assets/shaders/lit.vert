@@ -6,6 +6,9 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
 layout(location = 2) in vec2 tex_coord;
 layout(location = 3) in vec3 normal;
+// Constant per mesh, used to decode the attributes of packed meshes (see vertex-packing.hpp)
+layout(location = 4) in vec4 position_decode;
+layout(location = 5) in float normal_decode;
 
 // Output vertex attributes
 out Varyings {
@@ -14,6 +17,15 @@ out Varyings {
     vec2 TexCoord;
 } vs_out;
 
+// Decodes a normal stored as 2 integers with the octahedral encoding
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 // Uniforms
 uniform mat4 model;
 uniform mat4 VP;
@@ -21,9 +33,11 @@ uniform mat4 VP;
 void main()
 {
     // Transform the vertex position and normal
-    vec4 worldPos = model * vec4(position, 1.0);
+    vec3 localPos = position_decode.xyz + position_decode.w * position;
+    vec3 localNormal = normal_decode != 0.0 ? decodeOctahedral(normal.xy * normal_decode) : normal;
+    vec4 worldPos = model * vec4(localPos, 1.0);
     vs_out.FragPos = vec3(worldPos);
-    vs_out.Normal = normalize(transpose(inverse(model))* vec4(normal, 0.0)).xyz;
+    vs_out.Normal = normalize(transpose(inverse(model))* vec4(localNormal, 0.0)).xyz;
 
     // Calculate the final position of the vertex
     gl_Position = VP * worldPos;
@@ -2,6 +2,8 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
+// Constant per mesh, packed meshes store their positions relative to their bounds (see vertex-packing.hpp)
+layout(location = 4) in vec4 position_decode;
 
 out Varyings {
     vec4 color;
@@ -11,6 +13,6 @@ uniform mat4 transform;
 
 void main(){
     //TODO: (Req 7) Change the next line to apply the transformation matrix
-    gl_Position = transform * vec4(position, 1.0);
+    gl_Position = transform * vec4(position_decode.xyz + position_decode.w * position, 1.0);
     vs_out.color = color;
 }
\ No newline at end of file
@@ -23,6 +23,11 @@
 #endif
 
 #include "texture/screenshot.hpp"
+#include "shader/shader-cache.hpp"
+#include "mesh/geometry-pool.hpp"
+#include "job-system.hpp"
+#include "asset-loader.hpp"
+#include "asset-pack.hpp"
 
 std::string default_screenshot_filepath() {
     std::stringstream stream;
@@ -207,6 +212,13 @@ int portal::Application::run(int run_for_frames) {
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
 
+    // Start the worker threads of the loading jobs ("jobThreads" overrides the default of one per core)
+    JobSystem::start(app_config.value("jobThreads", 0));
+    // The memory the loaded assets can use before the unused ones are evicted (0 for no limit)
+    AssetBudget::limit = app_config.value("assetBudgetMB", (size_t)0) << 20;
+    // The assets are read from the pack if one is given (the files it doesn't have are read from the disk)
+    if(std::string pack = app_config.value("assetPack", ""); !pack.empty()) AssetPack::mount(pack);
+
     setupCallbacks();
     keyboard.enable(window);
     mouse.enable(window);
@@ -348,6 +360,13 @@ int portal::Application::run(int run_for_frames) {
 
     // Call for cleaning up
     if(currentState) currentState->onDestroy();
+    JobSystem::stop();
+    // The states can leave their assets loaded for the next state (see "retainSharedAssets")
+    clearAllAssets();
+    // The shader programs and the geometry buffers are shared between the states so they are deleted last
+    ShaderCache::clear();
+    GeometryPool::clear();
+    AssetPack::unmount();
 
     // Shutdown ImGui & destroy the context
     ImGui_ImplOpenGL3_Shutdown();
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <type_traits>
@@ -23,6 +24,7 @@ namespace portal {
     };
 
     class Application; // Forward declaration
+    class CompiledScene;
 
     // This is the base class for all states
     // The application will be responsible for managing all scene functionality by calling the "on*" functions.
@@ -58,6 +60,7 @@ namespace portal {
         Mouse mouse;                        // Instance of "our" mouse class that handles mouse functionalities.
 
         nlohmann::json app_config;           // A Json file that contains all application configuration
+        std::shared_ptr<CompiledScene> compiledScene; // The compiled world of the scene if the config was compiled (see "CompiledScene")
 
         std::unordered_map<std::string, State*> states;   // This will store all the states that the application can run
         State * currentState = nullptr;         // This will store the current scene that is being run
@@ -73,7 +76,8 @@ namespace portal {
     public:
 
         // Create an application with following configuration
-        Application(const nlohmann::json& app_config) : app_config(app_config) {}
+        Application(const nlohmann::json& app_config, std::shared_ptr<CompiledScene> compiledScene = nullptr)
+            : app_config(app_config), compiledScene(std::move(compiledScene)) {}
         // On destruction, delete all the states
         ~Application(){ for (auto &it : states) delete it.second; }
 
@@ -120,6 +124,7 @@ namespace portal {
         [[nodiscard]] const Mouse& getMouse() const { return mouse; }
 
         [[nodiscard]] const nlohmann::json& getConfig() const { return app_config; }
+        [[nodiscard]] std::shared_ptr<CompiledScene> getCompiledScene() const { return compiledScene; }
 
         // Get the size of the frame buffer of the window in pixels.
         glm::ivec2 getFrameBufferSize() {
@@ -1,14 +1,26 @@
 #include "asset-loader.hpp"
 
 #include "shader/shader.hpp"
+#include "shader/shader-cache.hpp"
 #include "texture/texture2d.hpp"
 #include "texture/texture-utils.hpp"
 #include "texture/sampler.hpp"
+#include "texture/texture-array-pool.hpp"
 #include "mesh/mesh.hpp"
 #include "mesh/mesh-utils.hpp"
 #include "material/material.hpp"
 #include "deserialize-utils.hpp"
 #include "loading-screen.hpp"
+#include "job-system.hpp"
+#include "upload-queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <unordered_set>
 
 namespace portal {
 
@@ -16,35 +28,135 @@ namespace portal {
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
     template<>
-    void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
+    void AssetLoader<ShaderProgram>::deserializeInJobs(const nlohmann::json& data, UploadQueue& uploads, JobCounter& jobs) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                LoadingScreen::progress++;
                 std::string vsPath = desc.value("vs", "");
                 std::string fsPath = desc.value("fs", "");
-                auto shader = new ShaderProgram();
-                shader->attach(vsPath, GL_VERTEX_SHADER);
-                shader->attach(fsPath, GL_FRAGMENT_SHADER);
-                shader->link();
-                assets[name] = shader;
+                JobSystem::run([name = name, desc = desc, vsPath, fsPath, &uploads](){
+                    // The job reads the files, the program is created and compiled by the upload
+                    ShaderProgram::preloadSource(vsPath);
+                    ShaderProgram::preloadSource(fsPath);
+                    LoadingScreen::decoded++;
+                    uploads.push([name, desc, vsPath, fsPath](){
+                        // The programs are shared with the rest of the application through the shader cache
+                        store(name, ShaderCache::get(vsPath, fsPath), desc);
+                    });
+                }, &jobs);
             }
         }
     };
 
+    template<>
+    void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
+        UploadQueue uploads(&LoadingScreen::progress);
+        uploads.bind();
+        JobCounter jobs;
+        deserializeInJobs(data, uploads, jobs);
+        uploads.drainUntil(jobs);
+    };
+
+    template<>
+    ShaderProgram* AssetLoader<ShaderProgram>::load(const std::string&, const nlohmann::json& desc) {
+        return ShaderCache::get(desc.value("vs", ""), desc.value("fs", ""));
+    }
+
+    // The shader programs are owned by the ShaderCache, so they are only removed from the map
+    template<>
+    void AssetLoader<ShaderProgram>::clear() {
+        assets.clear();
+        declared.clear();
+        records.clear();
+    }
+
+    // The memory of the programs is not counted since they stay in the shader cache
+    template<>
+    AssetMemory AssetLoader<ShaderProgram>::measure(const ShaderProgram*) {
+        return {};
+    }
+
+    template<>
+    bool AssetLoader<ShaderProgram>::canEvict(const ShaderProgram*) {
+        return false;
+    }
+
+    template<>
+    void AssetLoader<ShaderProgram>::destroy(ShaderProgram*) {}
+
+    template<>
+    Texture2D* AssetLoader<Texture2D>::load(const std::string&, const nlohmann::json& desc) {
+        return texture_utils::loadImage(desc.get<std::string>());
+    }
+
+    // A packed texture also counts its layer (most of them don't have any storage left), evicting it frees the layer
+    // so the texture arrays are bounded by the budget too (the materials using a layer hold handles to its texture)
+    template<>
+    AssetMemory AssetLoader<Texture2D>::measure(const Texture2D* texture) {
+        return {sizeof(Texture2D), texture->getBytes() + TextureArrayPool::getLayerBytes(texture)};
+    }
+
+    // The layer of a packed texture can be used by another texture once the texture is deleted
+    template<>
+    void AssetLoader<Texture2D>::destroy(Texture2D* texture) {
+        TextureArrayPool::forget(texture);
+        delete texture;
+    }
+
+    // The staging ring of the texture uploads, it is created by the thread running the uploads while the assets load
+    // (the decoded levels are copied into it so the uploads don't stall the loading context)
+    static StagingRing* textureStaging = nullptr;
+
     // This will load all the textures defined in "data"
     // data must be in the form:
     //    { texture_name : "path/to/image", ... }
     template<>
-    void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
+    void AssetLoader<Texture2D>::deserializeInJobs(const nlohmann::json& data, UploadQueue& uploads, JobCounter& jobs) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                LoadingScreen::progress++;
                 std::string path = desc.get<std::string>();
-                assets[name] = texture_utils::loadImage(path);
+                JobSystem::run([name = name, path, &uploads](){
+                    // The decoded image is shared so the upload (a copyable function) can own it
+                    std::shared_ptr<texture_utils::ImageData> image = texture_utils::decodeImage(path);
+                    LoadingScreen::decoded++;
+                    uploads.push([name, image, path](){
+                        store(name, image ? texture_utils::uploadImage(*image, textureStaging) : nullptr, path);
+                    });
+                }, &jobs);
             }
         }
     };
 
+    void setTextureStaging(StagingRing* ring){
+        textureStaging = ring;
+    }
+
+    // Reports the texture loading cost (bake the textures with "--bake-textures" to reduce both)
+    // The time is the sum of the time spent on each texture by the jobs and the uploads
+    static void reportTextureStats(){
+        auto& stats = texture_utils::loadStats;
+        std::cout << "Loaded " << stats.textures << " textures (" << stats.baked << " baked) in "
+                  << stats.milliseconds << " ms, " << stats.bytes / (1024.0 * 1024.0) << " MB of VRAM, "
+                  << stats.stagedBytes / (1024.0 * 1024.0) << " MB staged";
+        if(textureStaging) std::cout << " (" << textureStaging->waitMilliseconds << " ms waiting for staging slots)";
+        std::cout << std::endl;
+    }
+
+    template<>
+    void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
+        if(data.is_object()){
+            texture_utils::loadStats = {};
+            StagingRing staging;
+            textureStaging = &staging;
+            UploadQueue uploads(&LoadingScreen::progress);
+            uploads.bind();
+            JobCounter jobs;
+            deserializeInJobs(data, uploads, jobs);
+            uploads.drainUntil(jobs);
+            reportTextureStats();
+            textureStaging = nullptr;
+        }
+    };
+
     // This will load all the samplers defined in "data"
     // data must be in the form:
     //    { sampler_name : parameters, ... }
@@ -52,14 +164,27 @@ namespace portal {
     //      The key is the parameter name, e.g. "MAG_FILTER", "MIN_FILTER", "WRAP_S", "WRAP_T" or "MAX_ANISOTROPY"
     //      The value is the parameter value, e.g. "GL_NEAREST", "GL_REPEAT"
     //  For "MAX_ANISOTROPY", the value must be a float with a value >= 1.0f
+    template<>
+    Sampler* AssetLoader<Sampler>::load(const std::string&, const nlohmann::json& desc) {
+        auto sampler = new Sampler();
+        sampler->deserialize(desc);
+        return sampler;
+    }
+
+    template<>
+    AssetMemory AssetLoader<Sampler>::measure(const Sampler*) {
+        return {sizeof(Sampler), 0};
+    }
+
     template<>
     void AssetLoader<Sampler>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
+                LoadingScreen::decoded++;
                 LoadingScreen::progress++;
                 auto sampler = new Sampler();
                 sampler->deserialize(desc);
-                assets[name] = sampler;
+                store(name, sampler, desc);
             }
         }
     };
@@ -68,14 +193,52 @@ namespace portal {
     // data must be in the form:
     //    { mesh_name : "path/to/3d-model-file", ... }
     template<>
-    void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
+    Mesh* AssetLoader<Mesh>::load(const std::string&, const nlohmann::json& desc) {
+        return mesh_utils::loadOBJ(desc.get<std::string>());
+    }
+
+    template<>
+    AssetMemory AssetLoader<Mesh>::measure(const Mesh* mesh) {
+        size_t cpu = sizeof(Mesh);
+        for(auto& lod : mesh->getLods()) cpu += sizeof(MeshLod) + lod.submeshes.size() * sizeof(Submesh);
+        return {cpu, mesh->getBytes()};
+    }
+
+    void deserializeMeshesInJobs(const nlohmann::json& data, const VertexLayout& layout, UploadQueue& uploads, JobCounter& jobs) {
         if(data.is_object()){
-            for(auto& [name, desc] : data.items()){
-                LoadingScreen::progress++;
-                std::string path = desc.get<std::string>();
-                assets[name] = mesh_utils::loadOBJ(path);
+            // Each file is imported once (two jobs must not write the same cached mesh) then a mesh is created for each name
+            std::unordered_map<std::string, std::vector<std::string>> namesOfPath;
+            for(auto& [name, desc] : data.items()) namesOfPath[desc.get<std::string>()].push_back(name);
+            for(auto& [path, names] : namesOfPath){
+                JobSystem::run([path = path, names = names, layout, &uploads](){
+                    std::shared_ptr<MeshData> meshData(mesh_utils::loadOBJData(path));
+                    for(auto& name : names){
+                        LoadingScreen::decoded++;
+                        uploads.push([name, meshData, path, layout](){
+                            AssetLoader<Mesh>::store(name, meshData ? mesh_utils::createMesh(*meshData, layout) : nullptr, path);
+                        });
+                    }
+                }, &jobs);
             }
         }
+    }
+
+    template<>
+    void AssetLoader<Mesh>::deserializeInJobs(const nlohmann::json& data, UploadQueue& uploads, JobCounter& jobs) {
+        deserializeMeshesInJobs(data, Mesh::layout, uploads, jobs);
+    };
+
+    template<>
+    void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
+        if(data.is_object()){
+            Mesh::stats = MeshMemoryStats();
+            UploadQueue uploads(&LoadingScreen::progress);
+            uploads.bind();
+            JobCounter jobs;
+            deserializeInJobs(data, uploads, jobs);
+            uploads.drainUntil(jobs);
+            Mesh::reportStats();
+        }
     };
 
     // This will load all the materials defined in "data"
@@ -90,15 +253,39 @@ namespace portal {
     //      "pipelineState" (optional) where the value is a json object that can be read by "PipelineState::deserialize"
     //      "transparent" (optional, default=false) where the value is a boolean indicating whether the material is transparent or not
     //      ... more keys/values can be added depending on the material type (e.g. "texture", "sampler", "tint")
+    // The shaders, textures and samplers of the material are resolved (and loaded if needed) by its deserialization
+    template<>
+    Material* AssetLoader<Material>::load(const std::string&, const nlohmann::json& desc) {
+        auto material = createMaterialFromType(desc.value("type", ""));
+        material->deserialize(desc);
+        // A lit material loaded after the maps were packed uses the same layers (the packed maps have no storage left)
+        if(auto lit = dynamic_cast<LitMaterial*>(material); lit) TextureArrayPool::assign(lit);
+        // Any other material (or a lit one whose maps weren't all packed) samples its textures directly,
+        // so the ones that were packed get their storage back
+        TextureArrayPool::restoreSampled(material);
+        AssetLoader<Texture2D>::remeasure();
+        return material;
+    }
+
+    // The materials only hold their parameters, their textures are counted by the textures
+    template<>
+    AssetMemory AssetLoader<Material>::measure(const Material* material) {
+        if(dynamic_cast<const LitMaterial*>(material)) return {sizeof(LitMaterial), 0};
+        if(dynamic_cast<const TexturedMaterial*>(material)) return {sizeof(TexturedMaterial), 0};
+        if(dynamic_cast<const MultiTextureMaterial*>(material)) return {sizeof(MultiTextureMaterial), 0};
+        return {sizeof(TintedMaterial), 0};
+    }
+
     template<>
     void AssetLoader<Material>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
+                LoadingScreen::decoded++;
                 LoadingScreen::progress++;
                 std::string type = desc.value("type", "");
                 auto material = createMaterialFromType(type);
                 material->deserialize(desc);
-                assets[name] = material;
+                store(name, material, desc);
             }
         }
     };
@@ -106,40 +293,375 @@ namespace portal {
 
     // To store data such as models as json objects to be dynamically loaded when needed
     template<>
-    void AssetLoader<nlohmann::json>::deserialize(const nlohmann::json& data) {
+    nlohmann::json* AssetLoader<nlohmann::json>::load(const std::string&, const nlohmann::json& desc) {
+        return new nlohmann::json(desc);
+    }
+
+    // The size of the model text is used as an estimate of the memory of its json object
+    template<>
+    AssetMemory AssetLoader<nlohmann::json>::measure(const nlohmann::json* model) {
+        return {sizeof(nlohmann::json) + model->dump().size(), 0};
+    }
+
+    template<>
+    bool AssetLoader<nlohmann::json>::canEvict(const nlohmann::json*) {
+        return false;
+    }
+
+    template<>
+    void AssetLoader<nlohmann::json>::deserializeInJobs(const nlohmann::json& data, UploadQueue& uploads, JobCounter& jobs) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                LoadingScreen::progress++;
-                // Create Json object and store its pointer in assets
-                assets[name] = new nlohmann::json(desc);
+                JobSystem::run([name = name, &desc, &uploads](){
+                    // Create Json object, its pointer is stored in assets by the loading thread (the map isn't thread safe)
+                    nlohmann::json* model = new nlohmann::json(desc);
+                    LoadingScreen::decoded++;
+                    uploads.push([name, model](){ store(name, model, *model); });
+                }, &jobs);
             }
         }
     };
-    
 
-    void deserializeAllAssets(const nlohmann::json& assetData){
-        if(!assetData.is_object()) return;
+    template<>
+    void AssetLoader<nlohmann::json>::deserialize(const nlohmann::json& data) {
+        UploadQueue uploads(&LoadingScreen::progress);
+        uploads.bind();
+        JobCounter jobs;
+        deserializeInJobs(data, uploads, jobs);
+        uploads.drainUntil(jobs);
+    };
+
+
+    // The maps of a lit material that use a default texture when they are not given (see "LitMaterial::deserialize")
+    static const char* litMaterialMaps[] = {"albedo", "specular", "roughness", "ambient_occlusion", "emission", "metallic"};
+
+    nlohmann::json filterReferencedAssets(const nlohmann::json& assetData, const nlohmann::json& world){
+        nlohmann::json result = nlohmann::json::object();
+        if(!assetData.is_object()) return result;
+        // Adds the asset to the result the first time it is referenced, returns its description (or nullptr if it was already added)
+        auto reference = [&](const char* type, const nlohmann::json& name) -> const nlohmann::json* {
+            if(!name.is_string() || !assetData.contains(type)) return nullptr;
+            auto& assets = assetData[type];
+            auto it = assets.find(name.get<std::string>());
+            if(it == assets.end() || (result.contains(type) && result[type].contains(it.key()))) return nullptr;
+            result[type][it.key()] = *it;
+            return &*it;
+        };
+        // A material depends on its shader, its sampler and every texture named by one of its values
+        auto referenceMaterial = [&](const nlohmann::json& name){
+            const nlohmann::json* material = reference("materials", name);
+            if(!material || !material->is_object()) return;
+            for(auto& [key, value] : material->items()){
+                if(key == "shader") reference("shaders", value);
+                else if(key == "sampler") reference("samplers", value);
+                else reference("textures", value);
+            }
+            if(material->value("type", "") == "lit"){
+                for(const char* map : litMaterialMaps)
+                    if(!material->contains(map)) reference("textures", std::string("default_") + map);
+            }
+        };
+        // The entities reference meshes and materials from their mesh renderers and models from their model loaders
+        // (the entities of a model are visited the first time it is referenced)
+        std::function<void(const nlohmann::json&)> visitEntities = [&](const nlohmann::json& entities){
+            if(!entities.is_array()) return;
+            for(auto& entity : entities){
+                if(!entity.is_object()) continue;
+                if(auto components = entity.find("components"); components != entity.end() && components->is_array()){
+                    for(auto& component : *components){
+                        if(!component.is_object()) continue;
+                        if(component.contains("mesh")) reference("meshes", component["mesh"]);
+                        if(component.contains("material")) referenceMaterial(component["material"]);
+                        if(auto materials = component.find("materials"); materials != component.end() && materials->is_array()){
+                            for(auto& material : *materials) referenceMaterial(material);
+                        }
+                        if(component.contains("model")){
+                            if(const nlohmann::json* model = reference("models", component["model"])) visitEntities(*model);
+                        }
+                    }
+                }
+                if(entity.contains("children")) visitEntities(entity["children"]);
+            }
+        };
+        visitEntities(world);
+        if(assetData.contains("vertexLayout")) result["vertexLayout"] = assetData["vertexLayout"];
+        return result;
+    }
+
+    template<typename T>
+    static void collectUnused(const char* type, std::ostringstream& report, size_t& count){
+        std::vector<std::string> names = AssetLoader<T>::getUnloadedNames();
+        if(names.empty()) return;
+        report << "\n  " << type << ":";
+        for(auto& name : names) report << " " << name;
+        count += names.size();
+    }
+
+    void reportUnusedAssets(){
+        std::ostringstream report;
+        size_t count = 0;
+        collectUnused<ShaderProgram>("shaders", report, count);
+        collectUnused<Texture2D>("textures", report, count);
+        collectUnused<Sampler>("samplers", report, count);
+        collectUnused<Mesh>("meshes", report, count);
+        collectUnused<Material>("materials", report, count);
+        collectUnused<nlohmann::json>("models", report, count);
+        if(count > 0) std::cout << count << " declared assets are not used (they are loaded if something resolves them):" << report.str() << std::endl;
+    }
+
+    template<typename T>
+    static void reportMemory(const char* type, AssetMemory& total){
+        AssetMemory memory = AssetLoader<T>::getMemory();
+        std::cout << "\n  " << type << ": " << memory.cpu / 1024.0 << " KB of RAM, " << memory.gpu / (1024.0 * 1024.0) << " MB of VRAM";
+        total.cpu += memory.cpu;
+        total.gpu += memory.gpu;
+    }
+
+    AssetMemory getAssetMemory(){
+        AssetMemory total;
+        for(AssetMemory memory : {AssetLoader<ShaderProgram>::getMemory(), AssetLoader<Texture2D>::getMemory(), AssetLoader<Sampler>::getMemory(),
+                                  AssetLoader<Mesh>::getMemory(), AssetLoader<Material>::getMemory(), AssetLoader<nlohmann::json>::getMemory()}){
+            total.cpu += memory.cpu;
+            total.gpu += memory.gpu;
+        }
+        return total;
+    }
+
+    void reportAssetMemory(){
+        AssetMemory total;
+        std::cout << "Memory of the loaded assets:";
+        reportMemory<ShaderProgram>("shaders", total);
+        reportMemory<Texture2D>("textures", total);
+        reportMemory<Sampler>("samplers", total);
+        reportMemory<Mesh>("meshes", total);
+        reportMemory<Material>("materials", total);
+        reportMemory<nlohmann::json>("models", total);
+        std::cout << "\n  total: " << total.total() / (1024.0 * 1024.0) << " MB";
+        if(AssetBudget::limit > 0) std::cout << " of a " << AssetBudget::limit / (1024.0 * 1024.0) << " MB budget";
+        std::cout << std::endl;
+    }
+
+    // Keeps the least recently used candidate of the type (the ones used before "lastUse")
+    template<typename T>
+    static void findCandidate(std::string& name, uint64_t& lastUse, std::function<AssetMemory()>& evict){
+        if(AssetLoader<T>::findLeastRecentlyUsed(name, lastUse))
+            evict = [name](){ return AssetLoader<T>::evict(name); };
+    }
+
+    // Set once the referenced assets alone were reported to exceed the budget (until the assets fit again)
+    static bool reportedOverBudget = false;
+
+    void enforceAssetBudget(){
+        if(AssetBudget::limit == 0) return;
+        size_t memory = getAssetMemory().total();
+        if(memory <= AssetBudget::limit){
+            reportedOverBudget = false;
+            return;
+        }
+        size_t evicted = 0, freed = 0;
+        while(memory > AssetBudget::limit){
+            // Evicting an asset can release others (e.g. the textures of a material), so the candidates are searched again each time
+            std::string name;
+            uint64_t lastUse = UINT64_MAX;
+            std::function<AssetMemory()> evict;
+            findCandidate<Texture2D>(name, lastUse, evict);
+            findCandidate<Sampler>(name, lastUse, evict);
+            findCandidate<Mesh>(name, lastUse, evict);
+            findCandidate<Material>(name, lastUse, evict);
+            if(!evict) break;
+            freed += evict().total();
+            evicted++;
+            memory = getAssetMemory().total();
+        }
+        AssetBudget::evictions += evicted;
+        if(evicted > 0){
+            std::cout << "Evicted " << evicted << " assets (" << freed / (1024.0 * 1024.0) << " MB), the loaded assets use "
+                      << memory / (1024.0 * 1024.0) << " MB of a " << AssetBudget::limit / (1024.0 * 1024.0) << " MB budget" << std::endl;
+        }
+        if(memory > AssetBudget::limit && !reportedOverBudget){
+            std::cerr << "The referenced assets use " << memory / (1024.0 * 1024.0) << " MB, more than the budget of "
+                      << AssetBudget::limit / (1024.0 * 1024.0) << " MB" << std::endl;
+            reportedOverBudget = true;
+        }
+    }
+
+    // Returns the names of the loaded assets of the type that the asset data doesn't have with the same description
+    template<typename T>
+    static std::unordered_set<std::string> findChangedAssets(const nlohmann::json& assetData, const char* type){
+        std::unordered_set<std::string> changed;
+        const nlohmann::json& descs = assetData.contains(type) ? assetData[type] : nlohmann::json::object();
+        for(auto& name : AssetLoader<T>::getLoadedNames()){
+            auto it = descs.find(name);
+            if(it == descs.end() || !AssetLoader<T>::isUnchanged(name, *it)) changed.insert(name);
+        }
+        return changed;
+    }
+
+    template<typename T>
+    static void unloadAssets(const std::unordered_set<std::string>& names){
+        for(auto& name : names){
+            if(!AssetLoader<T>::unload(name)) std::cerr << "Can't unload the asset \"" << name << "\", it is still referenced" << std::endl;
+        }
+    }
+
+    size_t retainSharedAssets(const nlohmann::json& assetData){
+        if(!assetData.is_object()) return 0;
+        auto shaders = findChangedAssets<ShaderProgram>(assetData, "shaders");
+        auto textures = findChangedAssets<Texture2D>(assetData, "textures");
+        auto samplers = findChangedAssets<Sampler>(assetData, "samplers");
+        auto meshes = findChangedAssets<Mesh>(assetData, "meshes");
+        auto models = findChangedAssets<nlohmann::json>(assetData, "models");
+        // A material is loaded again if its shader, sampler or one of its textures changed (they are named by its values)
+        auto materials = findChangedAssets<Material>(assetData, "materials");
+        if(assetData.contains("materials")){
+            for(auto& [name, desc] : assetData["materials"].items()){
+                if(!AssetLoader<Material>::isLoaded(name) || materials.count(name) || !desc.is_object()) continue;
+                bool dependsOnChanged = false;
+                for(auto& [key, value] : desc.items()){
+                    if(!value.is_string()) continue;
+                    std::string dependency = value.get<std::string>();
+                    if(shaders.count(dependency) || textures.count(dependency) || samplers.count(dependency)) dependsOnChanged = true;
+                }
+                if(desc.value("type", "") == "lit"){
+                    for(const char* map : litMaterialMaps)
+                        if(!desc.contains(map) && textures.count(std::string("default_") + map)) dependsOnChanged = true;
+                }
+                if(dependsOnChanged) materials.insert(name);
+            }
+        }
+        // The materials go first since they hold handles to the textures and samplers
+        unloadAssets<Material>(materials);
+        // The layers of the unloaded textures are given back to the texture array pool (see "AssetLoader<Texture2D>::destroy")
+        unloadAssets<Texture2D>(textures);
+        unloadAssets<Sampler>(samplers);
+        unloadAssets<Mesh>(meshes);
+        unloadAssets<nlohmann::json>(models);
+        unloadAssets<ShaderProgram>(shaders);
+        AssetLoader<ShaderProgram>::clearDeclared();
+        AssetLoader<Texture2D>::clearDeclared();
+        AssetLoader<Sampler>::clearDeclared();
+        AssetLoader<Mesh>::clearDeclared();
+        AssetLoader<Material>::clearDeclared();
+        AssetLoader<nlohmann::json>::clearDeclared();
+        // The meshes created from now on use the layout of the next scene (or the full one if it has none)
+        Mesh::layout = VertexLayout::full();
+
+        size_t kept = AssetLoader<ShaderProgram>::getLoadedNames().size() + AssetLoader<Texture2D>::getLoadedNames().size() +
+                      AssetLoader<Sampler>::getLoadedNames().size() + AssetLoader<Mesh>::getLoadedNames().size() +
+                      AssetLoader<Material>::getLoadedNames().size() + AssetLoader<nlohmann::json>::getLoadedNames().size();
+        size_t unloaded = shaders.size() + textures.size() + samplers.size() + meshes.size() + materials.size() + models.size();
+        if(kept + unloaded > 0) std::cout << "Kept " << kept << " loaded assets for the next scene, unloaded " << unloaded << std::endl;
+        return kept;
+    }
+
+    nlohmann::json filterLoadedAssets(const nlohmann::json& assetData){
+        if(!assetData.is_object()) return assetData;
+        nlohmann::json result = assetData;
+        auto filter = [&](const char* type, const std::function<bool(const std::string&)>& isLoaded){
+            if(!result.contains(type) || !result[type].is_object()) return;
+            nlohmann::json& assets = result[type];
+            for(auto it = assets.begin(); it != assets.end();){
+                if(isLoaded(it.key())) it = assets.erase(it);
+                else ++it;
+            }
+        };
+        filter("shaders", AssetLoader<ShaderProgram>::isLoaded);
+        filter("textures", AssetLoader<Texture2D>::isLoaded);
+        filter("samplers", AssetLoader<Sampler>::isLoaded);
+        filter("meshes", AssetLoader<Mesh>::isLoaded);
+        filter("materials", AssetLoader<Material>::isLoaded);
+        filter("models", AssetLoader<nlohmann::json>::isLoaded);
+        return result;
+    }
+
+    // Loads the referenced assets (all of them if "referencedAssets" is null)
+    static void loadAssets(const nlohmann::json& allAssets, const nlohmann::json* referencedAssets){
+        // Only the referenced assets are loaded now, the others are declared so they can still be resolved later
+        // The assets kept from the previous scene (see "retainSharedAssets") are not loaded again
+        const nlohmann::json assetData = filterLoadedAssets(referencedAssets ? *referencedAssets : allAssets);
+        if(referencedAssets){
+            auto skipped = [&](const char* type){ return assetData.value(type, nlohmann::json::object()); };
+            AssetLoader<ShaderProgram>::declare(allAssets.value("shaders", nlohmann::json()), skipped("shaders"));
+            AssetLoader<Texture2D>::declare(allAssets.value("textures", nlohmann::json()), skipped("textures"));
+            AssetLoader<Sampler>::declare(allAssets.value("samplers", nlohmann::json()), skipped("samplers"));
+            AssetLoader<Mesh>::declare(allAssets.value("meshes", nlohmann::json()), skipped("meshes"));
+            AssetLoader<Material>::declare(allAssets.value("materials", nlohmann::json()), skipped("materials"));
+            AssetLoader<nlohmann::json>::declare(allAssets.value("models", nlohmann::json()), skipped("models"));
+            reportUnusedAssets();
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        auto elapsed = [&](){ return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); };
+        ShaderProgram::resetLinkStats();
+        texture_utils::loadStats = {};
+        Mesh::stats = MeshMemoryStats();
+        StagingRing staging;
+        textureStaging = &staging;
+        // The uploads of the jobs are run by this thread, except the meshes of a loading screen which are created by the main thread
+        UploadQueue uploads(&LoadingScreen::progress);
+        uploads.bind();
+        UploadQueue& meshUploads = AssetLoader<Mesh>::separateThread ? LoadingScreen::meshUploads : uploads;
+        JobCounter jobs, meshJobs;
+        // The layout of the vertex buffers of the meshes (e.g. "packed"), it stays in use until the assets are cleared
+        if(assetData.contains("vertexLayout"))
+            Mesh::layout.deserialize(assetData["vertexLayout"]);
+        // Queue the jobs of all the types first so they all run in parallel
+        // The shaders keep compiling in the background (if the driver supports it) while the other assets load
         if(assetData.contains("shaders"))
-            AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
+            AssetLoader<ShaderProgram>::deserializeInJobs(assetData["shaders"], uploads, jobs);
         if(assetData.contains("textures"))
-            AssetLoader<Texture2D>::deserialize(assetData["textures"]);
+            AssetLoader<Texture2D>::deserializeInJobs(assetData["textures"], uploads, jobs);
+        if(assetData.contains("meshes"))
+            AssetLoader<Mesh>::deserializeInJobs(assetData["meshes"], meshUploads, meshJobs);
+        if(assetData.contains("models")) 
+            AssetLoader<nlohmann::json>::deserializeInJobs(assetData["models"], uploads, jobs);
         if(assetData.contains("samplers"))
             AssetLoader<Sampler>::deserialize(assetData["samplers"]);
-        if(assetData.contains("meshes")) {
-            if (AssetLoader<Mesh>::separateThread) {
-                LoadingScreen::deserializeMesh(assetData["meshes"]);
-            } else {
-                AssetLoader<Mesh>::deserialize(assetData["meshes"]);
-            }
-        }
-        if(assetData.contains("materials"))
+        // The materials need the shaders, textures and samplers
+        uploads.drainUntil(jobs);
+        if(assetData.contains("materials")){
             AssetLoader<Material>::deserialize(assetData["materials"]);
-        if(assetData.contains("models")) 
-            AssetLoader<nlohmann::json>::deserialize(assetData["models"]);
+            // Pack the maps of the lit materials into texture arrays (the storage of most of their textures is released)
+            TextureArrayPool::build();
+            AssetLoader<Texture2D>::remeasure();
+        }
+        if(&meshUploads == &uploads) uploads.drainUntil(meshJobs);
+        else JobSystem::wait(meshJobs);
+        double jobsMilliseconds = elapsed();
+        // Wait for the shaders so their errors are reported and their binaries are saved for the next run
+        ShaderCache::finishAll();
+        ShaderProgram::clearPreloadedSources();
+        // Wait for the uploads so the other context can use them
+        uploads.finish();
+        if(assetData.contains("textures")) reportTextureStats();
+        textureStaging = nullptr;
+        // The meshes of a loading screen are reported once the main thread created them
+        if(assetData.contains("meshes") && &meshUploads == &uploads) Mesh::reportStats();
+        ShaderLinkStats stats = ShaderProgram::getLinkStats();
+        std::cout << "Linked " << stats.programs << " shader programs (" << stats.fromBinary << " from the binary cache) in "
+                  << stats.milliseconds << " ms, assets loaded in " << elapsed() << " ms" << std::endl;
+        std::cout << "Loading jobs done in " << jobsMilliseconds << " ms on " << JobSystem::getWorkerCount() << " worker threads, "
+                  << uploads.milliseconds << " ms of uploads on the loading thread" << std::endl;
         LoadingScreen::doneLoading = true;
     }
 
+    void deserializeAllAssets(const nlohmann::json& allAssets, const nlohmann::json* world){
+        if(!allAssets.is_object()) return;
+        if(world){
+            nlohmann::json referencedAssets = filterReferencedAssets(allAssets, *world);
+            loadAssets(allAssets, &referencedAssets);
+        } else {
+            loadAssets(allAssets, nullptr);
+        }
+    }
+
+    void deserializeReferencedAssets(const nlohmann::json& allAssets, const nlohmann::json& referencedAssets){
+        if(!allAssets.is_object()) return;
+        loadAssets(allAssets, &referencedAssets);
+    }
+
     void clearAllAssets(){
+        TextureArrayPool::clear();
+        Mesh::layout = VertexLayout::full();
         AssetLoader<ShaderProgram>::clear();
         AssetLoader<Texture2D>::clear();
         AssetLoader<Sampler>::clear();
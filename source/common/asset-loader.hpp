@@ -1,11 +1,83 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <unordered_map>
 #include <string>
+#include <type_traits>
+#include <vector>
 #include <json/json.hpp>
 
 namespace portal {
     class LoadingScreen;
+    class TextureArrayPool;
+    class UploadQueue;
+    class StagingRing;
+    struct JobCounter;
+    class ShaderProgram;
+    class Texture2D;
+    class Sampler;
+    class Mesh;
+    class Material;
+    struct VertexLayout;
+    template<typename T>
+    class AssetLoader;
+
+    // The memory used by an asset in bytes (an estimate for the CPU side)
+    struct AssetMemory {
+        size_t cpu = 0, gpu = 0;
+        size_t total() const { return cpu + gpu; }
+    };
+
+    // This static class holds the memory budget of the loaded assets (see "enforceAssetBudget")
+    class AssetBudget {
+    public:
+        // The maximum memory (CPU + GPU bytes) of the loaded assets, 0 for no limit (set by "assetBudgetMB" in the app config)
+        static inline size_t limit = 0;
+        // Advanced each time an asset is used or released, the assets with the oldest use are evicted first
+        static inline std::atomic<uint64_t> clock = 0;
+        // The number of assets evicted since the start
+        static inline size_t evictions = 0;
+    };
+
+    // A counted reference to an asset of the AssetLoader, the asset is not evicted while a handle references it
+    // It converts to a raw pointer so it can be used like one (the pointer must not be kept longer than the handle)
+    // A handle can also hold an asset that the AssetLoader doesn't own (e.g. a texture created by a system), it is then not counted
+    template<typename T>
+    class AssetHandle {
+        T* asset = nullptr;
+        // The name of the asset in the AssetLoader (empty if it is not counted)
+        std::string name;
+
+        void release(){
+            if(!name.empty()) AssetLoader<T>::removeReference(name, asset);
+            name.clear();
+        }
+    public:
+        AssetHandle() = default;
+        AssetHandle(T* asset) : asset(asset) {}
+        // Counts a reference to the loaded asset with the given name (use "AssetLoader<T>::acquire")
+        AssetHandle(T* asset, const std::string& name) : asset(asset), name(name) {
+            if(!this->name.empty()) AssetLoader<T>::addReference(this->name, asset);
+        }
+        AssetHandle(const AssetHandle& other) : AssetHandle(other.asset, other.name) {}
+        AssetHandle(AssetHandle&& other) noexcept : asset(other.asset), name(std::move(other.name)) { other.name.clear(); }
+        AssetHandle& operator=(AssetHandle other) noexcept {
+            release();
+            asset = other.asset;
+            name = std::move(other.name);
+            other.name.clear();
+            return *this;
+        }
+        ~AssetHandle(){ release(); }
+
+        T* get() const { return asset; }
+        T* operator->() const { return asset; }
+        operator T*() const { return asset; }
+        const std::string& getName() const { return name; }
+    };
+
     // This static template class will hold the loaded assets
     // and can be called from anywhere to get an asset by its name.
     // Since we have different types of assets, this declared as a template class
@@ -15,7 +87,51 @@ namespace portal {
         // This map stores a pointer to each asset identified by its name
         // All assets in this map are owned by the asset loader so it should not be deleted outside of this class
         static inline std::unordered_map<std::string, T*> assets;
+        // The descriptions of the declared assets that were not loaded yet (see "declare")
+        static inline std::unordered_map<std::string, nlohmann::json> declared;
+        // The bookkeeping of each loaded asset for the memory budget
+        struct Record {
+            // The number of handles referencing the asset, only the assets without references can be evicted
+            int references = 0;
+            // The value of "AssetBudget::clock" when the asset was last resolved or released
+            uint64_t lastUse = 0;
+            AssetMemory memory;
+            // The description the asset was loaded from, it is declared again when the asset is evicted
+            nlohmann::json desc;
+        };
+        static inline std::unordered_map<std::string, Record> records;
+        // Loads a single asset from its description on the calling thread (defined for each asset type in "asset-loader.cpp")
+        static T* load(const std::string& name, const nlohmann::json& desc);
+        // Measures the memory used by an asset (defined for each asset type in "asset-loader.cpp")
+        static AssetMemory measure(const T* asset);
+        // Returns false for the assets that must stay loaded even without references (specialized in "asset-loader.cpp")
+        static bool canEvict(const T*) { return true; }
+        // Deletes an asset that is removed from the loader (specialized in "asset-loader.cpp" for the types that need more)
+        static void destroy(T* asset) { delete asset; }
+
+        // Adds the loaded asset and the record used to evict and reload it
+        static void store(const std::string& name, T* asset, const nlohmann::json& desc){
+            assets[name] = asset;
+            Record& record = records[name];
+            record.lastUse = AssetBudget::clock++;
+            record.memory = asset ? measure(asset) : AssetMemory();
+            // A model is its own description
+            if constexpr(!std::is_same_v<T, nlohmann::json>) record.desc = desc;
+        }
+        // Called by the handles, the asset must still be the one with this name (it may have been cleared since)
+        static void addReference(const std::string& name, const T* asset){
+            if(auto it = assets.find(name); it != assets.end() && it->second == asset) records[name].references++;
+        }
+        static void removeReference(const std::string& name, const T* asset){
+            if(auto it = assets.find(name); it == assets.end() || it->second != asset) return;
+            Record& record = records[name];
+            if(record.references > 0) record.references--;
+            record.lastUse = AssetBudget::clock++;
+        }
+        friend class AssetHandle<T>;
         friend class LoadingScreen;
+        friend class TextureArrayPool;
+        friend void deserializeMeshesInJobs(const nlohmann::json&, const VertexLayout&, UploadQueue&, JobCounter&);
     public:
         static inline std::atomic<bool> separateThread = false;
         // This function loads the assets defined by the given json object
@@ -23,31 +139,213 @@ namespace portal {
         // For example: {"white": "textures/white.png", "polka": "textures/polka.png"} defines 2 textures
         // where the key will be asset name and the description holds the path to the texture file
         static void deserialize(const nlohmann::json&);
+        // Same as "deserialize" but the assets are loaded by jobs running in parallel (defined for the types with CPU work to do)
+        // Each job reads or decodes one asset then pushes its GPU upload to "uploads" (the counter tracks the jobs)
+        static void deserializeInJobs(const nlohmann::json&, UploadQueue& uploads, JobCounter& jobs);
+        // Declares the assets defined by the given json object (same form as "deserialize") without loading them,
+        // except the ones in "skip" (e.g. the ones being loaded). A declared asset is loaded the first time "get" resolves it
+        static void declare(const nlohmann::json& data, const nlohmann::json& skip = nlohmann::json::object()){
+            if(!data.is_object()) return;
+            for(auto& [name, desc] : data.items()){
+                if(!skip.contains(name) && !assets.count(name)) declared[name] = desc;
+            }
+        }
+        // Returns true if the asset was declared or loaded
+        static bool isDeclared(const std::string& name){
+            return assets.count(name) || declared.count(name);
+        }
+        // Returns true if the asset is loaded
+        static bool isLoaded(const std::string& name){
+            return assets.count(name) != 0;
+        }
+        // Returns true if the asset is loaded from the same description (so a new scene declaring it can keep it)
+        static bool isUnchanged(const std::string& name, const nlohmann::json& desc){
+            auto it = assets.find(name);
+            if(it == assets.end()) return false;
+            if constexpr(std::is_same_v<T, nlohmann::json>) return it->second && *it->second == desc;
+            else return records[name].desc == desc;
+        }
+        // Returns the names of the loaded assets
+        static std::vector<std::string> getLoadedNames(){
+            std::vector<std::string> names;
+            for(auto& [name, asset] : assets) names.push_back(name);
+            return names;
+        }
+        // Returns the names of the declared assets that were not loaded yet (sorted)
+        static std::vector<std::string> getUnloadedNames(){
+            std::vector<std::string> names;
+            for(auto& [name, desc] : declared) names.push_back(name);
+            std::sort(names.begin(), names.end());
+            return names;
+        }
         // This function find an asset by its name and returns a pointer to it
+        // If the asset was declared but not loaded yet, it is loaded now (on the calling thread which must have an OpenGL context)
         // If no asset with the given name was found, the function returns a nullptr
         // WARNING: never delete the asset returned by the function.
         // The asset could be shared with another object and
         // all the assets will be automatically cleared when the function "clear" is called
         static T* get(const std::string& name) {
             if(auto it = assets.find(name); it != assets.end()){
+                records[name].lastUse = AssetBudget::clock++;
                 return it->second;
             }
+            if(auto it = declared.find(name); it != declared.end()){
+                nlohmann::json desc = std::move(it->second);
+                declared.erase(it);
+                T* asset = load(name, desc);
+                store(name, asset, desc);
+                return asset;
+            }
             return nullptr;
         };
+        // Same as "get" but the returned handle keeps the asset from being evicted until it is destroyed
+        // The objects that keep their assets (e.g. the mesh renderers and the materials) should hold handles
+        static AssetHandle<T> acquire(const std::string& name){
+            T* asset = get(name);
+            if(!asset) return AssetHandle<T>();
+            return AssetHandle<T>(asset, name);
+        }
+
+        // Returns the memory used by the loaded assets of this type
+        static AssetMemory getMemory(){
+            AssetMemory total;
+            for(auto& [name, record] : records){
+                total.cpu += record.memory.cpu;
+                total.gpu += record.memory.gpu;
+            }
+            return total;
+        }
+        // Measures the loaded assets again (e.g. after the storage of some of them was released)
+        static void remeasure(){
+            for(auto& [name, record] : records){
+                T* asset = assets[name];
+                record.memory = asset ? measure(asset) : AssetMemory();
+            }
+        }
+        // Finds the loaded asset without references that was used the longest time ago (the asset must be evictable)
+        // Returns false if there is no such asset or if it was used after "lastUse"
+        static bool findLeastRecentlyUsed(std::string& name, uint64_t& lastUse){
+            bool found = false;
+            for(auto& [assetName, record] : records){
+                if(record.references > 0 || record.lastUse >= lastUse || !canEvict(assets[assetName])) continue;
+                name = assetName;
+                lastUse = record.lastUse;
+                found = true;
+            }
+            return found;
+        }
+        // Deletes a loaded asset and declares it again so the next "get" loads it again, returns the memory it freed
+        static AssetMemory evict(const std::string& name){
+            auto it = records.find(name);
+            if(it == records.end()) return AssetMemory();
+            AssetMemory memory = it->second.memory;
+            declared[name] = std::move(it->second.desc);
+            records.erase(it);
+            T* asset = assets[name];
+            assets.erase(name);
+            // Deleting the asset may release the handles it holds (e.g. the textures of a material)
+            destroy(asset);
+            return memory;
+        }
+        // Deletes a loaded asset without declaring it again, returns false if it isn't loaded or a handle still references it
+        static bool unload(const std::string& name){
+            auto it = assets.find(name);
+            if(it == assets.end()) return false;
+            if(auto record = records.find(name); record != records.end() && record->second.references > 0) return false;
+            T* asset = it->second;
+            assets.erase(it);
+            records.erase(name);
+            destroy(asset);
+            return true;
+        }
+        // Forgets the declared assets (a new scene declares its own)
+        static void clearDeclared(){
+            declared.clear();
+        }
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
             for(auto& [name, asset] : assets){
-                delete asset;
+                destroy(asset);
             }
             assets.clear();
+            declared.clear();
+            records.clear();
         }
     };
 
+    // Lets a handle be the value of a json field (see "reflection.hpp"): it is written as the name of its asset (null if it has none)
+    // and read by acquiring the asset with the given name
+    template<typename T>
+    void from_json(const nlohmann::json& data, AssetHandle<T>& handle){
+        handle = data.is_string() ? AssetLoader<T>::acquire(data.get<std::string>()) : AssetHandle<T>();
+    }
+    template<typename T>
+    void to_json(nlohmann::json& data, const AssetHandle<T>& handle){
+        if(handle.getName().empty()) data = nullptr;
+        else data = handle.getName();
+    }
+
+    // The shader programs are owned by the ShaderCache (defined in "asset-loader.cpp")
+    template<>
+    void AssetLoader<ShaderProgram>::clear();
+    template<> ShaderProgram* AssetLoader<ShaderProgram>::load(const std::string&, const nlohmann::json&);
+    template<> Texture2D* AssetLoader<Texture2D>::load(const std::string&, const nlohmann::json&);
+    template<> Sampler* AssetLoader<Sampler>::load(const std::string&, const nlohmann::json&);
+    template<> Mesh* AssetLoader<Mesh>::load(const std::string&, const nlohmann::json&);
+    template<> Material* AssetLoader<Material>::load(const std::string&, const nlohmann::json&);
+    template<> nlohmann::json* AssetLoader<nlohmann::json>::load(const std::string&, const nlohmann::json&);
+    template<> AssetMemory AssetLoader<ShaderProgram>::measure(const ShaderProgram*);
+    template<> AssetMemory AssetLoader<Texture2D>::measure(const Texture2D*);
+    template<> AssetMemory AssetLoader<Sampler>::measure(const Sampler*);
+    template<> AssetMemory AssetLoader<Mesh>::measure(const Mesh*);
+    template<> AssetMemory AssetLoader<Material>::measure(const Material*);
+    template<> AssetMemory AssetLoader<nlohmann::json>::measure(const nlohmann::json*);
+    // The shader programs are owned by the ShaderCache and the models are kept since they are their own descriptions
+    template<> bool AssetLoader<ShaderProgram>::canEvict(const ShaderProgram*);
+    template<> bool AssetLoader<nlohmann::json>::canEvict(const nlohmann::json*);
+    // The shader programs stay in the shader cache and the textures give their layer back to the texture array pool
+    template<> void AssetLoader<ShaderProgram>::destroy(ShaderProgram*);
+    template<> void AssetLoader<Texture2D>::destroy(Texture2D*);
+
     // Given a json holding the data for all the assets
-    // This function will call "AssetLoader<T>::deserialize" for all the different asset types T
+    // This function will call "AssetLoader<T>::deserialize" (or "deserializeInJobs") for all the different asset types T
+    // The CPU work of all the types runs in parallel and the uploads are run by the calling thread (which must own a context)
+    // except the meshes when "AssetLoader<Mesh>::separateThread" is set, their uploads go to "LoadingScreen::meshUploads"
+    // since their vertex arrays can't be shared between contexts
     // For example, a json in the form {"shaders": ... , "textures": ... } will call "deserialize" for:
     // AssetLoader<ShaderProgram> and AssetLoader<Texture2D>
-    void deserializeAllAssets(const nlohmann::json& assetData);
+    // If the world of the scene is given, only the assets it references are loaded (see "filterReferencedAssets")
+    // and the other assets are only declared, so they are loaded if something resolves them later
+    void deserializeAllAssets(const nlohmann::json& assetData, const nlohmann::json* world = nullptr);
+    // Same as "AssetLoader<Mesh>::deserializeInJobs" but the meshes are created with the given vertex layout
+    // instead of "Mesh::layout" (e.g. the meshes of the next scene preloaded while the current one resolves its own meshes)
+    void deserializeMeshesInJobs(const nlohmann::json& data, const VertexLayout& layout, UploadQueue& uploads, JobCounter& jobs);
+    // Same as "deserializeAllAssets" with the assets referenced by the world already filtered (e.g. by the scene compiler)
+    void deserializeReferencedAssets(const nlohmann::json& assetData, const nlohmann::json& referencedAssets);
+    // Returns the part of "assetData" needed by the given world: the meshes, materials and models its entities
+    // (and the models they load) reference, then the shaders, textures and samplers of these materials
+    nlohmann::json filterReferencedAssets(const nlohmann::json& assetData, const nlohmann::json& world);
+    // Prints the declared assets that were never loaded
+    void reportUnusedAssets();
+    // Compares the assets of the next scene with the loaded ones and unloads the loaded assets it doesn't have
+    // (or has with another description, including the materials whose shader, sampler or textures changed)
+    // The others stay loaded so "deserializeAllAssets" only loads what changed. The declared assets are forgotten.
+    // Must be called by the thread that owns the OpenGL context once nothing references the assets (e.g. the world was cleared)
+    // Returns the number of assets kept
+    size_t retainSharedAssets(const nlohmann::json& assetData);
+    // Returns the part of "assetData" that is not loaded yet
+    nlohmann::json filterLoadedAssets(const nlohmann::json& assetData);
+    // Returns the memory used by the loaded assets of all the types
+    AssetMemory getAssetMemory();
+    // Prints the CPU and GPU memory used by the loaded assets of each type
+    void reportAssetMemory();
+    // While the loaded assets use more memory than "AssetBudget::limit", evicts the least recently used asset
+    // that no handle references (it is loaded again the next time something resolves it)
+    // Must be called by the thread that owns the OpenGL context while no assets are loading (e.g. once per frame)
+    void enforceAssetBudget();
+    // Sets the staging ring used by the texture uploads queued by "AssetLoader<Texture2D>::deserializeInJobs"
+    // while they run (null to upload the textures directly), "deserializeAllAssets" uses its own
+    void setTextureStaging(StagingRing* ring);
     // This will call "AssetLoader<T>::clear" for all the different asset types T
     void clearAllAssets();
 }
\ No newline at end of file
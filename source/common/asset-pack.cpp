@@ -0,0 +1,354 @@
+#include "asset-pack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace portal {
+
+    // FNV-1a (the same hash as the mesh cache), used for the content hash of the packed files
+    static uint64_t hashBytes(const uint8_t* bytes, size_t size){
+        uint64_t hash = 14695981039346656037ull;
+        for(size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // The LZ4 block format: a sequence of (token, literals, match) where the token holds the literal count and the match length
+    // (extended by bytes of 255 when they don't fit in 4 bits) and the match is an offset back into the decompressed data.
+    // The last sequence only has literals. The compressor is a greedy single pass with a hash table of 4 bytes sequences,
+    // it compresses less than the reference one but the blocks are compatible with any LZ4 decoder.
+    namespace lz4 {
+
+        static uint32_t read32(const uint8_t* bytes){
+            uint32_t value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+
+        // The largest block the compression of "size" bytes can produce
+        static size_t compressBound(size_t size){
+            return size + size / 255 + 16;
+        }
+
+        static size_t compress(const uint8_t* source, size_t size, uint8_t* destination){
+            // The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+            const size_t lastLiterals = 5, matchStartLimit = 12;
+            uint8_t* out = destination;
+            size_t anchor = 0;
+            auto writeLength = [&](size_t length){
+                for(; length >= 255; length -= 255) *out++ = 255;
+                *out++ = (uint8_t)length;
+            };
+            // Writes the literals from the anchor to "literalEnd" followed by the match (none for the last sequence)
+            auto writeSequence = [&](size_t literalEnd, size_t matchLength, size_t offset){
+                size_t literals = literalEnd - anchor;
+                uint8_t* token = out++;
+                *token = (uint8_t)(std::min<size_t>(literals, 15) << 4);
+                if(literals >= 15) writeLength(literals - 15);
+                std::memcpy(out, source + anchor, literals);
+                out += literals;
+                if(matchLength == 0) return;
+                *out++ = (uint8_t)(offset & 0xFF);
+                *out++ = (uint8_t)(offset >> 8);
+                size_t extra = matchLength - 4;
+                *token |= (uint8_t)std::min<size_t>(extra, 15);
+                if(extra >= 15) writeLength(extra - 15);
+            };
+            if(size > matchStartLimit){
+                std::vector<int64_t> table(1 << 16, -1);
+                size_t position = 0;
+                while(position <= size - matchStartLimit){
+                    uint32_t sequence = read32(source + position);
+                    uint32_t slot = (sequence * 2654435761u) >> 16;
+                    int64_t candidate = table[slot];
+                    table[slot] = (int64_t)position;
+                    if(candidate >= 0 && position - candidate <= 65535 && read32(source + candidate) == sequence){
+                        size_t length = 4;
+                        while(position + length < size - lastLiterals && source[candidate + length] == source[position + length]) length++;
+                        writeSequence(position, length, position - (size_t)candidate);
+                        position += length;
+                        anchor = position;
+                    } else {
+                        position++;
+                    }
+                }
+            }
+            writeSequence(size, 0, 0);
+            return out - destination;
+        }
+
+        static bool decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size){
+            const uint8_t* in = source;
+            const uint8_t* inEnd = source + sourceSize;
+            uint8_t* out = destination;
+            uint8_t* outEnd = destination + size;
+            auto readLength = [&](size_t& length){
+                uint8_t byte;
+                do {
+                    if(in >= inEnd) return false;
+                    byte = *in++;
+                    length += byte;
+                } while(byte == 255);
+                return true;
+            };
+            while(in < inEnd){
+                uint8_t token = *in++;
+                size_t literals = token >> 4;
+                if(literals == 15 && !readLength(literals)) return false;
+                if(literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out)) return false;
+                std::memcpy(out, in, literals);
+                in += literals;
+                out += literals;
+                // The last sequence has no match
+                if(in == inEnd) break;
+                if(inEnd - in < 2) return false;
+                size_t offset = in[0] | (in[1] << 8);
+                in += 2;
+                if(offset == 0 || offset > (size_t)(out - destination)) return false;
+                size_t length = token & 15;
+                if(length == 15 && !readLength(length)) return false;
+                length += 4;
+                if(length > (size_t)(outEnd - out)) return false;
+                // A match that overlaps the bytes it writes (e.g. a repeated pattern) is copied byte by byte
+                const uint8_t* match = out - offset;
+                if(offset >= length) std::memcpy(out, match, length);
+                else for(size_t i = 0; i < length; i++) out[i] = match[i];
+                out += length;
+            }
+            return out == outEnd;
+        }
+
+    }
+
+    std::string AssetPack::normalize(const std::string& path){
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    bool AssetPack::mount(const std::string& path){
+        unmount();
+        if(!file.open(path)){
+            std::cerr << "Couldn't open the asset pack: " << path << std::endl;
+            return false;
+        }
+        const uint8_t* bytes = file.getData();
+        size_t size = file.getSize();
+        PackHeader header;
+        bool valid = size >= sizeof(PackHeader);
+        if(valid){
+            std::memcpy(&header, bytes, sizeof(header));
+            valid = std::memcmp(header.magic, PackMagic, 4) == 0 && header.version == PackVersion &&
+                    header.entriesOffset <= size && header.entryCount <= (size - header.entriesOffset) / sizeof(PackEntry) &&
+                    header.pathsOffset <= size;
+        }
+        if(valid){
+            const PackEntry* packEntries = (const PackEntry*)(bytes + header.entriesOffset);
+            const char* paths = (const char*)(bytes + header.pathsOffset);
+            for(uint32_t i = 0; i < header.entryCount && valid; i++){
+                const PackEntry& entry = packEntries[i];
+                // The ranges are checked as "length <= remaining" so a corrupted offset can't overflow the sum.
+                // A stored entry is read as "size" bytes from its range, so both sizes must match.
+                valid = entry.pathOffset <= size - header.pathsOffset && entry.pathSize <= size - header.pathsOffset - entry.pathOffset &&
+                        entry.offset <= size && entry.storedSize <= size - entry.offset &&
+                        (entry.compression != PackCompression::Stored || entry.storedSize == entry.size);
+                if(valid) entries[std::string(paths + entry.pathOffset, entry.pathSize)] = &entry;
+            }
+        }
+        if(!valid){
+            std::cerr << "Invalid asset pack: " << path << std::endl;
+            unmount();
+            return false;
+        }
+        std::cout << "Mounted the asset pack " << path << " (" << entries.size() << " files)" << std::endl;
+        return true;
+    }
+
+    void AssetPack::unmount(){
+        entries.clear();
+        file.close();
+    }
+
+    const PackEntry* AssetPack::find(const std::string& path){
+        if(entries.empty()) return nullptr;
+        auto it = entries.find(normalize(path));
+        return it == entries.end() ? nullptr : it->second;
+    }
+
+    bool AssetPack::decompress(const PackEntry* entry, uint8_t* destination){
+        const uint8_t* stored = getStoredData(entry);
+        if(entry->compression == PackCompression::Stored){
+            std::memcpy(destination, stored, entry->size);
+            return true;
+        }
+        return entry->compression == PackCompression::LZ4 && lz4::decompress(stored, entry->storedSize, destination, entry->size);
+    }
+
+    bool AssetPack::verify(){
+        size_t corrupted = 0;
+        std::vector<uint8_t> buffer;
+        for(auto& [path, entry] : entries){
+            const uint8_t* content = getStoredData(entry);
+            if(entry->compression != PackCompression::Stored){
+                buffer.resize(entry->size);
+                if(!decompress(entry, buffer.data())){
+                    std::cerr << "Corrupted packed file: " << path << std::endl;
+                    corrupted++;
+                    continue;
+                }
+                content = buffer.data();
+            }
+            if(hashBytes(content, entry->size) != entry->contentHash){
+                std::cerr << "Corrupted packed file: " << path << std::endl;
+                corrupted++;
+            }
+        }
+        std::cout << "Verified " << entries.size() << " packed files, " << corrupted << " corrupted" << std::endl;
+        return corrupted == 0;
+    }
+
+    bool AssetPack::build(const std::vector<std::string>& folders, const std::string& packPath, double minSaving){
+        auto start = std::chrono::high_resolution_clock::now();
+        // Collect the files sorted by path so the same files always produce the same pack
+        std::vector<std::string> paths;
+        std::error_code error;
+        std::string packFile = normalize(packPath);
+        for(auto& folder : folders){
+            if(!std::filesystem::is_directory(folder, error)) continue;
+            for(auto& item : std::filesystem::recursive_directory_iterator(folder, error)){
+                if(!item.is_regular_file()) continue;
+                std::string path = normalize(item.path().string());
+                if(path != packFile) paths.push_back(path);
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+        auto align = [](uint64_t offset){ return (offset + 15) & ~(uint64_t)15; };
+        PackHeader header = {};
+        std::memcpy(header.magic, PackMagic, 4);
+        header.version = PackVersion;
+        header.entryCount = (uint32_t)paths.size();
+        header.entriesOffset = align(sizeof(PackHeader));
+        header.pathsOffset = align(header.entriesOffset + paths.size() * sizeof(PackEntry));
+        std::vector<PackEntry> packEntries(paths.size());
+        std::string pathData;
+        for(size_t i = 0; i < paths.size(); i++){
+            packEntries[i].pathOffset = (uint32_t)pathData.size();
+            packEntries[i].pathSize = (uint32_t)paths[i].size();
+            pathData += paths[i];
+        }
+
+        // Write to a temporary file first so a failed build never leaves a partial pack
+        std::string temporaryPath = packPath + ".tmp";
+        std::ofstream out(temporaryPath, std::ios::binary);
+        if(!out){
+            std::cerr << "Couldn't open file: " << temporaryPath << std::endl;
+            return false;
+        }
+        static const char padding[16] = {};
+        auto writeAt = [&](uint64_t offset, const void* bytes, size_t size){
+            // The gap can be larger than the padding (e.g. the entries table before the paths)
+            for(uint64_t gap = offset - (uint64_t)out.tellp(); gap > 0 && out;){
+                uint64_t chunk = std::min<uint64_t>(gap, sizeof(padding));
+                out.write(padding, (std::streamsize)chunk);
+                gap -= chunk;
+            }
+            out.write((const char*)bytes, size);
+        };
+        // The entries are written once the files are, the paths are known now
+        out.write((const char*)&header, sizeof(header));
+        writeAt(header.pathsOffset, pathData.data(), pathData.size());
+
+        uint64_t originalBytes = 0, storedBytes = 0;
+        size_t compressedCount = 0;
+        std::vector<uint8_t> compressed;
+        for(size_t i = 0; i < paths.size(); i++){
+            PackEntry& entry = packEntries[i];
+            MappedFile source;
+            const uint8_t* content = nullptr;
+            size_t size = 0;
+            if(std::filesystem::file_size(paths[i], error) > 0 && !error){
+                if(!source.open(paths[i])){
+                    std::cerr << "Couldn't read file: " << paths[i] << std::endl;
+                    return false;
+                }
+                content = source.getData();
+                size = source.getSize();
+            }
+            entry.size = size;
+            entry.contentHash = hashBytes(content, size);
+            entry.compression = PackCompression::Stored;
+            entry.storedSize = size;
+            const uint8_t* stored = content;
+            if(size > 0){
+                compressed.resize(lz4::compressBound(size));
+                size_t compressedSize = lz4::compress(content, size, compressed.data());
+                if(compressedSize <= size * (1.0 - minSaving)){
+                    entry.compression = PackCompression::LZ4;
+                    entry.storedSize = compressedSize;
+                    stored = compressed.data();
+                    compressedCount++;
+                }
+            }
+            entry.offset = align((uint64_t)out.tellp());
+            writeAt(entry.offset, stored, entry.storedSize);
+            originalBytes += entry.size;
+            storedBytes += entry.storedSize;
+        }
+        out.seekp(header.entriesOffset);
+        out.write((const char*)packEntries.data(), packEntries.size() * sizeof(PackEntry));
+        if(!out){
+            std::cerr << "Couldn't write file: " << temporaryPath << std::endl;
+            return false;
+        }
+        out.close();
+        std::filesystem::rename(temporaryPath, packPath, error);
+        if(error){
+            std::cerr << "Couldn't write file: " << packPath << " (" << error.message() << ")" << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        std::cout << "Packed " << paths.size() << " files (" << compressedCount << " compressed) into " << packPath << ": "
+                  << originalBytes / (1024.0 * 1024.0) << " MB -> " << storedBytes / (1024.0 * 1024.0) << " MB in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+        return true;
+    }
+
+    bool AssetFile::open(const std::string& path, bool usePack){
+        close();
+        if(const PackEntry* entry = usePack ? AssetPack::find(path) : nullptr){
+            if(entry->compression == PackCompression::Stored){
+                data = AssetPack::getStoredData(entry);
+            } else {
+                buffer.resize(entry->size);
+                if(!AssetPack::decompress(entry, buffer.data())){
+                    std::cerr << "Corrupted packed file: " << path << std::endl;
+                    buffer.clear();
+                    return false;
+                }
+                data = buffer.data();
+            }
+            size = entry->size;
+            packed = true;
+            return true;
+        }
+        if(!mapping.open(path)) return false;
+        data = mapping.getData();
+        size = mapping.getSize();
+        return true;
+    }
+
+    void AssetFile::close(){
+        mapping.close();
+        buffer = std::vector<uint8_t>();
+        data = nullptr;
+        size = 0;
+        packed = false;
+    }
+
+}
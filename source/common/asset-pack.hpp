@@ -0,0 +1,108 @@
+#pragma once
+
+#include "mapped-file.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace portal {
+
+    // A pack (".pak") holds the asset files in a single file that is memory mapped when it is mounted:
+    // - The header
+    // - The table of contents (an entry for each file)
+    // - The paths of the files (normalized, see "AssetPack::normalize")
+    // - The content of each file, stored as is or compressed as an LZ4 block
+    // Every section and every file starts at a 16 bytes aligned offset, so the stored files can be
+    // given to the decoders and the uploads directly from the mapping
+    struct PackHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t entriesOffset;
+        uint64_t pathsOffset;
+    };
+
+    enum class PackCompression : uint32_t {
+        Stored = 0,
+        LZ4 = 1
+    };
+
+    struct PackEntry {
+        // The offset of the content in the pack and its size in the pack (compressed or not)
+        uint64_t offset;
+        uint64_t storedSize;
+        // The size of the original file and the FNV-1a hash of its content
+        uint64_t size;
+        uint64_t contentHash;
+        // The path of the file in the paths section
+        uint32_t pathOffset;
+        uint32_t pathSize;
+        PackCompression compression;
+        uint32_t reserved;
+    };
+
+    inline constexpr char PackMagic[4] = {'P', 'P', 'A', 'K'};
+    inline constexpr uint32_t PackVersion = 1;
+
+    // This static class gives access to the files of the mounted pack (use "AssetFile" to read an asset from the pack or the disk)
+    class AssetPack {
+        static inline MappedFile file;
+        // The entry of each file by its normalized path
+        static inline std::unordered_map<std::string, const PackEntry*> entries;
+    public:
+        // Returns the path in the form used by the table of contents (e.g. "assets/models/a.obj" for "./assets//models/a.obj")
+        static std::string normalize(const std::string& path);
+
+        // Maps the pack and reads its table of contents, returns false if the pack is missing or invalid
+        // It must be mounted before the assets are loaded and stay mounted while they use its files
+        static bool mount(const std::string& path);
+        static void unmount();
+        static bool isMounted() { return file.isOpen(); }
+
+        // Returns the entry of the file with the given path (nullptr if the pack doesn't have it)
+        static const PackEntry* find(const std::string& path);
+        // Returns the content of the entry as it is stored in the pack (compressed if the entry is compressed)
+        static const uint8_t* getStoredData(const PackEntry* entry) { return file.getData() + entry->offset; }
+        // Decompresses the entry into "destination" which must hold "entry->size" bytes, returns false if the entry is corrupted
+        static bool decompress(const PackEntry* entry, uint8_t* destination);
+        // Checks the content hash of every entry of the mounted pack (prints the corrupted ones)
+        static bool verify();
+
+        // Writes the files of the given folders (recursively) into a pack at "packPath"
+        // The files are compressed if LZ4 saves at least "minSaving" of their size (already compressed images are stored as is)
+        static bool build(const std::vector<std::string>& folders, const std::string& packPath, double minSaving = 0.1);
+    };
+
+    // A read-only view of an asset file, from the mounted pack if it has the file or from the disk otherwise
+    // The stored files of the pack and the files on the disk are mapped (no copy), the compressed files are decompressed into a buffer
+    class AssetFile {
+        MappedFile mapping;
+        std::vector<uint8_t> buffer;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        bool packed = false;
+    public:
+        AssetFile() = default;
+        // Opens the given file, use "isOpen" to check if it succeeded
+        explicit AssetFile(const std::string& path) { open(path); }
+
+        // Opens the file from the pack or the disk, returns false if neither has it (or the packed file is corrupted)
+        // The pack is skipped if "usePack" is false (e.g. to read back a file that was just written to the disk)
+        bool open(const std::string& path, bool usePack = true);
+        void close();
+
+        bool isOpen() const { return data != nullptr; }
+        // True if the file was read from the pack
+        bool isPacked() const { return packed; }
+        const uint8_t* getData() const { return data; }
+        size_t getSize() const { return size; }
+
+        AssetFile(const AssetFile&) = delete;
+        AssetFile& operator=(const AssetFile&) = delete;
+    };
+
+}
@@ -0,0 +1,501 @@
+#include "compiled-scene.hpp"
+
+#include "asset-loader.hpp"
+#include "deserialize-utils.hpp"
+#include "ecs/world.hpp"
+#include "ecs/button.hpp"
+#include "ecs/reflection.hpp"
+#include "components/component-deserializer.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace portal {
+
+    // Builds the tables of a compiled scene from a json world
+    struct SceneCompiler {
+        const nlohmann::json& assets;
+        std::vector<CompiledString> strings;
+        std::string stringData;
+        std::unordered_map<std::string, uint32_t> stringIndices;
+        std::vector<CompiledAsset> assetTable;
+        std::map<std::pair<CompiledAssetType, std::string>, uint32_t> assetIndices;
+        std::vector<CompiledEntity> entities;
+        std::vector<CompiledComponent> components;
+        std::vector<uint8_t> blobs;
+        // The entity range of each model, compiled the first time it is loaded
+        std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> models;
+        std::unordered_set<std::string> compilingModels;
+        std::unordered_set<std::string> entityNames, doors;
+        size_t errors = 0;
+
+        explicit SceneCompiler(const nlohmann::json& assets) : assets(assets) {}
+
+        uint32_t addString(const std::string& value){
+            auto [it, added] = stringIndices.emplace(value, (uint32_t)strings.size());
+            if(added){
+                strings.push_back({(uint32_t)stringData.size(), (uint32_t)value.size()});
+                stringData += value;
+            }
+            return it->second;
+        }
+
+        // Returns the index of the asset in the asset table (-1 for an empty name)
+        int32_t addAsset(CompiledAssetType type, const std::string& name){
+            if(name.empty()) return -1;
+            const char* assetType = type == CompiledAssetType::Mesh ? "meshes" : "materials";
+            if(!assets.contains(assetType) || !assets[assetType].contains(name))
+                std::cerr << "Warning: the scene doesn't declare the " << assetType << " \"" << name << "\"" << std::endl;
+            auto [it, added] = assetIndices.emplace(std::make_pair(type, name), (uint32_t)assetTable.size());
+            if(added) assetTable.push_back({type, addString(name)});
+            return (int32_t)it->second;
+        }
+
+        void error(const std::string& message){
+            std::cerr << "Error: " << message << std::endl;
+            errors++;
+        }
+
+        static glm::vec3 readVec3(const nlohmann::json& data, const char* key, glm::vec3 value){
+            return data.is_object() ? data.value(key, value) : value;
+        }
+
+        // Writes the packed fields of a component read from json (the component has no owner, so it is not set up)
+        template<typename T>
+        static void packComponent(BlobWriter& writer, const nlohmann::json& data){
+            T component;
+            readFields(data, component);
+            component.pack(writer);
+        }
+
+        // Returns the type of the component if it is compiled, false if it is skipped
+        bool getType(const nlohmann::json& data, CompiledComponentType& type){
+            std::string typeName = data.is_object() ? data.value("type", "") : "";
+            if(typeName == CameraComponent::getID()) type = CompiledComponentType::Camera;
+            else if(typeName == FreeCameraControllerComponent::getID()) type = CompiledComponentType::FreeCameraController;
+            else if(typeName == MovementComponent::getID()) type = CompiledComponentType::Movement;
+            else if(typeName == MeshRendererComponent::getID()) type = CompiledComponentType::MeshRenderer;
+            else if(typeName == RigidBodyComponent::getID()) type = CompiledComponentType::RigidBody;
+            else if(typeName == LightComponent::getID()) type = CompiledComponentType::Light;
+            else if(typeName == AnimationComponent::getID()) type = CompiledComponentType::Animation;
+            else if(typeName == "ModelLoader"){
+                std::string model = data.value("model", "");
+                if(!assets.contains("models") || !assets["models"].contains(model)){
+                    std::cerr << "Warning: the scene doesn't declare the model \"" << model << "\", its loader is skipped" << std::endl;
+                    return false;
+                }
+                type = CompiledComponentType::Model;
+            } else {
+                std::cerr << "Warning: unknown component type \"" << typeName << "\" is skipped" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Writes the packed data of the component, the fields of the components are packed as they are read from json
+        // (see "reflection.hpp") while the mesh renderers reference the asset table
+        void compileComponent(CompiledComponentType type, const nlohmann::json& data, uint32_t index){
+            // The entities of a model are compiled before its data is written since they write their own component data
+            std::pair<uint32_t, uint32_t> model;
+            if(type == CompiledComponentType::Model) model = compileModel(data["model"].get<std::string>());
+            size_t offset = blobs.size();
+            BlobWriter writer{blobs};
+            switch(type){
+                case CompiledComponentType::Camera: packComponent<CameraComponent>(writer, data); break;
+                case CompiledComponentType::FreeCameraController: packComponent<FreeCameraControllerComponent>(writer, data); break;
+                case CompiledComponentType::Movement: packComponent<MovementComponent>(writer, data); break;
+                case CompiledComponentType::MeshRenderer: {
+                    if(!data.contains("mesh") || !data["mesh"].is_string()) error("a mesh renderer has no mesh");
+                    writer.write(addAsset(CompiledAssetType::Mesh, data.value("mesh", "")));
+                    writer.write(addAsset(CompiledAssetType::Material, data.value("material", "")));
+                    std::vector<int32_t> slots;
+                    if(auto it = data.find("materials"); it != data.end() && it->is_array()){
+                        for(auto& name : *it)
+                            slots.push_back(name.is_string() ? addAsset(CompiledAssetType::Material, name.get<std::string>()) : -1);
+                    }
+                    writer.write((uint32_t)slots.size());
+                    for(int32_t slot : slots) writer.write(slot);
+                    break;
+                }
+                case CompiledComponentType::Light: packComponent<LightComponent>(writer, data); break;
+                case CompiledComponentType::RigidBody: {
+                    RigidBodyComponent rigidBody;
+                    readFields(data, rigidBody);
+                    if(data.contains("collider") && rigidBody.desc.collider.shape == ColliderDesc::Shape::None)
+                        std::cerr << "Warning: unknown collider type \"" << data["collider"].value("type", "") << "\"" << std::endl;
+                    rigidBody.pack(writer);
+                    break;
+                }
+                case CompiledComponentType::Animation: packComponent<AnimationComponent>(writer, data); break;
+                case CompiledComponentType::Model: {
+                    writer.write(model.first);
+                    writer.write(model.second);
+                    break;
+                }
+            }
+            components[index] = {type, (uint32_t)(blobs.size() - offset), offset};
+        }
+
+        std::pair<uint32_t, uint32_t> compileModel(const std::string& name){
+            if(auto it = models.find(name); it != models.end()) return it->second;
+            if(!compilingModels.insert(name).second){
+                error("the model \"" + name + "\" loads itself");
+                return {0, 0};
+            }
+            auto range = compileEntities(assets["models"][name]);
+            compilingModels.erase(name);
+            models[name] = range;
+            return range;
+        }
+
+        // Compiles a list of entities (same order as "World::deserialize") and returns its range in the entity table
+        std::pair<uint32_t, uint32_t> compileEntities(const nlohmann::json& data){
+            if(!data.is_array()) return {0, 0};
+            uint32_t first = (uint32_t)entities.size();
+            entities.resize(entities.size() + data.size());
+            for(size_t i = 0; i < data.size(); i++){
+                const nlohmann::json& entityData = data[i];
+                uint32_t index = first + (uint32_t)i;
+                CompiledEntity entity = {};
+                entity.name = entity.door = -1;
+                if(!entityData.is_object()){
+                    entities[index] = entity;
+                    continue;
+                }
+                if(entityData.contains("name")){
+                    std::string name = entityData.value("name", "");
+                    entity.name = addString(name);
+                    entityNames.insert(name);
+                }
+                std::string type = entityData.value("type", "Regular");
+                auto entityType = EntityFactory::stringToEntityType(type);
+                if(entityType == EntityFactory::EntityType::Regular && type != "Regular")
+                    std::cerr << "Warning: unknown entity type \"" << type << "\" is created as a regular entity" << std::endl;
+                entity.type = (uint32_t)entityType;
+                glm::vec3 position = readVec3(entityData, "position", glm::vec3(0.0f));
+                glm::vec3 rotation = glm::radians(readVec3(entityData, "rotation", glm::vec3(0.0f)));
+                glm::vec3 scale = readVec3(entityData, "scale", glm::vec3(1.0f));
+                for(int c = 0; c < 3; c++){
+                    entity.position[c] = position[c];
+                    entity.rotation[c] = rotation[c];
+                    entity.scale[c] = scale[c];
+                }
+                if(entityType == EntityFactory::EntityType::Button){
+                    if(auto action = entityData.find("action"); action != entityData.end() && action->is_object() && action->contains("Door")){
+                        std::string door = (*action)["Door"].get<std::string>();
+                        entity.door = addString(door);
+                        doors.insert(door);
+                    }
+                }
+                // Reserve the components first, the models compile their entities while their loader is compiled
+                std::vector<std::pair<CompiledComponentType, const nlohmann::json*>> compiled;
+                if(auto list = entityData.find("components"); list != entityData.end() && list->is_array()){
+                    for(auto& component : *list){
+                        CompiledComponentType componentType;
+                        if(getType(component, componentType)) compiled.emplace_back(componentType, &component);
+                    }
+                }
+                entity.firstComponent = (uint32_t)components.size();
+                entity.componentCount = (uint32_t)compiled.size();
+                components.resize(components.size() + compiled.size());
+                for(size_t c = 0; c < compiled.size(); c++)
+                    compileComponent(compiled[c].first, *compiled[c].second, entity.firstComponent + (uint32_t)c);
+                if(entityData.contains("children")){
+                    auto [firstChild, childCount] = compileEntities(entityData["children"]);
+                    entity.firstChild = firstChild;
+                    entity.childCount = childCount;
+                }
+                entities[index] = entity;
+            }
+            return {first, (uint32_t)data.size()};
+        }
+    };
+
+    bool CompiledScene::isCompiled(const std::string& path){
+        return std::filesystem::path(path).extension() == ".pscene";
+    }
+
+    bool CompiledScene::compile(const nlohmann::json& config, const std::string& path){
+        auto start = std::chrono::high_resolution_clock::now();
+        // The world is in the scene of the app config or at the root of a scene file
+        std::string scenePointer;
+        if(config.contains("scene") && config["scene"].is_object() && config["scene"].contains("world")) scenePointer = "/scene";
+        else if(!config.is_object() || !config.contains("world")){
+            std::cerr << "Error: the config has no world to compile" << std::endl;
+            return false;
+        }
+        nlohmann::json document = config;
+        nlohmann::json& scene = scenePointer.empty() ? document : document.at(nlohmann::json::json_pointer(scenePointer));
+        nlohmann::json world = std::move(scene["world"]);
+        scene.erase("world");
+        const nlohmann::json& assets = scene.contains("assets") ? scene["assets"] : nlohmann::json::object();
+
+        SceneCompiler compiler(assets);
+        auto [roots, rootCount] = compiler.compileEntities(world);
+        for(auto& door : compiler.doors){
+            if(!compiler.entityNames.count(door)) compiler.error("a button opens the door \"" + door + "\" which is not in the world");
+        }
+        if(compiler.errors > 0){
+            std::cerr << "The scene has " << compiler.errors << " errors, it was not compiled" << std::endl;
+            return false;
+        }
+        // The models are compiled into the entity table, so they are not loaded with the other assets
+        nlohmann::json referencedAssets = filterReferencedAssets(assets, world);
+        referencedAssets.erase("models");
+        std::vector<uint8_t> documentData = nlohmann::json::to_cbor({
+            {"document", document}, {"scenePointer", scenePointer}, {"referencedAssets", referencedAssets}
+        });
+
+        auto align = [](uint64_t offset){ return (offset + 15) & ~(uint64_t)15; };
+        CompiledSceneHeader header = {};
+        std::memcpy(header.magic, CompiledSceneMagic, 4);
+        header.version = CompiledSceneVersion;
+        header.stringCount = (uint32_t)compiler.strings.size();
+        header.assetCount = (uint32_t)compiler.assetTable.size();
+        header.entityCount = (uint32_t)compiler.entities.size();
+        header.componentCount = (uint32_t)compiler.components.size();
+        header.rootCount = rootCount;
+        header.stringsOffset = align(sizeof(CompiledSceneHeader));
+        header.stringDataOffset = align(header.stringsOffset + compiler.strings.size() * sizeof(CompiledString));
+        header.assetsOffset = align(header.stringDataOffset + compiler.stringData.size());
+        header.entitiesOffset = align(header.assetsOffset + compiler.assetTable.size() * sizeof(CompiledAsset));
+        header.componentsOffset = align(header.entitiesOffset + compiler.entities.size() * sizeof(CompiledEntity));
+        header.blobsOffset = align(header.componentsOffset + compiler.components.size() * sizeof(CompiledComponent));
+        header.blobsSize = compiler.blobs.size();
+        header.documentOffset = align(header.blobsOffset + header.blobsSize);
+        header.documentSize = documentData.size();
+
+        // Write to a temporary file first so a failed compilation never leaves a partial scene
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            if(!file){
+                std::cerr << "Couldn't open file: " << temporaryPath << std::endl;
+                return false;
+            }
+            static const char padding[16] = {};
+            auto writeAt = [&](uint64_t offset, const void* bytes, size_t size){
+                file.write(padding, offset - (uint64_t)file.tellp());
+                file.write((const char*)bytes, size);
+            };
+            file.write((const char*)&header, sizeof(header));
+            writeAt(header.stringsOffset, compiler.strings.data(), compiler.strings.size() * sizeof(CompiledString));
+            writeAt(header.stringDataOffset, compiler.stringData.data(), compiler.stringData.size());
+            writeAt(header.assetsOffset, compiler.assetTable.data(), compiler.assetTable.size() * sizeof(CompiledAsset));
+            writeAt(header.entitiesOffset, compiler.entities.data(), compiler.entities.size() * sizeof(CompiledEntity));
+            writeAt(header.componentsOffset, compiler.components.data(), compiler.components.size() * sizeof(CompiledComponent));
+            writeAt(header.blobsOffset, compiler.blobs.data(), compiler.blobs.size());
+            writeAt(header.documentOffset, documentData.data(), documentData.size());
+            if(!file){
+                std::cerr << "Couldn't write file: " << temporaryPath << std::endl;
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error){
+            std::cerr << "Couldn't write file: " << path << " (" << error.message() << ")" << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        std::cout << "Compiled the scene into " << path << ": " << compiler.entities.size() << " entities, " << compiler.components.size()
+                  << " components, " << compiler.assetTable.size() << " assets, " << compiler.models.size() << " models in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+        return true;
+    }
+
+    bool CompiledScene::load(const std::string& path){
+        if(!file.open(path)){
+            std::cerr << "Couldn't open the compiled scene: " << path << std::endl;
+            return false;
+        }
+        const uint8_t* bytes = file.getData();
+        uint64_t size = file.getSize();
+        auto fits = [&](uint64_t offset, uint64_t length){ return offset <= size && length <= size - offset; };
+        header = (const CompiledSceneHeader*)bytes;
+        bool valid = size >= sizeof(CompiledSceneHeader) && std::memcmp(header->magic, CompiledSceneMagic, 4) == 0 &&
+                     header->version == CompiledSceneVersion &&
+                     fits(header->stringsOffset, (uint64_t)header->stringCount * sizeof(CompiledString)) &&
+                     fits(header->assetsOffset, (uint64_t)header->assetCount * sizeof(CompiledAsset)) &&
+                     fits(header->entitiesOffset, (uint64_t)header->entityCount * sizeof(CompiledEntity)) &&
+                     fits(header->componentsOffset, (uint64_t)header->componentCount * sizeof(CompiledComponent)) &&
+                     fits(header->blobsOffset, header->blobsSize) && fits(header->documentOffset, header->documentSize) &&
+                     header->rootCount <= header->entityCount;
+        if(valid){
+            assets = (const CompiledAsset*)(bytes + header->assetsOffset);
+            entities = (const CompiledEntity*)(bytes + header->entitiesOffset);
+            components = (const CompiledComponent*)(bytes + header->componentsOffset);
+            blobs = bytes + header->blobsOffset;
+            const CompiledString* stringTable = (const CompiledString*)(bytes + header->stringsOffset);
+            strings.clear();
+            strings.reserve(header->stringCount);
+            for(uint32_t i = 0; i < header->stringCount && valid; i++){
+                valid = fits(header->stringDataOffset + stringTable[i].offset, stringTable[i].size);
+                if(valid) strings.emplace_back((const char*)bytes + header->stringDataOffset + stringTable[i].offset, stringTable[i].size);
+            }
+            // Check the indices once so the instantiation can trust them
+            auto validString = [&](int32_t index){ return index < 0 || (uint32_t)index < header->stringCount; };
+            for(uint32_t i = 0; i < header->assetCount && valid; i++) valid = validString(assets[i].name);
+            for(uint32_t i = 0; i < header->entityCount && valid; i++){
+                const CompiledEntity& entity = entities[i];
+                valid = validString(entity.name) && validString(entity.door) &&
+                        (uint64_t)entity.firstComponent + entity.componentCount <= header->componentCount &&
+                        (uint64_t)entity.firstChild + entity.childCount <= header->entityCount;
+            }
+            for(uint32_t i = 0; i < header->componentCount && valid; i++)
+                valid = components[i].dataOffset + components[i].dataSize <= header->blobsSize;
+            // The mesh renderers and the models have indices in their packed data: the assets of a mesh renderer
+            // and the entity range of a model (the entities it loads under the entity of its loader)
+            auto validAsset = [&](int32_t index, CompiledAssetType type){
+                return index < 0 || ((uint32_t)index < header->assetCount && assets[index].type == type);
+            };
+            std::vector<std::vector<std::pair<uint32_t, uint32_t>>> modelRanges(valid ? header->entityCount : 0);
+            for(uint32_t i = 0; i < header->entityCount && valid; i++){
+                const CompiledEntity& entity = entities[i];
+                for(uint32_t c = entity.firstComponent; c < entity.firstComponent + entity.componentCount && valid; c++){
+                    const CompiledComponent& component = components[c];
+                    BlobReader reader{blobs + component.dataOffset, component.dataSize};
+                    if(component.type == CompiledComponentType::MeshRenderer){
+                        valid = reader.remaining() >= 3 * sizeof(int32_t) &&
+                                validAsset(reader.read<int32_t>(), CompiledAssetType::Mesh) && validAsset(reader.read<int32_t>(), CompiledAssetType::Material);
+                        uint32_t slotCount = reader.read<uint32_t>();
+                        valid = valid && slotCount <= reader.remaining() / sizeof(int32_t);
+                        for(uint32_t slot = 0; slot < slotCount && valid; slot++) valid = validAsset(reader.read<int32_t>(), CompiledAssetType::Material);
+                    } else if(component.type == CompiledComponentType::Model){
+                        uint32_t modelFirst = reader.read<uint32_t>();
+                        uint32_t modelCount = reader.read<uint32_t>();
+                        valid = component.dataSize >= 2 * sizeof(uint32_t) && (uint64_t)modelFirst + modelCount <= header->entityCount;
+                        if(valid) modelRanges[i].emplace_back(modelFirst, modelCount);
+                    }
+                }
+            }
+            // The entities of the children and models of an entity can't lead back to it (e.g. a model whose range contains its
+            // own loader), its instantiation would never end. A model can be loaded by several entities, so the same entities
+            // can be reached more than once, only a cycle is invalid
+            enum VisitState : uint8_t { Unvisited, Visiting, Visited };
+            std::vector<uint8_t> states(valid ? header->entityCount : 0, Unvisited);
+            // The entities on the path being visited with the index of their next entity to visit (children first, then models)
+            std::vector<std::pair<uint32_t, uint64_t>> path;
+            auto getNext = [&](uint32_t entity, uint64_t index, uint32_t& next){
+                if(index < entities[entity].childCount){
+                    next = entities[entity].firstChild + (uint32_t)index;
+                    return true;
+                }
+                index -= entities[entity].childCount;
+                for(auto [first, count] : modelRanges[entity]){
+                    if(index < count){
+                        next = first + (uint32_t)index;
+                        return true;
+                    }
+                    index -= count;
+                }
+                return false;
+            };
+            for(uint32_t root = 0; root < header->entityCount && valid; root++){
+                if(states[root] != Unvisited) continue;
+                states[root] = Visiting;
+                path.assign(1, {root, 0});
+                while(!path.empty() && valid){
+                    auto& [entity, index] = path.back();
+                    uint32_t next;
+                    if(!getNext(entity, index++, next)){
+                        states[entity] = Visited;
+                        path.pop_back();
+                    } else if(states[next] == Visiting){
+                        valid = false;
+                    } else if(states[next] == Unvisited){
+                        states[next] = Visiting;
+                        path.emplace_back(next, 0);
+                    }
+                }
+            }
+        }
+        if(valid){
+            const uint8_t* documentData = bytes + header->documentOffset;
+            nlohmann::json data = nlohmann::json::from_cbor(documentData, documentData + header->documentSize, true, false);
+            valid = data.is_object() && data.contains("document");
+            if(valid){
+                document = std::move(data["document"]);
+                scenePointer = data.value("scenePointer", "");
+                referencedAssets = std::move(data["referencedAssets"]);
+            }
+        }
+        if(!valid){
+            std::cerr << "Invalid compiled scene (compile it again): " << path << std::endl;
+            file.close();
+            header = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    struct CompiledScene::ResolvedAssets {
+        std::vector<AssetHandle<Mesh>> meshes;
+        std::vector<AssetHandle<Material>> materials;
+
+        Mesh* getMesh(int32_t index) const { return index >= 0 && (size_t)index < meshes.size() ? meshes[index] : nullptr; }
+        AssetHandle<Material> getMaterial(int32_t index) const {
+            return index >= 0 && (size_t)index < materials.size() ? materials[index] : AssetHandle<Material>();
+        }
+    };
+
+    void CompiledScene::instantiate(World* world) const {
+        if(!header) return;
+        ResolvedAssets resolved;
+        resolved.meshes.resize(header->assetCount);
+        resolved.materials.resize(header->assetCount);
+        for(uint32_t i = 0; i < header->assetCount; i++){
+            if(assets[i].type == CompiledAssetType::Mesh) resolved.meshes[i] = AssetLoader<Mesh>::acquire(strings[assets[i].name]);
+            else resolved.materials[i] = AssetLoader<Material>::acquire(strings[assets[i].name]);
+        }
+        instantiateEntities(world, 0, header->rootCount, nullptr, resolved);
+    }
+
+    void CompiledScene::instantiateEntities(World* world, uint32_t first, uint32_t count, Entity* parent, const ResolvedAssets& resolved) const {
+        for(uint32_t i = first; i < first + count; i++){
+            const CompiledEntity& data = entities[i];
+            Entity* entity = world->createEntity((EntityFactory::EntityType)data.type, data.name >= 0 ? strings[data.name] : "", parent);
+            entity->localTransform.set(glm::vec3(data.position[0], data.position[1], data.position[2]),
+                                       glm::vec3(data.rotation[0], data.rotation[1], data.rotation[2]),
+                                       glm::vec3(data.scale[0], data.scale[1], data.scale[2]));
+            for(uint32_t c = data.firstComponent; c < data.firstComponent + data.componentCount; c++){
+                const CompiledComponent& component = components[c];
+                BlobReader reader{blobs + component.dataOffset, component.dataSize};
+                switch(component.type){
+                    case CompiledComponentType::Camera: entity->addComponent<CameraComponent>()->unpack(reader); break;
+                    case CompiledComponentType::FreeCameraController: entity->addComponent<FreeCameraControllerComponent>()->unpack(reader); break;
+                    case CompiledComponentType::Movement: entity->addComponent<MovementComponent>()->unpack(reader); break;
+                    case CompiledComponentType::MeshRenderer: {
+                        auto renderer = entity->addComponent<MeshRendererComponent>();
+                        int32_t mesh = reader.read<int32_t>();
+                        renderer->mesh = AssetHandle<Mesh>(resolved.getMesh(mesh), mesh >= 0 ? strings[assets[mesh].name] : "");
+                        renderer->material = resolved.getMaterial(reader.read<int32_t>());
+                        uint32_t slotCount = std::min<uint32_t>(reader.read<uint32_t>(), component.dataSize / sizeof(int32_t));
+                        renderer->materials.reserve(slotCount);
+                        for(uint32_t slot = 0; slot < slotCount; slot++) renderer->materials.push_back(resolved.getMaterial(reader.read<int32_t>()));
+                        break;
+                    }
+                    case CompiledComponentType::Light: entity->addComponent<LightComponent>()->unpack(reader); break;
+                    case CompiledComponentType::RigidBody: entity->addComponent<RigidBodyComponent>()->unpack(reader); break;
+                    case CompiledComponentType::Animation: entity->addComponent<AnimationComponent>()->unpack(reader); break;
+                    case CompiledComponentType::Model: {
+                        uint32_t modelFirst = reader.read<uint32_t>();
+                        uint32_t modelCount = reader.read<uint32_t>();
+                        if((uint64_t)modelFirst + modelCount <= header->entityCount)
+                            instantiateEntities(world, modelFirst, modelCount, entity, resolved);
+                        break;
+                    }
+                }
+            }
+            if(data.door >= 0 && entity->getType() == EntityFactory::EntityType::Button) static_cast<Button*>(entity)->setDoor(strings[data.door]);
+            instantiateEntities(world, data.firstChild, data.childCount, entity, resolved);
+        }
+    }
+
+}
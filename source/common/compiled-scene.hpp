@@ -0,0 +1,123 @@
+#pragma once
+
+#include "asset-pack.hpp"
+
+#include <json/json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace portal {
+
+    class World;
+    class Entity;
+
+    // A compiled scene (".pscene") is a config file (the app config or a scene file) whose world was validated and
+    // converted by "CompiledScene::compile" so it can be instantiated without reading json:
+    // - The header
+    // - The string table (the names of the entities, animations and assets)
+    // - The asset table (the meshes and materials used by the mesh renderers, resolved once per instantiation)
+    // - The entity table, the entities of each list (the world, the children of an entity or a model) are contiguous
+    // - The component table and the packed data of each component (its fields, see "reflection.hpp")
+    // - The rest of the config file (without the world) and the assets the world references, both stored as CBOR
+    // The json stays the authoring format, the compiled file is rebuilt with "--compile-scene" when it changes
+    struct CompiledSceneHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t stringCount;
+        uint32_t assetCount;
+        uint32_t entityCount;
+        uint32_t componentCount;
+        // The entities of the world are the first "rootCount" entities
+        uint32_t rootCount;
+        uint32_t reserved;
+        uint64_t stringsOffset, stringDataOffset, assetsOffset, entitiesOffset, componentsOffset;
+        uint64_t blobsOffset, blobsSize;
+        uint64_t documentOffset, documentSize;
+    };
+
+    struct CompiledString {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    enum class CompiledAssetType : uint32_t {
+        Mesh,
+        Material
+    };
+
+    struct CompiledAsset {
+        CompiledAssetType type;
+        uint32_t name;
+    };
+
+    // The string indices are -1 when the entity has no name or no door
+    struct CompiledEntity {
+        int32_t name;
+        uint32_t type;
+        float position[3];
+        float rotation[3]; // in radians
+        float scale[3];
+        uint32_t firstComponent, componentCount;
+        uint32_t firstChild, childCount;
+        // The door opened by a button
+        int32_t door;
+    };
+
+    enum class CompiledComponentType : uint32_t {
+        Camera,
+        FreeCameraController,
+        Movement,
+        MeshRenderer,
+        Light,
+        RigidBody,
+        Animation,
+        // A model loader, its data is the range of the entities of the model (compiled once for all its instances)
+        Model
+    };
+
+    struct CompiledComponent {
+        CompiledComponentType type;
+        uint32_t dataSize;
+        uint64_t dataOffset;
+    };
+
+    inline constexpr char CompiledSceneMagic[4] = {'P', 'S', 'C', 'N'};
+    inline constexpr uint32_t CompiledSceneVersion = 4;
+
+    class CompiledScene {
+        AssetFile file;
+        const CompiledSceneHeader* header = nullptr;
+        const CompiledAsset* assets = nullptr;
+        const CompiledEntity* entities = nullptr;
+        const CompiledComponent* components = nullptr;
+        const uint8_t* blobs = nullptr;
+        std::vector<std::string> strings;
+
+        // The assets of the asset table, acquired once per instantiation
+        struct ResolvedAssets;
+        void instantiateEntities(World* world, uint32_t first, uint32_t count, Entity* parent, const ResolvedAssets& resolved) const;
+    public:
+        // The config file without its world
+        nlohmann::json document;
+        // The path of the object that held the world in the config file ("/scene" for the app config, "" for a scene file)
+        std::string scenePointer;
+        // The assets referenced by the world, the models are compiled into the scene so they are not needed
+        // (given to "deserializeReferencedAssets" instead of filtering the world)
+        nlohmann::json referencedAssets;
+
+        // Returns true if the path is a compiled scene (by its extension)
+        static bool isCompiled(const std::string& path);
+        // Validates the world of the config file and writes the compiled scene to "path", returns false if the world is invalid
+        static bool compile(const nlohmann::json& config, const std::string& path);
+
+        // Maps the compiled scene (from the asset pack if it has it) and reads its document, returns false if it is invalid
+        bool load(const std::string& path);
+        // Returns the scene object of the document (the one that held the world)
+        const nlohmann::json& getScene() const { return scenePointer.empty() ? document : document.at(nlohmann::json::json_pointer(scenePointer)); }
+        // Creates the entities of the world and their components (same as "World::deserialize" on the json world)
+        void instantiate(World* world) const;
+    };
+
+}
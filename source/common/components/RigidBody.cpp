@@ -2,91 +2,134 @@
 #include <reactphysics3d/reactphysics3d.h>
 #include "RigidBody.hpp"
 #include "../ecs/world.hpp"
+#include <iostream>
 
 namespace portal {
-    void RigidBodyComponent::deserialize(const nlohmann::json& data) {
-        if(!data.is_object()) return;
+    void RigidBodyComponent::create(const RigidBodyDesc& desc) {
+        this->desc = desc;
         r3d::PhysicsWorld *pWorld = this->getOwner()->getWorld()->getPhysicsWorld();
-        relativePosition = r3d::Vector3(0,0,0);
-        glm::vec3 rel = data.value("relativePosition", glm::vec3(0.0f));
         // transform relative position to world space
-        relativePosition = this->getOwner()->localTransform.getRotation() * r3d::Vector3(rel.x, rel.y, rel.z);
+        relativePosition = this->getOwner()->localTransform.getRotation() * r3d::Vector3(desc.relativePosition.x, desc.relativePosition.y, desc.relativePosition.z);
         r3d::Transform transform = this->getOwner()->localTransform.getTransform();
         transform.setPosition(transform.getPosition() + relativePosition);
         // Create a rigid body in the physics world
         r3d::RigidBody *body = pWorld->createRigidBody(transform);
         // Set the rigid body to the component
         this->body = body;
-        this->body->setUserData(new std::string(this->getOwner()->name));
-        // get r3dType
-        const std::string r3dType = data.value("r3dType", "Static");
-        if(r3dType == "Kinemtatic") {
-            this->body->setType(r3d::BodyType::KINEMATIC);
-        } else if (r3dType == "Dynamic") {
-            this->body->setType(r3d::BodyType::DYNAMIC);
-        } else {
-            this->body->setType(r3d::BodyType::STATIC);
-        }
-        // get enableGravity
-        const bool enableGravity = data.value("enableGravity", false);
-        this->body->enableGravity(enableGravity);
-
-        // get allowedToSleep
-        const bool allowedToSleep = data.value("allowedToSleep", false);
-        this->body->setIsAllowedToSleep(allowedToSleep);
-
+        // The owner is found from the body by the events and the scene queries
+        this->body->setUserData(this->getOwner());
+        this->body->setType(desc.type);
+        this->body->enableGravity(desc.enableGravity);
+        this->body->setIsAllowedToSleep(desc.allowedToSleep);
         // motion axis
-        const glm::vec3 motionAxis = data.value("motionAxis", glm::vec3(1.0f));
-        this->body->setLinearLockAxisFactor(r3d::Vector3(motionAxis.x, motionAxis.y, motionAxis.z));
+        this->body->setLinearLockAxisFactor(r3d::Vector3(desc.motionAxis.x, desc.motionAxis.y, desc.motionAxis.z));
         //rotation axis
-        const glm::vec3 rotationAxis = data.value("rotationAxis", glm::vec3(1.0f));
-        this->body->setAngularLockAxisFactor(r3d::Vector3(rotationAxis.x, rotationAxis.y, rotationAxis.z));
-        
-        // parse collider
-        if(data.contains("collider")) {
-            deserialize_collider(data["collider"]);
-        }
+        this->body->setAngularLockAxisFactor(r3d::Vector3(desc.rotationAxis.x, desc.rotationAxis.y, desc.rotationAxis.z));
+        createCollider(desc.collider);
     }
 
-    void RigidBodyComponent::deserialize_collider(const nlohmann::json& data) {
-        if(!data.is_object()) return;
-        r3d::PhysicsCommon& pCommon = this->getOwner()->getWorld()->getPhysicsCommon();
-        std::string colliderType = data.value("type", "");
-        if(colliderType == "Box Collider") {
-            // halfExtents
-            const glm::vec3 hE = data.value("halfExtents", glm::vec3(1.0f));
-            const r3d::Vector3 halfExtents(hE.x, hE.y, hE.z);
-            // Create a box shape and add it to the body
-            r3d::BoxShape* boxShape = pCommon.createBoxShape(halfExtents);
-            collider = body->addCollider(boxShape, r3d::Transform::identity());
-        }else if(colliderType == "Sphere Collider") {
-            // radius
-            const r3d::decimal radius = data.value("radius", 1.0f);
-            // Create a sphere shape and add it to the body
-            r3d::SphereShape* sphereShape = pCommon.createSphereShape(radius);
-            collider = body->addCollider(sphereShape, r3d::Transform::identity());
-        } else if(colliderType == "Capsule Collider") {
-            // radius
-            const r3d::decimal radius = data.value("radius", 1.0f);
-            // height
-            const r3d::decimal height = data.value("height", 2.0f);
-            // Create a capsule shape and add it to the body
-            r3d::CapsuleShape* capsuleShape = pCommon.createCapsuleShape(radius, height);
-            collider = body->addCollider(capsuleShape, r3d::Transform::identity());
+    void RigidBodyComponent::createCollider(const ColliderDesc& desc) {
+        ShapeLibrary& shapes = this->getOwner()->getWorld()->getShapeLibrary();
+        r3d::CollisionShape* shape = nullptr;
+        if(desc.shape == ColliderDesc::Shape::Box) {
+            shape = shapes.getBox(desc.halfExtents);
+        } else if(desc.shape == ColliderDesc::Shape::Sphere) {
+            shape = shapes.getSphere(desc.radius);
+        } else if(desc.shape == ColliderDesc::Shape::Capsule) {
+            shape = shapes.getCapsule(desc.radius, desc.height);
+        } else if(desc.shape == ColliderDesc::Shape::ConvexMesh) {
+            shape = shapes.getConvexMesh(desc.mesh, desc.scale);
+        } else if(desc.shape == ColliderDesc::Shape::ConcaveMesh) {
+            // reactphysics3d can't simulate a triangle mesh on a moving body, so they get the convex hull instead
+            if(body->getType() == r3d::BodyType::STATIC) {
+                shape = shapes.getConcaveMesh(desc.mesh, desc.scale);
+            } else {
+                std::cerr << "Only static bodies can have a triangle mesh collider, using its convex hull for: " << getOwner()->name << std::endl;
+                shape = shapes.getConvexMesh(desc.mesh, desc.scale);
+            }
         }
+        // Add the shared shape to the body
+        if(shape) collider = body->addCollider(shape, r3d::Transform::identity());
+        // A body without a (known) collider has nothing to configure
+        if(!collider) return;
         // material properties
         r3d::Material &material = collider->getMaterial();
-        material.setBounciness(data.value("bounciness", material.getBounciness()));
-        material.setFrictionCoefficient(data.value("friction", material.getFrictionCoefficient()));
-        material.setMassDensity(data.value("massDensity", material.getMassDensity()));
+        if(desc.bounciness >= 0) material.setBounciness(desc.bounciness);
+        if(desc.friction >= 0) material.setFrictionCoefficient(desc.friction);
+        if(desc.massDensity >= 0) material.setMassDensity(desc.massDensity);
         // trigger
-        collider->setIsTrigger(data.value("isTrigger", false));
-        // sett all colliders to be on category 1
-        collider->setCollisionCategoryBits(1);
-        collider->setCollideWithMaskBits(1);
+        collider->setIsTrigger(desc.isTrigger);
+        // layer
+        if(!setLayer(getLayer())) {
+            std::cerr << "Unknown collision layer \"" << getLayer() << "\" for: " << getOwner()->name << std::endl;
+        }
+    }
+
+    std::string RigidBodyComponent::getLayer() const {
+        if(!desc.collider.layer.empty()) return desc.collider.layer;
+        if(desc.collider.isTrigger) return "Trigger";
+        return desc.type == r3d::BodyType::STATIC ? "Static" : "Default";
+    }
+
+    bool RigidBodyComponent::setLayer(const std::string& layer) {
+        if(!collider) return false;
+        return this->getOwner()->getWorld()->getCollisionLayers().apply(collider, layer);
+    }
+
+    // The state of a body and of its collider saved in a snapshot of the world
+    struct RigidBodyState {
+        r3d::Transform transform;
+        r3d::Vector3 linearVelocity, angularVelocity;
+        bool isSleeping;
+        bool isTrigger;
+        unsigned short categoryBits, maskBits;
+    };
+
+    void RigidBodyComponent::saveState(BlobWriter& writer) const {
+        if(!body) return;
+        RigidBodyState state = {
+            body->getTransform(), body->getLinearVelocity(), body->getAngularVelocity(), body->isSleeping(),
+            false, 0, 0
+        };
+        if(collider) {
+            state.isTrigger = collider->getIsTrigger();
+            state.categoryBits = collider->getCollisionCategoryBits();
+            state.maskBits = collider->getCollideWithMaskBits();
+        }
+        writer.write(state);
+    }
+
+    void RigidBodyComponent::restoreState(BlobReader& reader) {
+        if(!body) return;
+        RigidBodyState state = reader.read<RigidBodyState>();
+        // Setting the transform wakes the body up and updates the broad phase, so it is only done for the bodies that moved
+        if(!(body->getTransform() == state.transform)) body->setTransform(state.transform);
+        if(body->getType() != r3d::BodyType::STATIC) {
+            body->setIsSleeping(state.isSleeping);
+            // A sleeping body has no velocity (and setting one would wake it up)
+            if(!state.isSleeping) {
+                body->setLinearVelocity(state.linearVelocity);
+                body->setAngularVelocity(state.angularVelocity);
+            }
+        }
+        if(collider) {
+            if(collider->getIsTrigger() != state.isTrigger) collider->setIsTrigger(state.isTrigger);
+            if(collider->getCollisionCategoryBits() != state.categoryBits) collider->setCollisionCategoryBits(state.categoryBits);
+            if(collider->getCollideWithMaskBits() != state.maskBits) collider->setCollideWithMaskBits(state.maskBits);
+        }
+    }
+
+    r3d::Transform RigidBodyComponent::getInterpolatedTransform(float factor) const {
+        const r3d::Transform& current = body->getTransform();
+        // Only the position is compared since the orientation of the player is set by the camera controller every frame
+        if(current.getPosition() != stepTransform.getPosition()) return current;
+        return r3d::Transform::interpolateTransforms(previousTransform, stepTransform, factor);
     }
 
     RigidBodyComponent::~RigidBodyComponent() {
+        if (this->collider) {
+            this->getOwner()->getWorld()->getShapeLibrary().release(collider->getCollisionShape());
+        }
         if (this->body) {
             this->getOwner()->getWorld()->getPhysicsWorld()->destroyRigidBody(body);
         }
@@ -1,24 +1,122 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 #include "../deserialize-utils.hpp"
+#include <reactphysics3d/reactphysics3d.h>
 namespace r3d = reactphysics3d;
 
 namespace portal {
-    class RigidBodyComponent : public Component {
+
+    // The description of a collider read from the "collider" of a rigid body
+    // The shapes are shared by the colliders with the same parameters (see "ShapeLibrary")
+    struct ColliderDesc {
+        enum class Shape : uint32_t { None, Box, Sphere, Capsule, ConvexMesh, ConcaveMesh } shape = Shape::None;
+        glm::vec3 halfExtents = glm::vec3(1.0f);
+        float radius = 1.0f;
+        float height = 2.0f;
+        // The ".obj" file of a mesh collider (its convex hull or its triangles, cooked once and cached) and its scaling
+        std::string mesh;
+        glm::vec3 scale = glm::vec3(1.0f);
+        // The material properties (negative to keep the defaults of reactphysics3d)
+        float bounciness = -1.0f;
+        float friction = -1.0f;
+        float massDensity = -1.0f;
+        bool isTrigger = false;
+        // The collision layer of the collider (see "CollisionLayers"), if empty it is "Trigger" for a trigger,
+        // "Static" for a static body and "Default" otherwise
+        std::string layer;
+
+        static auto getFields() {
+            return std::make_tuple(
+                field("type", &ColliderDesc::shape, enumCodec<Shape>({
+                    {"None", Shape::None}, {"Box Collider", Shape::Box}, {"Sphere Collider", Shape::Sphere}, {"Capsule Collider", Shape::Capsule},
+                    {"Convex Mesh Collider", Shape::ConvexMesh}, {"Triangle Mesh Collider", Shape::ConcaveMesh}
+                })),
+                field("halfExtents", &ColliderDesc::halfExtents),
+                field("radius", &ColliderDesc::radius),
+                field("height", &ColliderDesc::height),
+                field("mesh", &ColliderDesc::mesh),
+                field("scale", &ColliderDesc::scale),
+                field("bounciness", &ColliderDesc::bounciness),
+                field("friction", &ColliderDesc::friction),
+                field("massDensity", &ColliderDesc::massDensity),
+                field("isTrigger", &ColliderDesc::isTrigger),
+                field("layer", &ColliderDesc::layer)
+            );
+        }
+    };
+
+    // The description of a rigid body, the body is created from it
+    struct RigidBodyDesc {
+        glm::vec3 relativePosition = glm::vec3(0.0f);
+        r3d::BodyType type = r3d::BodyType::STATIC;
+        bool enableGravity = false;
+        bool allowedToSleep = false;
+        glm::vec3 motionAxis = glm::vec3(1.0f);
+        glm::vec3 rotationAxis = glm::vec3(1.0f);
+        ColliderDesc collider;
+
+        static auto getFields() {
+            return std::make_tuple(
+                field("relativePosition", &RigidBodyDesc::relativePosition),
+                // "Kinemtatic" is the name used by the scenes
+                field("r3dType", &RigidBodyDesc::type, enumCodec<r3d::BodyType>({
+                    {"Static", r3d::BodyType::STATIC}, {"Kinemtatic", r3d::BodyType::KINEMATIC}, {"Dynamic", r3d::BodyType::DYNAMIC}
+                })),
+                field("enableGravity", &RigidBodyDesc::enableGravity),
+                field("allowedToSleep", &RigidBodyDesc::allowedToSleep),
+                field("motionAxis", &RigidBodyDesc::motionAxis),
+                field("rotationAxis", &RigidBodyDesc::rotationAxis),
+                field("collider", &RigidBodyDesc::collider)
+            );
+        }
+    };
+
+    class RigidBodyComponent : public ReflectedComponent<RigidBodyComponent> {
         r3d::RigidBody* body = nullptr;
         r3d::Collider* collider = nullptr;
-        void deserialize_collider(const nlohmann::json& data);
+        // The transforms of the body before and after the last physics step (see "getInterpolatedTransform")
+        r3d::Transform previousTransform, stepTransform;
+        void createCollider(const ColliderDesc& desc);
+        friend ReflectedComponent<RigidBodyComponent>;
+        // Creates the body once its description is read
+        void onFieldsRead() { create(desc); }
     public:
+        // The description the body was created from
+        RigidBodyDesc desc;
         r3d::Vector3 relativePosition;
         static std::string getID() { return "RigidBody"; }
 
-        void deserialize(const nlohmann::json &data) override;
+        // The fields of the description are at the root of the json object
+        static auto getFields() {
+            return std::make_tuple(inlineFields(&RigidBodyComponent::desc));
+        }
+        // Creates the body (and its collider) in the physics world of the owner
+        void create(const RigidBodyDesc& desc);
+
+        // The state of the body (its transform, velocities and sleeping) and of its collider (trigger and collision bits)
+        // is restored in place, the body is not created again
+        void saveState(BlobWriter& writer) const override;
+        void restoreState(BlobReader& reader) override;
+
+        // The layer the collider was created on (from its description)
+        std::string getLayer() const;
+        // Moves the collider to another collision layer (e.g. "Held" while the player holds it), returns false if there is no such layer
+        bool setLayer(const std::string& layer);
+
+        // Called by the movement system around each physics step
+        void beginStep() { previousTransform = body->getTransform(); }
+        void endStep() { stepTransform = body->getTransform(); }
+        // Returns the transform of the body at "factor" of a step after the last step (0 is the state before it and 1 the state after it)
+        // A body moved outside of the simulation since the last step (e.g. teleported) is not interpolated
+        r3d::Transform getInterpolatedTransform(float factor) const;
 
         r3d::RigidBody* getBody() const { return body; }
         r3d::Collider* getCollider() const { return collider; }
+        // Returns the entity owning a body (stored as its user data), null for the bodies of no entity (e.g. the overlap probes of the SceneQuery)
+        static Entity* getEntity(const r3d::CollisionBody* body) { return (Entity*)body->getUserData(); }
         
         ~RigidBodyComponent();
     };
 
-}
\ No newline at end of file
+}
@@ -14,22 +14,28 @@ namespace portal {
         if(!data.is_object()) return;
         // if type is "animation" then it would call another animation
         std::string type = data.value("type", "");
-        std::function<void()> tempCallback = nullptr;
         if(type == "animation"){
             //there can be multiple names for callbacks
-            std::vector<std::string> names = data.value("names", std::vector<std::string>());
-            tempCallback = [this, names](){
-                // Loop on each animation name and start it
-                for(auto& name : names){
-                    // If first character is '#' then animation is reversed
-                    if(name[0] == '#'){
-                        this->getOwner()->getWorld()->startAnimation(name.substr(1), true);
-                    } else {
-                        this->getOwner()->getWorld()->startAnimation(name);
-                    }
-                }
-            };
+            setCallback(data.value("names", std::vector<std::string>()), reverse);
+        } else {
+            setCallback({}, reverse);
         }
+    }
+
+    void AnimationComponent::setCallback(const std::vector<std::string>& names, bool reverse) {
+        (reverse ? reverseCallbackNames : callbackNames) = names;
+        std::function<void()> tempCallback;
+        if(!names.empty()) tempCallback = [this, names](){
+            // Loop on each animation name and start it
+            for(auto& name : names){
+                // If first character is '#' then animation is reversed
+                if(name[0] == '#'){
+                    this->getOwner()->getWorld()->startAnimation(name.substr(1), true);
+                } else {
+                    this->getOwner()->getWorld()->startAnimation(name);
+                }
+            }
+        };
         if (reverse) {
             reverseCallback = tempCallback;
         } else {
@@ -37,27 +43,23 @@ namespace portal {
         }
     }
 
-    // Reads animation data from the given json object
-    void AnimationComponent::deserialize(const nlohmann::json& data){
-        if(!data.is_object()) return;
-        start.deserialize(data.value("start", nlohmann::json::object()));
-        end.deserialize(data.value("end", nlohmann::json::object()));
-        duration = data.value("duration", duration);
-        name = data.value("name", name);
+    void AnimationComponent::onFieldsRead(){
+        setup(start, end, duration, localName);
+        setCallback(callbackNames);
+        setCallback(reverseCallbackNames, true);
+    }
+
+    void AnimationComponent::setup(const Transform& start, const Transform& end, float duration, const std::string& name){
+        this->start = start;
+        this->end = end;
+        this->duration = duration;
+        this->localName = name;
+        this->name = name;
         // Append the name of the parent entity to the animation name
         // Since animation can only be applied to child entities
         // Make them unique that way if parent exists
-        if(this->getOwner()->parent) name = this->getOwner()->parent->name + "_" + name;
-        // For callback it would either call another animation or
-        // it would call disable collider of parent of owner
-        if(data.contains("callback")) {
-            deserializeCallback(data["callback"]);
-        }
-        if(data.contains("callback_reversed")) {
-            deserializeCallback(data["callback_reversed"], true);
-        }
-
-        this->getOwner()->getWorld()->addAnimation(name, this);
+        if(this->getOwner()->parent) this->name = this->getOwner()->parent->name + "_" + name;
+        this->getOwner()->getWorld()->addAnimation(this->name, this);
     }
     // Resets the animation
     void AnimationComponent::reset(){
@@ -66,6 +68,24 @@ namespace portal {
         isReversed = false;
         accumulatedTime = 0.0f;
     }
+    // The progress of an animation saved in a snapshot of the world
+    struct AnimationState {
+        float accumulatedTime;
+        bool isPlaying, isStarted, isReversed;
+    };
+
+    void AnimationComponent::saveState(BlobWriter& writer) const {
+        writer.write(AnimationState{accumulatedTime, isPlaying, isStarted, isReversed});
+    }
+
+    void AnimationComponent::restoreState(BlobReader& reader) {
+        AnimationState state = reader.read<AnimationState>();
+        accumulatedTime = state.accumulatedTime;
+        isPlaying = state.isPlaying;
+        isStarted = state.isStarted;
+        isReversed = state.isReversed;
+    }
+
     // Plays animation given delta time
     bool AnimationComponent::play(float deltaTime){
         if(!isPlaying) return false;
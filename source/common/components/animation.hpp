@@ -1,11 +1,25 @@
 #pragma once
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 #include "../ecs/transform.hpp"
 
+#include <functional>
+
 namespace portal {
 
+    // The animations started when an animation ends, written as {"type": "animation", "names": [...]} (null if there are none)
+    struct AnimationCallbackCodec {
+        void read(const nlohmann::json& data, std::vector<std::string>& names) const {
+            if(data.is_object() && data.value("type", "") == "animation") names = data.value("names", std::vector<std::string>());
+            else names.clear();
+        }
+        nlohmann::json write(const std::vector<std::string>& names) const {
+            if(names.empty()) return nullptr;
+            return {{"type", "animation"}, {"names", names}};
+        }
+    };
+
     // WARNING: IT IS PROHIBITED TO USE THIS WITH AN OBJECT THAT HAS A "RigidBody" COMPONENT
-    class AnimationComponent : public Component {
+    class AnimationComponent : public ReflectedComponent<AnimationComponent> {
         Transform start;
         Transform end;
         float duration = 1.0f;
@@ -14,17 +28,43 @@ namespace portal {
         bool isStarted = false;
         bool isReversed = false;
         std::string name = "";
+        // The name given to the animation (without the name of the parent)
+        std::string localName = "";
+        // The animations started by the callbacks ('#' before a name plays it reversed)
+        std::vector<std::string> callbackNames, reverseCallbackNames;
         // Callback lambda function to be called when animation ends
         std::function<void()> callback;
         std::function<void()> reverseCallback;
 
+        friend ReflectedComponent<AnimationComponent>;
+        // Adds the animation to the world and sets its callbacks once it is read
+        void onFieldsRead();
+
     public:
         // The ID of this component type is "Animation"
         static std::string getID() { return "Animation"; }
 
-        // Reads animation data from the given json object
-        void deserialize(const nlohmann::json& data) override;
+        // The animation data in the json object
+        static auto getFields() {
+            return std::make_tuple(
+                field("start", &AnimationComponent::start),
+                field("end", &AnimationComponent::end),
+                field("duration", &AnimationComponent::duration),
+                field("name", &AnimationComponent::localName),
+                field("callback", &AnimationComponent::callbackNames, AnimationCallbackCodec()),
+                field("callback_reversed", &AnimationComponent::reverseCallbackNames, AnimationCallbackCodec())
+            );
+        }
+
         void deserializeCallback(const nlohmann::json& data, bool reverse = false);
+        // Sets the transforms, the duration and the name then adds the animation to the world
+        void setup(const Transform& start, const Transform& end, float duration, const std::string& name);
+        // Sets the callback to start the given animations when this one ends ('#' before a name plays it reversed)
+        void setCallback(const std::vector<std::string>& names, bool reverse = false);
+
+        // The progress of the animation is restored in place (its fields don't change while playing)
+        void saveState(BlobWriter& writer) const override;
+        void restoreState(BlobReader& reader) override;
 
         // Plays animation given delta time
         bool play(float deltaTime);
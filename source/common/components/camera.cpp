@@ -4,21 +4,6 @@
 #include <glm/gtc/matrix_transform.hpp> 
 
 namespace portal {
-    // Reads camera parameters from the given json object
-    void CameraComponent::deserialize(const nlohmann::json& data){
-        if(!data.is_object()) return;
-        std::string cameraTypeStr = data.value("cameraType", "perspective");
-        if(cameraTypeStr == "orthographic"){
-            cameraType = CameraType::ORTHOGRAPHIC;
-        } else {
-            cameraType = CameraType::PERSPECTIVE;
-        }
-        near = data.value("near", 0.01f);
-        far = data.value("far", 100.0f);
-        fovY = data.value("fovY", 90.0f) * (glm::pi<float>() / 180);
-        orthoHeight = data.value("orthoHeight", 1.0f);
-    }
-
     // Creates and returns the camera view matrix
     glm::mat4 CameraComponent::getViewMatrix() const {
         auto owner = getOwner();
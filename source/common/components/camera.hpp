@@ -1,8 +1,9 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 
 #include <glm/mat4x4.hpp>
+#include <glm/gtc/constants.hpp>
 
 namespace portal {
 
@@ -14,18 +15,28 @@ namespace portal {
 
     // This component denotes that any renderer should draw the scene relative to this camera.
     // We do not define the eye, center or up here since they can be extracted from the entity local to world matrix
-    class CameraComponent : public Component {
+    class CameraComponent : public ReflectedComponent<CameraComponent> {
     public:
-        CameraType cameraType; // The type of the camera
-        float near, far; // The distance from the camera center to the near and far plane
-        float fovY; // The field of view angle of the camera if it is a perspective camera
-        float orthoHeight; // The orthographic height of the camera if it is an orthographic camera
+        CameraType cameraType = CameraType::PERSPECTIVE; // The type of the camera
+        float near = 0.01f, far = 100.0f; // The distance from the camera center to the near and far plane
+        float fovY = glm::half_pi<float>(); // The field of view angle (in radians) of the camera if it is a perspective camera
+        float orthoHeight = 1.0f; // The orthographic height of the camera if it is an orthographic camera
 
         // The ID of this component type is "Camera"
         static std::string getID() { return "Camera"; }
 
-        // Reads camera parameters from the given json object
-        void deserialize(const nlohmann::json& data) override;
+        // The camera parameters in the json object (the field of view is in degrees)
+        static auto getFields() {
+            return std::make_tuple(
+                field("cameraType", &CameraComponent::cameraType, enumCodec<CameraType>({
+                    {"perspective", CameraType::PERSPECTIVE}, {"orthographic", CameraType::ORTHOGRAPHIC}
+                })),
+                field("near", &CameraComponent::near),
+                field("far", &CameraComponent::far),
+                field("fovY", &CameraComponent::fovY, DegreesCodec()),
+                field("orthoHeight", &CameraComponent::orthoHeight)
+            );
+        }
 
         // Creates and returns the camera view matrix
         glm::mat4 getViewMatrix() const;
@@ -1,14 +0,0 @@
-#include "free-camera-controller.hpp"
-#include "../ecs/entity.hpp"
-#include "../deserialize-utils.hpp"
-
-namespace portal {
-    // Reads sensitivities & speedupFactor from the given json object
-    void FreeCameraControllerComponent::deserialize(const nlohmann::json& data){
-        if(!data.is_object()) return;
-        rotationSensitivity = data.value("rotationSensitivity", rotationSensitivity);
-        fovSensitivity = data.value("fovSensitivity", fovSensitivity);
-        positionSensitivity = data.value("positionSensitivity", positionSensitivity);
-        speedupFactor = data.value("speedupFactor", speedupFactor);
-    }
-}
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 
 #include <glm/glm.hpp> 
 
@@ -11,7 +11,7 @@ namespace portal {
     // This component is added as a slightly complex example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/free-camera-controller.hpp"
     // For a more simple example of how to use the ECS framework, see "movement.hpp"
-    class FreeCameraControllerComponent : public Component {
+    class FreeCameraControllerComponent : public ReflectedComponent<FreeCameraControllerComponent> {
     public:
         // The senstivity paramter defined sensitive the camera rotation & fov is to the mouse moves and wheel scrolling
         float rotationSensitivity = 0.01f; // The angle change per pixel of mouse movement
@@ -22,8 +22,15 @@ namespace portal {
         // The ID of this component type is "Free Camera Controller"
         static std::string getID() { return "Free Camera Controller"; }
 
-        // Reads sensitivities & speedupFactor from the given json object
-        void deserialize(const nlohmann::json& data) override;
+        // The sensitivities & speedupFactor in the json object
+        static auto getFields() {
+            return std::make_tuple(
+                field("rotationSensitivity", &FreeCameraControllerComponent::rotationSensitivity),
+                field("fovSensitivity", &FreeCameraControllerComponent::fovSensitivity),
+                field("positionSensitivity", &FreeCameraControllerComponent::positionSensitivity),
+                field("speedupFactor", &FreeCameraControllerComponent::speedupFactor)
+            );
+        }
     };
 
 }
\ No newline at end of file
@@ -1,13 +1,16 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 
 #include <glm/glm.hpp>
 
 namespace portal {
 
 
-    class LightComponent : public Component {
+    class LightComponent : public ReflectedComponent<LightComponent> {
+        friend ReflectedComponent<LightComponent>;
+        // Computes the world space properties once the light is read
+        void onFieldsRead() { computeWorldSpace(); }
     public:
         // color of the light
         glm::vec3 color = { 1, 1, 1 };
@@ -17,10 +20,10 @@ namespace portal {
             Point,
             Spot
         } type = Type::Directional;
-        // for spot lights, the angle of the cone
-        float innerCutOff = 45.0f;
-        // for spot lights, the falloff of the cone
-        float outerCutOff = 50.0f;
+        // for spot lights, the cosine of the angle of the cone
+        float innerCutOff = glm::cos(glm::radians(45.0f));
+        // for spot lights, the cosine of the falloff of the cone
+        float outerCutOff = glm::cos(glm::radians(50.0f));
         // for directional lights and spot lights, the direction of the light in world space
         glm::vec3 direction = { 0, -1, 0 };
         // attenuation
@@ -30,8 +33,20 @@ namespace portal {
         // The ID of this component type is "Light"
         static std::string getID() { return "Light"; }
 
-        // Reads lighting data from the given json object
-        void deserialize(const nlohmann::json& data) override;
+        // The lighting data in the json object (the angles of the cone are in degrees)
+        static auto getFields() {
+            return std::make_tuple(
+                field("color", &LightComponent::color),
+                field("lightType", &LightComponent::type, enumCodec<Type>({
+                    {"directional", Type::Directional}, {"point", Type::Point}, {"spot", Type::Spot}
+                })),
+                field("innerCutOff", &LightComponent::innerCutOff, CosineDegreesCodec()),
+                field("outerCutOff", &LightComponent::outerCutOff, CosineDegreesCodec()),
+                field("attenuation", &LightComponent::attenuation)
+            );
+        }
+        // Computes the direction and the position of the light from the transform of its owner
+        void computeWorldSpace();
         
     };
 
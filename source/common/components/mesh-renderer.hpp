@@ -1,23 +1,48 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 #include "../mesh/mesh.hpp"
 #include "../material/material.hpp"
 #include "../asset-loader.hpp"
 
+#include <array>
+
 namespace portal {
 
     // This component denotes that any renderer should draw the given mesh using the given material at the transformation of the owning entity.
-    class MeshRendererComponent : public Component {
+    // The mesh and materials are held by handles so they are not evicted while the component exists
+    class MeshRendererComponent : public ReflectedComponent<MeshRendererComponent> {
     public:
-        Mesh* mesh; // The mesh that should be drawn
-        Material* material; // The material used to draw the mesh
+        AssetHandle<Mesh> mesh; // The mesh that should be drawn
+        AssetHandle<Material> material; // The material used to draw the mesh
+        // The material of each slot of the mesh (see "Submesh"), the slots without a material use "material"
+        std::vector<AssetHandle<Material>> materials;
+        // The level of detail drawn in each view during the last frame (the main view then the views through the portals)
+        // The renderer uses it to avoid switching back and forth between two levels
+        std::array<uint8_t, 4> lodLevels = {};
+
+        // Returns the material used to draw the submeshes of the given slot (null if the slot should not be drawn)
+        Material* getMaterial(uint32_t slot) const {
+            if(slot < materials.size() && materials[slot]) return materials[slot];
+            return material;
+        }
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Mesh Renderer"; }
 
-        // Receives the mesh & material from the AssetLoader by the names given in the json object
-        void deserialize(const nlohmann::json& data) override;
+        // The mesh & material are received from the AssetLoader by the names given in the json object
+        // "materials" (optional) is an array with the material name of each slot (null to use "material")
+        static auto getFields() {
+            return std::make_tuple(
+                field("mesh", &MeshRendererComponent::mesh),
+                field("material", &MeshRendererComponent::material),
+                field("materials", &MeshRendererComponent::materials)
+            );
+        }
+
+        // The mesh and materials don't change while the world is played (restoring them would acquire them again)
+        void saveState(BlobWriter&) const override {}
+        void restoreState(BlobReader&) override {}
     };
 
 }
\ No newline at end of file
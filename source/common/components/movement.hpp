@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/reflection.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
@@ -9,11 +9,21 @@
 
 namespace portal {
 
+    // The angular velocity of a movement is written as euler angles in degrees per second
+    // and stored as a quaternion (0, x, y, z) with the angles in radians
+    struct AngularVelocityCodec {
+        void read(const nlohmann::json& data, glm::quat& value) const {
+            glm::vec3 euler = glm::radians(data.get<glm::vec3>());
+            value = glm::quat(0, euler.x, euler.y, euler.z);
+        }
+        nlohmann::json write(const glm::quat& value) const { return glm::degrees(glm::vec3(value.x, value.y, value.z)); }
+    };
+
     // This component denotes that the MovementSystem will move the owning entity by a certain linear and angular velocity.
     // This component is added as a simple example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/movement.hpp"
     // For a more complex example of how to use the ECS framework, see "free-camera-controller.hpp"
-    class MovementComponent : public Component {
+    class MovementComponent : public ReflectedComponent<MovementComponent> {
     public:
         glm::vec3 linearVelocity = {0, 0, 0}; // Each frame, the entity should move as follows: position += linearVelocity * deltaTime 
         glm::quat angularVelocity = glm::quat(0, 0, 0, 0); // Each frame, the entity should rotate as follows: rotation += angularVelocity * deltaTime
@@ -21,8 +31,13 @@ namespace portal {
         // The ID of this component type is "Movement"
         static std::string getID() { return "Movement"; }
 
-        // Reads linearVelocity & angularVelocity from the given json object
-        void deserialize(const nlohmann::json& data) override;
+        // The linearVelocity & angularVelocity in the json object
+        static auto getFields() {
+            return std::make_tuple(
+                field("linearVelocity", &MovementComponent::linearVelocity),
+                field("angularVelocity", &MovementComponent::angularVelocity, AngularVelocityCodec())
+            );
+        }
     };
 
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 #include <json/json.hpp>
 
 // This file contains some helper code for deserialization which includes:
-// - Deserializing glm vectors from json via nlohmann::json
+// - Deserializing glm vectors from json via nlohmann::json (and serializing them back)
 // - Converting strings to GLenums
 
 // This template function allows us to read glm vectors from json
@@ -19,6 +19,14 @@ namespace glm {
         for(length_t index = 0; index < L; ++index)
             v[index] = j[index].get<T>();
     }
+
+    // And this one writes them back as json arrays
+    template<length_t L, typename T, qualifier Q>
+    void to_json(nlohmann::json& j, const vec<L, T, Q>& v){
+        j = nlohmann::json::array();
+        for(length_t index = 0; index < L; ++index)
+            j.push_back(v[index]);
+    }
 }
 
 namespace portal {
@@ -1,6 +1,7 @@
 #include "button.hpp"
 #include "door.hpp"
 #include "world.hpp"
+#include "reflection.hpp"
 #include <GLFW/glfw3.h>
 namespace portal {
     
@@ -32,19 +33,22 @@ namespace portal {
         
         // If action has "Door" then button will open and close a door
         if(data.contains("Door")) {
-            std::string doorName = data["Door"];
-            // Call open and close in onPress and onRelease
-            onPress = [doorName, this]() {
-                Door *door = dynamic_cast<Door*>(getWorld()->getEntityByName(doorName));
-                door->open();
-            };
-            onRelease = [doorName, this]() {
-                Door *door = dynamic_cast<Door*>(getWorld()->getEntityByName(doorName));
-                door->close();
-            };
+            setDoor(data["Door"].get<std::string>());
         }
     }
 
+    void Button::setDoor(const std::string& doorName) {
+        // Call open and close in onPress and onRelease
+        onPress = [doorName, this]() {
+            Door *door = dynamic_cast<Door*>(getWorld()->getEntityByName(doorName));
+            door->open();
+        };
+        onRelease = [doorName, this]() {
+            Door *door = dynamic_cast<Door*>(getWorld()->getEntityByName(doorName));
+            door->close();
+        };
+    }
+
     void Button::deserialize(const nlohmann::json &data) {
         // Call parent deserialize
         Entity::deserialize(data);
@@ -53,4 +57,12 @@ namespace portal {
             deserializeAction(data["action"]);
         }
     }
-}
\ No newline at end of file
+
+    void Button::saveState(BlobWriter& writer) const {
+        writer.write(isPressed);
+    }
+
+    void Button::restoreState(BlobReader& reader) {
+        isPressed = reader.read<bool>();
+    }
+}
@@ -20,6 +20,13 @@ namespace portal {
         void release();
         
         bool getIsPressed() const { return isPressed; }
+        // Saves and restores whether the button is pressed (see "World::takeSnapshot")
+        // The count of entities on the button is kept since it follows the contacts of the physics world,
+        // which keeps its contacts when the bodies are restored and reports their changes in the next update
+        virtual void saveState(BlobWriter& writer) const override;
+        virtual void restoreState(BlobReader& reader) override;
+        // Makes the button open the door with the given name when it is pressed and close it when it is released
+        void setDoor(const std::string& doorName);
         virtual EntityFactory::EntityType getType() const override { return EntityFactory::EntityType::Button; }
         virtual void deserialize(const nlohmann::json &data) override;
     };
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <json/json.hpp>
+#include <cstdint>
 #include <string>
 
 namespace portal {
 
     class Entity; // A forward declaration of the Entity Class
+    struct BlobWriter;
+    struct BlobReader;
 
     // A component is a data container that can be added to an entity.
     // The role of the entity in the world is defined by the components it holds.
@@ -22,6 +25,20 @@ namespace portal {
         // Reads the data of the component from a json object
         // It is abstract since it must be overriden by derived components
         virtual void deserialize(const nlohmann::json& data) = 0;
+        // The following are defined by the fields of the component (see "ReflectedComponent" in "reflection.hpp")
+        // Writes the data of the component into a json object (in the form read by "deserialize")
+        virtual void serialize(nlohmann::json& data) const = 0;
+        // Writes the data of the component in its packed form and reads it back (only read by the same build)
+        virtual void pack(BlobWriter& writer) const = 0;
+        virtual void unpack(BlobReader& reader) = 0;
+        // Returns a mask of the fields that differ from the other component (all of them if it has another type)
+        virtual uint64_t diff(const Component& other) const = 0;
+        // Packs the fields of the mask and reads them back (e.g. to send the changes of a component)
+        virtual void packChanged(BlobWriter& writer, uint64_t mask) const = 0;
+        virtual void unpackChanged(BlobReader& reader) = 0;
+        // Writes the state the component changes while the world is played and reads it back in place (see "World::takeSnapshot")
+        virtual void saveState(BlobWriter& writer) const = 0;
+        virtual void restoreState(BlobReader& reader) = 0;
         // Returns the owner of this component
         Entity* getOwner() const { return owner; }
         // Define a virtual destructor
@@ -3,6 +3,7 @@
 #include "../components/animation.hpp"
 #include <json/json.hpp>
 #include "../components/RigidBody.hpp"
+#include "reflection.hpp"
 #include <reactphysics3d/reactphysics3d.h>
 namespace portal {
     void Door::setup() {
@@ -59,4 +60,12 @@ namespace portal {
         getWorld()->startAnimation(name + "_" + "left_spin_open", true);
         getWorld()->startAnimation(name + "_" + "right_spin_open", true);
     }
-}
\ No newline at end of file
+
+    void Door::saveState(BlobWriter& writer) const {
+        writer.write(isOpened);
+    }
+
+    void Door::restoreState(BlobReader& reader) {
+        isOpened = reader.read<bool>();
+    }
+}
@@ -23,6 +23,9 @@ namespace portal {
         void close();
         
         bool getIsOpened() const { return isOpened; }
+        // Saves and restores whether the door is opened (see "World::takeSnapshot")
+        virtual void saveState(BlobWriter& writer) const override;
+        virtual void restoreState(BlobReader& reader) override;
         virtual EntityFactory::EntityType getType() const override { return EntityFactory::EntityType::Door; }
     };
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "elevator.hpp"
 #include "world.hpp"
 #include "../components/RigidBody.hpp"
+#include "reflection.hpp"
 namespace portal {
     void Elevator::setup() {
         // Retrieve rigid body 
@@ -47,5 +48,12 @@ namespace portal {
     }
 
 
-}
 
+    void Elevator::saveState(BlobWriter& writer) const {
+        writer.write(isOpened);
+    }
+
+    void Elevator::restoreState(BlobReader& reader) {
+        isOpened = reader.read<bool>();
+    }
+}
@@ -20,6 +20,9 @@ namespace portal {
         void open();
         // To close the elevator
         void close();
+        // Saves and restores whether the elevator is opened (its door is a rigid body restored by its component)
+        virtual void saveState(BlobWriter& writer) const override;
+        virtual void restoreState(BlobReader& reader) override;
 
 
         virtual EntityFactory::EntityType getType() const override { return EntityFactory::EntityType::Elevator; }
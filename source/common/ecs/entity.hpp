@@ -37,6 +37,11 @@ namespace portal {
         
         // Virtual deserialize to allow for specific entity type deserialization
         virtual void deserialize(const nlohmann::json&); // Deserializes the entity data and components from a json object
+
+        // Writes the state this type of entity changes while the world is played and reads it back in place
+        // (the transform and the components are saved by the world, see "World::takeSnapshot")
+        virtual void saveState(BlobWriter&) const {}
+        virtual void restoreState(BlobReader&) {}
         
         // This template method create a component of type T,
         // adds it to the components map and returns a pointer to it 
@@ -3,26 +3,8 @@
 #include <GLFW/glfw3.h>
 #include "../application.hpp"
 #include "world.hpp"
+#include "reflection.hpp"
 namespace portal {
-    // Class Handle player Grounded
-    class RayCastInteraction : public r3d::RaycastCallback {
-        std::string& attachedName;
-        public:
-        RayCastInteraction(std::string& attachedName) : attachedName(attachedName) {}
-        // Called when a raycast hits a body
-        virtual r3d::decimal notifyRaycastHit(const r3d::RaycastInfo& raycastInfo) override {
-            // Get the name of the body that has been hit
-            if(raycastInfo.body->getCollider(0)->getIsTrigger()){
-                // if trigger, return 1.0 to continue raycast
-                return r3d::decimal(1.0);
-            }
-            attachedName = *((std::string*)raycastInfo.body->getUserData());
-            // std::cout << "RayCast Hit" << attachedName << std::endl;
-            // return 0 to stop raycast
-            return r3d::decimal(0.0);
-        }
-    };
-
     void Player::update() {
         // Calculate player vectors
         calculatePlayerVectors();
@@ -42,30 +24,31 @@ namespace portal {
         rgb->getBody()->setTransform(temp);
         rgb->getBody()->setLinearVelocity(r3d::Vector3(0,0,0));
         rgb->getBody()->setAngularVelocity(r3d::Vector3(0,0,0));
-        // transfer collider to separate layer to disable it from colliding with other objects
-        rgb->getCollider()->setCollideWithMaskBits(0);
-        rgb->getCollider()->setCollisionCategoryBits(0);
+        // move the collider to the held layer to disable it from colliding with other objects
+        rgb->setLayer("Held");
     }
     
     void Player::checkAttachment() {
         // Check if E is pressed
         if(!attachement && app->getKeyboard().justPressed(GLFW_KEY_E)) {
             // RayCast from player position to front direction with length 1.5
-            r3d::Ray ray(localTransform.getPosition() + absoluteFront,absoluteFront * 3 + localTransform.getPosition());
-            getWorld()->getPhysicsWorld()->raycast(ray, new RayCastInteraction(attachementName));
-            if(attachementName.empty()) return;
-            // get entity with current attachementName and check if it is attachable
-            Entity *potentialAttachement = getWorld()->getEntityByName(attachementName);
-            if(potentialAttachement->isAttachable) {
-                attachement = potentialAttachement;
+            r3d::Vector3 from = localTransform.getPosition() + absoluteFront, to = absoluteFront * 3 + localTransform.getPosition();
+            // The triggers and the held objects can't be picked up
+            QueryFilter filter;
+            filter.layers = getWorld()->getCollisionLayers().getBitsExcept({"Trigger", "Held"});
+            QueryHit hit;
+            if(!getWorld()->getSceneQuery().raycastClosest(glm::vec3(from.x, from.y, from.z), glm::vec3(to.x, to.y, to.z), hit, filter)) return;
+            // check if the closest entity is attachable
+            if(hit.entity->isAttachable) {
+                attachement = hit.entity;
+                attachementName = hit.entity->name;
             }
         } else if (app->getKeyboard().justPressed(GLFW_KEY_E)) {
             // If E is pressed and we have an attachement then we detach it
             // attachment should return to not be a trigger to collide with other objects
-            r3d::Collider *collider = attachement->getComponent<RigidBodyComponent>()->getCollider();
-            // return collider to same layer as other objects to collide with them again
-            collider->setCollideWithMaskBits(1);
-            collider->setCollisionCategoryBits(1);
+            RigidBodyComponent *rgb = attachement->getComponent<RigidBodyComponent>();
+            // return collider to its own layer to collide with other objects again
+            rgb->setLayer(rgb->getLayer());
             attachement = nullptr;
             attachementName = "";
         }
@@ -90,4 +73,14 @@ namespace portal {
         right.y = 0;
         right = glm::normalize(right);
     }
-}
\ No newline at end of file
+
+    void Player::saveState(BlobWriter& writer) const {
+        writer.write(attachement);
+        Packer<std::string>::pack(writer, attachementName);
+    }
+
+    void Player::restoreState(BlobReader& reader) {
+        attachement = reader.read<Entity*>();
+        Packer<std::string>::unpack(reader, attachementName);
+    }
+}
@@ -29,6 +29,9 @@ namespace portal {
         const glm::vec3 &getFront() const { return front; }
         const glm::vec3 &getRight() const { return right; }
         Entity *getAttachement() const { return attachement; }
+        // Saves and restores the attached entity (the entities of a world are kept by its snapshots)
+        virtual void saveState(BlobWriter& writer) const override;
+        virtual void restoreState(BlobReader& reader) override;
         virtual EntityFactory::EntityType getType() const override { return EntityFactory::EntityType::Player; }
     };
 
@@ -6,6 +6,7 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/glm.hpp>
 #include "../components/RigidBody.hpp"
+#include "reflection.hpp"
 #include "../../states/play-state.hpp"
 namespace r3d = reactphysics3d;
 
@@ -15,7 +16,6 @@ namespace portal {
     void Portal::setSurface(Entity *surf) {
         surface = surf;
         surfaceCollider = surface->getComponent<RigidBodyComponent>()->getCollider();
-        this->getComponent<RigidBodyComponent>()->getCollider()->setCollideWithMaskBits(1);
     }
 
     void Portal::calculateFailSafeLocation(const std::string& objectName) {
@@ -148,7 +148,9 @@ namespace portal {
 
         // Call teleportation functions
         // on position, orientation, and velocity
-        r3d::Vector3 newPosition = teleportedPosition(ObjectName, object->localTransform.getPosition());
+        // The position of the body is used since the rendered position of the entity trails it (see "MovementSystem")
+        r3d::Vector3 objectPosition = objectRgb->getBody()->getTransform().getPosition() - objectRgb->relativePosition;
+        r3d::Vector3 newPosition = teleportedPosition(ObjectName, objectPosition);
         r3d::Quaternion newRotation = teleportedRotation(object->localTransform.getRotation(), ObjectName);
         r3d::Vector3 newVelocity = teleportedVelocity(objectRgb->getBody()->getLinearVelocity());
         
@@ -273,22 +275,16 @@ namespace portal {
 
         // RayCast behind the portal to get the surface
         // the portal is currently on (if any)
-        std::string surfaceName = "";
-        RayCastGetSurface rayCastHandler(surfaceName);
         // Ray Cast from center of portal to behind it (in direction of -ve normal)
         glm::vec4 start(localToWorld * glm::vec4(0, 0, 0, 1));
         // Note: portalNormal is front facing
         glm::vec4 end = start - portalNormal;
-        r3d::Ray ray(r3d::Vector3(start.x, start.y, start.z), r3d::Vector3(end.x, end.y, end.z));
-        // Cast ray with rayCastHandler
-        getWorld()->getPhysicsWorld()->raycast(ray, &rayCastHandler);
-        // if surfaceName got modified then we found a surface
-        if(surfaceName != "") {
-            // Set the surface with entity with name surfaceName
-            Entity* surface = getWorld()->getEntityByName(surfaceName);
-            if(surface != nullptr) {
-                setSurface(surface);
-            }
+        // The triggers (e.g. the portal itself) and the held objects are not surfaces
+        QueryFilter filter;
+        filter.layers = getWorld()->getCollisionLayers().getBitsExcept({"Trigger", "Held"});
+        QueryHit hit;
+        if(getWorld()->getSceneQuery().raycastClosest(glm::vec3(start), glm::vec3(end), hit, filter)) {
+            setSurface(hit.entity);
         }
     }
     void Portal::assertRemoval(const std::string &objectName) {
@@ -299,4 +295,44 @@ namespace portal {
             markedForRemoval.insert(objectName);
         }
     }
-}
\ No newline at end of file
+
+    // The placement of a portal saved in a snapshot of the world
+    struct PortalState {
+        Entity* surface;
+        r3d::Collider* surfaceCollider;
+        Portal* destination;
+        glm::fquat portalRot, invPortalRot;
+        glm::mat4 invLocalToWorld, localToWorld;
+        glm::vec4 portalNormal;
+        glm::vec3 portalPosition;
+        bool togObj;
+        bool isPlaced;
+    };
+
+    void Portal::saveState(BlobWriter& writer) const {
+        writer.write(PortalState{
+            surface, surfaceCollider, destination, portalRot, invPortalRot, invLocalToWorld, localToWorld,
+            portalNormal, portalPosition, togObj, isPlaced
+        });
+    }
+
+    void Portal::restoreState(BlobReader& reader) {
+        PortalState state = reader.read<PortalState>();
+        surface = state.surface;
+        surfaceCollider = state.surfaceCollider;
+        destination = state.destination;
+        portalRot = state.portalRot;
+        invPortalRot = state.invPortalRot;
+        invLocalToWorld = state.invLocalToWorld;
+        localToWorld = state.localToWorld;
+        portalNormal = state.portalNormal;
+        portalPosition = state.portalPosition;
+        togObj = state.togObj;
+        isPlaced = state.isPlaced;
+        // The triggers of the surface and of the passing objects are restored by their rigid bodies
+        objectRgb = nullptr;
+        passedObjects.clear();
+        markedForRemoval.clear();
+        failSafeTeleportLocation.clear();
+    }
+}
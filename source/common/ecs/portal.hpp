@@ -13,24 +13,6 @@ namespace portal {
     class RigidBodyComponent;
     class EntityFactory;
     class Portal : public Entity {
-        // Class Handle player Grounded
-        class RayCastGetSurface : public r3d::RaycastCallback {
-            std::string& surfaceName;
-            public:
-            RayCastGetSurface(std::string& surfaceName) : surfaceName(surfaceName) {}
-            // Called when a raycast hits a body
-            virtual r3d::decimal notifyRaycastHit(const r3d::RaycastInfo& raycastInfo) override {
-                // Get the name of the body that has been hit
-                if(raycastInfo.body->getCollider(0)->getIsTrigger()){
-                    // if trigger, return 1.0 to continue raycast
-                    return r3d::decimal(1.0);
-                }
-                surfaceName = *((std::string*)raycastInfo.body->getUserData());
-                // std::cout << "Surface Retrieved: " << surfaceName << std::endl;
-                // return 0 to stop raycast
-                return r3d::decimal(0.0);
-            }
-        };
         // Make EntityFactory a friend so that it can call the private constructor
         friend class EntityFactory;
 
@@ -81,6 +63,8 @@ namespace portal {
         glm::mat4 localToWorld;
         glm::vec4 portalNormal; //(x,y,z,0)
         glm::vec3 portalPosition; //(x,y,z)
+        // Whether the portal was shot on a surface (set by the portal manager)
+        bool isPlaced = false;
 
         // Once a destination is set then we can calculate
         // the cached values
@@ -103,6 +87,11 @@ namespace portal {
         // Adds it to markedForRemoval
         void assertRemoval(const std::string &objectName);
 
+        // Saves and restores the placement of the portal and its cached values (see "World::takeSnapshot")
+        // The objects passing through the portal are dropped, the overlaps of the next physics update add them again
+        virtual void saveState(BlobWriter& writer) const override;
+        virtual void restoreState(BlobReader& reader) override;
+
         virtual EntityFactory::EntityType getType() const override { return EntityFactory::EntityType::Portal; }
     };
 }
\ No newline at end of file
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "component.hpp"
+#include "../deserialize-utils.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// This file lets a type declare its fields once to get its json reading & writing, its packed binary form and a diff between two values.
+// A type declares its fields by defining a static "getFields" function that returns a tuple of fields:
+//
+//     static auto getFields() {
+//         return std::make_tuple(
+//             field("near", &CameraComponent::near),
+//             field("fovY", &CameraComponent::fovY, DegreesCodec())
+//         );
+//     }
+//
+// - The json key of each field is its name, the codec decides how the value is written in json (by default its own json value)
+// - The packed form is the fields in their order, each one in its in-memory form (see "Packer"), it is only read by the same build
+// - A type with "getFields" can be the type of a field (it is read and written as a json object or packed in place)
+// The components use it through "ReflectedComponent"
+
+namespace portal {
+
+    template<typename T>
+    class AssetHandle;
+    template<typename T>
+    class AssetLoader;
+
+    // Appends packed data to a byte array
+    struct BlobWriter {
+        std::vector<uint8_t>& bytes;
+
+        template<typename T>
+        void write(const T& value){
+            static_assert(std::is_trivially_copyable_v<T>);
+            writeBytes(&value, sizeof(T));
+        }
+        void writeBytes(const void* data, size_t size){
+            bytes.insert(bytes.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+        }
+    };
+
+    // Reads packed data, the values read past its end are zero
+    struct BlobReader {
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+
+        template<typename T>
+        T read(){
+            T value = {};
+            if(const uint8_t* bytes = readBytes(sizeof(T))) std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+        // Returns the next "count" bytes (null if there are not enough bytes left)
+        const uint8_t* readBytes(size_t count){
+            if(count > size - position) return nullptr;
+            const uint8_t* bytes = data + position;
+            position += count;
+            return bytes;
+        }
+        size_t remaining() const { return size - position; }
+    };
+
+    // A bit for each field of a type (the fields that differ between two values, see "diffFields")
+    using FieldMask = uint64_t;
+
+    template<typename T, typename = void>
+    struct HasFields : std::false_type {};
+    template<typename T>
+    struct HasFields<T, std::void_t<decltype(T::getFields())>> : std::true_type {};
+
+    template<typename T> void readFields(const nlohmann::json& data, T& object);
+    template<typename T> void writeFields(nlohmann::json& data, const T& object);
+    template<typename T> void packFields(BlobWriter& writer, const T& object);
+    template<typename T> void unpackFields(BlobReader& reader, T& object);
+    template<typename T> bool equalFields(const T& a, const T& b);
+
+    // How a value is packed: a type with fields packs its fields, a trivially copyable value is copied as is,
+    // strings and vectors are written as their size followed by their elements
+    // Specialize it for the other types (e.g. "AssetHandle" packs the name of its asset)
+    template<typename T, typename = void>
+    struct Packer {
+        static_assert(std::is_trivially_copyable_v<T>, "Specialize \"Packer\" for this type");
+        static void pack(BlobWriter& writer, const T& value){ writer.write(value); }
+        static void unpack(BlobReader& reader, T& value){ value = reader.read<T>(); }
+    };
+
+    template<typename T>
+    struct Packer<T, std::enable_if_t<HasFields<T>::value>> {
+        static void pack(BlobWriter& writer, const T& value){ packFields(writer, value); }
+        static void unpack(BlobReader& reader, T& value){ unpackFields(reader, value); }
+    };
+
+    template<>
+    struct Packer<std::string> {
+        static void pack(BlobWriter& writer, const std::string& value){
+            writer.write((uint32_t)value.size());
+            writer.writeBytes(value.data(), value.size());
+        }
+        static void unpack(BlobReader& reader, std::string& value){
+            uint32_t size = reader.read<uint32_t>();
+            const uint8_t* bytes = reader.readBytes(size);
+            if(bytes) value.assign((const char*)bytes, size);
+            else value.clear();
+        }
+    };
+
+    template<typename T>
+    struct Packer<std::vector<T>> {
+        static void pack(BlobWriter& writer, const std::vector<T>& value){
+            writer.write((uint32_t)value.size());
+            for(auto& element : value) Packer<T>::pack(writer, element);
+        }
+        static void unpack(BlobReader& reader, std::vector<T>& value){
+            // Every element takes at least a byte, so a corrupted size can't allocate more than the blob
+            size_t count = std::min<size_t>(reader.read<uint32_t>(), reader.remaining());
+            value.clear();
+            value.resize(count);
+            for(auto& element : value) Packer<T>::unpack(reader, element);
+        }
+    };
+
+    // A handle packs the name of its asset and acquires it again when it is unpacked
+    template<typename T>
+    struct Packer<AssetHandle<T>> {
+        static void pack(BlobWriter& writer, const AssetHandle<T>& value){ Packer<std::string>::pack(writer, value.getName()); }
+        static void unpack(BlobReader& reader, AssetHandle<T>& value){
+            std::string name;
+            Packer<std::string>::unpack(reader, name);
+            value = name.empty() ? AssetHandle<T>() : AssetLoader<T>::acquire(name);
+        }
+    };
+
+    // The codec of a field decides how it is written in json. This one uses the json value of the type itself
+    // (the "from_json" & "to_json" of the type, or its fields for a type with fields)
+    struct ValueCodec {
+        template<typename T>
+        void read(const nlohmann::json& data, T& value) const {
+            if constexpr(HasFields<T>::value) readFields(data, value);
+            else value = data.get<T>();
+        }
+        template<typename T>
+        nlohmann::json write(const T& value) const {
+            nlohmann::json data;
+            if constexpr(HasFields<T>::value) writeFields(data, value);
+            else data = value;
+            return data;
+        }
+    };
+
+    // An angle (or euler angles) stored in radians and written in degrees
+    struct DegreesCodec {
+        template<typename T>
+        void read(const nlohmann::json& data, T& value) const { value = glm::radians(data.get<T>()); }
+        template<typename T>
+        nlohmann::json write(const T& value) const { return glm::degrees(value); }
+    };
+
+    // An angle stored as its cosine and written in degrees (e.g. the cone of a spot light)
+    struct CosineDegreesCodec {
+        void read(const nlohmann::json& data, float& value) const { value = glm::cos(glm::radians(data.get<float>())); }
+        nlohmann::json write(const float& value) const { return glm::degrees(glm::acos(glm::clamp(value, -1.0f, 1.0f))); }
+    };
+
+    // An enum written as one of the given names, an unknown name keeps the current value
+    // If a value has more than one name, the first one is written
+    template<typename E, size_t N>
+    struct EnumCodec {
+        std::array<std::pair<const char*, E>, N> names;
+
+        void read(const nlohmann::json& data, E& value) const {
+            if(!data.is_string()) return;
+            const std::string& name = data.get_ref<const std::string&>();
+            for(auto& [enumName, enumValue] : names){
+                if(name == enumName){
+                    value = enumValue;
+                    return;
+                }
+            }
+        }
+        nlohmann::json write(const E& value) const {
+            for(auto& [enumName, enumValue] : names)
+                if(enumValue == value) return enumName;
+            return nullptr;
+        }
+    };
+
+    template<typename E, size_t N>
+    EnumCodec<E, N> enumCodec(const std::pair<const char*, E> (&names)[N]){
+        EnumCodec<E, N> codec = {};
+        for(size_t index = 0; index < N; index++) codec.names[index] = names[index];
+        return codec;
+    }
+
+    // A field of "Class" named "name" in json
+    template<typename Class, typename T, typename Codec>
+    struct Field {
+        const char* name;
+        T Class::* member;
+        Codec codec;
+
+        void read(const nlohmann::json& data, Class& object) const {
+            if(auto it = data.find(name); it != data.end()) codec.read(*it, object.*member);
+        }
+        void write(nlohmann::json& data, const Class& object) const { data[name] = codec.write(object.*member); }
+        void pack(BlobWriter& writer, const Class& object) const { Packer<T>::pack(writer, object.*member); }
+        void unpack(BlobReader& reader, Class& object) const { Packer<T>::unpack(reader, object.*member); }
+        bool equals(const Class& a, const Class& b) const {
+            if constexpr(HasFields<T>::value) return equalFields(a.*member, b.*member);
+            else return a.*member == b.*member;
+        }
+    };
+
+    template<typename Class, typename T, typename Codec = ValueCodec>
+    constexpr Field<Class, T, Codec> field(const char* name, T Class::* member, Codec codec = {}){
+        return {name, member, codec};
+    }
+
+    // A member whose fields are read and written at the same level as the fields of "Class" (instead of a nested object)
+    template<typename Class, typename T>
+    struct InlineField {
+        T Class::* member;
+
+        void read(const nlohmann::json& data, Class& object) const { readFields(data, object.*member); }
+        void write(nlohmann::json& data, const Class& object) const { writeFields(data, object.*member); }
+        void pack(BlobWriter& writer, const Class& object) const { packFields(writer, object.*member); }
+        void unpack(BlobReader& reader, Class& object) const { unpackFields(reader, object.*member); }
+        bool equals(const Class& a, const Class& b) const { return equalFields(a.*member, b.*member); }
+    };
+
+    template<typename Class, typename T>
+    constexpr InlineField<Class, T> inlineFields(T Class::* member){
+        static_assert(HasFields<T>::value, "Only a type with fields can be inlined");
+        return {member};
+    }
+
+    // Reads the fields found in the json object (the missing ones keep their current value)
+    template<typename T>
+    void readFields(const nlohmann::json& data, T& object){
+        if(!data.is_object()) return;
+        std::apply([&](const auto&... fields){ (fields.read(data, object), ...); }, T::getFields());
+    }
+
+    // Writes every field into the json object
+    template<typename T>
+    void writeFields(nlohmann::json& data, const T& object){
+        if(!data.is_object()) data = nlohmann::json::object();
+        std::apply([&](const auto&... fields){ (fields.write(data, object), ...); }, T::getFields());
+    }
+
+    template<typename T>
+    void packFields(BlobWriter& writer, const T& object){
+        std::apply([&](const auto&... fields){ (fields.pack(writer, object), ...); }, T::getFields());
+    }
+
+    template<typename T>
+    void unpackFields(BlobReader& reader, T& object){
+        std::apply([&](const auto&... fields){ (fields.unpack(reader, object), ...); }, T::getFields());
+    }
+
+    // Returns true if every field of "a" equals the same field of "b"
+    template<typename T>
+    bool equalFields(const T& a, const T& b){
+        return std::apply([&](const auto&... fields){ return (fields.equals(a, b) && ...); }, T::getFields());
+    }
+
+    // Returns a mask with the bit of each field that differs between "a" and "b" (bit i for the i-th field)
+    template<typename T>
+    FieldMask diffFields(const T& a, const T& b){
+        FieldMask mask = 0;
+        std::apply([&](const auto&... fields){
+            static_assert(sizeof...(fields) <= 64, "A field mask holds at most 64 fields");
+            FieldMask bit = 1;
+            ((mask |= (fields.equals(a, b) ? 0 : bit), bit <<= 1), ...);
+        }, T::getFields());
+        return mask;
+    }
+
+    // Packs the mask followed by the fields in the mask (e.g. the fields returned by "diffFields")
+    template<typename T>
+    void packChangedFields(BlobWriter& writer, const T& object, FieldMask mask){
+        writer.write(mask);
+        std::apply([&](const auto&... fields){
+            FieldMask bit = 1;
+            ((mask & bit ? fields.pack(writer, object) : void(), bit <<= 1), ...);
+        }, T::getFields());
+    }
+
+    // Reads the fields written by "packChangedFields" and returns their mask
+    template<typename T>
+    FieldMask unpackChangedFields(BlobReader& reader, T& object){
+        FieldMask mask = reader.read<FieldMask>();
+        std::apply([&](const auto&... fields){
+            FieldMask bit = 1;
+            ((mask & bit ? fields.unpack(reader, object) : void(), bit <<= 1), ...);
+        }, T::getFields());
+        return mask;
+    }
+
+    // A component whose data is described by the fields of "T" (its "getFields"), so it gets its json reading & writing,
+    // its packed form and its diff without writing them. "T" can define "onFieldsRead" to set up the component once its
+    // fields were read from json or unpacked (e.g. to create the body of a rigid body), the changed fields of a diff are
+    // written as is without setting the component up again
+    template<typename T>
+    class ReflectedComponent : public Component {
+        T& self() { return static_cast<T&>(*this); }
+        const T& self() const { return static_cast<const T&>(*this); }
+    protected:
+        void onFieldsRead() {}
+    public:
+        void deserialize(const nlohmann::json& data) override {
+            if(!data.is_object()) return;
+            readFields(data, self());
+            self().onFieldsRead();
+        }
+        void serialize(nlohmann::json& data) const override {
+            data["type"] = T::getID();
+            writeFields(data, self());
+        }
+        void pack(BlobWriter& writer) const override { packFields(writer, self()); }
+        void unpack(BlobReader& reader) override {
+            unpackFields(reader, self());
+            self().onFieldsRead();
+        }
+        FieldMask diff(const Component& other) const override {
+            const T* otherComponent = dynamic_cast<const T*>(&other);
+            return otherComponent ? diffFields(self(), *otherComponent) : ~(FieldMask)0;
+        }
+        void packChanged(BlobWriter& writer, FieldMask mask) const override { packChangedFields(writer, self(), mask); }
+        void unpackChanged(BlobReader& reader) override { unpackChangedFields(reader, self()); }
+        // By default the state of a component is its fields (restored without calling "onFieldsRead")
+        void saveState(BlobWriter& writer) const override { packFields(writer, self()); }
+        void restoreState(BlobReader& reader) override { unpackFields(reader, self()); }
+    };
+
+}
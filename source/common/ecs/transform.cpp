@@ -26,7 +26,23 @@ namespace portal {
         glm::vec3 rotation(0,0,0), position(0,0,0);
         position = data.value("position", position);
         rotation = glm::radians(data.value("rotation", glm::degrees(rotation)));
-        scale    = data.value("scale", scale);
+        set(position, rotation, data.value("scale", scale));
+    }
+
+    void Transform::serialize(nlohmann::json& data) const {
+        const r3d::Vector3& position = transform.getPosition();
+        const r3d::Quaternion& orientation = transform.getOrientation();
+        // The rotation is applied as yaw, pitch then roll (see "set"), which is the YXZ order of glm
+        glm::mat4 rotationMatrix = glm::mat4_cast(glm::quat(orientation.w, orientation.x, orientation.y, orientation.z));
+        glm::vec3 rotation;
+        glm::extractEulerAngleYXZ(rotationMatrix, rotation.y, rotation.x, rotation.z);
+        data["position"] = glm::vec3(position.x, position.y, position.z);
+        data["rotation"] = glm::degrees(rotation);
+        data["scale"] = scale;
+    }
+
+    void Transform::set(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale){
+        this->scale = scale;
         transform.setPosition(r3d::Vector3(position.x, position.y, position.z));
         // axis angle for yaw, pitch, roll
         glm::quat yawQuat = glm::angleAxis(rotation.y, glm::vec3(0,1,0));
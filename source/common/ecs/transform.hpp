@@ -18,6 +18,10 @@ namespace portal {
         glm::mat4 toMat4() const;
          // Deserializes the entity data and components from a json object
         void deserialize(const nlohmann::json&);
+        // Writes the position, the rotation (euler angles in degrees) and the scale in the form read by "deserialize"
+        void serialize(nlohmann::json&) const;
+        // Sets the transform from a position, euler angles in radians (applied as yaw, pitch then roll) and a scale
+        void set(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
 
         const r3d::Transform& getTransform() const {
             return transform;
@@ -40,6 +44,12 @@ namespace portal {
         }
 
         static r3d::Transform interpolate(const Transform &a, const Transform &b, float t);
+
+        bool operator==(const Transform& other) const { return transform == other.transform && scale == other.scale; }
     };
 
+    // Lets a transform be the value of a json field (see "reflection.hpp")
+    inline void from_json(const nlohmann::json& data, Transform& transform){ transform.deserialize(data); }
+    inline void to_json(nlohmann::json& data, const Transform& transform){ transform.serialize(data); }
+
 }
\ No newline at end of file
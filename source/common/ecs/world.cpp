@@ -5,6 +5,7 @@
 #include "portal.hpp"
 #include "../systems/event.hpp"
 #include "entity-factory.hpp"
+#include "reflection.hpp"
 namespace portal {
 
     // This will deserialize a json array of entities and add the new entities to the current world
@@ -13,13 +14,9 @@ namespace portal {
     void World::deserialize(const nlohmann::json& data, Entity* parent){
         if(!data.is_array()) return;
         for(const auto& entityData : data){
-            std::string name = entityData.value("name", std::to_string(entities.size()));
+            std::string name = entityData.value("name", "");
             std::string type = entityData.value("type", "Regular");
-            Entity *entity = EntityFactory::createEntity(EntityFactory::stringToEntityType(type));
-            entity->parent = parent;
-            entity->name = name;
-            entity->world = this;
-            entities[entity->name] = entity;
+            Entity *entity = createEntity(EntityFactory::stringToEntityType(type), name, parent);
             entity->deserialize(entityData);
             if(entityData.contains("children")){
                 deserialize(entityData["children"], entity);
@@ -27,6 +24,16 @@ namespace portal {
         }
     }
 
+    Entity* World::createEntity(EntityFactory::EntityType type, const std::string& name, Entity* parent){
+        Entity *entity = EntityFactory::createEntity(type);
+        entity->parent = parent;
+        entity->name = name.empty() ? std::to_string(entities.size()) : name;
+        entity->world = this;
+        entities[entity->name] = entity;
+        generation++;
+        return entity;
+    }
+
     Entity *World::getEntityByName(const std::string &name) const {
         return entities.at(name);
     }
@@ -38,8 +45,15 @@ namespace portal {
         gravity = data.value("gravity", gravity);
         settings.gravity = r3d::Vector3(gravity.x, gravity.y, gravity.z);
         settings.worldName = data.value("worldName", settings.worldName);
+        // The layers must be known before the colliders are created
+        if(data.contains("collisionLayers")) collisionLayers.deserialize(data["collisionLayers"]);
         // TODO: Support other world settings if needed
 
+        // The overlap probes of the scene queries belong to the previous physics world
+        sceneQuery.reset();
+        // The bodies of the previous scene were destroyed with its entities, so its physics world and shapes can go
+        if(this->physicsWorld) this->physicsCommon.destroyPhysicsWorld(this->physicsWorld);
+        shapeLibrary.clear();
         this->physicsWorld = this->physicsCommon.createPhysicsWorld(settings);
         // Create a new eventsystem that would be used to detect collisions
         // pass isGrounded by reference to allow the event system to change it
@@ -90,4 +104,39 @@ namespace portal {
         }
         toStopPlaying.clear();
     }
-}
\ No newline at end of file
+
+    void World::takeSnapshot(WorldSnapshot& snapshot) const {
+        // Clearing keeps the memory of the previous snapshot
+        snapshot.data.clear();
+        snapshot.entities.clear();
+        snapshot.world = this;
+        snapshot.generation = generation;
+        BlobWriter writer{snapshot.data};
+        for(auto& [name, entity] : entities) {
+            snapshot.entities.push_back(entity);
+            writer.write(entity->localTransform);
+            entity->saveState(writer);
+            for(Component* component : entity->components) component->saveState(writer);
+        }
+        writer.write((uint32_t)playingAnimations.size());
+        for(auto& [name, animation] : playingAnimations) writer.write(animation);
+    }
+
+    bool World::restoreSnapshot(const WorldSnapshot& snapshot) {
+        if(snapshot.world != this || snapshot.generation != generation) return false;
+        BlobReader reader{snapshot.data.data(), snapshot.data.size()};
+        for(Entity* entity : snapshot.entities) {
+            entity->localTransform = reader.read<Transform>();
+            entity->restoreState(reader);
+            for(Component* component : entity->components) component->restoreState(reader);
+        }
+        playingAnimations.clear();
+        uint32_t playingCount = reader.read<uint32_t>();
+        for(uint32_t index = 0; index < playingCount; index++) {
+            AnimationComponent* animation = reader.read<AnimationComponent*>();
+            playingAnimations[animation->getName()] = animation;
+        }
+        toStopPlaying.clear();
+        return true;
+    }
+}
@@ -1,13 +1,33 @@
 #pragma once
 
 #include <unordered_set>
+#include <vector>
+#include <cstdint>
 #include "entity.hpp"
+#include "../physics/shape-library.hpp"
+#include "../physics/collision-layers.hpp"
+#include "../physics/scene-query.hpp"
 #include <reactphysics3d/reactphysics3d.h>
 
 namespace portal {
 
     class AnimationComponent;
     class EventSystem;
+    class World;
+
+    // A copy of the state of the entities of a world, taken by "World::takeSnapshot" and restored by "World::restoreSnapshot"
+    // The state is packed into one byte array (see "reflection.hpp") so taking a snapshot again reuses its memory
+    struct WorldSnapshot {
+        std::vector<uint8_t> data;
+        // The entities in the order of their state in "data"
+        std::vector<Entity*> entities;
+        // The world it was taken from and its generation at that time (the snapshot is invalid once an entity is created or deleted)
+        const World* world = nullptr;
+        uint64_t generation = 0;
+
+        bool isEmpty() const { return world == nullptr; }
+    };
+
     // This class holds a set of entities
     class World {
         std::unordered_map<std::string, Entity*> entities; // These are the entities held by this world
@@ -15,10 +35,15 @@ namespace portal {
                                                       // when deleteMarkedEntities is called
         r3d::PhysicsCommon physicsCommon; // Factory pattern for creating physics world objects , logging, and memory management
         r3d::PhysicsWorld* physicsWorld = nullptr; // This is the physics world that will be used for physics simulation
+        ShapeLibrary shapeLibrary{physicsCommon}; // The collision shapes shared by the colliders (destroyed before the physics common)
+        CollisionLayers collisionLayers; // The collision layers of the colliders (read from the physics world settings)
+        SceneQuery sceneQuery{this}; // The raycasts and the sphere and box overlap queries of the game logic (see "SceneQuery::flush")
         EventSystem* eventSystem = nullptr; // This is the event system that will be used for collision detection
         std::unordered_map<std::string, AnimationComponent*> animations;
         std::unordered_map<std::string, AnimationComponent *> playingAnimations;
         std::unordered_set<std::string> toStopPlaying;
+        // Incremented whenever an entity is created or deleted (see "WorldSnapshot")
+        uint64_t generation = 0;
     public:
 
         World() = default;
@@ -28,6 +53,9 @@ namespace portal {
         // If any of the entities has children, this function will be called recursively for these children
         void deserialize(const nlohmann::json& data, Entity* parent = nullptr);
 
+        // Creates an entity of the given type and adds it to the world (an entity without a name is named by its index)
+        Entity* createEntity(EntityFactory::EntityType type, const std::string& name, Entity* parent = nullptr);
+
         // This will deserialize a json object of physics world settings and create a physics world
         // The physics world will be used for physics simulation
         void deserialize_physics(const nlohmann::json& data, const nlohmann::json* onTriggerData = nullptr);
@@ -58,6 +86,7 @@ namespace portal {
                 delete entities[name];
                 entities.erase(name);
             }
+            if(!markedForRemoval.empty()) generation++;
             markedForRemoval.clear();
         }
 
@@ -80,6 +109,18 @@ namespace portal {
             return physicsCommon;
         }
 
+        ShapeLibrary& getShapeLibrary() {
+            return shapeLibrary;
+        }
+
+        const CollisionLayers& getCollisionLayers() const {
+            return collisionLayers;
+        }
+
+        SceneQuery& getSceneQuery() {
+            return sceneQuery;
+        }
+
         void startAnimation(const std::string &name, bool reverse = false);
 
         void addAnimation(const std::string& name, AnimationComponent* animation) {
@@ -104,6 +145,15 @@ namespace portal {
         // resetting when changing states of the game
         void clearPlayingAnimations();
 
+        // Saves the state of the entities into the snapshot: their transforms, the state of their components
+        // (e.g. the rigid bodies and the progress of the animations, see "Component::saveState") and of their type
+        // (e.g. the placement of the portals, see "Entity::saveState") and the playing animations
+        void takeSnapshot(WorldSnapshot& snapshot) const;
+        // Rewrites the state of the entities from the snapshot in place (no entity or physics body is created),
+        // returns false if the snapshot was not taken from this world or entities were created or deleted since then
+        // The contacts and overlaps of the physics world are updated by its next update
+        bool restoreSnapshot(const WorldSnapshot& snapshot);
+
         //Since the world owns all of its entities, they should be deleted alongside it.
         ~World(){
             clear();
@@ -0,0 +1,88 @@
+#include "job-system.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace portal {
+
+    void JobSystem::start(size_t workerCount){
+        if(!workers.empty()) return;
+        if(workerCount == 0) workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        // On a single core, the jobs run on the threads that queue them
+        stopping = false;
+        for(size_t i = 0; i < workerCount; i++) workers.emplace_back(workerLoop);
+    }
+
+    void JobSystem::stop(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobQueued.notify_all();
+        for(auto& worker : workers) worker.join();
+        workers.clear();
+    }
+
+    void JobSystem::execute(std::function<void()>& job, JobCounter* counter){
+        job();
+        if(counter) counter->pending--;
+        notifyWaiting();
+    }
+
+    void JobSystem::workerLoop(){
+        while(true){
+            std::pair<std::function<void()>, JobCounter*> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobQueued.wait(lock, []{ return stopping || !jobs.empty(); });
+                // The queued jobs are finished before stopping
+                if(jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            execute(job.first, job.second);
+        }
+    }
+
+    void JobSystem::run(std::function<void()> job, JobCounter* counter){
+        if(counter) counter->pending++;
+        if(workers.empty()){
+            execute(job, counter);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace_back(std::move(job), counter);
+        }
+        jobQueued.notify_one();
+    }
+
+    void JobSystem::wait(JobCounter& counter){
+        while(!counter.isDone()){
+            std::pair<std::function<void()>, JobCounter*> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if(jobs.empty()){
+                    // Nothing to help with, sleep until a job is done (the timeout covers the jobs done before locking)
+                    jobDone.wait_for(lock, std::chrono::milliseconds(1), [&]{ return counter.isDone() || !jobs.empty(); });
+                    continue;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            execute(job.first, job.second);
+        }
+    }
+
+    void JobSystem::waitForAnyJob(double milliseconds){
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait_for(lock, std::chrono::duration<double, std::milli>(milliseconds));
+    }
+
+    void JobSystem::notifyWaiting(){
+        // Lock so a thread that just checked its counter can't miss the notification
+        { std::lock_guard<std::mutex> lock(mutex); }
+        jobDone.notify_all();
+    }
+
+}
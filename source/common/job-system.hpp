@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace portal {
+
+    // The number of jobs of a group that are still queued or running (see "JobSystem::run")
+    struct JobCounter {
+        std::atomic<int> pending = 0;
+        bool isDone() const { return pending == 0; }
+    };
+
+    // This static class runs jobs on a pool of worker threads (one per core by default)
+    // The jobs must not use OpenGL since the workers have no context, the CPU work of the assets is done in jobs
+    // and the GPU work is pushed to an "UploadQueue" drained by the thread that owns the context
+    class JobSystem {
+        static inline std::vector<std::thread> workers;
+        static inline std::deque<std::pair<std::function<void()>, JobCounter*>> jobs;
+        static inline std::mutex mutex;
+        // Signaled when a job is queued or when the workers should stop
+        static inline std::condition_variable jobQueued;
+        // Signaled when a job of any group is done (or when "notifyWaiting" is called)
+        static inline std::condition_variable jobDone;
+        static inline bool stopping = false;
+
+        static void workerLoop();
+        static void execute(std::function<void()>& job, JobCounter* counter);
+    public:
+        // Starts the worker threads, if "workerCount" is 0 one worker is started per core except the one of the main thread
+        static void start(size_t workerCount = 0);
+        // Waits for the queued jobs then stops the worker threads
+        static void stop();
+        static size_t getWorkerCount() { return workers.size(); }
+
+        // Queues the job, the counter (if any) is incremented now and decremented when the job is done
+        // If the workers were not started, the job runs immediately on the calling thread
+        static void run(std::function<void()> job, JobCounter* counter = nullptr);
+        // Waits for all the jobs of the counter, the calling thread runs queued jobs while it waits
+        // (so it must not be the thread draining an upload queue the jobs push into)
+        static void wait(JobCounter& counter);
+        // Waits until a job is done or the timeout expires (used by the threads that can't run jobs while they wait)
+        static void waitForAnyJob(double milliseconds);
+        // Wakes the threads in "waitForAnyJob" (e.g. when a job queued an upload)
+        static void notifyWaiting();
+    };
+
+}
@@ -7,46 +7,31 @@
 #include "texture/texture2d.hpp"
 #include "texture/sampler.hpp"
 #include "texture/texture-utils.hpp"
-#include "shader/shader.hpp"
+#include "shader/shader-cache.hpp"
 #include <thread>
 
 namespace portal {
-    void LoadingScreen::deserializeMesh(const nlohmann::json& data) {
-        if(data.is_object()){
-            for(auto& [name, desc] : data.items()){
-                progress++;
-                std::string path = desc.get<std::string>();
-                meshData[name] = mesh_utils::loadOBJData(path);
-            }
-        }
-    }
-
     void LoadingScreen::fillAssetLoader() {
-        // loop on meshData and call new Mesh()
-        for(auto& [name, data] : meshData){
-            AssetLoader<Mesh>::assets[name] = new Mesh(*data.first, *data.second);
-        }
+        // Create the meshes queued after the last frame (the stats were reset by the loading thread)
+        meshUploads.drain();
+        meshUploads.finish();
+        if(Mesh::stats.meshes > 0) Mesh::reportStats();
     }
 
     void LoadingScreen::init(Application* app, std::function<void()> multithreadedload, std::function<void()> computeTotal, std::function<void()> callback) {
         doneLoading = false;
         progress = 0;
+        decoded = 0;
         total = 0;
         // Load the loading screen material
         menuMaterial = new TexturedMaterial();
-        menuMaterial->shader = new ShaderProgram();
-        menuMaterial->shader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
-        menuMaterial->shader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-        menuMaterial->shader->link();
+        menuMaterial->shader = ShaderCache::get("assets/shaders/textured.vert", "assets/shaders/textured.frag");
         menuMaterial->texture = texture_utils::loadImage("assets/textures/Loading.png");
         menuMaterial->tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
         // Load the progress bar material
         progressMaterial = new TintedMaterial();
-        progressMaterial->shader = new ShaderProgram();
-        progressMaterial->shader->attach("assets/shaders/tinted.vert", GL_VERTEX_SHADER);
-        progressMaterial->shader->attach("assets/shaders/tinted.frag", GL_FRAGMENT_SHADER);
-        progressMaterial->shader->link();
-        progressMaterial->tint = glm::vec4(0.6666f, 0.83529f, 0.97254f, 1.0f);
+        progressMaterial->shader = ShaderCache::get("assets/shaders/tinted.vert", "assets/shaders/tinted.frag");
+        progressMaterial->tint = progressTint;
         // Load the progress bar mesh
         rectangle = new portal::Mesh({
             {{0.0f, 0.0f, 0.0f}, {255, 255, 255, 255}, {0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
@@ -72,6 +57,7 @@ namespace portal {
     }
 
     void LoadingScreen::render() {
+        meshUploads.bind();
         std::thread loadingThread(LoadingScreen::multithreadedload);
         // Idk these value were just trial and error
         float minWidth = 0.0f;
@@ -80,8 +66,14 @@ namespace portal {
         float x = size.x / 2.0f;
         float y = size.y * 0.729f;
         float curWidth = minWidth;
+        auto barWidth = [&](int count){
+            float width = minWidth + (maxWidth - minWidth) * ((float)count / (float)std::max((int)total, 1));
+            return std::min(width, size.x * 0.465f);
+        };
         while(!doneLoading) {
             glfwMakeContextCurrent(app->getWindow());
+            // Create some of the meshes loaded by the jobs
+            meshUploads.drain(meshUploadBudget);
             // Clear the screen
             glViewport(0, 0, size.x, size.y);
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -93,41 +85,34 @@ namespace portal {
             menuMaterial->setup();
             menuMaterial->shader->set("transform", VP * menuModelMatrix);
             rectangle->draw();
-            // Draw the progress bar
-            progressMaterial->setup();
-            // calculate model matrix based on LoadingScreen::progress / LoadingScreen::total percentage
-            curWidth = minWidth + (maxWidth - minWidth) * ((float)progress / (float)total);
-            curWidth = std::min(curWidth, size.x * 0.465f);
-            x = (size.x - curWidth) / 2.0f;
-            glm::mat4 progressM = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
-            progressM = glm::scale(progressM, glm::vec3(curWidth, height, 1.0f));
-            progressMaterial->shader->set("transform", VP * progressM);
-            rectangle->draw();
+            // Draw the progress bars, the dim bar shows the decoded assets and the bright one shows the uploaded assets
+            for(int stage = 0; stage < 2; stage++){
+                progressMaterial->tint = stage == 0 ? decodedTint : progressTint;
+                progressMaterial->setup();
+                // calculate model matrix based on LoadingScreen::decoded or LoadingScreen::progress / LoadingScreen::total percentage
+                curWidth = barWidth(stage == 0 ? decoded : progress);
+                x = (size.x - curWidth) / 2.0f;
+                glm::mat4 progressM = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+                progressM = glm::scale(progressM, glm::vec3(curWidth, height, 1.0f));
+                progressMaterial->shader->set("transform", VP * progressM);
+                rectangle->draw();
+            }
             // Swap the buffers
             glfwSwapBuffers(app->getWindow());
             // Poll events
             glfwPollEvents();
         }
         loadingThread.join();
+        fillAssetLoader();
         if(callback) callback();
-        else {
-            fillAssetLoader();
-        }
         cleanUp();
     }
 
     void LoadingScreen::cleanUp() {
-        delete menuMaterial->shader;
         delete menuMaterial->texture;
         delete menuMaterial;
-        delete progressMaterial->shader;
         delete progressMaterial;
         delete rectangle;
-        for (auto& [name, data] : meshData) {
-            delete data.first;
-            delete data.second;
-        }
-        meshData.clear();
         delete multithreadedload.target<void(*)()>();
         if(callback) delete callback.target<void(*)()>();
     }
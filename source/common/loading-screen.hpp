@@ -1,6 +1,7 @@
 #pragma once
 #include "asset-loader.hpp"
 #include "mesh/mesh.hpp"
+#include "upload-queue.hpp"
 namespace portal {
     // Loading screen has
     class Application;
@@ -11,6 +12,8 @@ namespace portal {
         static inline TexturedMaterial *menuMaterial = nullptr;
         static inline Mesh *rectangle = nullptr;
         static inline TintedMaterial* progressMaterial = nullptr;
+        static inline const glm::vec4 progressTint = glm::vec4(0.6666f, 0.83529f, 0.97254f, 1.0f);
+        static inline const glm::vec4 decodedTint = glm::vec4(0.3333f, 0.41764f, 0.48627f, 1.0f);
         static inline glm::ivec2 size;
         static inline glm::mat4 VP;
         static inline glm::mat4 menuModelMatrix;
@@ -24,17 +27,20 @@ namespace portal {
         static inline std::function<void()> callback = nullptr;
         static inline Application* app = nullptr;
 
-        // Holds mesh data of .obj files with its name as key
-        static inline std::unordered_map<std::string, std::pair<std::vector<portal::Vertex>*, std::vector<GLuint>*>> meshData;
-        // Loops on meshData and call new Mesh() to be added
-        // to AssetLoader<Mesh>::assets
+        // The time the main thread spends creating the meshes in each frame of the loading screen (in milliseconds)
+        static inline const double meshUploadBudget = 4.0;
+        // Creates the meshes left in meshUploads once loading is done (adding them to AssetLoader<Mesh>::assets)
         static void fillAssetLoader();
         // Gets called at the end of render() to delete LoadingScreen assets
         static void cleanUp();
     public:
-        static inline std::atomic<int> progress = 0; // Progress of the application (used by the loading screen)
+        static inline std::atomic<int> progress = 0; // Number of assets loaded and uploaded to the GPU (used by the loading screen)
+        static inline std::atomic<int> decoded = 0; // Number of assets read or decoded by the loading jobs (used by the loading screen)
         static inline std::atomic<int> total = 0; // Total number of assets to load (used by the loading screen)
         static inline std::atomic<bool> doneLoading = false; // Is the application done loading (used by the loading screen)
+        // The meshes loaded while the loading screen is shown are created by the main thread between the frames
+        // (their vertex arrays can't be shared between contexts)
+        static inline UploadQueue meshUploads{&progress};
 
         // Initializes the loading screen
         // Loads screen, progress bar, and some assets to be displayed
@@ -47,7 +53,7 @@ namespace portal {
         //          o Should update LoadingScreen::total
         //          o Defaults to LoadingScreen::countTotalAssets(app->getConfig()["scene"]["assets"])
         // - callback: lambda function to be called at the end of LoadingScreen::render()
-        //          o Defaults to moving loaded meshData to AssetLoader<Mesh>::assets
+        //          o Called after the remaining meshes are added to AssetLoader<Mesh>::assets
         static void init(Application* app, std::function<void()> multithreadedload, std::function<void()> computeTotal = nullptr, std::function<void()> callback = nullptr);
         // Handles loop to render loading screen
         // (gets called in main thread)
@@ -70,7 +76,5 @@ namespace portal {
             if(assetData.contains("models")) 
                 total += (int)assetData["models"].size();
         }
-        // Loops and loads Obj data (gets called in separate thread in asset-loader.cpp)
-        static void deserializeMesh(const nlohmann::json &data);
     };
 }
\ No newline at end of file
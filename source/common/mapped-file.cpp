@@ -0,0 +1,82 @@
+#include "mapped-file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace portal {
+
+#ifdef _WIN32
+    bool MappedFile::open(const std::string& path){
+        close();
+        HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(fileHandle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0){
+            CloseHandle(fileHandle);
+            return false;
+        }
+        HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mappingHandle){
+            CloseHandle(fileHandle);
+            return false;
+        }
+        void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if(!view){
+            CloseHandle(mappingHandle);
+            CloseHandle(fileHandle);
+            return false;
+        }
+        file = fileHandle;
+        mapping = mappingHandle;
+        data = (const uint8_t*)view;
+        size = (size_t)fileSize.QuadPart;
+        return true;
+    }
+
+    void MappedFile::close(){
+        if(data) UnmapViewOfFile(data);
+        if(mapping) CloseHandle(mapping);
+        if(file) CloseHandle(file);
+        data = nullptr;
+        mapping = file = nullptr;
+        size = 0;
+    }
+#else
+    bool MappedFile::open(const std::string& path){
+        close();
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if(descriptor < 0) return false;
+        struct stat info;
+        if(fstat(descriptor, &info) != 0 || info.st_size == 0){
+            ::close(descriptor);
+            return false;
+        }
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(view == MAP_FAILED){
+            ::close(descriptor);
+            return false;
+        }
+        file = descriptor;
+        data = (const uint8_t*)view;
+        size = (size_t)info.st_size;
+        return true;
+    }
+
+    void MappedFile::close(){
+        if(data) munmap((void*)data, size);
+        if(file >= 0) ::close(file);
+        data = nullptr;
+        file = -1;
+        size = 0;
+    }
+#endif
+
+}
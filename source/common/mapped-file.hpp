@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace portal {
+
+    // A read-only memory mapped file
+    // The operating system pages the file in on demand, so reading a baked asset doesn't need
+    // an intermediate copy in a heap buffer before sending it to the GPU
+    class MappedFile {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+#else
+        int file = -1;
+#endif
+    public:
+        MappedFile() = default;
+        // Maps the given file, use "isOpen" to check if it succeeded
+        explicit MappedFile(const std::string& path) { open(path); }
+        ~MappedFile() { close(); }
+
+        // Maps the whole file into memory, returns false if the file couldn't be opened or mapped
+        bool open(const std::string& path);
+        // Unmaps the file (the pointer returned by "getData" is no longer valid)
+        void close();
+
+        bool isOpen() const { return data != nullptr; }
+        const uint8_t* getData() const { return data; }
+        size_t getSize() const { return size; }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+}
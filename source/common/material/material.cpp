@@ -66,8 +66,8 @@ namespace portal {
         TintedMaterial::deserialize(data);
         if(!data.is_object()) return;
         alphaThreshold = data.value("alphaThreshold", 0.0f);
-        texture = AssetLoader<Texture2D>::get(data.value("texture", ""));
-        sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
+        texture = AssetLoader<Texture2D>::acquire(data.value("texture", ""));
+        sampler = AssetLoader<Sampler>::acquire(data.value("sampler", ""));
     }
 
     // This function should call the setup of its parent and
@@ -77,6 +77,22 @@ namespace portal {
 
         //calling the setup of its parent
         TintedMaterial::setup();
+
+        if(isPacked()){
+            // Each map is a layer of a texture array, the arrays are only bound if the previous material
+            // used different ones so consecutive materials sharing arrays only update the layer indices
+            static const char* mapNames[6] = {"albedoMap", "specularMap", "roughnessMap", "ambient_occlusionMap", "emissionMap", "metallicMap"};
+            static const char* layerNames[6] = {"albedoLayer", "specularLayer", "roughnessLayer", "ambient_occlusionLayer", "emissionLayer", "metallicLayer"};
+            for(GLuint unit = 0; unit < 6; unit++){
+                arrays[unit]->bindToUnit(unit);
+                if(sampler)
+                    sampler->bind(unit);
+                shader->set(mapNames[unit], (GLint)unit);
+                shader->set(layerNames[unit], layers[unit]);
+            }
+            shader->set("alphaThreshold", alphaThreshold);
+            return;
+        }
         
         //binding the textures and sampler to texture units and sending the unit numbers to the uniform variables
         // "albedo", "specular", "roughness", "ambient_occlusion" and "emission"
@@ -128,37 +144,63 @@ namespace portal {
         TintedMaterial::deserialize(data);
         if(!data.is_object()) return;
         if(data.contains("albedo")) {
-            albedo = AssetLoader<Texture2D>::get(data.value("albedo", ""));
+            albedo = AssetLoader<Texture2D>::acquire(data.value("albedo", ""));
         } else {
-            albedo = AssetLoader<Texture2D>::get("default_albedo");
+            albedo = AssetLoader<Texture2D>::acquire("default_albedo");
         } 
         if(data.contains("specular")) {
-            specular = AssetLoader<Texture2D>::get(data.value("specular", ""));
+            specular = AssetLoader<Texture2D>::acquire(data.value("specular", ""));
         } else {
-            specular = AssetLoader<Texture2D>::get("default_specular");
+            specular = AssetLoader<Texture2D>::acquire("default_specular");
         } 
         if(data.contains("roughness")) {
-            roughness = AssetLoader<Texture2D>::get(data.value("roughness", ""));
+            roughness = AssetLoader<Texture2D>::acquire(data.value("roughness", ""));
         } else {
-            roughness = AssetLoader<Texture2D>::get("default_roughness");
+            roughness = AssetLoader<Texture2D>::acquire("default_roughness");
         } 
         if(data.contains("ambient_occlusion")) {
-            ambient_occlusion = AssetLoader<Texture2D>::get(data.value("ambient_occlusion", ""));
+            ambient_occlusion = AssetLoader<Texture2D>::acquire(data.value("ambient_occlusion", ""));
         } else {
-            ambient_occlusion = AssetLoader<Texture2D>::get("default_ambient_occlusion");
+            ambient_occlusion = AssetLoader<Texture2D>::acquire("default_ambient_occlusion");
         } 
         if(data.contains("emission")) {
-            emission = AssetLoader<Texture2D>::get(data.value("emission", ""));
+            emission = AssetLoader<Texture2D>::acquire(data.value("emission", ""));
         } else {
-            emission = AssetLoader<Texture2D>::get("default_emission");
+            emission = AssetLoader<Texture2D>::acquire("default_emission");
         } 
         if(data.contains("metallic")) {
-            metallic = AssetLoader<Texture2D>::get(data.value("metallic", ""));
+            metallic = AssetLoader<Texture2D>::acquire(data.value("metallic", ""));
         } else {
-            metallic = AssetLoader<Texture2D>::get("default_metallic");
+            metallic = AssetLoader<Texture2D>::acquire("default_metallic");
         }
         alphaThreshold = data.value("alphaThreshold", 0.0f);
-        sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
+        sampler = AssetLoader<Sampler>::acquire(data.value("sampler", ""));
+
+        // The maps that are not given use the default maps which are constant, so the shader
+        // doesn't need to sample them (the shader uses the same constants)
+        baseShader = shader;
+        features = {"LIT_FEATURES"};
+        if(data.contains("specular")) features.push_back("HAS_SPECULAR");
+        if(data.contains("roughness")) features.push_back("HAS_ROUGHNESS");
+        if(data.contains("ambient_occlusion")) features.push_back("HAS_AO");
+        if(data.contains("emission")) features.push_back("HAS_EMISSION");
+        if(data.contains("metallic")) features.push_back("HAS_METALLIC");
+    }
+
+    void LitMaterial::selectVariant(int lightCount, bool bloom){
+        int bucket = lightCount <= 1 ? 0 : lightCount <= 2 ? 1 : lightCount <= 4 ? 2 : 3;
+        // Bloom only matters if this material writes bright colors
+        bloom = bloom && this->bloom;
+        bool packed = isPacked();
+        ShaderProgram*& variant = variantCache[bucket][bloom][packed];
+        if(!variant){
+            std::vector<std::string> defines = features;
+            defines.push_back("MAX_LIGHTS " + std::to_string(1 << bucket));
+            if(bloom) defines.push_back("BLOOM");
+            if(packed) defines.push_back("USE_TEXTURE_ARRAY");
+            variant = baseShader->getVariant(defines);
+        }
+        shader = variant;
     }
 
     // This function should call the setup of its parent and
@@ -189,9 +231,9 @@ namespace portal {
     void MultiTextureMaterial::deserialize(const nlohmann::json& data){
         Material::deserialize(data);
         if(!data.is_object()) return;
-        texture1 = AssetLoader<Texture2D>::get(data.value("texture1", ""));
-        texture2 = AssetLoader<Texture2D>::get(data.value("texture2", ""));
-        sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
+        texture1 = AssetLoader<Texture2D>::acquire(data.value("texture1", ""));
+        texture2 = AssetLoader<Texture2D>::acquire(data.value("texture2", ""));
+        sampler = AssetLoader<Sampler>::acquire(data.value("sampler", ""));
 
     }
 
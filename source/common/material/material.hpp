@@ -2,11 +2,16 @@
 
 #include "pipeline-state.hpp"
 #include "../texture/texture2d.hpp"
+#include "../texture/texture2d-array.hpp"
 #include "../texture/sampler.hpp"
 #include "../shader/shader.hpp"
+#include "../asset-loader.hpp"
 
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include <array>
+#include <vector>
+#include <string>
 
 namespace portal {
 
@@ -16,6 +21,8 @@ namespace portal {
     // 2- The shader program used to draw objects using this material
     // 3- Whether this material is transparent or not
     // Materials that send uniforms to the shader should inherit from the is material and add the required uniforms
+    // The textures and samplers are held by handles so they are not evicted while a material uses them
+    // (the shaders stay in the shader cache so they are not counted)
     class Material {
     public:
         PipelineState pipelineState;
@@ -23,6 +30,9 @@ namespace portal {
         bool transparent;
         bool bloom;
 
+        // The materials are deleted through this class (e.g. by the asset loader)
+        virtual ~Material() = default;
+
         // This function does 2 things: setup the pipeline state and set the shader program to be used
         virtual void setup() const;
         // This function read a material from a json object
@@ -46,8 +56,8 @@ namespace portal {
     // An example where this material can be used is when the object has a texture
     class TexturedMaterial : public TintedMaterial {
     public:
-        Texture2D* texture;
-        Sampler* sampler;
+        AssetHandle<Texture2D> texture;
+        AssetHandle<Sampler> sampler;
         float alphaThreshold;
 
         void setup() const override;
@@ -63,15 +73,36 @@ namespace portal {
     // - "emission" which is a Sampler2D. "emission" and "sampler" will be bound to it.
     class LitMaterial : public TintedMaterial {
     public:
-        Sampler* sampler; 
-        Texture2D* albedo;
-        Texture2D* specular;
-        Texture2D* roughness;
-        Texture2D* ambient_occlusion;
-        Texture2D* emission;
-        Texture2D* metallic;
+        AssetHandle<Sampler> sampler; 
+        AssetHandle<Texture2D> albedo;
+        AssetHandle<Texture2D> specular;
+        AssetHandle<Texture2D> roughness;
+        AssetHandle<Texture2D> ambient_occlusion;
+        AssetHandle<Texture2D> emission;
+        AssetHandle<Texture2D> metallic;
         float alphaThreshold;
 
+        // Set by TextureArrayPool when the maps are packed, in the same order as "getMaps"
+        Texture2DArray* arrays[6] = {};
+        int layers[6] = {};
+
+        // The shader given in the material data, "shader" is one of its variants (see selectVariant)
+        ShaderProgram* baseShader = nullptr;
+        // The feature defines of this material (e.g. HAS_EMISSION if it has an emission map), picked when deserializing
+        std::vector<std::string> features;
+        // The variants used so far for each light count bucket (1, 2, 4, 8) with and without bloom,
+        // with standalone maps and with packed maps (the maps can be packed or restored when the assets change)
+        ShaderProgram* variantCache[4][2][2] = {};
+        // Sets "shader" to the smallest variant of the base shader that supports the given number of lights
+        // and bloom state, the variant is compiled the first time it is needed (called by the renderer before setup)
+        void selectVariant(int lightCount, bool bloom);
+
+        // Returns the maps in the order: albedo, specular, roughness, ambient_occlusion, emission, metallic
+        std::array<Texture2D*, 6> getMaps() const {
+            return {albedo, specular, roughness, ambient_occlusion, emission, metallic};
+        }
+        bool isPacked() const { return arrays[0] != nullptr; }
+
         void setup() const override;
         void deserialize(const nlohmann::json& data) override;
     };
@@ -81,9 +112,9 @@ namespace portal {
     // - "tex2" which is a Sampler2D. "texture2" and "sampler2" will be bound to it.
     class MultiTextureMaterial : public Material {
     public:
-        Texture2D* texture1;
-        Texture2D* texture2;
-        Sampler* sampler;
+        AssetHandle<Texture2D> texture1;
+        AssetHandle<Texture2D> texture2;
+        AssetHandle<Sampler> sampler;
         // Sampler* sampler2;
 
         void setup() const override;
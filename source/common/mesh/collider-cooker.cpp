@@ -0,0 +1,434 @@
+#include "collider-cooker.hpp"
+#include "mesh-utils.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+namespace portal {
+
+    void CookedCollider::useStorage(){
+        vertices = vertexStorage.data();
+        vertexCount = vertexStorage.size();
+        indices = indexStorage.data();
+        indexCount = indexStorage.size();
+        faces = faceStorage.data();
+        faceCount = faceStorage.size() / 2;
+    }
+
+}
+
+namespace portal::collider_cooker {
+
+    // A triangle of the hull being built, its plane points outward
+    struct HullFace {
+        uint32_t a, b, c;
+        glm::dvec3 normal;
+        double distance;
+        bool alive;
+    };
+
+    // The hull of a detailed mesh is built from its extreme points in this number of directions (spread over the sphere),
+    // which bounds the size of the hull (the collision cost of a convex mesh grows with its faces and edges)
+    static const uint32_t hullDirections = 256;
+
+    // Returns the points that are the farthest along one of the directions (without duplicates)
+    static std::vector<glm::vec3> selectExtremePoints(const std::vector<glm::vec3>& points){
+        std::vector<uint32_t> extremes(hullDirections, 0);
+        std::vector<float> farthest(hullDirections, -std::numeric_limits<float>::infinity());
+        std::vector<glm::vec3> directions(hullDirections);
+        // A Fibonacci spiral gives evenly spread directions
+        const float goldenAngle = glm::pi<float>() * (3.0f - std::sqrt(5.0f));
+        for(uint32_t d = 0; d < hullDirections; d++){
+            float y = 1.0f - 2.0f * (d + 0.5f) / hullDirections;
+            float radius = std::sqrt(1.0f - y * y);
+            directions[d] = glm::vec3(radius * std::cos(d * goldenAngle), y, radius * std::sin(d * goldenAngle));
+        }
+        for(uint32_t p = 0; p < points.size(); p++){
+            for(uint32_t d = 0; d < hullDirections; d++){
+                float distance = glm::dot(points[p], directions[d]);
+                if(distance > farthest[d]){ farthest[d] = distance; extremes[d] = p; }
+            }
+        }
+        std::sort(extremes.begin(), extremes.end());
+        extremes.erase(std::unique(extremes.begin(), extremes.end()), extremes.end());
+        std::vector<glm::vec3> selected;
+        for(uint32_t p : extremes) selected.push_back(points[p]);
+        return selected;
+    }
+
+    bool computeConvexHull(const std::vector<glm::vec3>& meshPoints, CookedCollider& collider){
+        std::vector<glm::vec3> extremePoints;
+        if(meshPoints.size() > hullDirections) extremePoints = selectExtremePoints(meshPoints);
+        const std::vector<glm::vec3>& points = extremePoints.empty() ? meshPoints : extremePoints;
+        if(points.size() < 4) return false;
+        std::vector<glm::dvec3> positions(points.begin(), points.end());
+        glm::dvec3 boundsMin = positions[0], boundsMax = positions[0];
+        for(auto& position : positions){
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+        // The tolerance is relative to the size of the mesh so the points on the hull (within the tolerance) are skipped
+        double epsilon = glm::length(boundsMax - boundsMin) * 1e-5;
+        if(epsilon == 0) return false;
+
+        // The initial tetrahedron: the extremes along the longest axis, the farthest point from their line then from their plane
+        glm::dvec3 extent = boundsMax - boundsMin;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        uint32_t i0 = 0, i1 = 0;
+        for(uint32_t i = 0; i < positions.size(); i++){
+            if(positions[i][axis] < positions[i0][axis]) i0 = i;
+            if(positions[i][axis] > positions[i1][axis]) i1 = i;
+        }
+        glm::dvec3 lineDirection = glm::normalize(positions[i1] - positions[i0]);
+        uint32_t i2 = i0;
+        double farthest = 0;
+        for(uint32_t i = 0; i < positions.size(); i++){
+            double distance = glm::length(glm::cross(positions[i] - positions[i0], lineDirection));
+            if(distance > farthest){ farthest = distance; i2 = i; }
+        }
+        if(farthest <= epsilon) return false;
+        glm::dvec3 baseNormal = glm::normalize(glm::cross(positions[i1] - positions[i0], positions[i2] - positions[i0]));
+        uint32_t i3 = i0;
+        farthest = 0;
+        for(uint32_t i = 0; i < positions.size(); i++){
+            double distance = std::abs(glm::dot(positions[i] - positions[i0], baseNormal));
+            if(distance > farthest){ farthest = distance; i3 = i; }
+        }
+        if(farthest <= epsilon) return false;
+
+        // The faces are counter clockwise seen from the outside and each directed edge belongs to a single face
+        std::vector<HullFace> faces;
+        std::unordered_map<uint64_t, uint32_t> edgeFaces;
+        auto edgeKey = [](uint32_t from, uint32_t to){ return ((uint64_t)from << 32) | to; };
+        auto addFace = [&](uint32_t a, uint32_t b, uint32_t c){
+            glm::dvec3 normal = glm::normalize(glm::cross(positions[b] - positions[a], positions[c] - positions[a]));
+            uint32_t f = (uint32_t)faces.size();
+            faces.push_back({a, b, c, normal, glm::dot(normal, positions[a]), true});
+            edgeFaces[edgeKey(a, b)] = edgeFaces[edgeKey(b, c)] = edgeFaces[edgeKey(c, a)] = f;
+        };
+        // The tetrahedron is oriented away from its center
+        glm::dvec3 inside = (positions[i0] + positions[i1] + positions[i2] + positions[i3]) * 0.25;
+        if(glm::dot(glm::cross(positions[i1] - positions[i0], positions[i2] - positions[i0]), inside - positions[i0]) > 0) std::swap(i1, i2);
+        addFace(i0, i1, i2); addFace(i0, i3, i1); addFace(i1, i3, i2); addFace(i2, i3, i0);
+
+        // Add the farthest point outside of the hull until every point is inside of it (within the tolerance). Its visible faces
+        // are found from the face it is the farthest from through their edges, so they form a single region whose border (the horizon)
+        // is a single loop, and they are replaced by a cone from the point to the horizon
+        std::vector<bool> added(positions.size(), false);
+        added[i0] = added[i1] = added[i2] = added[i3] = true;
+        std::vector<uint32_t> visible;
+        std::vector<std::pair<uint32_t, uint32_t>> horizon;
+        while(true){
+            uint32_t point = 0, seed = 0;
+            double farthestDistance = epsilon;
+            for(uint32_t f = 0; f < faces.size(); f++){
+                if(!faces[f].alive) continue;
+                for(uint32_t i = 0; i < positions.size(); i++){
+                    if(added[i]) continue;
+                    double distance = glm::dot(faces[f].normal, positions[i]) - faces[f].distance;
+                    if(distance > farthestDistance){ farthestDistance = distance; point = i; seed = f; }
+                }
+            }
+            if(farthestDistance <= epsilon) break;
+            added[point] = true;
+            visible.assign(1, seed);
+            faces[seed].alive = false;
+            horizon.clear();
+            for(size_t v = 0; v < visible.size(); v++){
+                const HullFace& face = faces[visible[v]];
+                for(auto [from, to] : {std::make_pair(face.a, face.b), std::make_pair(face.b, face.c), std::make_pair(face.c, face.a)}){
+                    uint32_t neighbor = edgeFaces[edgeKey(to, from)];
+                    if(!faces[neighbor].alive) continue;
+                    if(glm::dot(faces[neighbor].normal, positions[point]) - faces[neighbor].distance > 0){
+                        faces[neighbor].alive = false;
+                        visible.push_back(neighbor);
+                    } else {
+                        horizon.emplace_back(from, to);
+                    }
+                }
+            }
+            for(uint32_t f : visible){
+                edgeFaces.erase(edgeKey(faces[f].a, faces[f].b));
+                edgeFaces.erase(edgeKey(faces[f].b, faces[f].c));
+                edgeFaces.erase(edgeKey(faces[f].c, faces[f].a));
+            }
+            for(auto [from, to] : horizon) addFace(from, to, point);
+        }
+        faces.erase(std::remove_if(faces.begin(), faces.end(), [](const HullFace& face){ return !face.alive; }), faces.end());
+
+        // The face on the left of each directed edge (every edge of the hull is used once in each direction)
+        edgeFaces.clear();
+        for(uint32_t f = 0; f < faces.size(); f++){
+            edgeFaces[edgeKey(faces[f].a, faces[f].b)] = f;
+            edgeFaces[edgeKey(faces[f].b, faces[f].c)] = f;
+            edgeFaces[edgeKey(faces[f].c, faces[f].a)] = f;
+        }
+        // Merge the coplanar triangles that are connected by their edges into polygons. The polygons are the boundaries
+        // of these groups, so they use the edges of the triangles and each edge is still used once in each direction
+        // (the half edge structure of reactphysics3d rejects the hulls where an edge is used twice in the same direction)
+        std::vector<int> groupOf(faces.size(), -1);
+        std::vector<std::vector<uint32_t>> polygons;
+        std::vector<uint32_t> group;
+        std::unordered_map<uint32_t, uint32_t> boundary;
+        for(uint32_t seed = 0; seed < faces.size(); seed++){
+            if(groupOf[seed] >= 0) continue;
+            // A triangle is merged if its corners are on the plane of the first one (within the tolerance), comparing the normals
+            // wouldn't merge the thin triangles whose normal is imprecise. A slightly curved surface isn't merged step by step either
+            int id = (int)polygons.size();
+            auto onPlane = [&](uint32_t corner){ return std::abs(glm::dot(faces[seed].normal, positions[corner]) - faces[seed].distance) <= epsilon; };
+            group.assign(1, seed);
+            groupOf[seed] = id;
+            for(size_t g = 0; g < group.size(); g++){
+                const HullFace& face = faces[group[g]];
+                for(auto [from, to] : {std::make_pair(face.a, face.b), std::make_pair(face.b, face.c), std::make_pair(face.c, face.a)}){
+                    auto twin = edgeFaces.find(edgeKey(to, from));
+                    if(twin == edgeFaces.end() || groupOf[twin->second] >= 0) continue;
+                    const HullFace& other = faces[twin->second];
+                    if(onPlane(other.a) && onPlane(other.b) && onPlane(other.c)){
+                        groupOf[twin->second] = id;
+                        group.push_back(twin->second);
+                    }
+                }
+            }
+            // Walk the edges whose twin is outside of the group, which gives the corners counter clockwise seen from the outside
+            boundary.clear();
+            bool simple = true;
+            for(uint32_t f : group){
+                const HullFace& face = faces[f];
+                for(auto [from, to] : {std::make_pair(face.a, face.b), std::make_pair(face.b, face.c), std::make_pair(face.c, face.a)}){
+                    auto twin = edgeFaces.find(edgeKey(to, from));
+                    if(twin != edgeFaces.end() && groupOf[twin->second] == id) continue;
+                    simple &= boundary.emplace(from, to).second;
+                }
+            }
+            std::vector<uint32_t> polygon;
+            if(simple && !boundary.empty()){
+                uint32_t corner = boundary.begin()->first;
+                do {
+                    polygon.push_back(corner);
+                    corner = boundary[corner];
+                } while(corner != polygon[0] && polygon.size() <= boundary.size());
+                simple = corner == polygon[0] && polygon.size() == boundary.size();
+            }
+            if(simple){
+                polygons.push_back(std::move(polygon));
+                continue;
+            }
+            // A group touching itself at a corner has no single boundary, its triangles are kept as they are
+            for(size_t g = 0; g < group.size(); g++){
+                const HullFace& face = faces[group[g]];
+                if(g > 0) groupOf[group[g]] = (int)polygons.size();
+                polygons.push_back({face.a, face.b, face.c});
+            }
+        }
+        // A corner used by two polygons only is on the edge between them (e.g. a point of a straight edge of the mesh),
+        // it is dropped from both so the edge is a single edge on each side
+        std::unordered_map<uint32_t, std::vector<uint32_t>> cornerPolygons;
+        for(uint32_t g = 0; g < polygons.size(); g++){
+            for(uint32_t corner : polygons[g]) cornerPolygons[corner].push_back(g);
+        }
+        for(auto& [corner, users] : cornerPolygons){
+            if(users.size() != 2 || polygons[users[0]].size() <= 3 || polygons[users[1]].size() <= 3) continue;
+            for(uint32_t g : users){
+                auto& polygon = polygons[g];
+                polygon.erase(std::find(polygon.begin(), polygon.end(), corner));
+            }
+        }
+
+        // Keep the used points only
+        std::unordered_map<uint32_t, uint32_t> remap;
+        collider.vertexStorage.clear();
+        collider.indexStorage.clear();
+        collider.faceStorage.clear();
+        for(auto& polygon : polygons){
+            collider.faceStorage.push_back((uint32_t)polygon.size());
+            collider.faceStorage.push_back((uint32_t)collider.indexStorage.size());
+            for(uint32_t corner : polygon){
+                auto [it, inserted] = remap.try_emplace(corner, (uint32_t)collider.vertexStorage.size());
+                if(inserted) collider.vertexStorage.push_back(points[corner]);
+                collider.indexStorage.push_back(it->second);
+            }
+        }
+        collider.kind = CookedCollider::Kind::ConvexHull;
+        collider.useStorage();
+        return true;
+    }
+
+    bool computeTriangleMesh(const MeshData& mesh, CookedCollider& collider){
+        std::unordered_map<glm::vec3, uint32_t> positionIndices;
+        collider.vertexStorage.clear();
+        collider.indexStorage.clear();
+        collider.faceStorage.clear();
+        auto elementAt = [&](size_t index) -> uint32_t {
+            if(mesh.elementType == GL_UNSIGNED_SHORT) return ((const GLushort*)mesh.elements)[index];
+            return ((const GLuint*)mesh.elements)[index];
+        };
+        // The first level of detail is the full mesh, its submeshes are the first ones
+        for(size_t s = 0; s < mesh.submeshCount; s++){
+            const Submesh& submesh = mesh.submeshes[s];
+            for(uint32_t e = 0; e + 2 < submesh.elementCount; e += 3){
+                uint32_t triangle[3];
+                for(int corner = 0; corner < 3; corner++){
+                    const glm::vec3& position = mesh.vertices[elementAt(submesh.firstElement + e + corner)].position;
+                    auto [it, inserted] = positionIndices.try_emplace(position, (uint32_t)collider.vertexStorage.size());
+                    if(inserted) collider.vertexStorage.push_back(position);
+                    triangle[corner] = it->second;
+                }
+                // The welded triangles can collapse (e.g. the texture seams of a degenerate triangle)
+                if(triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) continue;
+                collider.indexStorage.insert(collider.indexStorage.end(), triangle, triangle + 3);
+            }
+        }
+        if(collider.indexStorage.empty()) return false;
+        collider.kind = CookedCollider::Kind::TriangleMesh;
+        collider.useStorage();
+        return true;
+    }
+
+    // Checks that the mapped file is a complete cooked collider of the given kind then points the arrays of "collider" into it
+    static bool mapSections(CookedCollider& collider, CookedCollider::Kind kind){
+        const uint8_t* bytes = collider.file.getData();
+        size_t size = collider.file.getSize();
+        if(size < sizeof(ColliderCacheHeader)) return false;
+        const ColliderCacheHeader* header = (const ColliderCacheHeader*)bytes;
+        if(std::memcmp(header->magic, ColliderCacheMagic, 4) != 0 || header->version != ColliderCacheVersion) return false;
+        if(header->kind != kind) return false;
+        if(header->verticesOffset + (uint64_t)header->vertexCount * sizeof(glm::vec3) > size ||
+           header->facesOffset + (uint64_t)header->faceCount * 2 * sizeof(uint32_t) > size ||
+           header->indicesOffset + (uint64_t)header->indexCount * sizeof(uint32_t) > size) return false;
+        collider.kind = kind;
+        collider.vertices = (const glm::vec3*)(bytes + header->verticesOffset);
+        collider.vertexCount = header->vertexCount;
+        collider.faces = (const uint32_t*)(bytes + header->facesOffset);
+        collider.faceCount = header->faceCount;
+        collider.indices = (const uint32_t*)(bytes + header->indicesOffset);
+        collider.indexCount = header->indexCount;
+        return true;
+    }
+
+    // The extension of the cooked colliders of each kind
+    static std::string getExtension(CookedCollider::Kind kind){
+        return kind == CookedCollider::Kind::ConvexHull ? ".hull.pcol" : ".tris.pcol";
+    }
+
+    // Maps the cooked collider, returns false if it is missing or stale
+    static bool load(const std::string& meshPath, CookedCollider::Kind kind, CookedCollider& collider){
+        if(!collider.file.open(mesh_cache::getCachePath(meshPath, getExtension(kind)))) return false;
+        if(!mapSections(collider, kind)){
+            collider.file.close();
+            return false;
+        }
+        const ColliderCacheHeader* header = (const ColliderCacheHeader*)collider.file.getData();
+        uint64_t size;
+        int64_t time;
+        // If the source doesn't exist anymore, the cooked collider is used as is (so it can be shipped alone)
+        if(!mesh_cache::getSourceStamp(meshPath, size, time)) return true;
+        if(header->sourceSize == size && header->sourceTime == time) return true;
+        // The modification time changes without the content on checkouts and copies, so the content decides
+        uint64_t hash;
+        if(header->sourceSize != size || !mesh_cache::getSourceHash(meshPath, hash) || header->sourceHash != hash){
+            collider.file.close();
+            return false;
+        }
+        return true;
+    }
+
+    // Writes the collider (which must use its storage vectors) to the cache then maps it
+    static bool store(const std::string& meshPath, CookedCollider& collider){
+        ColliderCacheHeader header = {};
+        std::memcpy(header.magic, ColliderCacheMagic, 4);
+        header.version = ColliderCacheVersion;
+        if(!mesh_cache::getSourceStamp(meshPath, header.sourceSize, header.sourceTime) || !mesh_cache::getSourceHash(meshPath, header.sourceHash)){
+            std::cerr << "Couldn't read the source of the cooked collider: " << meshPath << std::endl;
+            return false;
+        }
+        header.kind = collider.kind;
+        header.vertexCount = (uint32_t)collider.vertexStorage.size();
+        header.indexCount = (uint32_t)collider.indexStorage.size();
+        header.faceCount = (uint32_t)(collider.faceStorage.size() / 2);
+        auto align = [](uint64_t offset){ return (offset + 15) & ~(uint64_t)15; };
+        header.verticesOffset = align(sizeof(ColliderCacheHeader));
+        header.facesOffset = align(header.verticesOffset + header.vertexCount * sizeof(glm::vec3));
+        header.indicesOffset = align(header.facesOffset + collider.faceStorage.size() * sizeof(uint32_t));
+
+        std::error_code error;
+        std::filesystem::create_directories(mesh_cache::cacheFolder, error);
+        // Write to a temporary file first so a crash (or another instance) never sees a partial cooked collider
+        std::string cachePath = mesh_cache::getCachePath(meshPath, getExtension(collider.kind));
+        std::string temporaryPath = cachePath + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            if(!file){
+                std::cerr << "Couldn't open file: " << temporaryPath << std::endl;
+                return false;
+            }
+            static const char padding[16] = {};
+            auto writeAt = [&](uint64_t offset, const void* bytes, size_t size){
+                file.write(padding, offset - (uint64_t)file.tellp());
+                file.write((const char*)bytes, size);
+            };
+            file.write((const char*)&header, sizeof(header));
+            writeAt(header.verticesOffset, collider.vertexStorage.data(), collider.vertexStorage.size() * sizeof(glm::vec3));
+            writeAt(header.facesOffset, collider.faceStorage.data(), collider.faceStorage.size() * sizeof(uint32_t));
+            writeAt(header.indicesOffset, collider.indexStorage.data(), collider.indexStorage.size() * sizeof(uint32_t));
+            if(!file){
+                std::cerr << "Couldn't write file: " << temporaryPath << std::endl;
+                return false;
+            }
+        }
+        std::filesystem::rename(temporaryPath, cachePath, error);
+        if(error){
+            std::cerr << "Couldn't write file: " << cachePath << " (" << error.message() << ")" << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        // Use the mapped file from now on so the storage can be freed
+        if(!collider.file.open(cachePath, false) || !mapSections(collider, collider.kind)){
+            collider.file.close();
+            return false;
+        }
+        collider.vertexStorage = std::vector<glm::vec3>();
+        collider.indexStorage = std::vector<uint32_t>();
+        collider.faceStorage = std::vector<uint32_t>();
+        return true;
+    }
+
+    bool cook(const std::string& meshPath, CookedCollider::Kind kind, CookedCollider& collider){
+        auto start = std::chrono::high_resolution_clock::now();
+        bool cached = load(meshPath, kind, collider);
+        if(!cached){
+            MeshData* mesh = mesh_utils::loadOBJData(meshPath);
+            if(!mesh) return false;
+            bool cooked;
+            if(kind == CookedCollider::Kind::ConvexHull){
+                std::vector<glm::vec3> points(mesh->vertexCount);
+                for(size_t v = 0; v < mesh->vertexCount; v++) points[v] = mesh->vertices[v].position;
+                cooked = computeConvexHull(points, collider);
+            } else {
+                cooked = computeTriangleMesh(*mesh, collider);
+            }
+            delete mesh;
+            if(!cooked){
+                std::cerr << "Couldn't cook a collider from the mesh (it is flat or empty): " << meshPath << std::endl;
+                return false;
+            }
+            // If the collider can't be cached, it stays in the storage vectors
+            store(meshPath, collider);
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << (cached ? "Loaded the cooked " : "Cooked the ") << (kind == CookedCollider::Kind::ConvexHull ? "convex hull" : "triangle mesh")
+                  << " of " << meshPath << " (" << collider.vertexCount << " vertices) in " << milliseconds << " ms" << std::endl;
+        return true;
+    }
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "mesh-cache.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace portal {
+
+    // The collision geometry cooked from an imported mesh
+    // The arrays either point into the mapped cooked file or into the storage vectors
+    struct CookedCollider {
+        enum class Kind : uint32_t {
+            // The convex hull of the vertices, its faces are convex polygons (counter clockwise seen from the outside)
+            ConvexHull = 0,
+            // The triangles of the full detail of the mesh (all its submeshes), only usable by static bodies
+            TriangleMesh = 1
+        } kind = Kind::ConvexHull;
+        const glm::vec3* vertices = nullptr;
+        size_t vertexCount = 0;
+        // The vertices of each face (for a convex hull) or of each triangle (for a triangle mesh)
+        const uint32_t* indices = nullptr;
+        size_t indexCount = 0;
+        // The faces of a convex hull, for each face: its vertex count then the index of its first vertex in "indices"
+        const uint32_t* faces = nullptr;
+        size_t faceCount = 0;
+
+        AssetFile file;
+        std::vector<glm::vec3> vertexStorage;
+        std::vector<uint32_t> indexStorage;
+        std::vector<uint32_t> faceStorage;
+
+        // Points the arrays at the storage vectors
+        void useStorage();
+        // The memory used by the cooked geometry (the mapped file or the storage)
+        size_t getSizeInBytes() const {
+            return vertexCount * sizeof(glm::vec3) + indexCount * sizeof(uint32_t) + faceCount * 2 * sizeof(uint32_t);
+        }
+    };
+
+}
+
+namespace portal::collider_cooker {
+
+    // A cooked collider (".pcol") is a binary file stored next to the cached meshes (see "mesh_cache::cacheFolder"):
+    // - The header
+    // - The vertices (3 floats each)
+    // - The faces (2 integers each, convex hulls only)
+    // - The indices
+    // Every section starts at a 16 bytes aligned offset
+    struct ColliderCacheHeader {
+        char magic[4];
+        uint32_t version;
+        // The size, modification time and content hash of the source mesh, used to detect stale cooked colliders
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        CookedCollider::Kind kind;
+        uint32_t vertexCount, indexCount, faceCount;
+        uint64_t verticesOffset, facesOffset, indicesOffset;
+    };
+
+    inline constexpr char ColliderCacheMagic[4] = {'P', 'C', 'O', 'L'};
+    // Increase it whenever the cooking changes so the old cooked colliders are cooked again
+    inline constexpr uint32_t ColliderCacheVersion = 2;
+
+    // Computes the convex hull of the points (adding the farthest point outside of it first, the points inside or on it are skipped)
+    // then merges its coplanar triangles into polygons. Returns false if the points are flat (no volume)
+    // Above 256 points, the hull of their extreme points in 256 directions is computed instead (at most 256 vertices)
+    bool computeConvexHull(const std::vector<glm::vec3>& points, CookedCollider& collider);
+    // Welds the vertices of the full detail of the mesh by position and keeps its non degenerate triangles
+    // Returns false if the mesh has no triangles
+    bool computeTriangleMesh(const MeshData& mesh, CookedCollider& collider);
+
+    // Maps the cooked collider of the given kind for the ".obj" file, it is cooked (from the imported mesh) and cached
+    // if it is missing or was cooked from another version of the mesh. Returns false if the mesh can't be cooked
+    bool cook(const std::string& meshPath, CookedCollider::Kind kind, CookedCollider& collider);
+
+}
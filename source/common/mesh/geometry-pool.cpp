@@ -0,0 +1,188 @@
+#include "geometry-pool.hpp"
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace portal {
+
+    // The initial capacity of the arenas (they grow when they are full)
+    static const size_t initialVertexCapacity = 1 << 16;
+    static const size_t initialElementCapacity = 1 << 18;
+
+    static void appendAttribute(std::ostringstream& key, const PackedAttribute& attribute){
+        key << attribute.size << ":" << attribute.type << ":" << (int)attribute.normalized << ":" << attribute.offset << ";";
+    }
+
+    GeometryPool::Format* GeometryPool::getFormat(const PackedVertices& layout, GLenum indexType){
+        std::ostringstream key;
+        key << indexType << ";" << layout.stride << ";";
+        appendAttribute(key, layout.position);
+        appendAttribute(key, layout.color);
+        appendAttribute(key, layout.texCoord);
+        appendAttribute(key, layout.normal);
+        Format*& format = formats[key.str()];
+        if(format) return format;
+
+        format = new Format();
+        format->indexType = indexType;
+        format->layout.stride = layout.stride;
+        format->layout.position = layout.position;
+        format->layout.color = layout.color;
+        format->layout.texCoord = layout.texCoord;
+        format->layout.normal = layout.normal;
+        format->vertices.elementSize = layout.stride;
+        format->elements.elementSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glGenVertexArrays(1, &format->vertexArray);
+        rebuild(format, format->vertices, initialVertexCapacity);
+        rebuild(format, format->elements, initialElementCapacity);
+        return format;
+    }
+
+    static void setupAttribute(GLuint location, const PackedAttribute& attribute, GLsizei stride){
+        if(attribute.size == 0){
+            glDisableVertexAttribArray(location);
+            return;
+        }
+        glVertexAttribPointer(location, attribute.size, attribute.type, attribute.normalized, stride, (void*)(size_t)attribute.offset);
+        glEnableVertexAttribArray(location);
+    }
+
+    void GeometryPool::setupVertexArray(Format* format){
+        // The attribute pointers refer to the buffer bound when they are set, so they are set again whenever the buffers change
+        bindVertexArray(format->vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, format->vertices.buffer);
+        setupAttribute(ATTRIB_LOC_POSITION, format->layout.position, format->layout.stride);
+        setupAttribute(ATTRIB_LOC_COLOR, format->layout.color, format->layout.stride);
+        setupAttribute(ATTRIB_LOC_TEXCOORD, format->layout.texCoord, format->layout.stride);
+        setupAttribute(ATTRIB_LOC_NORMAL, format->layout.normal, format->layout.stride);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, format->elements.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void GeometryPool::rebuild(Format* format, Arena& arena, size_t capacity){
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * arena.elementSize, nullptr, GL_STATIC_DRAW);
+        // Copy the live ranges one after the other (in the same order) so the holes disappear
+        size_t used = 0;
+        if(arena.buffer){
+            std::vector<Range*> ranges(arena.live.begin(), arena.live.end());
+            std::sort(ranges.begin(), ranges.end(), [](Range* first, Range* second){ return first->offset < second->offset; });
+            glBindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+            for(Range* range : ranges){
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range->offset * arena.elementSize,
+                                    used * arena.elementSize, range->count * arena.elementSize);
+                range->offset = used;
+                used += range->count;
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &arena.buffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        arena.buffer = buffer;
+        arena.capacity = capacity;
+        arena.used = used;
+        arena.holes.clear();
+        setupVertexArray(format);
+    }
+
+    void GeometryPool::reserve(Format* format, Arena& arena, Range& range, size_t count){
+        range.count = count;
+        // First fit in the holes
+        for(auto it = arena.holes.begin(); it != arena.holes.end(); ++it){
+            if(it->count < count) continue;
+            range.offset = it->offset;
+            it->offset += count;
+            it->count -= count;
+            if(it->count == 0) arena.holes.erase(it);
+            arena.live.insert(&range);
+            return;
+        }
+        // Then at the end of the used part of the buffer
+        if(arena.capacity - arena.used < count){
+            // Compact the arena (and grow it if compacting is not enough)
+            size_t free = arena.capacity - arena.used;
+            for(auto& hole : arena.holes) free += hole.count;
+            size_t capacity = arena.capacity;
+            if(free < count) capacity = std::max(capacity * 2, arena.capacity - free + count);
+            rebuild(format, arena, capacity);
+        }
+        range.offset = arena.used;
+        arena.used += count;
+        arena.live.insert(&range);
+    }
+
+    void GeometryPool::release(Arena& arena, Range& range){
+        arena.live.erase(&range);
+        if(range.count == 0) return;
+        // Insert the range in the sorted holes and merge it with its neighbours
+        auto it = std::lower_bound(arena.holes.begin(), arena.holes.end(), range.offset,
+                                   [](const Range& hole, size_t offset){ return hole.offset < offset; });
+        it = arena.holes.insert(it, range);
+        if(it + 1 != arena.holes.end() && it->offset + it->count == (it + 1)->offset){
+            it->count += (it + 1)->count;
+            arena.holes.erase(it + 1);
+        }
+        if(it != arena.holes.begin() && (it - 1)->offset + (it - 1)->count == it->offset){
+            (it - 1)->count += it->count;
+            it = arena.holes.erase(it) - 1;
+        }
+        // A hole at the end of the used part is given back to it
+        if(it->offset + it->count == arena.used){
+            arena.used = it->offset;
+            arena.holes.erase(it);
+        }
+    }
+
+    GeometryPool::Allocation* GeometryPool::allocate(const PackedVertices& vertices, const void* elements, size_t elementCount, GLenum elementType){
+        Allocation* allocation = new Allocation();
+        size_t vertexCount = vertices.count;
+        Format* format = getFormat(vertices, vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+        allocation->format = format;
+        reserve(format, format->vertices, allocation->vertices, vertexCount);
+        reserve(format, format->elements, allocation->elements, elementCount);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, format->vertices.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation->vertices.offset * vertices.stride, vertices.getSize(), vertices.getData());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, format->elements.buffer);
+        GLintptr elementOffset = allocation->elements.offset * format->elements.elementSize;
+        if(elementType == format->indexType){
+            // The elements are already in the index type of the format (e.g. read from the mesh cache) so they are uploaded as they are
+            glBufferSubData(GL_COPY_WRITE_BUFFER, elementOffset, elementCount * format->elements.elementSize, elements);
+        } else if(format->indexType == GL_UNSIGNED_SHORT){
+            const GLuint* source = (const GLuint*)elements;
+            std::vector<GLushort> shortElements(source, source + elementCount);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, elementOffset, shortElements.size() * sizeof(GLushort), shortElements.data());
+        } else {
+            const GLushort* source = (const GLushort*)elements;
+            std::vector<GLuint> intElements(source, source + elementCount);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, elementOffset, intElements.size() * sizeof(GLuint), intElements.data());
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return allocation;
+    }
+
+    void GeometryPool::deallocate(Allocation* allocation){
+        if(!allocation) return;
+        release(allocation->format->vertices, allocation->vertices);
+        release(allocation->format->elements, allocation->elements);
+        delete allocation;
+    }
+
+    void GeometryPool::clear(){
+        for(auto& [key, format] : formats){
+            if(!format->vertices.live.empty())
+                std::cerr << "Geometry pool cleared while " << format->vertices.live.size() << " meshes still use it" << std::endl;
+            glDeleteBuffers(1, &format->vertices.buffer);
+            glDeleteBuffers(1, &format->elements.buffer);
+            glDeleteVertexArrays(1, &format->vertexArray);
+            delete format;
+        }
+        formats.clear();
+        resetBinding();
+    }
+
+}
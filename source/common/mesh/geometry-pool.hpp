@@ -0,0 +1,97 @@
+#pragma once
+
+#include "vertex-packing.hpp"
+
+#include <glad/gl.h>
+
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace portal {
+
+    // This static class sub-allocates the vertex and element data of all the meshes from a few large buffers
+    // Meshes with the same vertex format share a vertex buffer, an element buffer and a vertex array,
+    // so drawing them one after the other doesn't switch the vertex array, only the offsets passed to
+    // glDrawElementsBaseVertex change (the elements of each mesh stay relative to its first vertex,
+    // so most meshes can use 16-bit elements).
+    // Note: vertex arrays are not shared between contexts so the meshes must be created on the main context.
+    class GeometryPool {
+    public:
+        // A range of vertices or elements (in units of vertices or elements, not bytes)
+        struct Range {
+            size_t offset = 0;
+            size_t count = 0;
+        };
+        struct Format;
+        // The data of a single mesh, the offsets can change when the pool is compacted
+        struct Allocation {
+            Format* format = nullptr;
+            Range vertices;
+            Range elements;
+        };
+
+    private:
+        // A single buffer with its free ranges
+        // The buffer is used up to "used", the free ranges are the holes left by the freed allocations below it
+        struct Arena {
+            GLuint buffer = 0;
+            size_t elementSize = 0;
+            size_t capacity = 0;
+            size_t used = 0;
+            std::vector<Range> holes;
+            // The ranges of the live allocations (updated when the arena is rebuilt)
+            std::unordered_set<Range*> live;
+        };
+    public:
+        struct Format {
+            GLuint vertexArray = 0;
+            // GL_UNSIGNED_SHORT for the meshes with at most 65536 vertices (the elements are relative to the mesh)
+            GLenum indexType = GL_UNSIGNED_INT;
+            PackedVertices layout;  // Only the attributes and the stride are used
+            Arena vertices, elements;
+        };
+
+    private:
+        // The formats keyed by their stride and attributes
+        static inline std::map<std::string, Format*> formats;
+        // The vertex array currently bound (to skip binding it again between draws)
+        static inline GLuint boundVertexArray = 0;
+
+        static Format* getFormat(const PackedVertices& layout, GLenum indexType);
+        static void setupVertexArray(Format* format);
+        // Reserves "count" units in the arena, the arena is compacted or grown if needed
+        static void reserve(Format* format, Arena& arena, Range& range, size_t count);
+        static void release(Arena& arena, Range& range);
+        // Copies the live ranges to the start of a new buffer with the given capacity
+        static void rebuild(Format* format, Arena& arena, size_t capacity);
+
+    public:
+        // Uploads the vertices and the elements to the buffers of their format
+        // The elements are either GL_UNSIGNED_INT or GL_UNSIGNED_SHORT, they are converted to the index type of the format if needed
+        static Allocation* allocate(const PackedVertices& vertices, const void* elements, size_t elementCount, GLenum elementType);
+        // Returns the ranges of the allocation to the pool (adjacent free ranges are merged)
+        static void deallocate(Allocation* allocation);
+
+        // Binds the vertex array of the format unless it is already bound
+        static void bind(const Format* format){
+            bindVertexArray(format->vertexArray);
+        }
+        // Every vertex array bind should go through this function (or call "resetBinding" afterwards)
+        // so that the pool knows which vertex array is bound
+        static void bindVertexArray(GLuint vertexArray){
+            if(boundVertexArray == vertexArray) return;
+            glBindVertexArray(vertexArray);
+            boundVertexArray = vertexArray;
+        }
+        static void resetBinding(){
+            boundVertexArray = 0;
+            glBindVertexArray(0);
+        }
+
+        // Deletes all the buffers and vertex arrays (every mesh must be deleted before)
+        static void clear();
+    };
+
+}
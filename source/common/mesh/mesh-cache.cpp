@@ -0,0 +1,207 @@
+#include "mesh-cache.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace portal {
+
+    void MeshData::useStorage(){
+        vertices = vertexStorage.data();
+        vertexCount = vertexStorage.size();
+        elements = elementStorage.data();
+        elementCount = elementStorage.size();
+        elementType = GL_UNSIGNED_INT;
+        // The first level of detail (the full mesh) has no error
+        if(lodErrorStorage.empty()) lodErrorStorage.push_back(0.0f);
+        lodErrors = lodErrorStorage.data();
+        lodCount = lodErrorStorage.size();
+        submeshes = submeshStorage.data();
+        submeshCount = submeshStorage.size() / lodCount;
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        if(vertexStorage.empty()) return;
+        boundsMin = boundsMax = vertexStorage[0].position;
+        for(auto& vertex : vertexStorage){
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+    }
+
+}
+
+namespace portal::mesh_cache {
+
+    // FNV-1a, used for the content hash of the source files and to name the cached meshes
+    static uint64_t hashBytes(const uint8_t* bytes, size_t size, uint64_t hash = 14695981039346656037ull){
+        for(size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string getCachePath(const std::string& sourcePath, const std::string& extension){
+        std::string normalized = std::filesystem::path(sourcePath).lexically_normal().generic_string();
+        std::ostringstream path;
+        path << cacheFolder << "/" << std::filesystem::path(sourcePath).stem().string() << "-"
+             << std::hex << std::setw(16) << std::setfill('0') << hashBytes((const uint8_t*)normalized.data(), normalized.size()) << extension;
+        return path.str();
+    }
+
+    bool getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time){
+        std::error_code error;
+        size = (uint64_t)std::filesystem::file_size(sourcePath, error);
+        if(error) return false;
+        auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+        if(error) return false;
+        time = (int64_t)writeTime.time_since_epoch().count();
+        return true;
+    }
+
+    bool getSourceHash(const std::string& sourcePath, uint64_t& hash){
+        AssetFile source(sourcePath);
+        if(!source.isOpen()) return false;
+        hash = hashBytes(source.getData(), source.getSize());
+        return true;
+    }
+
+    // Checks that the mapped file is a complete cached mesh then points the arrays of "data" into it
+    static bool mapSections(MeshData& data){
+        const uint8_t* bytes = data.file.getData();
+        size_t size = data.file.getSize();
+        if(size < sizeof(MeshCacheHeader)) return false;
+        const MeshCacheHeader* header = (const MeshCacheHeader*)bytes;
+        if(std::memcmp(header->magic, MeshCacheMagic, 4) != 0 || header->version != MeshCacheVersion) return false;
+        if(header->elementSize != sizeof(GLushort) && header->elementSize != sizeof(GLuint)) return false;
+        if(header->lodCount == 0) return false;
+        if(header->lodErrorsOffset + (uint64_t)header->lodCount * sizeof(float) > size ||
+           header->submeshesOffset + (uint64_t)header->submeshCount * header->lodCount * sizeof(Submesh) > size ||
+           header->verticesOffset + (uint64_t)header->vertexCount * sizeof(Vertex) > size ||
+           header->elementsOffset + (uint64_t)header->elementCount * header->elementSize > size) return false;
+        data.lodErrors = (const float*)(bytes + header->lodErrorsOffset);
+        data.lodCount = header->lodCount;
+        data.submeshes = (const Submesh*)(bytes + header->submeshesOffset);
+        data.submeshCount = header->submeshCount;
+        data.vertices = (const Vertex*)(bytes + header->verticesOffset);
+        data.vertexCount = header->vertexCount;
+        data.elements = bytes + header->elementsOffset;
+        data.elementCount = header->elementCount;
+        data.elementType = header->elementSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        data.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+        data.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+        return true;
+    }
+
+    bool load(const std::string& sourcePath, MeshData& data){
+        std::string cachePath = getCachePath(sourcePath);
+        if(!data.file.open(cachePath)) return false;
+        if(!mapSections(data)){
+            data.file.close();
+            return false;
+        }
+        MeshCacheHeader header = *(const MeshCacheHeader*)data.file.getData();
+        uint64_t size;
+        int64_t time;
+        // If the source doesn't exist anymore, the cached mesh is used as is (so it can be shipped alone)
+        if(!getSourceStamp(sourcePath, size, time)) return true;
+        if(header.sourceSize == size && header.sourceTime == time) return true;
+        // The stamps of a packed cached mesh can't be updated, so only its content is checked
+
+        // The modification time changes without the content on checkouts and copies, so the content decides
+        uint64_t hash;
+        if(header.sourceSize != size || !getSourceHash(sourcePath, hash) || header.sourceHash != hash){
+            data.file.close();
+            return false;
+        }
+        if(data.file.isPacked()) return true;
+        // Save the new time so the source is not hashed again on the next load
+        // (the file is unmapped first since it can't be written while it is mapped on Windows)
+        data.file.close();
+        {
+            std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(offsetof(MeshCacheHeader, sourceTime));
+            file.write((const char*)&time, sizeof(time));
+        }
+        return data.file.open(cachePath, false) && mapSections(data);
+    }
+
+    bool store(const std::string& sourcePath, MeshData& data){
+        MeshCacheHeader header = {};
+        std::memcpy(header.magic, MeshCacheMagic, 4);
+        header.version = MeshCacheVersion;
+        if(!getSourceStamp(sourcePath, header.sourceSize, header.sourceTime) || !getSourceHash(sourcePath, header.sourceHash)){
+            std::cerr << "Couldn't read the source of the cached mesh: " << sourcePath << std::endl;
+            return false;
+        }
+        header.vertexCount = (uint32_t)data.vertexStorage.size();
+        header.elementCount = (uint32_t)data.elementStorage.size();
+        header.submeshCount = (uint32_t)data.submeshCount;
+        header.lodCount = (uint32_t)data.lodErrorStorage.size();
+        // The elements are relative to the mesh so 16 bits are enough for most meshes (the geometry pool uses the same rule)
+        bool shortElements = data.vertexStorage.size() <= 65536;
+        header.elementSize = shortElements ? sizeof(GLushort) : sizeof(GLuint);
+        for(int c = 0; c < 3; c++){
+            header.boundsMin[c] = data.boundsMin[c];
+            header.boundsMax[c] = data.boundsMax[c];
+        }
+        auto align = [](uint64_t offset){ return (offset + 15) & ~(uint64_t)15; };
+        header.lodErrorsOffset = align(sizeof(MeshCacheHeader));
+        header.submeshesOffset = align(header.lodErrorsOffset + header.lodCount * sizeof(float));
+        header.verticesOffset = align(header.submeshesOffset + data.submeshStorage.size() * sizeof(Submesh));
+        header.elementsOffset = align(header.verticesOffset + header.vertexCount * sizeof(Vertex));
+
+        std::error_code error;
+        std::filesystem::create_directories(cacheFolder, error);
+        // Write to a temporary file first so a crash (or another instance) never sees a partial cached mesh
+        std::string cachePath = getCachePath(sourcePath);
+        std::string temporaryPath = cachePath + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            if(!file){
+                std::cerr << "Couldn't open file: " << temporaryPath << std::endl;
+                return false;
+            }
+            static const char padding[16] = {};
+            auto writeAt = [&](uint64_t offset, const void* bytes, size_t size){
+                file.write(padding, offset - (uint64_t)file.tellp());
+                file.write((const char*)bytes, size);
+            };
+            file.write((const char*)&header, sizeof(header));
+            writeAt(header.lodErrorsOffset, data.lodErrorStorage.data(), data.lodErrorStorage.size() * sizeof(float));
+            writeAt(header.submeshesOffset, data.submeshStorage.data(), data.submeshStorage.size() * sizeof(Submesh));
+            writeAt(header.verticesOffset, data.vertexStorage.data(), data.vertexStorage.size() * sizeof(Vertex));
+            if(shortElements){
+                std::vector<GLushort> elements(data.elementStorage.begin(), data.elementStorage.end());
+                writeAt(header.elementsOffset, elements.data(), elements.size() * sizeof(GLushort));
+            } else {
+                writeAt(header.elementsOffset, data.elementStorage.data(), data.elementStorage.size() * sizeof(GLuint));
+            }
+            if(!file){
+                std::cerr << "Couldn't write file: " << temporaryPath << std::endl;
+                return false;
+            }
+        }
+        std::filesystem::rename(temporaryPath, cachePath, error);
+        if(error){
+            std::cerr << "Couldn't write file: " << cachePath << " (" << error.message() << ")" << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        // Use the mapped file from now on so the storage can be freed
+        if(!data.file.open(cachePath, false) || !mapSections(data)){
+            data.file.close();
+            return false;
+        }
+        data.vertexStorage = std::vector<Vertex>();
+        data.elementStorage = std::vector<GLuint>();
+        data.submeshStorage = std::vector<Submesh>();
+        data.lodErrorStorage = std::vector<float>();
+        return true;
+    }
+
+}
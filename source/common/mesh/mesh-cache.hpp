@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "../asset-pack.hpp"
+
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace portal {
+
+    // The final vertices and elements of an imported mesh (deduplicated and optimized)
+    // The arrays either point into the mapped cache file or into the storage vectors
+    struct MeshData {
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        // GL_UNSIGNED_SHORT when read from the cache and the mesh has at most 65536 vertices, GL_UNSIGNED_INT otherwise
+        const void* elements = nullptr;
+        size_t elementCount = 0;
+        GLenum elementType = GL_UNSIGNED_INT;
+        // The submeshes of every level of detail one level after the other ("submeshCount" for each level)
+        const Submesh* submeshes = nullptr;
+        size_t submeshCount = 0;
+        const float* lodErrors = nullptr;
+        size_t lodCount = 0;
+        glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+
+        AssetFile file;
+        std::vector<Vertex> vertexStorage;
+        std::vector<GLuint> elementStorage;
+        std::vector<Submesh> submeshStorage;
+        std::vector<float> lodErrorStorage;
+
+        // Points the arrays at the storage vectors and computes the bounds
+        void useStorage();
+    };
+
+}
+
+namespace portal::mesh_cache {
+
+    // A cached mesh (".pmesh") is a binary file that can be uploaded directly to the GPU:
+    // - The header
+    // - The error of each level of detail
+    // - The submeshes of each level of detail
+    // - The vertices (in the memory layout of "Vertex")
+    // - The elements (16-bit if the mesh has at most 65536 vertices)
+    // Every section starts at a 16 bytes aligned offset
+    struct MeshCacheHeader {
+        char magic[4];
+        uint32_t version;
+        // The size, modification time and content hash of the source file, used to detect stale cached meshes
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        uint32_t vertexCount, elementCount, elementSize, submeshCount, lodCount;
+        float boundsMin[3], boundsMax[3];
+        uint64_t lodErrorsOffset, submeshesOffset, verticesOffset, elementsOffset;
+    };
+
+    inline constexpr char MeshCacheMagic[4] = {'P', 'M', 'S', 'H'};
+    // Increase it whenever the import changes (e.g. the optimizations) so the old cached meshes are regenerated
+    inline constexpr uint32_t MeshCacheVersion = 3;
+
+    // The folder where the cached meshes are stored (relative to the working directory)
+    inline std::string cacheFolder = "mesh-cache";
+
+    // Returns the path of the cached mesh of the given source file (or of another file cached from it with the given extension)
+    std::string getCachePath(const std::string& sourcePath, const std::string& extension = ".pmesh");
+    // Reads the size and modification time of the source file
+    bool getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time);
+    // Reads the content hash (FNV-1a) of the source file
+    bool getSourceHash(const std::string& sourcePath, uint64_t& hash);
+    // Maps the cached mesh of the source file into "data"
+    // Returns false if there is no cached mesh or if it was created from another version of the source file
+    // If only the modification time changed, the content hash decides (and the cached time is updated)
+    bool load(const std::string& sourcePath, MeshData& data);
+    // Writes the data (which must use its storage vectors) to the cache then maps it into "data"
+    bool store(const std::string& sourcePath, MeshData& data);
+
+}
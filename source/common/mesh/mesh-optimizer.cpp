@@ -0,0 +1,223 @@
+#include "mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace portal::mesh_optimizer {
+
+    CacheStats analyzeVertexCache(const std::vector<GLuint>& elements, size_t vertexCount, size_t cacheSize){
+        CacheStats stats;
+        if(elements.empty() || vertexCount == 0) return stats;
+        // The time at which each vertex entered the cache, a vertex is in the cache if it entered less than "cacheSize" misses ago
+        std::vector<size_t> entered(vertexCount, 0);
+        size_t misses = 0;
+        for(GLuint element : elements){
+            if(entered[element] == 0 || misses - entered[element] >= cacheSize){
+                misses++;
+                entered[element] = misses;
+            }
+        }
+        stats.acmr = (float)misses / (elements.size() / 3);
+        stats.atvr = (float)misses / vertexCount;
+        return stats;
+    }
+
+    // The parameters of Forsyth's scoring, the cache is modelled as an LRU cache of 32 vertices
+    static const int maxCacheSize = 32;
+    static const float cacheDecayPower = 1.5f;
+    static const float lastTriangleScore = 0.75f;
+    static const float valenceBoostScale = 2.0f;
+    static const float valenceBoostPower = 0.5f;
+
+    static float vertexScore(int cachePosition, int remainingTriangles){
+        if(remainingTriangles == 0) return -1.0f;
+        float score = 0.0f;
+        if(cachePosition >= 0){
+            // The vertices of the last triangle get a fixed score so the next triangle doesn't just reuse the same edge
+            if(cachePosition < 3) score = lastTriangleScore;
+            else score = std::pow(1.0f - (float)(cachePosition - 3) / (maxCacheSize - 3), cacheDecayPower);
+        }
+        // Vertices with few triangles left are picked first so they don't end up alone later
+        score += valenceBoostScale * std::pow((float)remainingTriangles, -valenceBoostPower);
+        return score;
+    }
+
+    void optimizeVertexCache(std::vector<GLuint>& elements, size_t vertexCount){
+        size_t triangleCount = elements.size() / 3;
+        if(triangleCount == 0) return;
+
+        // The triangles using each vertex
+        std::vector<int> remaining(vertexCount, 0);
+        for(GLuint element : elements) remaining[element]++;
+        std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+        for(size_t v = 0; v < vertexCount; v++) firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+        std::vector<GLuint> adjacency(elements.size());
+        std::vector<size_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for(size_t t = 0; t < triangleCount; t++)
+            for(int c = 0; c < 3; c++) adjacency[filled[elements[3 * t + c]]++] = (GLuint)t;
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> score(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++) score[v] = vertexScore(-1, remaining[v]);
+        std::vector<float> triangleScore(triangleCount);
+        for(size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = score[elements[3 * t]] + score[elements[3 * t + 1]] + score[elements[3 * t + 2]];
+        std::vector<bool> added(triangleCount, false);
+
+        std::vector<GLuint> result;
+        result.reserve(elements.size());
+        std::vector<GLuint> cache, nextCache;
+        size_t scanPosition = 0;
+        size_t best = 0;
+        // Start with the best triangle overall
+        for(size_t t = 1; t < triangleCount; t++) if(triangleScore[t] > triangleScore[best]) best = t;
+
+        for(size_t emitted = 0; emitted < triangleCount; emitted++){
+            added[best] = true;
+            GLuint triangle[3] = {elements[3 * best], elements[3 * best + 1], elements[3 * best + 2]};
+            for(GLuint v : triangle){
+                result.push_back(v);
+                // Remove the triangle from the adjacency of its vertices
+                size_t begin = firstTriangle[v], end = begin + remaining[v];
+                for(size_t i = begin; i < end; i++){
+                    if(adjacency[i] == best){
+                        std::swap(adjacency[i], adjacency[end - 1]);
+                        break;
+                    }
+                }
+                remaining[v]--;
+            }
+
+            // Move the triangle vertices to the front of the cache
+            nextCache.assign(triangle, triangle + 3);
+            for(GLuint v : cache)
+                if(v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+            // The vertices pushed out of the cache lose their cache score
+            for(size_t i = maxCacheSize; i < nextCache.size(); i++){
+                cachePosition[nextCache[i]] = -1;
+                score[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+            }
+            if(nextCache.size() > (size_t)maxCacheSize) nextCache.resize(maxCacheSize);
+            cache.swap(nextCache);
+
+            // Update the scores of the vertices in the cache and of their triangles, then pick the best one
+            for(size_t i = 0; i < cache.size(); i++){
+                cachePosition[cache[i]] = (int)i;
+                score[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+            }
+            float bestScore = -1.0f;
+            for(GLuint v : cache){
+                size_t begin = firstTriangle[v], end = begin + remaining[v];
+                for(size_t i = begin; i < end; i++){
+                    GLuint t = adjacency[i];
+                    triangleScore[t] = score[elements[3 * t]] + score[elements[3 * t + 1]] + score[elements[3 * t + 2]];
+                    if(triangleScore[t] > bestScore){
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            // If no triangle touches the cache, continue with the next triangle that wasn't added yet
+            if(bestScore < 0.0f){
+                while(scanPosition < triangleCount && added[scanPosition]) scanPosition++;
+                if(scanPosition == triangleCount) break;
+                best = scanPosition;
+            }
+        }
+        elements.swap(result);
+    }
+
+    void optimizeOverdraw(std::vector<GLuint>& elements, const std::vector<Vertex>& vertices, float threshold){
+        size_t triangleCount = elements.size() / 3;
+        if(triangleCount < 2) return;
+        CacheStats original = analyzeVertexCache(elements, vertices.size());
+
+        // Split the triangles into clusters where the cache order restarts (a triangle with no cached vertex)
+        // so moving the clusters around keeps most of the cache reuse
+        std::vector<size_t> clusterStarts;
+        std::vector<size_t> entered(vertices.size(), 0);
+        size_t misses = 0;
+        for(size_t t = 0; t < triangleCount; t++){
+            int triangleMisses = 0;
+            for(int c = 0; c < 3; c++){
+                GLuint v = elements[3 * t + c];
+                if(entered[v] == 0 || misses - entered[v] >= 16){
+                    misses++;
+                    entered[v] = misses;
+                    triangleMisses++;
+                }
+            }
+            bool restart = triangleMisses == 3;
+            // Tiny clusters don't reduce the overdraw much, so they are merged with the previous one
+            if(t == 0 || (restart && t - clusterStarts.back() >= 16)) clusterStarts.push_back(t);
+        }
+        if(clusterStarts.size() < 2) return;
+        clusterStarts.push_back(triangleCount);
+
+        // Sort the clusters by how much they face away from the center of the mesh
+        glm::vec3 meshCenter(0.0f);
+        for(auto& vertex : vertices) meshCenter += vertex.position;
+        meshCenter /= (float)vertices.size();
+        size_t clusterCount = clusterStarts.size() - 1;
+        std::vector<float> sortKey(clusterCount);
+        for(size_t c = 0; c < clusterCount; c++){
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for(size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++){
+                glm::vec3 a = vertices[elements[3 * t]].position, b = vertices[elements[3 * t + 1]].position, d = vertices[elements[3 * t + 2]].position;
+                glm::vec3 cross = glm::cross(b - a, d - a);
+                float triangleArea = glm::length(cross);
+                centroid += (a + b + d) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+            float normalLength = glm::length(normal);
+            if(area > 0.0f) centroid /= area;
+            if(normalLength > 0.0f) normal /= normalLength;
+            sortKey[c] = glm::dot(centroid - meshCenter, normal);
+        }
+        std::vector<size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t first, size_t second){ return sortKey[first] > sortKey[second]; });
+
+        std::vector<GLuint> result;
+        result.reserve(elements.size());
+        for(size_t c : order)
+            result.insert(result.end(), elements.begin() + 3 * clusterStarts[c], elements.begin() + 3 * clusterStarts[c + 1]);
+        // Keep the new order only if it doesn't waste the vertex cache optimization
+        if(analyzeVertexCache(result, vertices.size()).acmr <= original.acmr * threshold) elements.swap(result);
+    }
+
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& elements){
+        const GLuint unused = ~0u;
+        std::vector<GLuint> remap(vertices.size(), unused);
+        std::vector<Vertex> result;
+        result.reserve(vertices.size());
+        for(GLuint& element : elements){
+            if(remap[element] == unused){
+                remap[element] = (GLuint)result.size();
+                result.push_back(vertices[element]);
+            }
+            element = remap[element];
+        }
+        // Vertices that no triangle uses are dropped
+        vertices.swap(result);
+    }
+
+    void optimizeTriangles(std::vector<GLuint>& elements, const std::vector<Vertex>& vertices){
+        std::vector<GLuint> optimized = elements;
+        optimizeVertexCache(optimized, vertices.size());
+        optimizeOverdraw(optimized, vertices);
+        // Meshes exported in a good order (e.g. strips) can already beat the greedy order, so they are kept as they are
+        if(analyzeVertexCache(optimized, vertices.size()).acmr < analyzeVertexCache(elements, vertices.size()).acmr) elements.swap(optimized);
+    }
+
+    void optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& elements, CacheStats* before, CacheStats* after){
+        if(before) *before = analyzeVertexCache(elements, vertices.size());
+        optimizeTriangles(elements, vertices);
+        optimizeVertexFetch(vertices, elements);
+        if(after) *after = analyzeVertexCache(elements, vertices.size());
+    }
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <glad/gl.h>
+
+#include <vector>
+
+namespace portal::mesh_optimizer {
+
+    // The post-transform vertex cache efficiency of an element order
+    // - ACMR (average cache miss ratio): transformed vertices per triangle (0.5 is ideal for large grids, 3 is the worst)
+    // - ATVR (average transformed vertex ratio): transformed vertices per vertex (1 is ideal)
+    struct CacheStats {
+        float acmr = 0;
+        float atvr = 0;
+    };
+
+    // Simulates a FIFO post-transform cache of the given size on the triangles
+    CacheStats analyzeVertexCache(const std::vector<GLuint>& elements, size_t vertexCount, size_t cacheSize = 16);
+
+    // Reorders the triangles to reuse the recently transformed vertices (Tom Forsyth's linear-speed algorithm)
+    void optimizeVertexCache(std::vector<GLuint>& elements, size_t vertexCount);
+
+    // Reorders groups of triangles so the ones facing outwards are drawn first, which reduces overdraw for
+    // opaque meshes when they are seen from the outside. The elements should be optimized for the vertex cache first,
+    // the groups are split where the cache order restarts so the ACMR can't get worse than "threshold" times its value.
+    void optimizeOverdraw(std::vector<GLuint>& elements, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+    // Reorders the vertices in the order of their first use so the vertex fetches are close to each other
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& elements);
+
+    // Optimizes the triangle order for the vertex cache then for the overdraw
+    // The new order is only kept if it improves the ACMR
+    void optimizeTriangles(std::vector<GLuint>& elements, const std::vector<Vertex>& vertices);
+
+    // Runs all the above in order and returns the stats before and after
+    void optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& elements, CacheStats* before = nullptr, CacheStats* after = nullptr);
+
+}
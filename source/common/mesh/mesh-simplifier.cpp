@@ -0,0 +1,235 @@
+#include "mesh-simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+namespace portal::mesh_simplifier {
+
+    // A symmetric 4x4 matrix holding the sum of the squared distances to a set of planes (and the sum of their weights)
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+        double weight = 0;
+
+        void addPlane(glm::dvec3 normal, double distance, double planeWeight){
+            a2 += planeWeight * normal.x * normal.x; ab += planeWeight * normal.x * normal.y; ac += planeWeight * normal.x * normal.z;
+            ad += planeWeight * normal.x * distance; b2 += planeWeight * normal.y * normal.y; bc += planeWeight * normal.y * normal.z;
+            bd += planeWeight * normal.y * distance; c2 += planeWeight * normal.z * normal.z; cd += planeWeight * normal.z * distance;
+            d2 += planeWeight * distance * distance;
+            weight += planeWeight;
+        }
+        void add(const Quadric& other){
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad; b2 += other.b2;
+            bc += other.bc; bd += other.bd; c2 += other.c2; cd += other.cd; d2 += other.d2;
+            weight += other.weight;
+        }
+        // The weighted mean of the squared distances from the point to the planes
+        double evaluate(glm::dvec3 p) const {
+            double sum = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+                       + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+                       + c2 * p.z * p.z + 2 * cd * p.z + d2;
+            return weight > 0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+    };
+
+    // A candidate collapse of the position "from" into the position "to"
+    struct Collapse {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    // The border edges get a plane perpendicular to their triangle so the border can only slide along itself
+    static const double borderWeight = 10.0;
+    // A collapse is rejected if it turns a triangle by more than about 80 degrees
+    static const double minNormalDot = 0.2;
+
+    std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, size_t targetTriangles,
+                                 float maxError, float* error, std::vector<uint32_t>* sourceTriangles){
+        // Weld the vertices with the same position, the texture seams and the hard edges are collapsed together
+        std::unordered_map<glm::vec3, uint32_t> positionIndices;
+        std::vector<uint32_t> positionOf(vertices.size());
+        std::vector<glm::dvec3> positions;
+        std::vector<std::vector<GLuint>> wedges;
+        for(size_t v = 0; v < vertices.size(); v++){
+            auto [it, inserted] = positionIndices.try_emplace(vertices[v].position, (uint32_t)positions.size());
+            if(inserted){
+                positions.push_back(glm::dvec3(vertices[v].position));
+                wedges.emplace_back();
+            }
+            positionOf[v] = it->second;
+            wedges[it->second].push_back((GLuint)v);
+        }
+
+        size_t triangleCount = elements.size() / 3;
+        std::vector<uint32_t> triangles(3 * triangleCount);
+        std::vector<bool> alive(triangleCount, false);
+        std::vector<std::vector<uint32_t>> positionTriangles(positions.size());
+        size_t aliveCount = 0;
+        for(size_t t = 0; t < triangleCount; t++){
+            for(int c = 0; c < 3; c++) triangles[3 * t + c] = positionOf[elements[3 * t + c]];
+            uint32_t* tri = &triangles[3 * t];
+            if(tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) continue;
+            alive[t] = true;
+            aliveCount++;
+            for(int c = 0; c < 3; c++) positionTriangles[tri[c]].push_back((uint32_t)t);
+        }
+
+        // Each position starts with the planes of its triangles weighted by their area
+        std::vector<Quadric> quadrics(positions.size());
+        std::unordered_map<uint64_t, int> edgeUses;
+        auto edgeKey = [](uint32_t a, uint32_t b){ return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a; };
+        for(size_t t = 0; t < triangleCount; t++){
+            if(!alive[t]) continue;
+            uint32_t* tri = &triangles[3 * t];
+            glm::dvec3 cross = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+            double area = glm::length(cross) * 0.5;
+            if(area <= 0) continue;
+            glm::dvec3 normal = cross / (2.0 * area);
+            for(int c = 0; c < 3; c++){
+                quadrics[tri[c]].addPlane(normal, -glm::dot(normal, positions[tri[0]]), area);
+                edgeUses[edgeKey(tri[c], tri[(c + 1) % 3])]++;
+            }
+        }
+        std::vector<bool> border(positions.size(), false);
+        for(size_t t = 0; t < triangleCount; t++){
+            if(!alive[t]) continue;
+            uint32_t* tri = &triangles[3 * t];
+            glm::dvec3 triangleNormal = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+            if(glm::length(triangleNormal) <= 0) continue;
+            triangleNormal = glm::normalize(triangleNormal);
+            for(int c = 0; c < 3; c++){
+                uint32_t a = tri[c], b = tri[(c + 1) % 3];
+                if(edgeUses[edgeKey(a, b)] != 1) continue;
+                border[a] = border[b] = true;
+                glm::dvec3 edge = positions[b] - positions[a];
+                double length = glm::length(edge);
+                if(length <= 0) continue;
+                glm::dvec3 normal = glm::normalize(glm::cross(edge, triangleNormal));
+                double distance = -glm::dot(normal, positions[a]);
+                quadrics[a].addPlane(normal, distance, length * length * borderWeight);
+                quadrics[b].addPlane(normal, distance, length * length * borderWeight);
+            }
+        }
+
+        // The collapses are kept in a priority queue, a collapse is outdated if one of its positions changed since it was pushed
+        std::vector<uint32_t> versions(positions.size(), 0);
+        std::vector<bool> removed(positions.size(), false);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        auto pushCollapse = [&](uint32_t from, uint32_t to){
+            // A border position can only move along the border
+            if(border[from] && (!border[to] || edgeUses[edgeKey(from, to)] != 1)) return;
+            Quadric sum = quadrics[from];
+            sum.add(quadrics[to]);
+            queue.push({sum.evaluate(positions[to]), from, to, versions[from], versions[to]});
+        };
+        for(size_t t = 0; t < triangleCount; t++){
+            if(!alive[t]) continue;
+            uint32_t* tri = &triangles[3 * t];
+            for(int c = 0; c < 3; c++){
+                pushCollapse(tri[c], tri[(c + 1) % 3]);
+                pushCollapse(tri[(c + 1) % 3], tri[c]);
+            }
+        }
+
+        double maxCost = (double)maxError * maxError;
+        double largestCost = 0;
+        while(aliveCount > targetTriangles && !queue.empty()){
+            Collapse collapse = queue.top();
+            queue.pop();
+            uint32_t from = collapse.from, to = collapse.to;
+            if(removed[from] || removed[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) continue;
+            if(collapse.cost > maxCost) break;
+
+            // Reject the collapse if it flips (or nearly flips) one of the triangles that only move
+            bool valid = true;
+            auto& fromTriangles = positionTriangles[from];
+            fromTriangles.erase(std::remove_if(fromTriangles.begin(), fromTriangles.end(), [&](uint32_t t){ return !alive[t]; }), fromTriangles.end());
+            for(uint32_t t : fromTriangles){
+                uint32_t* tri = &triangles[3 * t];
+                if(tri[0] == to || tri[1] == to || tri[2] == to) continue;
+                glm::dvec3 before = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+                glm::dvec3 moved[3] = {positions[tri[0]], positions[tri[1]], positions[tri[2]]};
+                for(int c = 0; c < 3; c++) if(tri[c] == from) moved[c] = positions[to];
+                glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                double lengths = glm::length(before) * glm::length(after);
+                if(lengths <= 0 || glm::dot(before, after) < minNormalDot * lengths){
+                    valid = false;
+                    break;
+                }
+            }
+            if(!valid) continue;
+
+            // Move the triangles of "from" to "to", the triangles using both disappear
+            // (the edge uses are updated so the border edges stay known)
+            for(uint32_t t : fromTriangles){
+                uint32_t* tri = &triangles[3 * t];
+                bool collapsed = tri[0] == to || tri[1] == to || tri[2] == to;
+                for(int c = 0; c < 3; c++){
+                    uint32_t a = tri[c], b = tri[(c + 1) % 3];
+                    edgeUses[edgeKey(a, b)]--;
+                    if(collapsed) continue;
+                    edgeUses[edgeKey(a == from ? to : a, b == from ? to : b)]++;
+                }
+                if(collapsed){
+                    alive[t] = false;
+                    aliveCount--;
+                    continue;
+                }
+                for(int c = 0; c < 3; c++) if(tri[c] == from) tri[c] = to;
+                positionTriangles[to].push_back(t);
+            }
+            fromTriangles.clear();
+            removed[from] = true;
+            quadrics[to].add(quadrics[from]);
+            versions[to]++;
+            largestCost = std::max(largestCost, collapse.cost);
+
+            // The collapses around "to" have a new cost
+            auto& toTriangles = positionTriangles[to];
+            toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&](uint32_t t){ return !alive[t]; }), toTriangles.end());
+            for(uint32_t t : toTriangles){
+                uint32_t* tri = &triangles[3 * t];
+                for(int c = 0; c < 3; c++){
+                    if(tri[c] == to) continue;
+                    pushCollapse(to, tri[c]);
+                    pushCollapse(tri[c], to);
+                }
+            }
+        }
+
+        // Pick the vertex of each corner at its new position, the closest in normal and texture coordinates to its original vertex
+        std::vector<GLuint> result;
+        result.reserve(3 * aliveCount);
+        if(sourceTriangles) sourceTriangles->clear();
+        for(size_t t = 0; t < triangleCount; t++){
+            if(!alive[t]) continue;
+            for(int c = 0; c < 3; c++){
+                GLuint original = elements[3 * t + c];
+                uint32_t position = triangles[3 * t + c];
+                if(positionOf[original] == position){
+                    result.push_back(original);
+                    continue;
+                }
+                const Vertex& vertex = vertices[original];
+                GLuint best = wedges[position][0];
+                float bestScore = -1e30f;
+                for(GLuint candidate : wedges[position]){
+                    const Vertex& other = vertices[candidate];
+                    float score = glm::dot(vertex.normal, other.normal) - glm::length(vertex.tex_coord - other.tex_coord);
+                    if(score > bestScore){
+                        bestScore = score;
+                        best = candidate;
+                    }
+                }
+                result.push_back(best);
+            }
+            if(sourceTriangles) sourceTriangles->push_back((uint32_t)t);
+        }
+        if(error) *error = (float)std::sqrt(largestCost);
+        return result;
+    }
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace portal::mesh_simplifier {
+
+    // Simplifies the triangles with edge collapses ordered by their quadric error (Garland & Heckbert)
+    // until there are at most "targetTriangles" triangles or the next collapse would move the surface more than "maxError".
+    // The vertices are collapsed into one of their neighbours, so the result uses the same vertices as the input:
+    // the collapses are done on the positions, then each corner picks the vertex at its new position with the closest normal
+    // and texture coordinates (so the hard edges and the texture seams are kept where possible).
+    // - "error" receives the largest error of the collapses (a distance in the units of the positions)
+    // - "sourceTriangles" receives the index of the input triangle each output triangle comes from
+    std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, size_t targetTriangles,
+                                 float maxError, float* error = nullptr, std::vector<uint32_t>* sourceTriangles = nullptr);
+
+}
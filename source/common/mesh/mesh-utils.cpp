@@ -6,15 +6,117 @@
 #include <reactphysics3d/reactphysics3d.h>
 namespace r3d = reactphysics3d;
 
+#include "mesh-optimizer.hpp"
+#include "mesh-simplifier.hpp"
+#include "mesh-cache.hpp"
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <streambuf>
 #include <vector>
 #include <unordered_map>
 
-portal::Mesh* portal::mesh_utils::loadOBJ(const std::string& filename) {
+// Reorders the triangles of each submesh then the vertices of the whole mesh for the vertex cache, overdraw and vertex fetch
+// then reports the cache efficiency before and after
+static void optimizeMesh(const std::string& filename, portal::MeshData& data){
+    std::vector<portal::Vertex>& vertices = data.vertexStorage;
+    std::vector<GLuint>& elements = data.elementStorage;
+    portal::mesh_optimizer::CacheStats before = portal::mesh_optimizer::analyzeVertexCache(elements, vertices.size());
+    // The triangles are only reordered inside their submesh so the submeshes stay contiguous
+    for(auto& submesh : data.submeshStorage){
+        auto first = elements.begin() + submesh.firstElement, last = first + submesh.elementCount;
+        std::vector<GLuint> submeshElements(first, last);
+        portal::mesh_optimizer::optimizeTriangles(submeshElements, vertices);
+        std::copy(submeshElements.begin(), submeshElements.end(), first);
+    }
+    portal::mesh_optimizer::optimizeVertexFetch(vertices, elements);
+    portal::mesh_optimizer::CacheStats after = portal::mesh_optimizer::analyzeVertexCache(elements, vertices.size());
+    std::cout << "Optimized " << filename << " (" << vertices.size() << " vertices, " << elements.size() / 3 << " triangles): "
+              << std::fixed << std::setprecision(3) << "ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::defaultfloat << std::endl;
+}
+
+// The levels of detail are generated until one of these limits is reached
+static const int maxLods = 4;
+// Each level targets this fraction of the triangles of the previous one and is dropped if it keeps more than "minReduction" of them
+static const float lodTriangleRatio = 0.5f;
+static const float minReduction = 0.8f;
+// The meshes with fewer triangles don't get any simplified level
+static const size_t minLodTriangles = 64;
+// The largest error allowed in the simplified levels, relative to the radius of the mesh
+static const float maxLodError = 0.1f;
+
+// Appends the simplified levels of detail to the storage of "data" (the first level must be the only one in it)
+// Every level is simplified from the full mesh so the errors don't add up, then its triangles are grouped by submesh
+static void generateLods(const std::string& filename, portal::MeshData& data){
+    std::vector<portal::Vertex>& vertices = data.vertexStorage;
+    size_t submeshCount = data.submeshStorage.size();
+    data.lodErrorStorage.assign(1, 0.0f);
+    std::vector<GLuint> fullElements = data.elementStorage;
+    size_t fullTriangles = fullElements.size() / 3;
+    if(fullTriangles < minLodTriangles || vertices.empty()) return;
+
+    // The submesh of each triangle of the full mesh
+    std::vector<uint32_t> triangleSubmesh(fullTriangles);
+    for(size_t s = 0; s < submeshCount; s++){
+        auto& submesh = data.submeshStorage[s];
+        for(uint32_t t = submesh.firstElement / 3; t < (submesh.firstElement + submesh.elementCount) / 3; t++) triangleSubmesh[t] = (uint32_t)s;
+    }
+    glm::vec3 minimum = vertices[0].position, maximum = vertices[0].position;
+    for(auto& vertex : vertices){
+        minimum = glm::min(minimum, vertex.position);
+        maximum = glm::max(maximum, vertex.position);
+    }
+    float radius = glm::length(maximum - minimum) * 0.5f;
+    if(radius <= 0.0f) return;
+
+    std::ostringstream report;
+    report << fullTriangles;
+    size_t previousTriangles = fullTriangles;
+    for(int lod = 1; lod <= maxLods && previousTriangles >= minLodTriangles; lod++){
+        float error = 0.0f;
+        std::vector<uint32_t> sourceTriangles;
+        std::vector<GLuint> simplified = portal::mesh_simplifier::simplify(vertices, fullElements, (size_t)(previousTriangles * lodTriangleRatio),
+                                                                            maxLodError * radius, &error, &sourceTriangles);
+        size_t triangles = simplified.size() / 3;
+        if(triangles > previousTriangles * minReduction) break;
+
+        // Group the triangles by submesh (in the same order as the first level) then optimize each group for the vertex cache
+        std::vector<std::vector<GLuint>> submeshElements(submeshCount);
+        for(size_t t = 0; t < triangles; t++){
+            auto& target = submeshElements[triangleSubmesh[sourceTriangles[t]]];
+            target.insert(target.end(), simplified.begin() + 3 * t, simplified.begin() + 3 * t + 3);
+        }
+        for(size_t s = 0; s < submeshCount; s++){
+            portal::mesh_optimizer::optimizeTriangles(submeshElements[s], vertices);
+            data.submeshStorage.push_back({(uint32_t)data.elementStorage.size(), (uint32_t)submeshElements[s].size(), data.submeshStorage[s].materialSlot});
+            data.elementStorage.insert(data.elementStorage.end(), submeshElements[s].begin(), submeshElements[s].end());
+        }
+        data.lodErrorStorage.push_back(error);
+        report << " -> " << triangles << " (error " << error / radius * 100.0f << "%)";
+        previousTriangles = triangles;
+    }
+    if(data.lodErrorStorage.size() > 1)
+        std::cout << "Generated " << data.lodErrorStorage.size() - 1 << " LODs for " << filename << ": " << report.str() << " triangles" << std::endl;
+}
+
+// A read-only stream buffer over the memory of a file (so tinyobj can parse it without a copy)
+struct MemoryBuffer : std::streambuf {
+    MemoryBuffer(const uint8_t* data, size_t size) {
+        char* begin = (char*)data;
+        setg(begin, begin, begin + size);
+    }
+};
+
+// Reads an ".obj" file into the storage of "data", removes the duplicate vertices then optimizes the mesh
+static bool importOBJ(const std::string& filename, portal::MeshData& data) {
 
     // The data that we will use to initialize our mesh
-    std::vector<portal::Vertex> vertices;
-    std::vector<GLuint> elements;
+    std::vector<portal::Vertex>& vertices = data.vertexStorage;
+    std::vector<GLuint>& elements = data.elementStorage;
 
     // Since the OBJ can have duplicated vertices, we make them unique using this map
     // The key is the vertex, the value is its index in the vector "vertices".
@@ -27,20 +129,36 @@ portal::Mesh* portal::mesh_utils::loadOBJ(const std::string& filename) {
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
+    // The file is read through "AssetFile" so it can come from the mounted asset pack
+    // (the material files are still read from the disk, relative to the working directory as before)
+    portal::AssetFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Failed to load obj file \"" << filename << "\" due to error: Cannot open file" << std::endl;
+        return false;
+    }
+    MemoryBuffer buffer(file.getData(), file.getSize());
+    std::istream stream(&buffer);
+    tinyobj::MaterialFileReader materialReader("");
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader)) {
         std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return nullptr;
+        return false;
     }
     if (!warn.empty()) {
         std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
     }
 
-    // An obj file can have multiple shapes where each shape can have its own material
-    // Ideally, we would load each shape into a separate mesh or store the start and end of it in the element buffer to be able to draw each shape separately
-    // But we ignored this fact since we don't plan to use multiple materials in the examples
-    for (const auto &shape : shapes) {
-        for (const auto &index : shape.mesh.indices) {
-            Vertex vertex = {};
+    // An obj file can have multiple shapes where each face can have its own material
+    // The elements are grouped by material slot (the material of the face, or its shape if the file has no materials)
+    // and each group is stored as a submesh, so the whole file can be drawn with a material per slot
+    std::vector<std::vector<GLuint>> slotElements(materials.empty() ? shapes.size() : materials.size());
+    for (size_t s = 0; s < shapes.size(); s++) {
+        const auto &shape = shapes[s];
+        for (size_t i = 0; i < shape.mesh.indices.size(); i++) {
+            const auto &index = shape.mesh.indices[i];
+            // The faces are triangulated by Tiny OBJ Loader so each face has 3 indices
+            size_t slot = s;
+            if (!materials.empty()) slot = (size_t)std::max(shape.mesh.material_ids[i / 3], 0);
+            portal::Vertex vertex = {};
 
             // Read the data for a vertex from the "attrib" object
             vertex.position = {
@@ -74,16 +192,55 @@ portal::Mesh* portal::mesh_utils::loadOBJ(const std::string& filename) {
                 // if no, add it to the vertices and record its index
                 auto new_vertex_index = static_cast<GLuint>(vertices.size());
                 vertex_map[vertex] = new_vertex_index;
-                elements.push_back(new_vertex_index);
+                slotElements[slot].push_back(new_vertex_index);
                 vertices.push_back(vertex);
             } else {
                 // if yes, just add its index in the elements vector
-                elements.push_back(it->second);
+                slotElements[slot].push_back(it->second);
             }
         }
     }
+    for (size_t slot = 0; slot < slotElements.size(); slot++) {
+        if (slotElements[slot].empty()) continue;
+        data.submeshStorage.push_back({(uint32_t)elements.size(), (uint32_t)slotElements[slot].size(), (uint32_t)slot});
+        elements.insert(elements.end(), slotElements[slot].begin(), slotElements[slot].end());
+    }
 
-    return new portal::Mesh(vertices, elements);
+    optimizeMesh(filename, data);
+    generateLods(filename, data);
+    data.useStorage();
+    return true;
+}
+
+portal::MeshData* portal::mesh_utils::loadOBJData(const std::string& filename) {
+    auto start = std::chrono::high_resolution_clock::now();
+    MeshData* data = new MeshData();
+    // Try the mesh cache first, then import the file and cache it for the next time
+    bool cached = mesh_cache::load(filename, *data);
+    if (!cached) {
+        if (!importOBJ(filename, *data)) {
+            delete data;
+            return nullptr;
+        }
+        // If the mesh can't be cached, the data stays in the storage vectors
+        mesh_cache::store(filename, *data);
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << (cached ? "Loaded cached mesh " : "Imported mesh ") << filename << " in " << milliseconds << " ms" << std::endl;
+    return data;
+}
+
+portal::Mesh* portal::mesh_utils::createMesh(const MeshData& data, const VertexLayout& layout) {
+    return new portal::Mesh(data.vertices, data.vertexCount, data.elements, data.elementCount, data.elementType,
+                            data.submeshes, data.submeshCount, data.lodErrors, data.lodCount, layout);
+}
+
+portal::Mesh* portal::mesh_utils::loadOBJ(const std::string& filename) {
+    MeshData* data = loadOBJData(filename);
+    if (!data) return nullptr;
+    Mesh* mesh = createMesh(*data);
+    delete data;
+    return mesh;
 }
 
 // Create a sphere (the vertex order in the triangles are CCW from the outside)
@@ -123,78 +280,3 @@ portal::Mesh* portal::mesh_utils::sphere(const glm::ivec2& segments){
 
     return new portal::Mesh(vertices, elements);
 }
-
-std::pair<std::vector<portal::Vertex>*, std::vector<GLuint>*> portal::mesh_utils::loadOBJData(const std::string& filename) {
-    // The data that we will use to initialize our mesh
-    std::vector<portal::Vertex>* vertices = new std::vector<portal::Vertex>();
-    std::vector<GLuint>* elements = new std::vector<GLuint>();
-
-    // Since the OBJ can have duplicated vertices, we make them unique using this map
-    // The key is the vertex, the value is its index in the vector "vertices".
-    // That index will be used to populate the "elements" vector.
-    std::unordered_map<portal::Vertex, GLuint> vertex_map;
-
-    // The data loaded by Tiny OBJ Loader
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
-        std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return {nullptr, nullptr};
-    }
-    if (!warn.empty()) {
-        std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
-    }
-
-    // An obj file can have multiple shapes where each shape can have its own material
-    // Ideally, we would load each shape into a separate mesh or store the start and end of it in the element buffer to be able to draw each shape separately
-    // But we ignored this fact since we don't plan to use multiple materials in the examples
-    for (const auto &shape : shapes) {
-        for (const auto &index : shape.mesh.indices) {
-            Vertex vertex = {};
-
-            // Read the data for a vertex from the "attrib" object
-            vertex.position = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-            };
-
-            vertex.tex_coord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-
-            vertex.color = {
-                    attrib.colors[3 * index.vertex_index + 0] * 255,
-                    attrib.colors[3 * index.vertex_index + 1] * 255,
-                    attrib.colors[3 * index.vertex_index + 2] * 255,
-                    255
-            };
-
-            // See if we already stored a similar vertex
-            auto it = vertex_map.find(vertex);
-            if (it == vertex_map.end()) {
-                // if no, add it to the vertices and record its index
-                auto new_vertex_index = static_cast<GLuint>(vertices->size());
-                vertex_map[vertex] = new_vertex_index;
-                elements->push_back(new_vertex_index);
-                vertices->push_back(vertex);
-            } else {
-                // if yes, just add its index in the elements vector
-                elements->push_back(it->second);
-            }
-        }
-    }
-
-    return std::make_pair(vertices, elements);
-}
\ No newline at end of file
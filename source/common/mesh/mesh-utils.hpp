@@ -1,18 +1,22 @@
 #pragma once
 
 #include "mesh.hpp"
+#include "mesh-cache.hpp"
 #include <string>
 #include <reactphysics3d/reactphysics3d.h>
 namespace r3d = reactphysics3d;
 
 namespace portal::mesh_utils {
-    // Load an ".obj" file into the mesh
+    // Load an ".obj" file into the mesh (through the mesh cache)
     Mesh* loadOBJ(const std::string& filename);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
 
-    // This will only load the data from the obj file into the vectors
-    // without creating a mesh object
-    std::pair<std::vector<portal::Vertex>*, std::vector<GLuint>*> loadOBJData(const std::string& filename);
+    // This will only load the data from the obj file without creating a mesh object
+    // The data is mapped from the mesh cache, if the cached mesh is missing or stale the file is imported and cached again
+    MeshData* loadOBJData(const std::string& filename);
+    // Creates a mesh from the loaded data (the data can be deleted afterwards)
+    // The vertices are packed with the given layout (the current one by default, see "Mesh::layout")
+    Mesh* createMesh(const MeshData& data, const VertexLayout& layout = Mesh::layout);
 }
\ No newline at end of file
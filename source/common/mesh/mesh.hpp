@@ -2,6 +2,11 @@
 
 #include <glad/gl.h>
 #include "vertex.hpp"
+#include "vertex-packing.hpp"
+#include "geometry-pool.hpp"
+
+#include <iostream>
+#include <vector>
 
 namespace portal {
 
@@ -9,73 +14,180 @@ namespace portal {
     #define ATTRIB_LOC_COLOR    1
     #define ATTRIB_LOC_TEXCOORD 2
     #define ATTRIB_LOC_NORMAL   3
+    // These are not stored in the vertex buffer, they are constant for each mesh
+    #define ATTRIB_LOC_POSITION_DECODE 4
+    #define ATTRIB_LOC_NORMAL_DECODE   5
+
+    // The number of meshes and vertices created and the size of their vertex buffers
+    struct MeshMemoryStats {
+        size_t meshes = 0;
+        size_t vertices = 0;
+        size_t bytes = 0;
+        // The size these vertices would take with the full layout
+        size_t fullBytes = 0;
+        size_t elements = 0;
+        size_t elementBytes = 0;
+    };
+
+    // A range of the elements of a mesh drawn with the material of its slot
+    // The slots of an imported mesh are its materials (in the order of the ".mtl" file)
+    // or its shapes (in the order of the ".obj" file) if it has no materials
+    struct Submesh {
+        uint32_t firstElement = 0;
+        uint32_t elementCount = 0;
+        uint32_t materialSlot = 0;
+    };
+
+    // A level of detail of a mesh, every level has the same slots in the same order
+    // (a submesh can be empty if the simplification removed all its triangles)
+    struct MeshLod {
+        // The quadric error of the simplification, an estimate of the distance between the simplified surface
+        // and the original one (in the units of the mesh, 0 for the full detail)
+        float error = 0.0f;
+        std::vector<Submesh> submeshes;
+    };
 
     class Mesh {
-        // Here, we store the object names of the 3 main components of a mesh:
-        // A vertex array object, A vertex buffer and an element buffer
-        unsigned int VBO, EBO;
-        unsigned int VAO;
+        // The vertices and elements of the mesh are stored in the shared buffers of the geometry pool
+        // (the vertex array, vertex buffer and element buffer are shared by all the meshes with the same vertex format)
+        GeometryPool::Allocation* allocation;
         // We need to remember the number of elements that will be draw by glDrawElements 
         GLsizei elementCount;
+        // The element ranges of each level of detail sorted by their first element, starting with the full detail
+        // (a single range with slot 0 if none was given)
+        std::vector<MeshLod> lods;
+        // The bounding sphere of the vertices (used to pick the level of detail from the size of the mesh on the screen)
+        glm::vec3 boundingCenter;
+        float boundingRadius;
+        // The values given to the vertex shader to decode the packed attributes (see "PackedVertices")
+        glm::vec4 positionDecode;
+        float normalDecode;
+        // If the color attribute was dropped, every vertex has this color
+        bool hasColor;
+        Color uniformColor;
+        // The vertex and element bytes used in the buffers of the geometry pool
+        size_t bytes;
     public:
+        // The layout used by the meshes created from now on (set by the "vertexLayout" of the assets of the current scene)
+        // The meshes preloaded for the next scene are given its layout instead (see "deserializeMeshesInJobs")
+        static inline VertexLayout layout = VertexLayout::full();
+        // The vertex buffer memory used by the meshes created since the last reset compared to the full layout
+        static inline MeshMemoryStats stats;
 
         // The constructor takes two vectors:
         // - vertices which contain the vertex data.
         // - elements which contain the indices of the vertices out of which each rectangle will be constructed.
-        // The mesh class does not keep a these data on the RAM. Instead, it should create
-        // a vertex buffer to store the vertex data on the VRAM,
-        // an element buffer to store the element data on the VRAM,
-        // a vertex array object to define how to read the vertex & element buffer during rendering 
+        // The mesh class does not keep a these data on the RAM. Instead, it uploads them to
+        // the vertex & element buffers of the geometry pool (in the VRAM)
         Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements)
+            : Mesh(vertices.data(), vertices.size(), elements.data(), elements.size(), GL_UNSIGNED_INT) {}
+
+        // The same from arrays (e.g. mapped from the mesh cache), elementType is GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+        // "submeshes" holds "submeshCount" submeshes for each of the "lodCount" levels of detail (whose errors are in "lodErrors")
+        // The vertices are packed with "vertexLayout" (the current layout if none is given)
+        Mesh(const Vertex* vertices, size_t vertexCount, const void* elements, size_t elementCount, GLenum elementType,
+             const Submesh* submeshes = nullptr, size_t submeshCount = 0, const float* lodErrors = nullptr, size_t lodCount = 1,
+             const VertexLayout& vertexLayout = layout)
         {
             //TODO: (Req 2) Write this function
             // remember to store the number of elements in "elementCount" since you will need it for drawing
             // For the attribute locations, use the constants defined above: ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
-            glGenBuffers(1, &EBO);
-            
-            glBindVertexArray(VAO);
-            
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
-
-            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(0));
-            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
-            
-            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(sizeof(glm::vec3)));
-            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+            // The vertices are converted to the vertex layout before being uploaded
+            PackedVertices packed = packVertices(vertices, vertexCount, vertexLayout);
+            positionDecode = packed.positionDecode;
+            normalDecode = packed.normalDecode;
+            uniformColor = packed.uniformColor;
+            hasColor = packed.color.size != 0;
 
-            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3) + sizeof(Color)));
-            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+            allocation = GeometryPool::allocate(packed, elements, elementCount, elementType);
+            if(submeshCount > 0){
+                lods.resize(lodCount);
+                for(size_t lod = 0; lod < lodCount; lod++){
+                    lods[lod].error = lodErrors ? lodErrors[lod] : 0.0f;
+                    lods[lod].submeshes.assign(submeshes + lod * submeshCount, submeshes + (lod + 1) * submeshCount);
+                }
+                // The first level is drawn by "draw()"
+                this->elementCount = 0;
+                for(auto& submesh : lods[0].submeshes) this->elementCount += (GLsizei)submesh.elementCount;
+            } else {
+                lods.push_back({0.0f, {{0, (uint32_t)elementCount, 0}}});
+                this->elementCount = (GLsizei)elementCount;
+            }
 
-            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3) + sizeof(Color) + sizeof(glm::vec2)));
-            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
-
-            glBindVertexArray(0);
-            elementCount = (GLsizei)elements.size();
+            glm::vec3 minimum(0.0f), maximum(0.0f);
+            if(vertexCount > 0) minimum = maximum = vertices[0].position;
+            for(size_t i = 0; i < vertexCount; i++){
+                minimum = glm::min(minimum, vertices[i].position);
+                maximum = glm::max(maximum, vertices[i].position);
+            }
+            boundingCenter = (minimum + maximum) * 0.5f;
+            boundingRadius = 0.0f;
+            for(size_t i = 0; i < vertexCount; i++)
+                boundingRadius = glm::max(boundingRadius, glm::length(vertices[i].position - boundingCenter));
 
+            bytes = packed.getSize() + elementCount * allocation->format->elements.elementSize;
+            stats.meshes++;
+            stats.vertices += vertexCount;
+            stats.elements += elementCount;
+            stats.bytes += packed.getSize();
+            stats.elementBytes += elementCount * allocation->format->elements.elementSize;
+            stats.fullBytes += vertexCount * sizeof(Vertex);
         }
 
+        const std::vector<Submesh>& getSubmeshes() const { return lods[0].submeshes; }
+        const std::vector<MeshLod>& getLods() const { return lods; }
+        GLsizei getElementCount() const { return elementCount; }
+        glm::vec3 getBoundingCenter() const { return boundingCenter; }
+        float getBoundingRadius() const { return boundingRadius; }
+        size_t getBytes() const { return bytes; }
+
         // this function should render the mesh
         void draw() 
         {
             //TODO: (Req 2) Write this function
             // You should use glDrawElements to draw the mesh
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0);
-            glBindVertexArray(0);
+            draw(0, elementCount);
+        }
+
+        // Draws "count" consecutive submeshes of the given level of detail
+        void drawSubmeshes(size_t lod, size_t firstSubmesh, size_t count)
+        {
+            auto& submeshes = lods[lod].submeshes;
+            GLsizei elements = 0;
+            for(size_t i = firstSubmesh; i < firstSubmesh + count; i++) elements += (GLsizei)submeshes[i].elementCount;
+            if(elements > 0) draw(submeshes[firstSubmesh].firstElement, elements);
         }
 
-        // this function should delete the vertex & element buffers and the vertex array object
+        // Draws "count" elements starting from "firstElement" (e.g. one or more consecutive submeshes)
+        // The submeshes share the vertex array and buffers of the mesh so drawing them one after the other only changes the offsets
+        void draw(GLuint firstElement, GLsizei count)
+        {
+            // The vertex array is only bound if the previous mesh had another vertex format
+            GeometryPool::bind(allocation->format);
+            // The constant attributes are not part of the vertex array state so they are set for every draw
+            glVertexAttrib4fv(ATTRIB_LOC_POSITION_DECODE, &positionDecode[0]);
+            glVertexAttrib1f(ATTRIB_LOC_NORMAL_DECODE, normalDecode);
+            if(!hasColor) glVertexAttrib4Nub(ATTRIB_LOC_COLOR, uniformColor.r, uniformColor.g, uniformColor.b, uniformColor.a);
+            // The elements are relative to the first vertex of the mesh so it is given as the base vertex
+            GeometryPool::Format* format = allocation->format;
+            glDrawElementsBaseVertex(GL_TRIANGLES, count, format->indexType,
+                                     (void*)((allocation->elements.offset + firstElement) * format->elements.elementSize), (GLint)allocation->vertices.offset);
+        }
+
+        // this function should give the vertex & element ranges back to the geometry pool
         ~Mesh(){
             //TODO: (Req 2) Write this function
-            glDeleteVertexArrays(1, &VAO);
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
+            GeometryPool::deallocate(allocation);
+        }
+
+        // Prints the vertex buffer memory of the meshes created since the last reset of "stats"
+        // The vertex fetch bandwidth is proportional to the vertex size, so it shrinks by the same ratio
+        static void reportStats(){
+            if(stats.vertices == 0) return;
+            std::cout << "Created " << stats.meshes << " meshes (" << stats.vertices << " vertices): "
+                      << stats.fullBytes / 1024.0 << " KB -> " << stats.bytes / 1024.0 << " KB of vertex data, "
+                      << (double)stats.bytes / stats.vertices << " bytes per vertex, " << stats.elements * sizeof(GLuint) / 1024.0
+                      << " KB -> " << stats.elementBytes / 1024.0 << " KB of element data" << std::endl;
         }
 
         Mesh(Mesh const &) = delete;
@@ -0,0 +1,185 @@
+#include "vertex-packing.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace portal {
+
+    typedef glm::vec<2, int16_t, glm::defaultp> Short2;
+
+    // The largest error allowed for half float texture coordinates (half a texel of a 2048x2048 texture)
+    static const float maxTexCoordError = 1.0f / 4096.0f;
+
+    void VertexLayout::deserialize(const nlohmann::json& data){
+        if(data.is_string()){
+            std::string name = data.get<std::string>();
+            if(name == "packed") *this = packed();
+            else {
+                if(name != "full") std::cerr << "Unknown vertex layout: " << name << ", using full" << std::endl;
+                *this = full();
+            }
+            return;
+        }
+        if(!data.is_object()) return;
+        std::string positionName = data.value("position", "float");
+        position = positionName == "snorm16" ? Position::Snorm16 : positionName == "half" ? Position::Half : Position::Float;
+        normal = data.value("normal", "float") == "octahedral" ? Normal::Octahedral : Normal::Float;
+        texCoord = data.value("tex_coord", "float") == "half" ? TexCoord::Half : TexCoord::Float;
+        dropUniformColor = data.value("dropUniformColor", false);
+    }
+
+    static float signNotZero(float value){
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    static glm::vec3 decodeOctahedral(Short2 encoded){
+        glm::vec2 e = glm::vec2(encoded) / 32767.0f;
+        glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        if(n.z < 0.0f){
+            float x = n.x;
+            n.x = (1.0f - std::abs(n.y)) * signNotZero(x);
+            n.y = (1.0f - std::abs(x)) * signNotZero(n.y);
+        }
+        return glm::normalize(n);
+    }
+
+    // Projects the normal on an octahedron then unfolds it on a square
+    // Out of the 4 nearest quantized points, the one that decodes closest to the normal is picked
+    static Short2 encodeOctahedral(glm::vec3 normal){
+        float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if(length == 0.0f) return {0, 0};
+        glm::vec2 e = glm::vec2(normal.x, normal.y) / length;
+        if(normal.z < 0.0f){
+            glm::vec2 folded = glm::vec2((1.0f - std::abs(e.y)) * signNotZero(e.x), (1.0f - std::abs(e.x)) * signNotZero(e.y));
+            e = folded;
+        }
+        glm::vec2 scaled = glm::clamp(e, -1.0f, 1.0f) * 32767.0f;
+        glm::vec3 target = glm::normalize(normal);
+        Short2 best = {0, 0};
+        float bestDot = -2.0f;
+        for(int i = 0; i < 4; i++){
+            Short2 candidate = {
+                (int16_t)((i & 1) ? std::ceil(scaled.x) : std::floor(scaled.x)),
+                (int16_t)((i & 2) ? std::ceil(scaled.y) : std::floor(scaled.y))
+            };
+            float dot = glm::dot(decodeOctahedral(candidate), target);
+            if(dot > bestDot){
+                bestDot = dot;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    PackedVertices packVertices(const Vertex* vertices, size_t count, const VertexLayout& layout){
+        PackedVertices result;
+        result.count = count;
+        const Vertex* end = vertices + count;
+
+        // Check which attributes can actually be packed
+        bool keepColor = true;
+        if(layout.dropUniformColor && count > 0){
+            keepColor = std::any_of(vertices, end, [&](const Vertex& vertex){ return vertex.color != vertices[0].color; });
+            if(!keepColor) result.uniformColor = vertices[0].color;
+        }
+        bool halfTexCoord = layout.texCoord == VertexLayout::TexCoord::Half;
+        if(halfTexCoord){
+            for(const Vertex* vertex = vertices; vertex != end; vertex++){
+                for(int c = 0; c < 2; c++){
+                    float value = vertex->tex_coord[c];
+                    if(std::abs(glm::unpackHalf1x16(glm::packHalf1x16(value)) - value) > maxTexCoordError){
+                        halfTexCoord = false;
+                        break;
+                    }
+                }
+                if(!halfTexCoord) break;
+            }
+        }
+        glm::vec3 center = glm::vec3(0.0f);
+        float halfExtent = 1.0f;
+        if(layout.position == VertexLayout::Position::Snorm16 && count > 0){
+            glm::vec3 minimum = vertices[0].position, maximum = vertices[0].position;
+            for(const Vertex* vertex = vertices; vertex != end; vertex++){
+                minimum = glm::min(minimum, vertex->position);
+                maximum = glm::max(maximum, vertex->position);
+            }
+            center = (minimum + maximum) * 0.5f;
+            // The same scale is used on all the axes so the decoding doesn't change the direction of the normals
+            halfExtent = glm::max(glm::max(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z) * 0.5f;
+            if(halfExtent <= 0.0f) halfExtent = 1.0f;
+            result.positionDecode = glm::vec4(center, halfExtent / 32767.0f);
+        }
+
+        // Compute the offsets, every attribute is aligned to 4 bytes
+        GLuint offset = 0;
+        switch(layout.position){
+            case VertexLayout::Position::Float: result.position = {3, GL_FLOAT, GL_FALSE, offset}; offset += 12; break;
+            case VertexLayout::Position::Half: result.position = {3, GL_HALF_FLOAT, GL_FALSE, offset}; offset += 8; break;
+            case VertexLayout::Position::Snorm16: result.position = {3, GL_SHORT, GL_FALSE, offset}; offset += 8; break;
+        }
+        if(keepColor){
+            result.color = {4, GL_UNSIGNED_BYTE, GL_TRUE, offset};
+            offset += 4;
+        }
+        if(halfTexCoord){
+            result.texCoord = {2, GL_HALF_FLOAT, GL_FALSE, offset};
+            offset += 4;
+        } else {
+            result.texCoord = {2, GL_FLOAT, GL_FALSE, offset};
+            offset += 8;
+        }
+        if(layout.normal == VertexLayout::Normal::Octahedral){
+            result.normal = {2, GL_SHORT, GL_FALSE, offset};
+            result.normalDecode = 1.0f / 32767.0f;
+            offset += 4;
+        } else {
+            result.normal = {3, GL_FLOAT, GL_FALSE, offset};
+            offset += 12;
+        }
+        result.stride = (GLsizei)offset;
+
+        // The full layout has the same offsets as "Vertex" so the vertices can be uploaded as they are
+        static_assert(sizeof(Vertex) == 36, "The full vertex layout must match the memory layout of Vertex");
+        if(keepColor && result.stride == (GLsizei)sizeof(Vertex) && layout.position == VertexLayout::Position::Float){
+            result.external = (const uint8_t*)vertices;
+            return result;
+        }
+
+        // Otherwise write the vertices
+        result.data.resize(count * result.stride);
+        for(size_t i = 0; i < count; i++){
+            const Vertex& vertex = vertices[i];
+            uint8_t* out = result.data.data() + i * result.stride;
+            if(layout.position == VertexLayout::Position::Float){
+                std::memcpy(out + result.position.offset, &vertex.position, 12);
+            } else if(layout.position == VertexLayout::Position::Half){
+                uint16_t packed[4] = {glm::packHalf1x16(vertex.position.x), glm::packHalf1x16(vertex.position.y), glm::packHalf1x16(vertex.position.z), 0};
+                std::memcpy(out + result.position.offset, packed, 8);
+            } else {
+                glm::vec3 normalized = glm::clamp((vertex.position - center) / halfExtent, -1.0f, 1.0f);
+                int16_t packed[4] = {(int16_t)std::round(normalized.x * 32767.0f), (int16_t)std::round(normalized.y * 32767.0f),
+                                     (int16_t)std::round(normalized.z * 32767.0f), 0};
+                std::memcpy(out + result.position.offset, packed, 8);
+            }
+            if(keepColor) std::memcpy(out + result.color.offset, &vertex.color, 4);
+            if(halfTexCoord){
+                uint16_t packed[2] = {glm::packHalf1x16(vertex.tex_coord.x), glm::packHalf1x16(vertex.tex_coord.y)};
+                std::memcpy(out + result.texCoord.offset, packed, 4);
+            } else {
+                std::memcpy(out + result.texCoord.offset, &vertex.tex_coord, 8);
+            }
+            if(layout.normal == VertexLayout::Normal::Octahedral){
+                Short2 packed = encodeOctahedral(vertex.normal);
+                std::memcpy(out + result.normal.offset, &packed, 4);
+            } else {
+                std::memcpy(out + result.normal.offset, &vertex.normal, 12);
+            }
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <glad/gl.h>
+#include <json/json.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace portal {
+
+    // How each attribute of a vertex is stored in the vertex buffer
+    // The full layout matches "Vertex" (36 bytes), the packed layout takes 16 bytes (20 if the color is kept)
+    struct VertexLayout {
+        enum class Position {
+            Float,      // 3 floats
+            Half,       // 3 half floats
+            Snorm16     // 3 16-bit integers relative to the mesh bounds (decoded in the vertex shader)
+        };
+        enum class Normal {
+            Float,      // 3 floats
+            Octahedral  // 2 16-bit integers holding the octahedral encoding of the normal (decoded in the vertex shader)
+        };
+        enum class TexCoord {
+            Float,      // 2 floats
+            Half        // 2 half floats (falls back to floats if the coordinates are too large to be precise)
+        };
+        Position position = Position::Float;
+        Normal normal = Normal::Float;
+        TexCoord texCoord = TexCoord::Float;
+        // If true, the color attribute is dropped when all the vertices have the same color
+        // and this color is given to the shader as a constant attribute instead
+        bool dropUniformColor = false;
+
+        static VertexLayout full(){ return {}; }
+        static VertexLayout packed(){ return {Position::Snorm16, Normal::Octahedral, TexCoord::Half, true}; }
+
+        // Reads the layout from a json, it is either "full", "packed" or an object in the form:
+        // { "position": "float" | "half" | "snorm16", "normal": "float" | "octahedral", "tex_coord": "float" | "half", "dropUniformColor": true }
+        void deserialize(const nlohmann::json& data);
+    };
+
+    // The format of a single attribute in the packed vertex buffer
+    struct PackedAttribute {
+        GLint size = 0;         // The number of components (0 if the attribute is not stored)
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        GLuint offset = 0;
+    };
+
+    // The vertices converted to a vertex layout
+    struct PackedVertices {
+        std::vector<uint8_t> data;
+        // If not null, the vertices were already in the layout so they are read from here instead of "data"
+        // (the pointer is only valid as long as the vertices given to "packVertices")
+        const uint8_t* external = nullptr;
+        size_t count = 0;
+        GLsizei stride = 0;
+        PackedAttribute position, color, texCoord, normal;
+        // The vertex shader computes "position_decode.xyz + position_decode.w * position"
+        glm::vec4 positionDecode = {0.0f, 0.0f, 0.0f, 1.0f};
+        // If not 0, the normal is octahedral encoded and is multiplied by this value before being decoded
+        float normalDecode = 0.0f;
+        // The color of every vertex if the color attribute was dropped
+        Color uniformColor = {255, 255, 255, 255};
+
+        const uint8_t* getData() const { return external ? external : data.data(); }
+        size_t getSize() const { return count * stride; }
+    };
+
+    // Converts the vertices to the given layout
+    // The full layout is the memory layout of "Vertex" so the vertices are not copied in that case
+    PackedVertices packVertices(const Vertex* vertices, size_t count, const VertexLayout& layout);
+    inline PackedVertices packVertices(const std::vector<Vertex>& vertices, const VertexLayout& layout){
+        return packVertices(vertices.data(), vertices.size(), layout);
+    }
+
+}
@@ -28,8 +28,9 @@ namespace portal {
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
 namespace std {
-    //A Simple method to combine two hash values
-    inline size_t hash_combine(size_t h1, size_t h2){ return h1 ^ (h2 << 1); }
+    //A method to combine two hash values (the same mixing as boost::hash_combine)
+    //XOR with a shift maps many different vertices to the same hash since their components are often equal
+    inline size_t hash_combine(size_t h1, size_t h2){ return h1 ^ (h2 + 0x9e3779b97f4a7c15ull + (h1 << 6) + (h1 >> 2)); }
 
     //A Hash function for struct Vertex
     template<> struct hash<portal::Vertex> {
@@ -12,20 +12,14 @@ namespace portal {
         
         // Load the pause menu material
         pauseMaterial = new TexturedMaterial();
-        pauseMaterial->shader = new ShaderProgram();
-        pauseMaterial->shader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
-        pauseMaterial->shader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-        pauseMaterial->shader->link();
+        pauseMaterial->shader = ShaderCache::get("assets/shaders/textured.vert", "assets/shaders/textured.frag");
         pauseMaterial->texture = texture_utils::loadImage("assets/textures/pause_menu.png");
         pauseMaterial->tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
         pauseMaterial->pipelineState.blending.enabled = true;
 
         // Load the options menu material
         optionsMaterial = new TexturedMaterial();
-        optionsMaterial->shader = new ShaderProgram();
-        optionsMaterial->shader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
-        optionsMaterial->shader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-        optionsMaterial->shader->link();
+        optionsMaterial->shader = ShaderCache::get("assets/shaders/textured.vert", "assets/shaders/textured.frag");
         optionsMaterial->texture = texture_utils::loadImage("assets/textures/options_menu.png");
         optionsMaterial->tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
         optionsMaterial->pipelineState.blending.enabled = true;
@@ -33,10 +27,7 @@ namespace portal {
         // create a material to highlight the hovered buttons
         highlightMaterial = new portal::TintedMaterial();
         // Since the highlight is not textured, we used the tinted material shaders
-        highlightMaterial->shader = new portal::ShaderProgram();
-        highlightMaterial->shader->attach("assets/shaders/tinted.vert", GL_VERTEX_SHADER);
-        highlightMaterial->shader->attach("assets/shaders/tinted.frag", GL_FRAGMENT_SHADER);
-        highlightMaterial->shader->link();
+        highlightMaterial->shader = ShaderCache::get("assets/shaders/tinted.vert", "assets/shaders/tinted.frag");
         // The tint is white since we will subtract the background color from it to create a negative effect.
         highlightMaterial->tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
         // To create a negative effect, we enable blending, set the equation to be subtract,
@@ -168,9 +159,7 @@ namespace portal {
         // Delete all the allocated resources
         delete rectangle;
         delete pauseMaterial->texture;
-        delete pauseMaterial->shader;
         delete pauseMaterial;
-        delete optionsMaterial->shader;
         delete optionsMaterial;
         pauseButtons.clear();
         optionsButtons.clear();
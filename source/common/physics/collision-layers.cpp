@@ -0,0 +1,73 @@
+#include "collision-layers.hpp"
+
+#include <iostream>
+
+namespace portal {
+
+    CollisionLayers::CollisionLayers(){
+        // Parsed since the initializer lists of nlohmann::json turn a list of string pairs into an object
+        deserialize(nlohmann::json::parse(R"({
+            "layers": ["Default", "Static", "Trigger", "Held"],
+            "ignore": [["Static", "Static"], ["Trigger", "Static"], ["Trigger", "Trigger"], ["Held", "*"]]
+        })"));
+    }
+
+    void CollisionLayers::deserialize(const nlohmann::json& data){
+        if(!data.is_object() || !data.contains("layers")) return;
+        names.clear();
+        for(auto& name : data["layers"]){
+            if(names.size() == MaxLayers){
+                std::cerr << "Only " << MaxLayers << " collision layers are supported, ignoring: " << name.get<std::string>() << std::endl;
+                continue;
+            }
+            names.push_back(name.get<std::string>());
+        }
+        // Every pair of layers interacts unless it is ignored
+        uint16_t all = (uint16_t)((1u << names.size()) - 1);
+        for(size_t layer = 0; layer < MaxLayers; layer++) masks[layer] = layer < names.size() ? all : 0;
+        for(auto& pair : data.value("ignore", nlohmann::json::array())){
+            if(!pair.is_array() || pair.size() != 2) continue;
+            auto getLayerBits = [&](const std::string& name) -> uint16_t {
+                if(name == "*") return all;
+                int index = getIndex(name);
+                if(index < 0) std::cerr << "Unknown collision layer: " << name << std::endl;
+                return index < 0 ? 0 : (uint16_t)(1u << index);
+            };
+            uint16_t first = getLayerBits(pair[0].get<std::string>()), second = getLayerBits(pair[1].get<std::string>());
+            // The matrix is symmetric
+            for(size_t layer = 0; layer < names.size(); layer++){
+                if(first & (1u << layer)) masks[layer] &= ~second;
+                if(second & (1u << layer)) masks[layer] &= ~first;
+            }
+        }
+    }
+
+    int CollisionLayers::getIndex(const std::string& name) const {
+        for(size_t index = 0; index < names.size(); index++){
+            if(names[index] == name) return (int)index;
+        }
+        return -1;
+    }
+
+    uint16_t CollisionLayers::getBits(std::initializer_list<const char*> layers) const {
+        uint16_t bits = 0;
+        for(const char* layer : layers){
+            int index = getIndex(layer);
+            if(index >= 0) bits |= (uint16_t)(1u << index);
+        }
+        return bits;
+    }
+
+    uint16_t CollisionLayers::getBitsExcept(std::initializer_list<const char*> layers) const {
+        return (uint16_t)~getBits(layers);
+    }
+
+    bool CollisionLayers::apply(r3d::Collider* collider, const std::string& layer) const {
+        int index = getIndex(layer);
+        if(index < 0) return false;
+        collider->setCollisionCategoryBits((unsigned short)(1u << index));
+        collider->setCollideWithMaskBits(masks[index]);
+        return true;
+    }
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <reactphysics3d/reactphysics3d.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+namespace r3d = reactphysics3d;
+
+namespace portal {
+
+    // The named collision layers of a physics world and which pairs of layers interact
+    // Each layer is a category bit of reactphysics3d and its mask holds the layers it interacts with,
+    // so the pairs of layers that don't interact are pruned by the broad phase (they never reach the narrow phase or the callbacks)
+    class CollisionLayers {
+    public:
+        // reactphysics3d has 16 category bits
+        static constexpr size_t MaxLayers = 16;
+    private:
+        std::vector<std::string> names;
+        // The layers each layer interacts with (a bit for each layer)
+        uint16_t masks[MaxLayers] = {};
+    public:
+        // The layers used when the physics world doesn't declare its own:
+        // - "Default": the moving bodies
+        // - "Static": the static bodies (they don't interact with each other)
+        // - "Trigger": the trigger colliders (they only interact with the moving bodies)
+        // - "Held": the objects held by the player (they interact with nothing)
+        CollisionLayers();
+
+        // Reads the layers from a json object in the form:
+        // {"layers": ["Default", "Static", ...], "ignore": [["Static", "Static"], ["Held", "*"], ...]}
+        // where every pair of layers interacts unless it is ignored ("*" stands for all the layers)
+        void deserialize(const nlohmann::json& data);
+
+        // Returns the index of the layer with the given name (-1 if there is none)
+        int getIndex(const std::string& name) const;
+        const std::string& getName(int index) const { return names[index]; }
+        size_t getCount() const { return names.size(); }
+
+        // Returns the category bits of the given layers (0 for the unknown names)
+        uint16_t getBits(std::initializer_list<const char*> layers) const;
+        // Returns the category bits of all the layers except the given ones (e.g. the filter of a raycast)
+        uint16_t getBitsExcept(std::initializer_list<const char*> layers) const;
+
+        // Puts the collider on the layer (its category bit and the mask of the layers it interacts with)
+        // Returns false if there is no layer with this name (the collider is left as is)
+        bool apply(r3d::Collider* collider, const std::string& layer) const;
+    };
+
+}
@@ -0,0 +1,205 @@
+#include "scene-query.hpp"
+#include "../ecs/world.hpp"
+#include "../components/RigidBody.hpp"
+
+#include <algorithm>
+
+namespace portal {
+
+    // Collects the hits of a raycast according to the mode of the query
+    class RaycastCollector : public r3d::RaycastCallback {
+        SceneQuery::RaycastMode mode;
+        const QueryFilter& filter;
+        std::vector<QueryHit>& hits;
+    public:
+        RaycastCollector(SceneQuery::RaycastMode mode, const QueryFilter& filter, std::vector<QueryHit>& hits)
+            : mode(mode), filter(filter), hits(hits) {}
+
+        virtual r3d::decimal notifyRaycastHit(const r3d::RaycastInfo& raycastInfo) override {
+            // -1 skips the collider and continues the raycast
+            if(raycastInfo.body == filter.ignoredBody || !RigidBodyComponent::getEntity(raycastInfo.body)) return r3d::decimal(-1.0);
+            if(!filter.includeTriggers && raycastInfo.collider->getIsTrigger()) return r3d::decimal(-1.0);
+            QueryHit hit;
+            hit.entity = RigidBodyComponent::getEntity(raycastInfo.body);
+            hit.collider = raycastInfo.collider;
+            hit.point = glm::vec3(raycastInfo.worldPoint.x, raycastInfo.worldPoint.y, raycastInfo.worldPoint.z);
+            hit.normal = glm::vec3(raycastInfo.worldNormal.x, raycastInfo.worldNormal.y, raycastInfo.worldNormal.z);
+            hit.fraction = (float)raycastInfo.hitFraction;
+            switch(mode) {
+                case SceneQuery::RaycastMode::Closest:
+                    // Returning the fraction clips the ray so only the closer hits are reported next
+                    if(hits.empty()) hits.push_back(hit);
+                    else if(hit.fraction < hits[0].fraction) hits[0] = hit;
+                    return raycastInfo.hitFraction;
+                case SceneQuery::RaycastMode::Any:
+                    hits.push_back(hit);
+                    return r3d::decimal(0.0);
+                default:
+                    hits.push_back(hit);
+                    return r3d::decimal(1.0);
+            }
+        }
+    };
+
+    // Collects the entities overlapping a probe
+    class ProbeOverlapCollector : public r3d::OverlapCallback {
+        const r3d::CollisionBody* probe;
+        const QueryFilter& filter;
+        std::vector<Entity*>& entities;
+        size_t first;
+    public:
+        ProbeOverlapCollector(const r3d::CollisionBody* probe, const QueryFilter& filter, std::vector<Entity*>& entities)
+            : probe(probe), filter(filter), entities(entities), first(entities.size()) {}
+
+        virtual void onOverlap(CallbackData& callbackData) override {
+            for(uint32_t p = 0; p < callbackData.getNbOverlappingPairs(); p++) {
+                OverlapPair pair = callbackData.getOverlappingPair(p);
+                bool isFirst = pair.getBody1() == probe;
+                const r3d::CollisionBody* body = isFirst ? pair.getBody2() : pair.getBody1();
+                const r3d::Collider* collider = isFirst ? pair.getCollider2() : pair.getCollider1();
+                Entity* entity = RigidBodyComponent::getEntity(body);
+                // Skip the other probes
+                if(!entity || body == filter.ignoredBody) continue;
+                if(!filter.includeTriggers && collider->getIsTrigger()) continue;
+                if(std::find(entities.begin() + first, entities.end(), entity) == entities.end()) entities.push_back(entity);
+            }
+        }
+    };
+
+    void SceneQuery::runRaycast(const glm::vec3& from, const glm::vec3& to, RaycastMode mode, const QueryFilter& filter) {
+        raycastHits.clear();
+        r3d::PhysicsWorld* physicsWorld = world->getPhysicsWorld();
+        if(!physicsWorld || from == to) return;
+        RaycastCollector collector(mode, filter, raycastHits);
+        r3d::Ray ray(r3d::Vector3(from.x, from.y, from.z), r3d::Vector3(to.x, to.y, to.z));
+        // The layers are filtered by the broad phase, the colliders of the other layers are never tested
+        physicsWorld->raycast(ray, &collector, filter.layers);
+    }
+
+    bool SceneQuery::raycastClosest(const glm::vec3& from, const glm::vec3& to, QueryHit& hit, const QueryFilter& filter) {
+        runRaycast(from, to, RaycastMode::Closest, filter);
+        if(raycastHits.empty()) return false;
+        hit = raycastHits[0];
+        return true;
+    }
+
+    bool SceneQuery::raycastAny(const glm::vec3& from, const glm::vec3& to, const QueryFilter& filter, QueryHit* hit) {
+        runRaycast(from, to, RaycastMode::Any, filter);
+        if(raycastHits.empty()) return false;
+        if(hit) *hit = raycastHits[0];
+        return true;
+    }
+
+    const std::vector<QueryHit>& SceneQuery::raycastAll(const glm::vec3& from, const glm::vec3& to, const QueryFilter& filter) {
+        runRaycast(from, to, RaycastMode::All, filter);
+        std::sort(raycastHits.begin(), raycastHits.end(), [](const QueryHit& first, const QueryHit& second){
+            return first.fraction < second.fraction;
+        });
+        return raycastHits;
+    }
+
+    SceneQuery::OverlapProbe& SceneQuery::getProbe(size_t index) {
+        while(probes.size() <= index) {
+            r3d::PhysicsCommon& physicsCommon = world->getPhysicsCommon();
+            OverlapProbe probe;
+            probe.body = world->getPhysicsWorld()->createCollisionBody(r3d::Transform::identity());
+            // The shapes are resized for each query, so they are not shared through the shape library
+            probe.sphereShape = physicsCommon.createSphereShape(1.0f);
+            probe.boxShape = physicsCommon.createBoxShape(r3d::Vector3(1.0f, 1.0f, 1.0f));
+            probe.sphere = probe.body->addCollider(probe.sphereShape, r3d::Transform::identity());
+            probe.box = probe.body->addCollider(probe.boxShape, r3d::Transform::identity());
+            // The probes are in every category so the layers in their mask always see them
+            probe.sphere->setCollisionCategoryBits(0xFFFF);
+            probe.box->setCollisionCategoryBits(0xFFFF);
+            probe.body->setIsActive(false);
+            probes.push_back(probe);
+        }
+        return probes[index];
+    }
+
+    void SceneQuery::reset() {
+        r3d::PhysicsWorld* physicsWorld = world->getPhysicsWorld();
+        r3d::PhysicsCommon& physicsCommon = world->getPhysicsCommon();
+        for(auto& probe : probes) {
+            // The colliders are removed with the body before their shapes are destroyed
+            if(physicsWorld) physicsWorld->destroyCollisionBody(probe.body);
+            physicsCommon.destroySphereShape(probe.sphereShape);
+            physicsCommon.destroyBoxShape(probe.boxShape);
+        }
+        probes.clear();
+        overlaps.clear();
+        overlapEntities.clear();
+        raycastHits.clear();
+        flushed = false;
+    }
+
+    SceneQuery::QueryId SceneQuery::queueOverlap(const OverlapQuery& query) {
+        if(flushed) {
+            overlaps.clear();
+            overlapEntities.clear();
+            flushed = false;
+        }
+        overlaps.push_back(query);
+        return (QueryId)(overlaps.size() - 1);
+    }
+
+    SceneQuery::QueryId SceneQuery::queueOverlapSphere(const glm::vec3& center, float radius, const QueryFilter& filter) {
+        return queueOverlap({true, center, glm::vec3(radius), glm::quat(1, 0, 0, 0), filter});
+    }
+
+    SceneQuery::QueryId SceneQuery::queueOverlapBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::quat& rotation,
+                                                    const QueryFilter& filter) {
+        return queueOverlap({false, center, halfExtents, rotation, filter});
+    }
+
+    void SceneQuery::flush() {
+        if(flushed) return;
+        flushed = true;
+        r3d::PhysicsWorld* physicsWorld = world->getPhysicsWorld();
+        if(!physicsWorld) return;
+        // Place every probe first, so the first test updates the broad phase for all of them at once
+        // and the next tests only read the pairs it found
+        for(size_t q = 0; q < overlaps.size(); q++) {
+            const OverlapQuery& query = overlaps[q];
+            OverlapProbe& probe = getProbe(q);
+            if(query.isSphere) probe.sphereShape->setRadius(query.halfExtents.x);
+            else probe.boxShape->setHalfExtents(r3d::Vector3(query.halfExtents.x, query.halfExtents.y, query.halfExtents.z));
+            probe.sphere->setCollideWithMaskBits(query.isSphere ? query.filter.layers : 0);
+            probe.box->setCollideWithMaskBits(query.isSphere ? 0 : query.filter.layers);
+            r3d::Quaternion rotation(query.rotation.x, query.rotation.y, query.rotation.z, query.rotation.w);
+            probe.body->setTransform(r3d::Transform(r3d::Vector3(query.center.x, query.center.y, query.center.z), rotation));
+            probe.body->setIsActive(true);
+        }
+        for(size_t q = 0; q < overlaps.size(); q++) {
+            OverlapQuery& query = overlaps[q];
+            query.first = (uint32_t)overlapEntities.size();
+            ProbeOverlapCollector collector(probes[q].body, query.filter, overlapEntities);
+            physicsWorld->testOverlap(probes[q].body, collector);
+            query.count = (uint32_t)(overlapEntities.size() - query.first);
+        }
+        for(size_t q = 0; q < overlaps.size(); q++) probes[q].body->setIsActive(false);
+    }
+
+    std::vector<Entity*> SceneQuery::getOverlaps(QueryId id) const {
+        if(id >= overlaps.size()) return {};
+        const OverlapQuery& query = overlaps[id];
+        return std::vector<Entity*>(overlapEntities.begin() + query.first, overlapEntities.begin() + query.first + query.count);
+    }
+
+    std::vector<Entity*> SceneQuery::overlapSphere(const glm::vec3& center, float radius, const QueryFilter& filter) {
+        // A pending batch is run first since the new query would otherwise start it over
+        flush();
+        QueryId id = queueOverlapSphere(center, radius, filter);
+        flush();
+        return getOverlaps(id);
+    }
+
+    std::vector<Entity*> SceneQuery::overlapBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::quat& rotation,
+                                                const QueryFilter& filter) {
+        flush();
+        QueryId id = queueOverlapBox(center, halfExtents, rotation, filter);
+        flush();
+        return getOverlaps(id);
+    }
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <reactphysics3d/reactphysics3d.h>
+
+#include <cstdint>
+#include <vector>
+namespace r3d = reactphysics3d;
+
+namespace portal {
+
+    class Entity;
+    class World;
+
+    // Selects what a scene query can hit
+    struct QueryFilter {
+        // The collision layers to hit (see "CollisionLayers::getBits"), all of them by default
+        uint16_t layers = 0xFFFF;
+        // The colliders that are triggers at the time of the query are skipped unless this is set
+        // (the layers can't tell since colliders become triggers while passing through a portal)
+        bool includeTriggers = false;
+        // A body to skip (e.g. the body the query starts from)
+        const r3d::CollisionBody* ignoredBody = nullptr;
+    };
+
+    // A collider hit by a raycast
+    struct QueryHit {
+        Entity* entity = nullptr;
+        r3d::Collider* collider = nullptr;
+        glm::vec3 point = glm::vec3(0.0f);
+        glm::vec3 normal = glm::vec3(0.0f);
+        // The distance from the start of the ray as a fraction of its length
+        float fraction = 1.0f;
+    };
+
+    // This class answers the raycasts and overlap queries of the game logic against the physics world
+    // The callbacks live on the stack (nothing is allocated per query) and the hits are written to reused arrays
+    // The overlaps can be queued then run by "flush": every queued probe is moved into the broad phase first,
+    // so a single broad phase update finds the candidates of all of them
+    class SceneQuery {
+    public:
+        enum class RaycastMode { Closest, Any, All };
+        using QueryId = uint32_t;
+    private:
+        // A body with a sphere and a box collider placed on the queried volume (the unused collider gets no mask)
+        // The probes are disabled outside of "flush" so the simulation never sees them
+        struct OverlapProbe {
+            r3d::CollisionBody* body = nullptr;
+            r3d::SphereShape* sphereShape = nullptr;
+            r3d::BoxShape* boxShape = nullptr;
+            r3d::Collider* sphere = nullptr;
+            r3d::Collider* box = nullptr;
+        };
+        struct OverlapQuery {
+            bool isSphere;
+            glm::vec3 center;
+            glm::vec3 halfExtents;
+            glm::quat rotation;
+            QueryFilter filter;
+            // The range of the result in "overlapEntities"
+            uint32_t first = 0, count = 0;
+        };
+
+        World* world;
+        std::vector<OverlapProbe> probes;
+        std::vector<OverlapQuery> overlaps;
+        std::vector<Entity*> overlapEntities;
+        std::vector<QueryHit> raycastHits;
+        // Set by "flush", the next queued query starts a new batch
+        bool flushed = false;
+
+        OverlapProbe& getProbe(size_t index);
+        QueryId queueOverlap(const OverlapQuery& query);
+        void runRaycast(const glm::vec3& from, const glm::vec3& to, RaycastMode mode, const QueryFilter& filter);
+    public:
+        explicit SceneQuery(World* world) : world(world) {}
+
+        // Casts a ray from "from" to "to", returns true if it hit something (the closest hit is written to "hit")
+        bool raycastClosest(const glm::vec3& from, const glm::vec3& to, QueryHit& hit, const QueryFilter& filter = {});
+        // Same as "raycastClosest" but stops at the first hit found, which is not the closest one (e.g. to check for ground)
+        bool raycastAny(const glm::vec3& from, const glm::vec3& to, const QueryFilter& filter = {}, QueryHit* hit = nullptr);
+        // Returns every hit sorted by distance (the array is reused by the next raycast)
+        const std::vector<QueryHit>& raycastAll(const glm::vec3& from, const glm::vec3& to, const QueryFilter& filter = {});
+
+        // Queues an overlap query, the result is available through "getOverlaps" after "flush"
+        QueryId queueOverlapSphere(const glm::vec3& center, float radius, const QueryFilter& filter = {});
+        QueryId queueOverlapBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::quat& rotation = glm::quat(1, 0, 0, 0),
+                                const QueryFilter& filter = {});
+        // Runs the queued overlap queries together
+        void flush();
+        // Returns the entities overlapping the volume of the query (each entity once)
+        // The ids of a flushed batch are valid until the next query is queued (which starts a new batch)
+        std::vector<Entity*> getOverlaps(QueryId id) const;
+
+        // Queue and flush a single overlap query
+        std::vector<Entity*> overlapSphere(const glm::vec3& center, float radius, const QueryFilter& filter = {});
+        std::vector<Entity*> overlapBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::quat& rotation = glm::quat(1, 0, 0, 0),
+                                        const QueryFilter& filter = {});
+
+        // Destroys the probes and drops the queued queries, called before the world replaces its physics world
+        // (the probes are created again in the new one when they are needed)
+        void reset();
+
+        // The probes belong to the physics world of the world, which destroys them
+        SceneQuery(const SceneQuery&) = delete;
+        SceneQuery& operator=(const SceneQuery&) = delete;
+    };
+
+}
@@ -0,0 +1,156 @@
+#include "shape-library.hpp"
+
+#include <iostream>
+
+namespace portal {
+
+    ShapeLibrary::CookedMesh* ShapeLibrary::getMesh(const std::string& path, CookedCollider::Kind kind){
+        auto& slot = meshes[{path, kind}];
+        if(slot) return slot.get();
+        auto mesh = std::make_unique<CookedMesh>();
+        if(!collider_cooker::cook(path, kind, mesh->geometry)){
+            meshes.erase({path, kind});
+            return nullptr;
+        }
+        const CookedCollider& geometry = mesh->geometry;
+        if(kind == CookedCollider::Kind::ConvexHull){
+            mesh->faces.resize(geometry.faceCount);
+            for(size_t f = 0; f < geometry.faceCount; f++){
+                mesh->faces[f].nbVertices = geometry.faces[2 * f];
+                mesh->faces[f].indexBase = geometry.faces[2 * f + 1];
+            }
+            mesh->polygonArray = std::make_unique<r3d::PolygonVertexArray>(
+                (uint32_t)geometry.vertexCount, geometry.vertices, (uint32_t)sizeof(glm::vec3),
+                geometry.indices, (uint32_t)sizeof(uint32_t), (uint32_t)geometry.faceCount, mesh->faces.data(),
+                r3d::PolygonVertexArray::VertexDataType::VERTEX_FLOAT_TYPE, r3d::PolygonVertexArray::IndexDataType::INDEX_INTEGER_TYPE);
+            mesh->polyhedronMesh = physicsCommon.createPolyhedronMesh(mesh->polygonArray.get());
+            if(!mesh->polyhedronMesh){
+                std::cerr << "The convex hull of the mesh is invalid: " << path << std::endl;
+                meshes.erase({path, kind});
+                return nullptr;
+            }
+        } else {
+            // The normals are computed by reactphysics3d from the triangles
+            mesh->triangleArray = std::make_unique<r3d::TriangleVertexArray>(
+                (uint32_t)geometry.vertexCount, geometry.vertices, (uint32_t)sizeof(glm::vec3),
+                (uint32_t)(geometry.indexCount / 3), geometry.indices, (uint32_t)(3 * sizeof(uint32_t)),
+                r3d::TriangleVertexArray::VertexDataType::VERTEX_FLOAT_TYPE, r3d::TriangleVertexArray::IndexDataType::INDEX_INTEGER_TYPE);
+            mesh->triangleMesh = physicsCommon.createTriangleMesh();
+            mesh->triangleMesh->addSubpart(mesh->triangleArray.get());
+        }
+        slot = std::move(mesh);
+        return slot.get();
+    }
+
+    r3d::BoxShape* ShapeLibrary::getBox(const glm::vec3& halfExtents){
+        return (r3d::BoxShape*)intern({Kind::Box, halfExtents.x, halfExtents.y, halfExtents.z, ""}, [&](){
+            return physicsCommon.createBoxShape(r3d::Vector3(halfExtents.x, halfExtents.y, halfExtents.z));
+        });
+    }
+
+    r3d::SphereShape* ShapeLibrary::getSphere(float radius){
+        return (r3d::SphereShape*)intern({Kind::Sphere, radius, 0.0f, 0.0f, ""}, [&](){
+            return physicsCommon.createSphereShape(radius);
+        });
+    }
+
+    r3d::CapsuleShape* ShapeLibrary::getCapsule(float radius, float height){
+        return (r3d::CapsuleShape*)intern({Kind::Capsule, radius, height, 0.0f, ""}, [&](){
+            return physicsCommon.createCapsuleShape(radius, height);
+        });
+    }
+
+    r3d::ConvexMeshShape* ShapeLibrary::getConvexMesh(const std::string& path, const glm::vec3& scaling){
+        return (r3d::ConvexMeshShape*)intern({Kind::ConvexMesh, scaling.x, scaling.y, scaling.z, path}, [&]() -> r3d::CollisionShape* {
+            CookedMesh* mesh = getMesh(path, CookedCollider::Kind::ConvexHull);
+            if(!mesh) return nullptr;
+            return physicsCommon.createConvexMeshShape(mesh->polyhedronMesh, r3d::Vector3(scaling.x, scaling.y, scaling.z));
+        });
+    }
+
+    r3d::ConcaveMeshShape* ShapeLibrary::getConcaveMesh(const std::string& path, const glm::vec3& scaling){
+        return (r3d::ConcaveMeshShape*)intern({Kind::ConcaveMesh, scaling.x, scaling.y, scaling.z, path}, [&]() -> r3d::CollisionShape* {
+            CookedMesh* mesh = getMesh(path, CookedCollider::Kind::TriangleMesh);
+            if(!mesh) return nullptr;
+            return physicsCommon.createConcaveMeshShape(mesh->triangleMesh, r3d::Vector3(scaling.x, scaling.y, scaling.z));
+        });
+    }
+
+    void ShapeLibrary::report(r3d::PhysicsWorld* physicsWorld) const {
+        size_t shapeCount = 0, users = 0, bytes = 0, unsharedBytes = 0;
+        for(auto& [key, shared] : shapes){
+            if(!shared.shape) continue;
+            // An estimate: the shape object and the cooked geometry of the mesh shapes (without sharing, each mesh collider
+            // would also have cooked its own geometry). The memory of the tree of a triangle mesh is not counted
+            Kind kind = std::get<0>(key);
+            size_t size = kind == Kind::Box ? sizeof(r3d::BoxShape) : kind == Kind::Sphere ? sizeof(r3d::SphereShape) :
+                          kind == Kind::Capsule ? sizeof(r3d::CapsuleShape) : kind == Kind::ConvexMesh ? sizeof(r3d::ConvexMeshShape) :
+                          sizeof(r3d::ConcaveMeshShape);
+            if(kind == Kind::ConvexMesh || kind == Kind::ConcaveMesh){
+                auto cookedKind = kind == Kind::ConvexMesh ? CookedCollider::Kind::ConvexHull : CookedCollider::Kind::TriangleMesh;
+                if(auto it = meshes.find({std::get<4>(key), cookedKind}); it != meshes.end()) size += it->second->geometry.getSizeInBytes();
+            }
+            shapeCount++;
+            users += shared.users;
+            bytes += size;
+            unsharedBytes += size * shared.users;
+        }
+        std::cout << "Collision shapes: " << users << " colliders share " << shapeCount << " shapes using "
+                  << bytes / 1024.0 << " KB (" << unsharedBytes / 1024.0 << " KB without sharing)" << std::endl;
+        if(!physicsWorld) return;
+
+        // The broad phase pairs the colliders of two bodies whose AABBs overlap unless both bodies are static
+        // or their collision bits filter them out (its AABBs are slightly fattened, so it may find a few more)
+        struct Entry { r3d::AABB aabb; const r3d::Collider* collider; const r3d::RigidBody* body; };
+        std::vector<Entry> entries;
+        for(uint32_t b = 0; b < physicsWorld->getNbRigidBodies(); b++){
+            const r3d::RigidBody* body = physicsWorld->getRigidBody(b);
+            for(uint32_t c = 0; c < body->getNbColliders(); c++){
+                const r3d::Collider* collider = body->getCollider(c);
+                entries.push_back({collider->getWorldAABB(), collider, body});
+            }
+        }
+        size_t pairs = 0;
+        for(size_t i = 0; i < entries.size(); i++){
+            for(size_t j = i + 1; j < entries.size(); j++){
+                const Entry& first = entries[i];
+                const Entry& second = entries[j];
+                if(first.body == second.body) continue;
+                if(first.body->getType() == r3d::BodyType::STATIC && second.body->getType() == r3d::BodyType::STATIC) continue;
+                if((first.collider->getCollisionCategoryBits() & second.collider->getCollideWithMaskBits()) == 0 ||
+                   (second.collider->getCollisionCategoryBits() & first.collider->getCollideWithMaskBits()) == 0) continue;
+                if(first.aabb.testCollision(second.aabb)) pairs++;
+            }
+        }
+        std::cout << "Broad phase: " << entries.size() << " colliders, " << pairs << " overlapping pairs" << std::endl;
+    }
+
+    void ShapeLibrary::release(const r3d::CollisionShape* shape){
+        if(auto it = entries.find(shape); it != entries.end() && it->second->users > 0) it->second->users--;
+    }
+
+    void ShapeLibrary::clear(){
+        for(auto& [key, shared] : shapes){
+            if(!shared.shape) continue;
+            switch(std::get<0>(key)){
+                case Kind::Box: physicsCommon.destroyBoxShape((r3d::BoxShape*)shared.shape); break;
+                case Kind::Sphere: physicsCommon.destroySphereShape((r3d::SphereShape*)shared.shape); break;
+                case Kind::Capsule: physicsCommon.destroyCapsuleShape((r3d::CapsuleShape*)shared.shape); break;
+                case Kind::ConvexMesh: physicsCommon.destroyConvexMeshShape((r3d::ConvexMeshShape*)shared.shape); break;
+                case Kind::ConcaveMesh: physicsCommon.destroyConcaveMeshShape((r3d::ConcaveMeshShape*)shared.shape); break;
+            }
+        }
+        for(auto& [key, mesh] : meshes){
+            if(mesh->polyhedronMesh) physicsCommon.destroyPolyhedronMesh(mesh->polyhedronMesh);
+            if(mesh->triangleMesh) physicsCommon.destroyTriangleMesh(mesh->triangleMesh);
+        }
+        shapes.clear();
+        entries.clear();
+        meshes.clear();
+    }
+
+    ShapeLibrary::~ShapeLibrary(){
+        clear();
+    }
+
+}
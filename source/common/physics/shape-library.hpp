@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../mesh/collider-cooker.hpp"
+
+#include <glm/glm.hpp>
+#include <reactphysics3d/reactphysics3d.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+namespace r3d = reactphysics3d;
+
+namespace portal {
+
+    // This class interns the collision shapes of a physics world: the colliders with the same shape parameters
+    // (e.g. the walls with the same half extents) share one shape instead of creating their own
+    // The mesh colliders are cooked from ".obj" files (see "collider_cooker::cook") once and shared by their scaling
+    class ShapeLibrary {
+    public:
+        enum class Kind : uint32_t { Box, Sphere, Capsule, ConvexMesh, ConcaveMesh };
+    private:
+        // The kind, the 3 parameters (half extents, radius and height or scaling) and the mesh path of a shape
+        using ShapeKey = std::tuple<Kind, float, float, float, std::string>;
+        struct SharedShape {
+            r3d::CollisionShape* shape = nullptr;
+            // The number of colliders using it (each would have created its own shape without the library)
+            size_t users = 0;
+        };
+        // The r3d meshes reference the cooked geometry so it lives as long as the library
+        struct CookedMesh {
+            CookedCollider geometry;
+            std::vector<r3d::PolygonVertexArray::PolygonFace> faces;
+            std::unique_ptr<r3d::PolygonVertexArray> polygonArray;
+            std::unique_ptr<r3d::TriangleVertexArray> triangleArray;
+            r3d::PolyhedronMesh* polyhedronMesh = nullptr;
+            r3d::TriangleMesh* triangleMesh = nullptr;
+        };
+
+        r3d::PhysicsCommon& physicsCommon;
+        std::map<ShapeKey, SharedShape> shapes;
+        // The entry of each created shape (to find it when a collider releases it)
+        std::unordered_map<const r3d::CollisionShape*, SharedShape*> entries;
+        std::map<std::pair<std::string, CookedCollider::Kind>, std::unique_ptr<CookedMesh>> meshes;
+
+        // Returns the cooked mesh of the ".obj" file (nullptr if it couldn't be cooked)
+        CookedMesh* getMesh(const std::string& path, CookedCollider::Kind kind);
+        // Returns the shared shape of the key, "create" is called if it doesn't exist yet
+        template<typename Create>
+        r3d::CollisionShape* intern(const ShapeKey& key, Create create){
+            SharedShape& shared = shapes[key];
+            if(!shared.shape){
+                shared.shape = create();
+                if(shared.shape) entries[shared.shape] = &shared;
+            }
+            if(shared.shape) shared.users++;
+            return shared.shape;
+        }
+    public:
+        explicit ShapeLibrary(r3d::PhysicsCommon& physicsCommon) : physicsCommon(physicsCommon) {}
+
+        r3d::BoxShape* getBox(const glm::vec3& halfExtents);
+        r3d::SphereShape* getSphere(float radius);
+        r3d::CapsuleShape* getCapsule(float radius, float height);
+        // The convex hull of the mesh (nullptr if the mesh is flat or can't be loaded)
+        r3d::ConvexMeshShape* getConvexMesh(const std::string& path, const glm::vec3& scaling = glm::vec3(1.0f));
+        // The triangles of the mesh, only the static bodies can use it (nullptr if the mesh can't be loaded)
+        r3d::ConcaveMeshShape* getConcaveMesh(const std::string& path, const glm::vec3& scaling = glm::vec3(1.0f));
+
+        // Called when a collider using the shape is destroyed, the shape stays in the library until "clear"
+        // (e.g. for the colliders created again by the same scene)
+        void release(const r3d::CollisionShape* shape);
+        // Destroys all the shapes and cooked meshes, no collider may use them anymore
+        // (called when the physics world of the previous scene is replaced)
+        void clear();
+
+        // Prints the number of shapes, their memory (and the memory without sharing) and the number of pairs
+        // of colliders whose world AABBs overlap in the physics world (the pairs tested by the narrow phase)
+        // Every pair of colliders is tested, so it is only called when "reportPhysics" is set in the app config
+        void report(r3d::PhysicsWorld* physicsWorld) const;
+
+        // The shapes must not be used by a collider anymore (the physics worlds are destroyed first)
+        ~ShapeLibrary();
+
+        ShapeLibrary(const ShapeLibrary&) = delete;
+        ShapeLibrary& operator=(const ShapeLibrary&) = delete;
+    };
+
+}
@@ -0,0 +1,148 @@
+#include "scene-streamer.hpp"
+
+#include "shader/shader.hpp"
+#include "texture/texture2d.hpp"
+#include "texture/sampler.hpp"
+#include "texture/texture-array-pool.hpp"
+#include "mesh/mesh.hpp"
+#include "material/material.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <fstream>
+#include <iostream>
+
+namespace portal {
+
+    static void trackPeak(){
+        AssetMemory memory = getAssetMemory();
+        if(memory.cpu > SceneStreamer::peakMemory.cpu) SceneStreamer::peakMemory.cpu = memory.cpu;
+        if(memory.gpu > SceneStreamer::peakMemory.gpu) SceneStreamer::peakMemory.gpu = memory.gpu;
+    }
+
+    void SceneStreamer::start(){
+        if(stage != Stage::Idle || nextScenePath.empty()) return;
+        stage = Stage::Reading;
+        startTime = glfwGetTime();
+        frames = 0;
+        startMemory = peakMemory = getAssetMemory();
+        sceneRead = false;
+        uploads.bind();
+        // The scene file is read and parsed by a job (it holds the whole world of the scene)
+        JobSystem::run([path = nextScenePath](){
+            if(CompiledScene::isCompiled(path)){
+                auto compiled = std::make_shared<CompiledScene>();
+                if(!compiled->load(path)) return;
+                scene = compiled->getScene();
+                compiledScene = std::move(compiled);
+                sceneRead = scene.is_object();
+                return;
+            }
+            std::ifstream file(path);
+            if(!file){
+                std::cerr << "Couldn't open the next scene: " << path << std::endl;
+                return;
+            }
+            scene = nlohmann::json::parse(file, nullptr, false, true);
+            sceneRead = !scene.is_discarded() && scene.is_object();
+            if(!sceneRead) std::cerr << "Couldn't parse the next scene: " << path << std::endl;
+        }, &readJob);
+    }
+
+    void SceneStreamer::startLoading(){
+        stage = Stage::Loading;
+        const nlohmann::json& allAssets = scene.contains("assets") ? scene["assets"] : nlohmann::json::object();
+        // The assets loaded for the current scene are kept, the ones it loaded with another description are loaded when the scenes are swapped
+        if(compiledScene) assetData = filterLoadedAssets(compiledScene->referencedAssets);
+        else assetData = filterLoadedAssets(scene.contains("world") ? filterReferencedAssets(allAssets, scene["world"]) : allAssets);
+        nextLayout = VertexLayout::full();
+        if(assetData.contains("vertexLayout")) nextLayout.deserialize(assetData["vertexLayout"]);
+        staging = std::make_unique<StagingRing>();
+        // Same as "deserializeAllAssets" except that all the uploads are run by the main thread, the materials are
+        // created once the assets they use are loaded
+        if(assetData.contains("shaders"))
+            AssetLoader<ShaderProgram>::deserializeInJobs(assetData["shaders"], uploads, jobs);
+        if(assetData.contains("textures"))
+            AssetLoader<Texture2D>::deserializeInJobs(assetData["textures"], uploads, jobs);
+        if(assetData.contains("meshes"))
+            deserializeMeshesInJobs(assetData["meshes"], nextLayout, uploads, jobs);
+        if(assetData.contains("models"))
+            AssetLoader<nlohmann::json>::deserializeInJobs(assetData["models"], uploads, jobs);
+        if(assetData.contains("samplers"))
+            AssetLoader<Sampler>::deserialize(assetData["samplers"]);
+    }
+
+    void SceneStreamer::queueMaterials(){
+        stage = Stage::Finishing;
+        if(!assetData.contains("materials")) return;
+        for(auto& [name, desc] : assetData["materials"].items()){
+            nlohmann::json material = nlohmann::json::object();
+            material[name] = desc;
+            uploads.defer([material](){ AssetLoader<Material>::deserialize(material); });
+        }
+        // Packing needs all the materials, its copies are deferred in turn (see "TextureArrayPool::build")
+        uploads.defer([](){ TextureArrayPool::build(&uploads); });
+    }
+
+    void SceneStreamer::finishLoading(){
+        AssetLoader<Texture2D>::remeasure();
+        ShaderProgram::clearPreloadedSources();
+        stage = Stage::Ready;
+    }
+
+    void SceneStreamer::update(){
+        if(!isStreaming()) return;
+        frames++;
+        if(stage == Stage::Reading){
+            if(!readJob.isDone()) return;
+            if(!sceneRead){
+                stage = Stage::Idle;
+                return;
+            }
+            startLoading();
+        }
+        // Check the jobs first, the uploads pushed before the last job was done are drained below
+        bool done = jobs.isDone();
+        setTextureStaging(staging.get());
+        size_t count = uploads.drain(frameBudget);
+        setTextureStaging(nullptr);
+        trackPeak();
+        if(!done || count > 0) return;
+        // The materials are queued once everything they use is loaded, the preload is done once they are all created
+        if(stage == Stage::Loading) queueMaterials();
+        else finishLoading();
+    }
+
+    nlohmann::json SceneStreamer::take(std::shared_ptr<CompiledScene>& compiled){
+        compiled = nullptr;
+        if(stage != Stage::Ready) return nlohmann::json();
+        uploads.finish();
+        staging.reset();
+        trackPeak();
+        std::cout << "Preloaded the next scene in " << (glfwGetTime() - startTime) * 1000.0 << " ms over " << frames << " frames ("
+                  << uploads.milliseconds << " ms of uploads), the assets used up to " << peakMemory.cpu / (1024.0 * 1024.0) << " MB of RAM and "
+                  << peakMemory.gpu / (1024.0 * 1024.0) << " MB of VRAM (" << startMemory.cpu / (1024.0 * 1024.0) << " MB and "
+                  << startMemory.gpu / (1024.0 * 1024.0) << " MB before the preload)" << std::endl;
+        uploads.milliseconds = 0;
+        stage = Stage::Idle;
+        assetData = nlohmann::json();
+        compiled = std::move(compiledScene);
+        return std::move(scene);
+    }
+
+    void SceneStreamer::cancel(){
+        if(stage == Stage::Idle) return;
+        JobSystem::wait(readJob);
+        setTextureStaging(staging.get());
+        uploads.drainUntil(jobs);
+        setTextureStaging(nullptr);
+        uploads.finish();
+        staging.reset();
+        ShaderProgram::clearPreloadedSources();
+        stage = Stage::Idle;
+        assetData = nlohmann::json();
+        scene = nlohmann::json();
+        compiledScene.reset();
+    }
+
+}
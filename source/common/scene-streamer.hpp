@@ -0,0 +1,75 @@
+#pragma once
+
+#include "asset-loader.hpp"
+#include "compiled-scene.hpp"
+#include "job-system.hpp"
+#include "upload-queue.hpp"
+#include "mesh/vertex-packing.hpp"
+#include "texture/staging-ring.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace portal {
+
+    // This static class preloads the assets of the next scene while the current one is still played
+    // (it is started when the player enters the elevator, see "EventSystem::checkElevatorTrigger")
+    // The scene file is read and the assets are decoded by jobs, their uploads are run by the main thread
+    // for at most "frameBudget" milliseconds in each frame (see "update") so the game keeps running meanwhile.
+    // The materials are then created and their maps packed the same way, a few of them in each frame.
+    // Once it is ready, the next play state takes the scene (see "take") and keeps the preloaded assets
+    // (see "retainSharedAssets"), so it only has to build its world.
+    // Without worker threads, the jobs run when they are queued so most of the preload happens in the frame it starts.
+    class SceneStreamer {
+        // Finishing: the materials are created and their maps packed by uploads deferred to the queue
+        enum class Stage { Idle, Reading, Loading, Finishing, Ready };
+        static inline Stage stage = Stage::Idle;
+        // The path of the scene played after the current one (empty if there is none)
+        static inline std::string nextScenePath;
+        // The next scene and the part of its assets that is preloaded (the assets that are not loaded yet)
+        static inline nlohmann::json scene;
+        static inline nlohmann::json assetData;
+        // The compiled world of the next scene if its file is a compiled scene
+        static inline std::shared_ptr<CompiledScene> compiledScene;
+        // The jobs reading the scene file then loading the assets
+        static inline JobCounter readJob, jobs;
+        // Set by the reading job if the file was parsed
+        static inline std::atomic<bool> sceneRead = false;
+        // The uploads of the jobs, run by the main thread in "update"
+        static inline UploadQueue uploads{nullptr};
+        static inline std::unique_ptr<StagingRing> staging;
+        // The vertex layout of the next scene, its meshes are created with it while the current scene keeps "Mesh::layout"
+        static inline VertexLayout nextLayout;
+        static inline double startTime = 0;
+        static inline size_t frames = 0;
+
+        static void startLoading();
+        // Defers the creation of each material and the packing of their maps to the queue (once the other assets are loaded)
+        static void queueMaterials();
+        static void finishLoading();
+    public:
+        // The time the main thread spends on the uploads in each frame (in milliseconds)
+        static inline double frameBudget = 2.0;
+        // The memory of the loaded assets when the preload started and its highest value while both scenes were loaded
+        static inline AssetMemory startMemory, peakMemory;
+
+        // Sets the scene to preload when "start" is called (a json file in the same form as the "scene" of the app config
+        // or its compiled version, see "CompiledScene")
+        static void setNextScene(const std::string& path) { nextScenePath = path; }
+        static bool hasNextScene() { return !nextScenePath.empty(); }
+        // Starts preloading the next scene if there is one (does nothing if it already started)
+        static void start();
+        // Runs the uploads of the preload for at most "frameBudget" milliseconds (called once per frame by the main thread)
+        static void update();
+        // True while the preload is running (the assets budget is not enforced meanwhile)
+        static bool isStreaming() { return stage == Stage::Reading || stage == Stage::Loading || stage == Stage::Finishing; }
+        // True once the assets of the next scene are loaded
+        static bool isReady() { return stage == Stage::Ready; }
+        // Returns the preloaded scene and its compiled world (null if it is not compiled), reports the preload and resets the streamer
+        static nlohmann::json take(std::shared_ptr<CompiledScene>& compiled);
+        // Waits for the running jobs and stops the preload (the loaded assets stay until the next scene is known)
+        static void cancel();
+    };
+
+}
@@ -0,0 +1,44 @@
+#include "shader-cache.hpp"
+
+namespace portal {
+
+    ShaderProgram* ShaderCache::get(const std::vector<std::pair<std::string, GLenum>>& stages, const std::vector<std::string>& defines){
+        // The request is looked up first, the files are only read and a program created the first time it is made
+        std::string request;
+        for(auto& [filename, type] : stages) request += filename + ":" + std::to_string(type) + ";";
+        request += "|";
+        for(auto& define : defines) request += define + ";";
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(auto it = requests.find(request); it != requests.end()) return it->second;
+        }
+        // Attaching only reads the files, so it runs without the lock (the other thread can meanwhile get its programs)
+        ShaderProgram* program = new ShaderProgram();
+        for(auto& [filename, type] : stages) program->attach(filename, type, defines);
+        uint64_t hash = program->getSourceHash();
+        std::lock_guard<std::mutex> lock(mutex);
+        // Another request may give the same sources (or the same request may have been made by the other thread meanwhile)
+        if(auto it = programs.find(hash); it != programs.end()){
+            delete program;
+            requests[request] = it->second;
+            return it->second;
+        }
+        program->link();
+        programs[hash] = program;
+        requests[request] = program;
+        return program;
+    }
+
+    void ShaderCache::finishAll(){
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& [hash, program] : programs) program->finish();
+    }
+
+    void ShaderCache::clear(){
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& [hash, program] : programs) delete program;
+        programs.clear();
+        requests.clear();
+    }
+
+}
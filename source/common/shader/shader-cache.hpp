@@ -0,0 +1,38 @@
+#pragma once
+
+#include "shader.hpp"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace portal {
+
+    // This static class holds the shader programs shared by the whole application
+    // Programs are identified by the hash of their sources and defines, so two requests for the same
+    // files (e.g. the menus and the renderer all using "textured.vert/frag") return the same program
+    // and each program is compiled once per run (and loaded from its binary in the following runs).
+    // All the programs are owned by the cache so they should not be deleted outside of this class
+    class ShaderCache {
+        static inline std::unordered_map<uint64_t, ShaderProgram*> programs;
+        // The program returned for each request (its stage files and types followed by its defines)
+        // so a request that was already made doesn't read the files again nor create a program
+        static inline std::unordered_map<std::string, ShaderProgram*> requests;
+        // The loading thread requests programs while the main thread may request the menu programs
+        static inline std::mutex mutex;
+    public:
+        // Returns the program made of the given stages (file and shader type) compiled with the given defines
+        static ShaderProgram* get(const std::vector<std::pair<std::string, GLenum>>& stages, const std::vector<std::string>& defines = {});
+        // Returns the program made of the given vertex and fragment shaders compiled with the given defines
+        static ShaderProgram* get(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines = {}){
+            return get({{vertexShader, GL_VERTEX_SHADER}, {fragmentShader, GL_FRAGMENT_SHADER}}, defines);
+        }
+        // Waits for every program still compiling in the background
+        static void finishAll();
+        // Deletes all the programs (should be called before the OpenGL context is destroyed)
+        static void clear();
+    };
+
+}
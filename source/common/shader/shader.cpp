@@ -1,64 +1,256 @@
 #include "shader.hpp"
+#include "shader-cache.hpp"
+#include "../asset-pack.hpp"
 
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool portal::ShaderProgram::attach(const std::string &filename, GLenum type) const {
-    // Here, we open the file and read a string from it containing the GLSL code of our shader
-    std::ifstream file(filename);
-    if(!file){
-        std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
-        return false;
+// FNV-1a, the program binaries are looked up by the hash of their sources
+static uint64_t hashBytes(const std::string& bytes, uint64_t hash = 14695981039346656037ull){
+    for(unsigned char byte : bytes){
+        hash ^= byte;
+        hash *= 1099511628211ull;
     }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char* sourceCStr = sourceString.c_str();
-    file.close();
+    return hash;
+}
 
-    //TODO: Complete this function
-    //Note: The function "checkForShaderCompilationErrors" checks if there is
-    // an error in the given shader. You should use it to check if there is a
-    // compilation error and print it so that you can know what is wrong with
-    // the shader. The returned string will be empty if there is no errors.
-
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &sourceCStr, nullptr);
-    glCompileShader(shader);
-    std::string error = checkForShaderCompilationErrors(shader);
-    if(!error.empty()){
-        std::cerr << "ERROR: Couldn't compile shader: " << filename << std::endl;
-        std::cerr << error << std::endl;
-        return false;
+bool portal::ShaderProgram::attach(const std::string &filename, GLenum type, const std::vector<std::string>& defines) {
+    for(auto& define : defines){
+        if(std::find(this->defines.begin(), this->defines.end(), define) == this->defines.end())
+            this->defines.push_back(define);
+    }
+    // Use the file if it was preloaded, otherwise open it and read a string from it containing the GLSL code of our shader
+    std::string sourceString;
+    {
+        std::lock_guard<std::mutex> lock(preloadMutex);
+        if(auto it = preloadedSources.find(filename); it != preloadedSources.end()) sourceString = it->second;
+    }
+    if(sourceString.empty()){
+        AssetFile file(filename);
+        if(!file.isOpen()){
+            std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
+            return false;
+        }
+        sourceString = std::string((const char*)file.getData(), file.getSize());
+    }
+    // The defines must come after the #version line (which must be the first line of the shader)
+    if(!defines.empty()){
+        std::string defineLines;
+        for(auto& define : defines) defineLines += "#define " + define + "\n";
+        size_t insertAt = 0;
+        if(size_t versionLine = sourceString.find("#version"); versionLine != std::string::npos){
+            size_t lineEnd = sourceString.find('\n', versionLine);
+            if(lineEnd == std::string::npos){
+                sourceString += '\n';
+                lineEnd = sourceString.size() - 1;
+            }
+            insertAt = lineEnd + 1;
+        }
+        sourceString.insert(insertAt, defineLines);
     }
-    glAttachShader(program, shader);
-    glDeleteShader(shader);
-    //We return true if the compilation succeeded
+    // Remember the file so the variants of this program can be compiled later
+    sources.emplace_back(filename, type);
+    // The compilation is deferred to "link" which can skip it if the program binary is cached
+    stageSources.emplace_back(std::move(sourceString), type);
     return true;
 }
 
+bool portal::ShaderProgram::preloadSource(const std::string &filename) {
+    {
+        std::lock_guard<std::mutex> lock(preloadMutex);
+        if(preloadedSources.count(filename)) return true;
+    }
+    AssetFile file(filename);
+    if(!file.isOpen()) return false;
+    std::string sourceString = std::string((const char*)file.getData(), file.getSize());
+    std::lock_guard<std::mutex> lock(preloadMutex);
+    preloadedSources.emplace(filename, std::move(sourceString));
+    return true;
+}
+
+void portal::ShaderProgram::clearPreloadedSources() {
+    std::lock_guard<std::mutex> lock(preloadMutex);
+    preloadedSources.clear();
+}
+
+uint64_t portal::ShaderProgram::getSourceHash() const {
+    uint64_t hash = hashBytes("");
+    for(auto& [source, type] : stageSources){
+        hash = hashBytes(std::to_string(type), hash);
+        hash = hashBytes(source, hash);
+    }
+    return hash;
+}
+
+// Returns the path of the cached binary of the program with the given key
+static std::string getBinaryPath(uint64_t key){
+    std::ostringstream path;
+    path << portal::ShaderProgram::binaryCacheFolder << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return path.str();
+}
+
+static bool supportsProgramBinary(){
+    return GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary;
+}
+
+void portal::ShaderProgram::countLink(double milliseconds, bool linked, bool fromBinary) {
+    std::lock_guard<std::mutex> lock(linkStatsMutex);
+    if(linked) linkStats.programs++;
+    if(fromBinary) linkStats.fromBinary++;
+    linkStats.milliseconds += milliseconds;
+}
+
+portal::ShaderLinkStats portal::ShaderProgram::getLinkStats() {
+    std::lock_guard<std::mutex> lock(linkStatsMutex);
+    return linkStats;
+}
+
+void portal::ShaderProgram::resetLinkStats() {
+    std::lock_guard<std::mutex> lock(linkStatsMutex);
+    linkStats = ShaderLinkStats();
+}
+
+bool portal::ShaderProgram::link() {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto elapsed = [&](){ return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); };
 
+    if(supportsProgramBinary()){
+        // A binary is only valid for the driver that created it, so the driver is part of the key
+        std::string driver = std::string((const char*)glGetString(GL_VENDOR)) + (const char*)glGetString(GL_RENDERER)
+                           + (const char*)glGetString(GL_VERSION);
+        binaryKey = hashBytes(driver, getSourceHash());
+        std::ifstream file(getBinaryPath(binaryKey), std::ios::binary);
+        if(file){
+            GLenum format = 0;
+            file.read((char*)&format, sizeof(format));
+            std::vector<char> binary(std::istreambuf_iterator<char>(file), {});
+            glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+            GLint status;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if(status){
+                countLink(elapsed(), true, true);
+                return true;
+            }
+            // The driver rejected the binary (e.g. after a driver update), compile the sources instead
+        }
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
 
-bool portal::ShaderProgram::link() const {
     //TODO: Complete this function
     //Note: The function "checkForLinkingErrors" checks if there is
     // an error in the given program. You should use it to check if there is a
     // linking error and print it so that you can know what is wrong with the
     // program. The returned string will be empty if there is no errors.
-    glLinkProgram(program);
-    std::string error = checkForLinkingErrors(program);
-    if(!error.empty()){
-        std::cerr << "ERROR: Couldn't link shader program" << std::endl;
-        std::cerr << error << std::endl;
-        return false;
+    if(GLAD_GL_KHR_parallel_shader_compile){
+        // Let the driver use as many compiler threads as it wants (this is a per context state)
+        static thread_local bool threadsSet = false;
+        if(!threadsSet){
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            threadsSet = true;
+        }
+    }
+    for(auto& [source, type] : stageSources){
+        const char* sourceCStr = source.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &sourceCStr, nullptr);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        pendingStages.push_back(shader);
     }
+    glLinkProgram(program);
+    pending = true;
+    countLink(elapsed(), true, false);
+    // Without parallel compilation, querying the status waits for the compilation anyway
+    if(!GLAD_GL_KHR_parallel_shader_compile) return finish();
     return true;
 }
 
+bool portal::ShaderProgram::isReady() const {
+    if(!pending) return true;
+    if(!GLAD_GL_KHR_parallel_shader_compile) return false;
+    GLint completed;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+bool portal::ShaderProgram::finish() {
+    if(!pending) return true;
+    std::lock_guard<std::mutex> lock(finishMutex);
+    // Another thread may have finished the program while this one was waiting for the lock
+    if(!pending) return true;
+    auto start = std::chrono::high_resolution_clock::now();
+    bool success = true;
+    for(size_t i = 0; i < pendingStages.size(); i++){
+        std::string error = checkForShaderCompilationErrors(pendingStages[i]);
+        if(!error.empty()){
+            std::string filename = i < sources.size() ? sources[i].first : "";
+            std::cerr << "ERROR: Couldn't compile shader: " << filename << std::endl;
+            std::cerr << error << std::endl;
+            success = false;
+        }
+        glDetachShader(program, pendingStages[i]);
+        glDeleteShader(pendingStages[i]);
+    }
+    pendingStages.clear();
+    if(success){
+        std::string error = checkForLinkingErrors(program);
+        if(!error.empty()){
+            std::cerr << "ERROR: Couldn't link shader program" << std::endl;
+            std::cerr << error << std::endl;
+            success = false;
+        }
+    }
+    // Save the binary so the next run can skip the compilation
+    if(success && supportsProgramBinary()){
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length > 0){
+            std::vector<char> binary(length);
+            GLenum format;
+            glGetProgramBinary(program, length, nullptr, &format, binary.data());
+            std::error_code ignored;
+            std::filesystem::create_directories(binaryCacheFolder, ignored);
+            std::ofstream file(getBinaryPath(binaryKey), std::ios::binary);
+            if(file){
+                file.write((const char*)&format, sizeof(format));
+                file.write(binary.data(), binary.size());
+            }
+        }
+    }
+    // The program is only marked as finished once its results were read so "use" never skips an unfinished program
+    pending = false;
+    countLink(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(), false, false);
+    return success;
+}
+
+portal::ShaderProgram* portal::ShaderProgram::getVariant(const std::vector<std::string>& extraDefines) {
+    if(extraDefines.empty()) return this;
+    // The key doesn't depend on the order of the defines
+    std::vector<std::string> sorted = extraDefines;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    std::string key;
+    for(auto& define : sorted) key += define + ";";
+    if(auto it = variants.find(key); it != variants.end()) return it->second;
+
+    std::vector<std::string> variantDefines = defines;
+    variantDefines.insert(variantDefines.end(), sorted.begin(), sorted.end());
+    ShaderProgram* variant = ShaderCache::get(sources, variantDefines);
+    variants[key] = variant;
+    return variant;
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
@@ -2,6 +2,12 @@
 #define SHADER_HPP
 
 #include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
@@ -9,11 +15,45 @@
 
 namespace portal {
 
+    // The number of linked programs and the time spent compiling or loading them
+    struct ShaderLinkStats {
+        int programs = 0;
+        int fromBinary = 0;
+        double milliseconds = 0;
+    };
+
     class ShaderProgram {
 
     private:
         //Shader Program Handle (OpenGL object name)
         GLuint program;
+        // The files attached to this program and their stages (used to compile the variants)
+        std::vector<std::pair<std::string, GLenum>> sources;
+        // The defines this program was compiled with
+        std::vector<std::string> defines;
+        // The variants of this program compiled with extra defines, keyed by their defines (owned by the ShaderCache)
+        std::map<std::string, ShaderProgram*> variants;
+        // The source code of each stage (with the defines inserted), they are compiled when the program is linked
+        std::vector<std::pair<std::string, GLenum>> stageSources;
+        // The shader objects of a program that is still compiling in the background (see "finish")
+        // "pending" is read by "use" on the main thread while the loading thread may still finish the program,
+        // "finishMutex" makes sure only one of them waits for the compilation and reads its results
+        std::vector<GLuint> pendingStages;
+        std::atomic<bool> pending = false;
+        std::mutex finishMutex;
+        // The hash of the stage sources, used to find the program binary saved by a previous run
+        uint64_t binaryKey = 0;
+
+        // The shader files read ahead of their programs by "preloadSource"
+        static inline std::unordered_map<std::string, std::string> preloadedSources;
+        static inline std::mutex preloadMutex;
+
+        // The statistics of the programs linked since the last reset, the programs are linked and finished by both the
+        // loading thread and the main thread so they are only accessed through "countLink", "getLinkStats" and "resetLinkStats"
+        static inline ShaderLinkStats linkStats;
+        static inline std::mutex linkStatsMutex;
+        // Adds the time spent on a program to the statistics (and counts it if it was linked)
+        static void countLink(double milliseconds, bool linked, bool fromBinary);
 
     public:
         ShaderProgram(){
@@ -22,14 +62,47 @@ namespace portal {
         }
         ~ShaderProgram(){
             //TODO: (Req 1) Delete a shader program
+            for(auto stage : pendingStages) glDeleteShader(stage);
             glDeleteProgram(program);
         }
 
-        bool attach(const std::string &filename, GLenum type) const;
-
-        bool link() const;
+        // Returns the statistics of the programs linked since the last reset (reported by the asset loader)
+        static ShaderLinkStats getLinkStats();
+        static void resetLinkStats();
+        // The folder where the program binaries are saved (the binaries are only valid for the driver that created them)
+        static inline std::string binaryCacheFolder = "shader-cache";
+
+        // Reads the shader file and adds it as a stage of the program (it is compiled by "link")
+        // Every define is inserted right after the #version line as "#define <define>"
+        // so it can be a flag (e.g. "HAS_EMISSION") or a name followed by its value (e.g. "MAX_LIGHTS 4")
+        bool attach(const std::string &filename, GLenum type, const std::vector<std::string>& defines = {});
+
+        // Reads the shader file so "attach" doesn't have to (it doesn't use OpenGL so it can run in the loading jobs)
+        static bool preloadSource(const std::string &filename);
+        // Frees the preloaded files (called once the assets are loaded so later edits of the files are read again)
+        static void clearPreloadedSources();
+
+        // Links the program, it is loaded from the binary cache if a previous run saved it
+        // Otherwise, the stages are compiled and linked, if GL_KHR_parallel_shader_compile is supported
+        // this returns immediately and the driver compiles in the background until "finish" is called
+        bool link();
+
+        // Returns true if the program is linked (it doesn't wait for a background compilation)
+        bool isReady() const;
+        // Waits for the background compilation (if any), reports its errors and saves the program binary
+        // It is called by "use" so the program is never used before it is ready
+        bool finish();
+
+        // Returns the hash of the stage sources and defines (programs with the same hash are identical)
+        uint64_t getSourceHash() const;
+
+        // Returns the variant of this program compiled from the same files with the given extra defines
+        // Variants are compiled the first time they are requested then cached
+        // If there are no extra defines, the program itself is returned
+        ShaderProgram* getVariant(const std::vector<std::string>& extraDefines);
 
         void use() { 
+            if(pending) finish();
             glUseProgram(program);
         }
 
@@ -4,6 +4,7 @@
 #include "../ecs/elevator.hpp"
 #include "../ecs/portal.hpp"
 #include "../deserialize-utils.hpp"
+#include "../scene-streamer.hpp"
 
 namespace portal {
     void EventSystem::handleTeleport(r3d::Collider* objectCollider, Entity* object, Portal* portal) {
@@ -45,11 +46,14 @@ namespace portal {
         // If one of the entities is an elevator
         // Check if the other entity is a player or a cube
         // If so then call the press/release function of the elevator
+        // The player is leaving the level, so the next one starts loading while the doors close
         if(entity_1->getType() == EntityFactory::EntityType::Elevator && entity_2->getType() == EntityFactory::EntityType::Player) {
             dynamic_cast<Elevator *>(entity_1)->close();
+            SceneStreamer::start();
         }
         if(entity_2->getType() == EntityFactory::EntityType::Elevator && entity_1->getType() == EntityFactory::EntityType::Player) {
             dynamic_cast<Elevator *>(entity_2)->close();
+            SceneStreamer::start();
         }
     }
 
@@ -50,12 +50,10 @@ namespace portal {
                 // contactPair.getNbContactPoints() gets the number of contact points (they can be multiple)
                 // Use contactPair.getContactPoint(index) to get the contact point at the given index
                 r3d::CollisionCallback::ContactPair contactPair = callbackData.getContactPair(p);
-                // Get the name of the body (we stored the name in the user data while creating the body)
-                // User data is stored as a void pointer so we need to cast it to the correct type
-                std::string name_1 = *((std::string*)contactPair.getBody1()->getUserData());
-                std::string name_2 = *((std::string*)contactPair.getBody2()->getUserData());
-                Entity* entity_1 = world->getEntityByName(name_1);
-                Entity* entity_2 = world->getEntityByName(name_2);
+                // Get the entities of the bodies (stored in the user data while creating the bodies)
+                Entity* entity_1 = RigidBodyComponent::getEntity(contactPair.getBody1());
+                Entity* entity_2 = RigidBodyComponent::getEntity(contactPair.getBody2());
+                if(!entity_1 || !entity_2) continue;
 
                 // Check if any of the entities is a button and handle it
                 checkButtonCollision(entity_1, entity_2, contactPair.getEventType());
@@ -74,10 +72,11 @@ namespace portal {
                 r3d::OverlapCallback::OverlapPair overlapPair = callbackData.getOverlappingPair(p);
                 // overlapPair.getBody1() and overlapPair.getBody2() are the two colliders that are overlapping
                 // overlapPair.getEventType() is the type of event (OverlapStart/OverlapStay/OverlapExit)
-                std::string name_1 = *((std::string*)overlapPair.getBody1()->getUserData());
-                std::string name_2 = *((std::string*)overlapPair.getBody2()->getUserData());
-                Entity* entity_1 = world->getEntityByName(name_1);
-                Entity* entity_2 = world->getEntityByName(name_2);
+                Entity* entity_1 = RigidBodyComponent::getEntity(overlapPair.getBody1());
+                Entity* entity_2 = RigidBodyComponent::getEntity(overlapPair.getBody2());
+                if(!entity_1 || !entity_2) continue;
+                const std::string& name_1 = entity_1->name;
+                const std::string& name_2 = entity_2->name;
                 if (entity_1->getType() == EntityFactory::EntityType::Portal) {
                     // if name_1 is a portal then name_2 is object
                     handleTeleport(overlapPair.getBody2()->getCollider(0), entity_2, dynamic_cast<Portal*>(entity_1));
@@ -1,6 +1,8 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
+#include "../mesh/geometry-pool.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../shader/shader-cache.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_access.inl>
 
@@ -9,6 +11,7 @@ namespace portal {
 
     void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json& config){
         firstFrame = true;
+        lightsUploaded.clear();
         // First, we store the window size for later use
         this->windowSize = windowSize;
         portals.resize(2);
@@ -19,10 +22,7 @@ namespace portal {
             this->skySphere = mesh_utils::sphere(glm::ivec2(16, 16));
             
             // We can draw the sky using the same shader used to draw textured objects
-            ShaderProgram* skyShader = new ShaderProgram();
-            skyShader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
-            skyShader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-            skyShader->link();
+            ShaderProgram* skyShader = ShaderCache::get("assets/shaders/textured.vert", "assets/shaders/textured.frag");
             
             //TODO: (Req 10) Pick the correct pipeline state to draw the sky
             // Hints: the sky will be draw after the opaque objects so we would need depth testing but which depth funtion should we pick?
@@ -63,23 +63,13 @@ namespace portal {
         bloomIntensity = config.value("bloomIntensity", 1.0f);
         bloomBlurIterations = config.value("bloomBlurIterations", 10);
         exposure = config.value("exposure", 1.0f);
+        // Load the level of detail parameters
+        lodThreshold = config.value("lodThreshold", 1.0f);
+        lodHysteresis = config.value("lodHysteresis", 0.25f);
+        fullTriangles.clear();
+        drawnTriangles.clear();
+        lodFrames = 0;
 
-        // Create a framebuffer to render the scene to
-        glGenFramebuffers(1, &postProcessFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, postProcessFBO);
-        // The depth format can be (Depth component with 24 bits).
-        colorTexture = texture_utils::empty(GL_RGBA16F, windowSize);
-        brightColorTexture = texture_utils::empty(GL_RGBA16F, windowSize);
-        depthTexture = texture_utils::empty(GL_DEPTH24_STENCIL8, windowSize);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture->getOpenGLName(), 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, brightColorTexture->getOpenGLName(), 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture->getOpenGLName(), 0);
-
-        
-        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-        glDrawBuffers(2, attachments);
-        //TODO: (Req 11) Unbind the framebuffer just to be safe
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
         // Create a vertex array to use for drawing the texture
         glGenVertexArrays(1, &postProcessVertexArray);
 
@@ -91,42 +81,19 @@ namespace portal {
         sampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
         // Create the post processing shader
-        ShaderProgram* bloomShader = new ShaderProgram();
-        bloomShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-        bloomShader->attach("assets/shaders/postprocess/bloom.frag", GL_FRAGMENT_SHADER);
-        bloomShader->link();
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // ping-pong-framebuffer for blurring
-        glGenFramebuffers(2, pingpongFBO);
-        // glGenTextures(2, pingpongColorbuffers);
-        for (unsigned int i = 0; i < 2; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-            pingpongColorbuffers[i] = texture_utils::empty(GL_RGBA16F, windowSize);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i]->getOpenGLName(), 0);
-            // also check if framebuffers are complete (no need for depth buffer)
-            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-                std::cout << "Framebuffer not complete!" << std::endl;
-        }
+        ShaderProgram* bloomShader = ShaderCache::get("assets/shaders/fullscreen.vert", "assets/shaders/postprocess/bloom.frag");
+
+        // The render targets are not created here, they are allocated by the frame graph
+        // depending on which passes are needed (see buildFrameGraph)
         pingpongMaterial = new MultiTextureMaterial();
-        ShaderProgram* blurShader = new ShaderProgram();
-        blurShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-        blurShader->attach("assets/shaders/postprocess/bloomBlur.frag", GL_FRAGMENT_SHADER);
-        blurShader->link();
+        ShaderProgram* blurShader = ShaderCache::get("assets/shaders/fullscreen.vert", "assets/shaders/postprocess/bloomBlur.frag");
         pingpongMaterial->shader = blurShader;
         pingpongMaterial->sampler = sampler;
-        // setting up the material texture to be the color buffer
-        pingpongMaterial->texture1 = pingpongColorbuffers[1];
-        pingpongMaterial->texture2 = pingpongColorbuffers[0];
         pingpongMaterial->pipelineState.depthMask = false;
 
         // Create a post processing material
         hdrMaterial = new MultiTextureMaterial();
         hdrMaterial->shader = bloomShader;
-        hdrMaterial->texture1 = colorTexture;
-        hdrMaterial->texture2 = pingpongColorbuffers[0];
         hdrMaterial->sampler = sampler;
         // The default options are fine but we don't need to interact with the depth buffer
         // so it is more performant to disable the depth mask
@@ -144,30 +111,29 @@ namespace portal {
             postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
             // Create the post processing shader
-            ShaderProgram* postprocessShader = new ShaderProgram();
-            postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-            postprocessShader->attach(config.value<std::string>("postprocess", ""), GL_FRAGMENT_SHADER);
-            postprocessShader->link();
+            ShaderProgram* postprocessShader = ShaderCache::get("assets/shaders/fullscreen.vert", config.value<std::string>("postprocess", ""));
 
             // Create a post processing material
             postprocessMaterial = new TexturedMaterial();
             postprocessMaterial->shader = postprocessShader;
-            // postprocessMaterial->texture = colorTarget;
-            postprocessMaterial->texture = colorTexture;
             postprocessMaterial->sampler = postprocessSampler;
             // The default options are fine but we don't need to interact with the depth buffer
             // so it is more performant to disable the depth mask
             postprocessMaterial->pipelineState.depthMask = false;
         }
     
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        frameGraphDirty = true;
     }
 
     void ForwardRenderer::destroy(){
+        // Report the triangles saved by the levels of detail
+        for(size_t view = 0; view < fullTriangles.size() && lodFrames > 0; view++){
+            std::cout << "View " << view << ": " << fullTriangles[view] / lodFrames << " -> " << drawnTriangles[view] / lodFrames
+                      << " triangles per frame with the levels of detail" << std::endl;
+        }
         // Delete all objects related to the sky
         if(skyMaterial){
             delete skySphere;
-            delete skyMaterial->shader;
             delete skyMaterial->texture;
             delete skyMaterial->sampler;
             delete skyMaterial;
@@ -175,28 +141,22 @@ namespace portal {
         // Delete all objects related to post processing
         if(postprocessMaterial){
             delete postprocessMaterial->sampler;
-            delete postprocessMaterial->shader;
             delete postprocessMaterial;
         }
         // Delete all objects related to bloom
-        glDeleteFramebuffers(1, &postProcessFBO);
         glDeleteVertexArrays(1, &postProcessVertexArray);
-        delete colorTexture;
-        delete brightColorTexture;
         if(!postprocessMaterial) delete hdrMaterial->sampler;
-        delete hdrMaterial->shader;
         delete hdrMaterial;
-        glDeleteFramebuffers(2, pingpongFBO);
-        delete pingpongColorbuffers[0];
-        delete pingpongColorbuffers[1];
-        delete pingpongMaterial->shader;
         delete pingpongMaterial;
-
+        // Delete the render targets
+        frameGraph.destroy();
     }
 
     // Utility function to add a lights to the shader and set the "lightCount" uniform
     void ForwardRenderer::setupLights(const std::vector<LightComponent*>& lights, ShaderProgram* shader){
-        for(int i = 0; i < lights.size(); i++){
+        // The lit shader variants support up to 8 lights
+        int count = std::min((int)lights.size(), 8);
+        for(int i = 0; i < count; i++){
             if(lights[i]->type == LightComponent::Type::Directional){ // Directional
                 shader->set("lights[" + std::to_string(i) + "].type", 0);
                 shader->set("lights[" + std::to_string(i) + "].color", lights[i]->color);
@@ -216,7 +176,42 @@ namespace portal {
                 shader->set("lights[" + std::to_string(i) + "].attenuation", lights[i]->attenuation);
             }
         }
-        shader->set("numLights", (int)lights.size());
+        shader->set("numLights", count);
+    }
+
+    size_t ForwardRenderer::selectLod(const RenderCommand& command, glm::vec3 const& eye, glm::mat4 const& projMat){
+        auto& lods = command.mesh->getLods();
+        uint8_t& level = command.lodLevels[std::min(viewIndex, (size_t)3)];
+        size_t current = std::min((size_t)level, lods.size() - 1);
+        if(lods.size() > 1){
+            // The error of a level in pixels is its error in world units times the pixels per world unit at the bounding sphere
+            float scale = std::max(std::max(glm::length(glm::vec3(command.localToWorld[0])), glm::length(glm::vec3(command.localToWorld[1]))),
+                                   glm::length(glm::vec3(command.localToWorld[2])));
+            glm::vec3 center = glm::vec3(command.localToWorld * glm::vec4(command.mesh->getBoundingCenter(), 1.0f));
+            float distance = glm::length(center - eye) - command.mesh->getBoundingRadius() * scale;
+            if(distance <= 0.0f){
+                current = 0;
+            } else {
+                float pixelsPerUnit = projMat[1][1] * windowSize.y * 0.5f / distance;
+                auto fits = [&](size_t lod, float threshold){ return lods[lod].error * scale * pixelsPerUnit <= threshold; };
+                // Go to a coarser level once its error is well below the threshold, go back to a finer one once the current error exceeds it
+                size_t coarser = current;
+                while(coarser + 1 < lods.size() && fits(coarser + 1, lodThreshold * (1.0f - lodHysteresis))) coarser++;
+                if(coarser > current) current = coarser;
+                else while(current > 0 && !fits(current, lodThreshold)) current--;
+            }
+        }
+        level = (uint8_t)current;
+
+        if(fullTriangles.size() <= viewIndex){
+            fullTriangles.resize(viewIndex + 1, 0);
+            drawnTriangles.resize(viewIndex + 1, 0);
+        }
+        for(uint32_t i = command.firstSubmesh; i < command.firstSubmesh + command.submeshCount; i++){
+            fullTriangles[viewIndex] += lods[0].submeshes[i].elementCount / 3;
+            drawnTriangles[viewIndex] += lods[current].submeshes[i].elementCount / 3;
+        }
+        return current;
     }
 
     void ForwardRenderer::drawNonPortalObjects(glm::mat4 const& modelMat, glm::mat4 const& viewMat, glm::mat4 const &projMat){
@@ -224,6 +219,8 @@ namespace portal {
         // HINT: See how you wrote the CameraComponent::getViewMatrix, it should help you solve this one
         //camera forward is the third row of the view matrix
         glm::vec3 eye = glm::vec3(modelMat * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        // The actual position of the view (the views through the portals are not at "modelMat")
+        glm::vec3 viewEye = glm::vec3(glm::inverse(viewMat)[3]);
         glm::vec3 cameraForward = glm::vec3(viewMat[2][0], viewMat[2][1], viewMat[2][2]);
         std::sort(transparentCommands.begin(), transparentCommands.end(), [cameraForward](const RenderCommand& first, const RenderCommand& second){
             //TODO: (Req 9) Finish this function
@@ -248,7 +245,7 @@ namespace portal {
             // check if the material is of type LitMaterial
             if (auto litMaterial = dynamic_cast<LitMaterial*>(command.material); litMaterial){
                 // set the lights in the shader
-                if(firstFrame){
+                if(lightsUploaded.insert(litMaterial->shader).second){
                     setupLights(lights, litMaterial->shader);
                 }
                 // set the model, view, projection matrices in the shader
@@ -261,7 +258,7 @@ namespace portal {
                 command.material->shader->set("transform", MVP);
             }
             command.material->shader->set("bloomThreshold", bloomThreshold);
-            command.mesh->draw();
+            command.mesh->drawSubmeshes(selectLod(command, viewEye, projMat), command.firstSubmesh, command.submeshCount);
         }
         // If there is a sky material, draw the sky
         if(this->skyMaterial){
@@ -293,7 +290,7 @@ namespace portal {
             // check if the material is of type LitMaterial
             if (auto litMaterial = dynamic_cast<LitMaterial*>(command.material); litMaterial){
                 // set the lights in the shader
-                if(firstFrame){
+                if(lightsUploaded.insert(litMaterial->shader).second){
                     setupLights(lights, litMaterial->shader);
                 }
                 // set the model, view, projection matrices in the shader
@@ -305,9 +302,10 @@ namespace portal {
                 glm::mat4 MVP = VP * command.localToWorld;
                 command.material->shader->set("transform", MVP);
             }
-            command.mesh->draw();
+            command.mesh->drawSubmeshes(selectLod(command, viewEye, projMat), command.firstSubmesh, command.submeshCount);
         }
         firstFrame = false;
+        viewIndex++;
     }
 
     void ForwardRenderer::drawPortal(glm::mat4 const& modelMat, glm::mat4 const &viewMat, glm::mat4 const &projMat, Entity* curportal) {
@@ -352,14 +350,108 @@ namespace portal {
         return newProj;
     }
    
+    void ForwardRenderer::buildFrameGraph(){
+        bool offscreen = bloom || postprocessMaterial;
+        std::string label = bloom ? "bloom" : "no bloom";
+        if(postprocessMaterial) label += ", postprocess";
+        frameGraph.reset(windowSize, label);
+        frameGraphDirty = false;
+
+        if(!offscreen){
+            // Nothing to do after drawing the scene, so it is drawn directly to the screen
+            frameGraph.addPass("scene", {}, {FrameGraph::Backbuffer}, [this](){ drawScene(); });
+            frameGraph.compile();
+            return;
+        }
+
+        // The scene is drawn in HDR, the bright parts go to a second color target used by bloom
+        FrameResource sceneColor = frameGraph.createTexture("sceneColor", GL_RGBA16F, windowSize);
+        FrameResource sceneBright = frameGraph.createTexture("sceneBright", GL_RGBA16F, windowSize);
+        FrameResource sceneDepth = frameGraph.createTexture("sceneDepth", GL_DEPTH24_STENCIL8, windowSize);
+        frameGraph.addPass("scene", {}, {sceneColor, sceneBright, sceneDepth}, [this](){ drawScene(); });
+
+        // The bloom passes are always declared, when bloom is off nothing reads the composite
+        // so the graph culls both passes and the bright target is never allocated
+        FrameResource blurA = frameGraph.createTexture("bloomBlurA", GL_RGBA16F, windowSize);
+        FrameResource blurB = frameGraph.createTexture("bloomBlurB", GL_RGBA16F, windowSize);
+        // The blur ping-pongs between its two targets, so it also reads back blurB
+        frameGraph.addPass("bloomBlur", {sceneBright, blurB}, {blurA, blurB}, [this, sceneBright, blurA, blurB](){
+            // apply the pingpong blur
+            GLuint pingpongFBO[2] = { frameGraph.getFramebuffer({blurA}), frameGraph.getFramebuffer({blurB}) };
+            pingpongMaterial->texture1 = frameGraph.getTexture(blurB);
+            pingpongMaterial->texture2 = frameGraph.getTexture(blurA);
+            bool horizontal = true, first_iteration = true;
+            for (int i = 0; i < bloomBlurIterations; i++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+                pingpongMaterial->setup();
+                pingpongMaterial->shader->set("horizontal", horizontal);
+                if (first_iteration){
+                    glActiveTexture(GL_TEXTURE1);
+                    frameGraph.getTexture(sceneBright)->bind();
+                    if(pingpongMaterial->sampler)
+                        pingpongMaterial->sampler->bind(1);
+                    pingpongMaterial->shader->set("tex2", 1);
+                } 
+                GeometryPool::bindVertexArray(postProcessVertexArray);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                horizontal = !horizontal;
+                if (first_iteration)
+                    first_iteration = false;
+            }
+        });
+
+        // The composite gets its own target (instead of drawing back into the scene color it samples)
+        FrameResource hdrColor = postprocessMaterial ? frameGraph.createTexture("hdrColor", GL_RGBA16F, windowSize) : FrameGraph::Backbuffer;
+        frameGraph.addPass("bloomComposite", {sceneColor, blurA}, {hdrColor}, [this, sceneColor, blurA](){
+            hdrMaterial->texture1 = frameGraph.getTexture(sceneColor);
+            hdrMaterial->texture2 = frameGraph.getTexture(blurA);
+            GeometryPool::bindVertexArray(postProcessVertexArray);
+            hdrMaterial->setup();
+            hdrMaterial->shader->set("bloomIntensity", bloomIntensity);
+            hdrMaterial->shader->set("exposure", exposure);       
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+
+        if(postprocessMaterial){
+            FrameResource input = bloom ? hdrColor : sceneColor;
+            frameGraph.addPass("postprocess", {input}, {FrameGraph::Backbuffer}, [this, input](){
+                postprocessMaterial->texture = frameGraph.getTexture(input);
+                GeometryPool::bindVertexArray(postProcessVertexArray);
+                postprocessMaterial->setup();
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+        }
+        frameGraph.compile();
+    }
+
+    void ForwardRenderer::drawScene(){
+        // CLear the screen
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glStencilMask(0xFF);
+        glClear(GL_STENCIL_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+        glViewport(0, 0, windowSize.x, windowSize.y);
+        Entity* portal1 = portals[0];
+        Entity* portal2 = portals[1];
+        if(!portal1 || !portal2) {
+            drawNonPortalObjects(camera->getOwner()->getLocalToWorldMatrix(), camera->getViewMatrix(), camera->getProjectionMatrix(windowSize));
+        } else{
+            portalModelMats[0] = portal1->getLocalToWorldMatrix(), portalModelMats[1] = portal2->getLocalToWorldMatrix();
+            drawPortalsNonRecursive(camera->getOwner()->getLocalToWorldMatrix(),camera->getViewMatrix(), camera->getProjectionMatrix(windowSize), portal1, portal2);
+        }
+    }
+   
     void ForwardRenderer::render(World* world){
         // First of all, we search for a camera and for all the mesh renderers
-        CameraComponent* camera = nullptr;
+        camera = nullptr;
         opaqueCommands.clear();
         transparentCommands.clear();
 
         Entity* portal1 = world->getEntityByName("Portal_1");
         Entity* portal2 = world->getEntityByName("Portal_2");
+        portals[0] = portal1, portals[1] = portal2;
         for(const auto& [name, entity] : world->getEntities()){
             if(entity == portal1 || entity == portal2) 
                 continue;
@@ -367,19 +459,40 @@ namespace portal {
             if(!camera) camera = entity->getComponent<CameraComponent>();
             // If this entity has a mesh renderer component
             if(auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer){
-                // We construct a command from it
+                // We construct a command from it for each material of its submeshes
                 RenderCommand command;
                 command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
                 command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
                 command.mesh = meshRenderer->mesh;
-                command.material = meshRenderer->material;
-                // if it is transparent, we add it to the transparent commands list
-                if(command.material->transparent){
-                    transparentCommands.push_back(command);
-                } else {
-                // Otherwise, we add it to the opaque command list
-                    opaqueCommands.push_back(command);
+                command.material = nullptr;
+                command.firstSubmesh = 0;
+                command.submeshCount = 0;
+                command.lodLevels = meshRenderer->lodLevels.data();
+                auto addCommand = [&](){
+                    if(!command.material || command.submeshCount == 0) return;
+                    // if it is transparent, we add it to the transparent commands list
+                    if(command.material->transparent){
+                        transparentCommands.push_back(command);
+                    } else {
+                    // Otherwise, we add it to the opaque command list
+                        opaqueCommands.push_back(command);
+                    }
+                };
+                // Consecutive submeshes with the same material are drawn together (a single material draws the whole mesh at once)
+                // The submeshes of every level of detail are in the same order, so the range is valid for all of them
+                auto& submeshes = command.mesh->getSubmeshes();
+                for(uint32_t i = 0; i < (uint32_t)submeshes.size(); i++){
+                    Material* material = meshRenderer->getMaterial(submeshes[i].materialSlot);
+                    if(material == command.material){
+                        command.submeshCount++;
+                        continue;
+                    }
+                    addCommand();
+                    command.material = material;
+                    command.firstSubmesh = i;
+                    command.submeshCount = 1;
                 }
+                addCommand();
             }
 
             if(firstFrame){
@@ -390,76 +503,36 @@ namespace portal {
             }
         }
 
-        if(bloom || postprocessMaterial){
-            glBindFramebuffer(GL_FRAMEBUFFER, postProcessFBO);
-        }
-
-        // CLear the screen
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-        glDepthMask(GL_TRUE);
-        glStencilMask(0xFF);
-        glClear(GL_STENCIL_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-        glViewport(0, 0, windowSize.x, windowSize.y);
-        // If there is no camera, we return (we cannot render without a camera)
-        if(camera == nullptr) return;
-        if(!portal1 || !portal2) {
-            drawNonPortalObjects(camera->getOwner()->getLocalToWorldMatrix(), camera->getViewMatrix(), camera->getProjectionMatrix(windowSize));
-            // return;
-        } else{
-            portals[0] = portal1, portals[1] = portal2;
-            portalModelMats[0] = portal1->getLocalToWorldMatrix(), portalModelMats[1] = portal2->getLocalToWorldMatrix();
-            size_t maxRecursionLevel = 1;
-            drawPortalsNonRecursive(camera->getOwner()->getLocalToWorldMatrix(),camera->getViewMatrix(), camera->getProjectionMatrix(windowSize), portal1, portal2);
-        }
-
-        if(bloom){ 
-            // apply the pingpong blur
-            bool horizontal = true, first_iteration = true;
-            for (int i = 0; i < bloomBlurIterations; i++)
-            {
-                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-                pingpongMaterial->setup();
-                pingpongMaterial->shader->set("horizontal", horizontal);
-                if (first_iteration){
-                    glActiveTexture(GL_TEXTURE1);
-                    brightColorTexture->bind();
-                    if(pingpongMaterial->sampler)
-                        pingpongMaterial->sampler->bind(1);
-                    pingpongMaterial->shader->set("tex2", 1);
-                } 
-                glBindVertexArray(postProcessVertexArray);
-                glDrawArrays(GL_TRIANGLES, 0, 3);
-                horizontal = !horizontal;
-                if (first_iteration)
-                    first_iteration = false;
+        // Pick the lit shader variant matching the number of lights and the bloom state
+        // (the variants are compiled the first time they are used)
+        for(auto commands : {&opaqueCommands, &transparentCommands}){
+            for(auto& command : *commands){
+                if(auto litMaterial = dynamic_cast<LitMaterial*>(command.material); litMaterial)
+                    litMaterial->selectVariant((int)lights.size(), bloom);
             }
+        }
 
-           if(postprocessMaterial){
-                // if there is a postprocess material, draw the scene to the framebuffer after applying bloom
-                // and then draw the framebuffer to the screen using the postprocess material
-                glBindFramebuffer(GL_FRAMEBUFFER, postProcessFBO);
-
-            } else {
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            }
+        // Group the opaque commands by shader then by material, so consecutive draws share their state
+        // (lit materials sharing texture arrays only change their layer indices between draws)
+        std::sort(opaqueCommands.begin(), opaqueCommands.end(), [](const RenderCommand& first, const RenderCommand& second){
+            if(first.material->shader != second.material->shader)
+                return first.material->shader < second.material->shader;
+            return first.material < second.material;
+        });
 
-            glBindVertexArray(postProcessVertexArray);
-            hdrMaterial->setup();
-            hdrMaterial->shader->set("bloomIntensity", bloomIntensity);
-            hdrMaterial->shader->set("exposure", exposure);       
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-        // If there is a postprocess material, draw the scene to the framebuffer
-        if(postprocessMaterial){
-            //TODO: (Req 11) Return to the default framebuffer
+        // If there is no camera, we just clear the screen and return (we cannot render without a camera)
+        if(camera == nullptr){
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            //TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
-            glBindVertexArray(postProcessVertexArray);
-            postprocessMaterial->setup();
-            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            return;
         }
 
+        // Rebuild the passes if the configuration changed, then run them
+        if(frameGraphDirty) buildFrameGraph();
+        viewIndex = 0;
+        frameGraph.execute();
+        lodFrames++;
     }
 
     void ForwardRenderer::drawPortalsNonRecursive(glm::mat4 const& modelMat, glm::mat4 const &viewMat, 
@@ -565,6 +638,7 @@ namespace portal {
     }
     
     void ForwardRenderer::setBloom(bool bloom){
+        if(this->bloom != bloom) frameGraphDirty = true;
         this->bloom = bloom;
     }
 }
\ No newline at end of file
@@ -5,9 +5,11 @@
 #include "../components/mesh-renderer.hpp"
 #include "../components/lighting.hpp"
 #include "../asset-loader.hpp"
+#include "frame-graph.hpp"
 
 #include <glad/gl.h>
 #include <vector>
+#include <unordered_set>
 #include <algorithm>
 
 namespace portal
@@ -16,11 +18,16 @@ namespace portal
     // The render command stores command that tells the renderer that it should draw
     // the given mesh at the given localToWorld matrix using the given material
     // The renderer will fill this struct using the mesh renderer components
+    // Only the submeshes drawn with this material are drawn (a range of consecutive submeshes)
     struct RenderCommand {
         glm::mat4 localToWorld;
         glm::vec3 center;
         Mesh* mesh;
         Material* material;
+        uint32_t firstSubmesh;
+        uint32_t submeshCount;
+        // The level of detail of the mesh renderer in each view (see "MeshRendererComponent::lodLevels")
+        uint8_t* lodLevels;
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
@@ -35,15 +42,18 @@ namespace portal
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
         // Objects used for rendering a skybox
-        Mesh* skySphere;
-        TexturedMaterial* skyMaterial;
+        Mesh* skySphere = nullptr;
+        TexturedMaterial* skyMaterial = nullptr;
         // Objects used for Postprocessing
         GLuint postProcessVertexArray;
-        // Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial* postprocessMaterial;
+        TexturedMaterial* postprocessMaterial = nullptr;
+        // The camera found in the world this frame
+        CameraComponent* camera = nullptr;
         // List of all the lights in the scene
         std::vector<LightComponent*> lights;
         bool firstFrame = true;
+        // The shader programs that already received the lights (each lit variant is a separate program)
+        std::unordered_set<ShaderProgram*> lightsUploaded;
 
         // **********************//
         // **** Bloom & HDR **//
@@ -53,23 +63,36 @@ namespace portal
         float bloomIntensity;
         int bloomBlurIterations;
         float exposure;
-        // Framebuffer used to store the bright color
-        GLuint postProcessFBO;
-        // Texture used to store the normal color
-        Texture2D *colorTexture, *depthTexture;
-        // Texture used to store the bright color
-        Texture2D *brightColorTexture;
         // Material used to render final frame
         MultiTextureMaterial* hdrMaterial;
-        // pingpong variable to switch between the two postprocess materials
-        // pingpong framebuffers
-        GLuint pingpongFBO[2];
-        // pingpong colorbuffers
-        Texture2D *pingpongColorbuffers[2];
-        // pingpong material
-        // Material used to blur the bright color
+        // Material used to blur the bright color (ping-pong between two targets)
         MultiTextureMaterial* pingpongMaterial;
-        // TexturedMaterial* pingpongMaterial[2];
+
+        // **********************//
+        // **** Frame Graph **//
+        // **********************//
+        // The scene, bloom and postprocess passes with their transient render targets
+        FrameGraph frameGraph;
+        // Set whenever the passes change (e.g. bloom toggled) so the graph is rebuilt before the next frame
+        bool frameGraphDirty = true;
+        void buildFrameGraph();
+        // Clears the bound framebuffer and draws the world (with the portals) from the camera
+        void drawScene();
+
+        // **********************//
+        // **** Levels of detail **//
+        // **********************//
+        // The largest error (in pixels) allowed for the level of detail of a mesh
+        float lodThreshold;
+        // A coarser level is only picked once its error is this fraction below the threshold (so the levels don't pop back and forth)
+        float lodHysteresis;
+        // The index of the view being drawn in this frame (0 is the main view, then the views through the portals)
+        size_t viewIndex = 0;
+        // The triangles of the drawn meshes at full detail and at the picked levels in each view (summed over "lodFrames" frames)
+        std::vector<size_t> fullTriangles, drawnTriangles;
+        size_t lodFrames = 0;
+        // Picks the level of detail of the command from the size of its bounding sphere on the screen
+        size_t selectLod(const RenderCommand& command, glm::vec3 const& eye, glm::mat4 const& projMat);
 
         // **********************//
         // **** Portal **//
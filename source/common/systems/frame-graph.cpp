@@ -0,0 +1,277 @@
+#include "frame-graph.hpp"
+#include "../texture/texture-utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace portal {
+
+    static bool isDepthFormat(GLenum format){
+        switch(format){
+            case GL_DEPTH_COMPONENT16:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32:
+            case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH24_STENCIL8:
+            case GL_DEPTH32F_STENCIL8:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static size_t getBytesPerPixel(GLenum format){
+        switch(format){
+            case GL_R8: return 1;
+            case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+            case GL_RGBA8: case GL_RG16F: case GL_R32F: case GL_R11F_G11F_B10F:
+            case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH24_STENCIL8: return 4;
+            case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+            case GL_RGBA32F: return 16;
+            default: return 4;
+        }
+    }
+
+    void FrameGraph::reset(glm::ivec2 backbufferSize, const std::string& label){
+        this->backbufferSize = backbufferSize;
+        this->label = label;
+        resources.clear();
+        passes.clear();
+        compiled = false;
+    }
+
+    FrameResource FrameGraph::createTexture(const std::string& name, GLenum format, glm::ivec2 size){
+        Resource resource;
+        resource.name = name;
+        resource.format = format;
+        resource.size = size;
+        resources.push_back(resource);
+        compiled = false;
+        return (FrameResource)resources.size() - 1;
+    }
+
+    void FrameGraph::addPass(const std::string& name, const std::vector<FrameResource>& reads,
+                             const std::vector<FrameResource>& writes, std::function<void()> execute){
+        Pass pass;
+        pass.name = name;
+        pass.reads = reads;
+        pass.writes = writes;
+        pass.execute = execute;
+        for(FrameResource resource : writes){
+            if(resource == Backbuffer) continue;
+            if(resources[resource].producer != -1)
+                std::cerr << "FrameGraph: " << resources[resource].name << " is written by more than one pass" << std::endl;
+            resources[resource].producer = (int)passes.size();
+        }
+        passes.push_back(pass);
+        compiled = false;
+    }
+
+    bool FrameGraph::isAllocated(FrameResource resource) const {
+        return resource != Backbuffer && resources[resource].pooled != -1;
+    }
+
+    void FrameGraph::cull(){
+        // Every pass starts referenced by the targets it writes and every target by the passes reading it
+        // A pass reading back its own output (like a ping-pong blur) doesn't keep itself alive
+        for(int i = 0; i < (int)passes.size(); i++){
+            Pass& pass = passes[i];
+            pass.refCount = (int)pass.writes.size();
+            pass.culled = false;
+            for(FrameResource resource : pass.reads)
+                if(resource != Backbuffer && resources[resource].producer != i) resources[resource].readers++;
+        }
+        // Then we repeatedly remove the targets that no one reads, which dereferences the pass writing them.
+        // A pass that isn't referenced anymore is culled and stops referencing the targets it reads.
+        // Since nothing removes the backbuffer, the passes writing to it (and all their inputs) survive.
+        std::vector<FrameResource> unread;
+        for(size_t i = 0; i < resources.size(); i++)
+            if(resources[i].readers == 0) unread.push_back((FrameResource)i);
+        while(!unread.empty()){
+            Resource& resource = resources[unread.back()];
+            unread.pop_back();
+            if(resource.producer == -1) continue;
+            Pass& producer = passes[resource.producer];
+            if(--producer.refCount > 0) continue;
+            producer.culled = true;
+            for(FrameResource read : producer.reads)
+                if(read != Backbuffer && --resources[read].readers == 0) unread.push_back(read);
+        }
+    }
+
+    void FrameGraph::allocate(){
+        // Compute the lifetime of every target used by the surviving passes.
+        // Color outputs that no surviving pass reads are not allocated at all, but depth targets are kept
+        // since the pass writing them still needs them for depth (and stencil) testing.
+        // Targets read by a surviving pass (including the pass writing them) are always allocated.
+        for(int i = 0; i < (int)passes.size(); i++){
+            if(passes[i].culled) continue;
+            for(auto* list : {&passes[i].reads, &passes[i].writes}){
+                for(FrameResource id : *list){
+                    if(id == Backbuffer) continue;
+                    Resource& resource = resources[id];
+                    bool read = list == &passes[i].reads;
+                    if(!read && resource.readers == 0 && resource.firstUse == -1 && !isDepthFormat(resource.format)) continue;
+                    if(resource.firstUse == -1) resource.firstUse = i;
+                    resource.lastUse = i;
+                }
+            }
+        }
+
+        // Assign the targets to pooled textures in the order they are first used.
+        // A pooled texture can be reused once the last pass using its previous target is done.
+        for(auto& entry : pool) entry.lastUse = -1;
+        std::vector<bool> claimed(pool.size(), false);
+        for(int i = 0; i < (int)passes.size(); i++){
+            for(auto* list : {&passes[i].writes, &passes[i].reads}){
+                for(FrameResource id : *list){
+                    if(id == Backbuffer) continue;
+                    Resource& resource = resources[id];
+                    if(resource.firstUse != i || resource.pooled != -1) continue;
+                    for(size_t p = 0; p < pool.size(); p++){
+                        PooledTexture& entry = pool[p];
+                        if(entry.format != resource.format || entry.size != resource.size) continue;
+                        if(claimed[p] && entry.lastUse >= i) continue;
+                        resource.pooled = (int)p;
+                        break;
+                    }
+                    if(resource.pooled == -1){
+                        pool.push_back({texture_utils::empty(resource.format, resource.size), resource.format, resource.size, -1});
+                        claimed.push_back(false);
+                        resource.pooled = (int)pool.size() - 1;
+                    }
+                    claimed[resource.pooled] = true;
+                    pool[resource.pooled].lastUse = resource.lastUse;
+                }
+            }
+        }
+
+        // Release the textures that this configuration doesn't need (e.g. the bloom targets after disabling bloom)
+        std::vector<int> remap(pool.size(), -1);
+        std::vector<PooledTexture> kept;
+        for(size_t p = 0; p < pool.size(); p++){
+            if(claimed[p]){
+                remap[p] = (int)kept.size();
+                kept.push_back(pool[p]);
+            } else {
+                delete pool[p].texture;
+            }
+        }
+        pool = kept;
+        for(auto& resource : resources)
+            if(resource.pooled != -1) resource.pooled = remap[resource.pooled];
+    }
+
+    void FrameGraph::compile(){
+        releaseFramebuffers();
+        for(auto& resource : resources){
+            resource.readers = 0;
+            resource.firstUse = resource.lastUse = -1;
+            resource.pooled = -1;
+        }
+        cull();
+        allocate();
+
+        // Create the framebuffer of each pass, a pass writing to the backbuffer renders to the default framebuffer
+        size_t culledCount = 0;
+        for(auto& pass : passes){
+            if(pass.culled){
+                culledCount++;
+                continue;
+            }
+            bool toBackbuffer = std::find(pass.writes.begin(), pass.writes.end(), Backbuffer) != pass.writes.end();
+            pass.framebuffer = toBackbuffer ? 0 : getFramebuffer(pass.writes);
+            pass.viewport = backbufferSize;
+            for(FrameResource resource : pass.writes){
+                if(resource != Backbuffer){
+                    pass.viewport = resources[resource].size;
+                    break;
+                }
+            }
+        }
+
+        // Report the memory used by this configuration, with and without aliasing
+        peakBytes = unaliasedBytes = 0;
+        size_t allocatedCount = 0;
+        for(auto& entry : pool)
+            peakBytes += getBytesPerPixel(entry.format) * entry.size.x * entry.size.y;
+        for(auto& resource : resources){
+            if(resource.pooled == -1) continue;
+            allocatedCount++;
+            unaliasedBytes += getBytesPerPixel(resource.format) * resource.size.x * resource.size.y;
+        }
+        std::cout << "FrameGraph [" << label << "]: " << passes.size() - culledCount << " passes ("
+                  << culledCount << " culled), " << allocatedCount << " targets in " << pool.size()
+                  << " textures, peak VRAM " << std::fixed << std::setprecision(2) << peakBytes / (1024.0 * 1024.0)
+                  << " MB (" << unaliasedBytes / (1024.0 * 1024.0) << " MB without aliasing)"
+                  << std::defaultfloat << std::endl;
+        compiled = true;
+    }
+
+    void FrameGraph::execute(){
+        if(!compiled) compile();
+        for(auto& pass : passes){
+            if(pass.culled) continue;
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+            glViewport(0, 0, pass.viewport.x, pass.viewport.y);
+            pass.execute();
+        }
+    }
+
+    Texture2D* FrameGraph::getTexture(FrameResource resource) const {
+        if(!isAllocated(resource)) return nullptr;
+        return pool[resources[resource].pooled].texture;
+    }
+
+    GLuint FrameGraph::getFramebuffer(const std::vector<FrameResource>& targets){
+        std::vector<GLuint> key;
+        for(FrameResource resource : targets){
+            if(resource == Backbuffer) return 0;
+            key.push_back(isAllocated(resource) ? getTexture(resource)->getOpenGLName() : 0);
+        }
+        if(auto it = framebuffers.find(key); it != framebuffers.end()) return it->second;
+
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        std::vector<GLenum> drawBuffers;
+        for(size_t i = 0; i < targets.size(); i++){
+            const Resource& resource = resources[targets[i]];
+            if(isDepthFormat(resource.format)){
+                GLenum attachment = (resource.format == GL_DEPTH24_STENCIL8 || resource.format == GL_DEPTH32F_STENCIL8)
+                                    ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, key[i], 0);
+            } else {
+                // Culled outputs keep their slot so the fragment shader output locations still match
+                GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+                if(key[i]) glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, key[i], 0);
+                drawBuffers.push_back(key[i] ? attachment : GL_NONE);
+            }
+        }
+        if(drawBuffers.empty()) glDrawBuffer(GL_NONE);
+        else glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        framebuffers[key] = framebuffer;
+        return framebuffer;
+    }
+
+    void FrameGraph::releaseFramebuffers(){
+        for(auto& [key, framebuffer] : framebuffers)
+            glDeleteFramebuffers(1, &framebuffer);
+        framebuffers.clear();
+    }
+
+    void FrameGraph::destroy(){
+        releaseFramebuffers();
+        for(auto& entry : pool) delete entry.texture;
+        pool.clear();
+        resources.clear();
+        passes.clear();
+        compiled = false;
+    }
+
+}
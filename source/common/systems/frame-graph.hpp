@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../texture/texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace portal
+{
+
+    // A handle to a render target declared in the frame graph
+    typedef int FrameResource;
+
+    // A small frame graph used by the renderer to schedule its full screen passes.
+    // Every pass declares the render targets it reads and writes, then "compile":
+    // - culls the passes whose output never reaches the screen (and the color outputs nobody reads)
+    // - computes the lifetime (first and last pass) of every transient render target
+    // - assigns textures from a pool such that targets with non overlapping lifetimes share the same texture
+    // The graph is only recompiled when the declared passes change (e.g. when bloom is toggled)
+    class FrameGraph {
+    public:
+        // The default framebuffer, passes writing to it are never culled
+        static constexpr FrameResource Backbuffer = -1;
+
+    private:
+        struct Resource {
+            std::string name;
+            GLenum format;
+            glm::ivec2 size;
+            // The pass that writes this target (-1 if none)
+            int producer = -1;
+            // The number of (non culled) passes that read this target
+            int readers = 0;
+            // The first and last (non culled) pass using this target
+            int firstUse = -1, lastUse = -1;
+            // The index of the pooled texture assigned to this target (-1 if it is not allocated)
+            int pooled = -1;
+        };
+
+        struct Pass {
+            std::string name;
+            std::vector<FrameResource> reads, writes;
+            std::function<void()> execute;
+            int refCount = 0;
+            bool culled = false;
+            GLuint framebuffer = 0;
+            glm::ivec2 viewport;
+        };
+
+        struct PooledTexture {
+            Texture2D* texture;
+            GLenum format;
+            glm::ivec2 size;
+            // The last pass using this texture in the current configuration (-1 if it is free)
+            int lastUse;
+        };
+
+        std::string label;
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        // The pool is kept between compilations so textures are only reallocated when the configuration needs more of them
+        std::vector<PooledTexture> pool;
+        // Framebuffers are cached by the names of their attachments
+        std::map<std::vector<GLuint>, GLuint> framebuffers;
+        glm::ivec2 backbufferSize;
+        size_t peakBytes = 0, unaliasedBytes = 0;
+        bool compiled = false;
+
+        bool isAllocated(FrameResource resource) const;
+        void cull();
+        void allocate();
+        void releaseFramebuffers();
+
+    public:
+        // Clears all the declared passes and targets (the pooled textures are kept for the next configuration)
+        // label is only used to name the configuration in the log
+        void reset(glm::ivec2 backbufferSize, const std::string& label);
+        // Declares a transient render target
+        FrameResource createTexture(const std::string& name, GLenum format, glm::ivec2 size);
+        // Declares a pass, passes are executed in the order they were added
+        void addPass(const std::string& name, const std::vector<FrameResource>& reads,
+                     const std::vector<FrameResource>& writes, std::function<void()> execute);
+        // Culls the unused passes, allocates the targets and creates the framebuffers of every pass
+        void compile();
+        // Binds the framebuffer of each non culled pass and executes it (compiles the graph if needed)
+        void execute();
+        // Deletes all the pooled textures and framebuffers
+        void destroy();
+
+        // Returns the texture assigned to the given target (nullptr if it was culled)
+        Texture2D* getTexture(FrameResource resource) const;
+        // Returns a (cached) framebuffer with the given targets attached in order, useful for passes that need
+        // to switch between their outputs (like a ping-pong blur). Culled color targets are attached as GL_NONE
+        GLuint getFramebuffer(const std::vector<FrameResource>& targets);
+
+        // The memory used by the render targets of the current configuration after and before aliasing
+        size_t getPeakBytes() const { return peakBytes; }
+        size_t getUnaliasedBytes() const { return unaliasedBytes; }
+    };
+
+}
@@ -143,9 +143,10 @@ namespace portal
             entity->localTransform.setRotation(rotation);
             RigidBodyComponent* rgb = entity->getComponent<RigidBodyComponent>();
             if (rgb){
+                // Only the orientation is set, the position of the entity is interpolated between physics steps
+                // so it trails the body (see "MovementSystem")
                 r3d::Transform transform = rgb->getBody()->getTransform();
                 transform.setOrientation(qt);
-                transform.setPosition(entity->localTransform.getPosition() + rgb->relativePosition);
                 rgb->getBody()->setTransform(transform);
             }
 
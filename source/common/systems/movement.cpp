@@ -1,32 +1,10 @@
 #include "movement.hpp"
 #include <glm/gtc/type_ptr.hpp>
+#include <cmath>
 
 namespace portal {
 
-    // Class Handle player Grounded
-    class RayCastPlayerGrounded : public r3d::RaycastCallback {
-        bool& isGrounded;
-        public:
-        RayCastPlayerGrounded(bool& isGrounded) : isGrounded(isGrounded) {}
-        /// Called when a raycast hit a body
-        /**
-         * @param hit The raycast hit information
-         */
-        virtual r3d::decimal notifyRaycastHit(const r3d::RaycastInfo& raycastInfo) override {
-            // is grounded 
-            // std::cout << "Player Grounded: " << *((std::string*)raycastInfo.body->getUserData()) << std::endl;
-            if(raycastInfo.body->getCollider(0)->getCollideWithMaskBits() != 0x0001 || raycastInfo.body->getCollider(0)->getIsTrigger()){
-                // if trigger, return 1.0 to continue raycast
-                return r3d::decimal(1.0);
-            }
-            isGrounded = true;
-            // return 0 to stop raycast
-            return r3d::decimal(0.0);
-        }
-    };
-
     void MovementSystem::checkForGround() {
-        RayCastPlayerGrounded rayCastHandler(isGrounded);
         // get player position and bounds
         r3d::Vector3 pos, min, max;
         pos = playerRigidBody->getBody()->getTransform().getPosition();
@@ -34,8 +12,12 @@ namespace portal {
         // RayCast to check if player is grounded
         r3d::decimal y = max.y - min.y;
         // Ray Cast from center of player to bottom of player
-        r3d::Ray ray(pos, pos - r3d::Vector3(0, y/2, 0));
-        physicsWorld->raycast(ray, &rayCastHandler);
+        r3d::Vector3 end = pos - r3d::Vector3(0, y/2, 0);
+        // The player can't stand on the triggers or on the object it holds, any hit is enough to be grounded
+        QueryFilter filter;
+        filter.layers = world->getCollisionLayers().getBitsExcept({"Trigger", "Held"});
+        filter.ignoredBody = playerRigidBody->getBody();
+        if(world->getSceneQuery().raycastAny(glm::vec3(pos.x, pos.y, pos.z), glm::vec3(end.x, end.y, end.z), filter)) isGrounded = true;
     }
 
 
@@ -44,20 +26,28 @@ namespace portal {
             // if space pressed make sure to update isGrounded
             checkForGround();
         }
-        // Constant physics time step (60 FPS)
-        const float timeStep = 1.0f / 60.0f;
-        float delta = deltaTime;
-        while(delta > 0.0f){
-            // If the remaining time is smaller than the time step, use the remaining time
+        // Collect the bodies moved by the simulation to keep their last two states
+        movingBodies.clear();
+        for(const auto& [name, entity] : world->getEntities()){
+            RigidBodyComponent* rgb = entity->getComponent<RigidBodyComponent>();
+            if(rgb && rgb->getBody()->getType() != r3d::BodyType::STATIC) movingBodies.push_back(rgb);
+        }
+        // Accumulate the frame time and consume it in constant steps, so the simulation doesn't depend on the frame rate
+        accumulator += deltaTime;
+        int steps = 0;
+        while(accumulator >= TimeStep && steps < MaxSubsteps){
             glm::vec3 vel = handlePlayerMovement();
             r3d::Vector3 linearVelocity = playerRigidBody->getBody()->getLinearVelocity();
             playerRigidBody->getBody()->setLinearVelocity(r3d::Vector3(vel.x, linearVelocity.y, vel.z));
-            float step = glm::min(delta, timeStep);
+            for(RigidBodyComponent* rgb : movingBodies) rgb->beginStep();
             // Update the physics world
-            physicsWorld->update(step);
-            // Subtract the time step from the remaining time
-            delta -= step;
+            physicsWorld->update(TimeStep);
+            for(RigidBodyComponent* rgb : movingBodies) rgb->endStep();
+            accumulator -= TimeStep;
+            steps++;
         }
+        // After a hitch the simulation falls behind instead of stalling the next frames with more steps
+        if(accumulator >= TimeStep) accumulator = std::fmod(accumulator, TimeStep);
     }
 
     glm::vec3 MovementSystem::handlePlayerMovement() {
@@ -30,6 +30,13 @@ namespace portal {
         double JumpCoolDown = 0.2;
         std::string attachedName = "";
         Entity* attachement = nullptr;
+        // The physics world is stepped with a constant time step: the frame time is accumulated and consumed in whole steps,
+        // at most "MaxSubsteps" per frame so a long frame can't make the next frames longer (the rest of its time is dropped)
+        static constexpr float TimeStep = 1.0f / 60.0f;
+        static constexpr int MaxSubsteps = 5;
+        float accumulator = 0.0f;
+        // The bodies moved by the simulation (collected every frame)
+        std::vector<RigidBodyComponent*> movingBodies;
 
         // Handles all physics updates
         void physicsUpdate(float deltaTime);
@@ -55,6 +62,9 @@ namespace portal {
             if(!physicsWorld) return;
             player->update();
             physicsUpdate(deltaTime);
+            // The time left in the accumulator is a fraction of a step, the bodies are rendered this far
+            // between their last two physics states
+            float interpolation = accumulator / TimeStep;
             // For each entity in the world
             for(const auto& [name, entity] : world->getEntities()){
                 if(player->getAttachement() && entity == player->getAttachement()) {
@@ -80,7 +90,7 @@ namespace portal {
                 if(rgb){
                     if(rgb->getBody()->getType() == r3d::BodyType::STATIC) continue;
                     FreeCameraControllerComponent* fcc = entity->getComponent<FreeCameraControllerComponent>();
-                    r3d::Transform transform = rgb->getBody()->getTransform();
+                    r3d::Transform transform = rgb->getInterpolatedTransform(interpolation);
                     transform.setPosition(transform.getPosition() - transform.getOrientation() * rgb->relativePosition);
                     if(fcc){
                         // orientation stays the same
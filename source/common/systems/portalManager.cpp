@@ -578,9 +578,9 @@ namespace portal {
                 
         Portal* otherPortal =  nullptr;
         if(portal == Portal_1){
-            if(isPortal2Shot) otherPortal = Portal_2;
+            if(Portal_2->isPlaced) otherPortal = Portal_2;
         } else {
-            if(isPortal1Shot) otherPortal = Portal_1;
+            if(Portal_1->isPlaced) otherPortal = Portal_1;
         }
 
         if(getCorrectedPortalPos(surface, otherPortal, hitPoint, up, right, front)){
@@ -607,47 +607,48 @@ namespace portal {
         return true;
     }
 
+    bool PortalManager::getAimedSurface(QueryHit& hit){
+        // RayCast from player position to front direction with length portalMaxDistance
+        r3d::Vector3 from = player->localTransform.getPosition() + player->getAbsoluteFront() * 0.5f;
+        r3d::Vector3 to = player->getAbsoluteFront() * portalMaxDistance + player->localTransform.getPosition();
+        QueryFilter filter;
+        filter.layers = world->getCollisionLayers().getBitsExcept({"Trigger", "Held"});
+        return world->getSceneQuery().raycastClosest(glm::vec3(from.x, from.y, from.z), glm::vec3(to.x, to.y, to.z), hit, filter);
+    }
+
     void PortalManager::checkPortalShot(){
          // Check if Mouse left is pressed
         if(app->getMouse().justPressed(GLFW_MOUSE_BUTTON_1)) {
-            std::string name = "";
-            glm::vec3 hitPoint = glm::vec3(0.0f, 0.0f, 0.0f);
-            // RayCast from player position to front direction with length 50
-            r3d::Ray ray(player->localTransform.getPosition() + player->getAbsoluteFront() * 0.5f,player->getAbsoluteFront() * portalMaxDistance + player->localTransform.getPosition());
-            physicsWorld->raycast(ray, new RayCastPortal(name, hitPoint));
-            if(name.empty()) return;
-            // get entity with current name and check if it is can hold a portal
-            Entity *potentialPortalSurface = player->getWorld()->getEntityByName(name);
+            QueryHit hit;
+            if(!getAimedSurface(hit)) return;
+            // check if the surface can hold a portal
+            Entity *potentialPortalSurface = hit.entity;
             if(potentialPortalSurface->canHoldPortal) {
                 // if portal can be placed, place it
-                if(!castPortal(potentialPortalSurface, Portal_1, hitPoint)) return;
+                if(!castPortal(potentialPortalSurface, Portal_1, hit.point)) return;
                 
-                isPortal1Shot = true;
+                Portal_1->isPlaced = true;
 
-                if(isPortal2Shot){
+                if(Portal_2->isPlaced){
                     Portal_1->setDestination(Portal_2);
                     Portal_2->setDestination(Portal_1);
                 }
             }
 
         } else if (app->getMouse().justPressed(GLFW_MOUSE_BUTTON_2)) {
-            std::string name = "";
-            glm::vec3 hitPoint = glm::vec3(0.0f, 0.0f, 0.0f);
-            // RayCast from player position to front direction with length 50
-            r3d::Ray ray(player->localTransform.getPosition() + player->getAbsoluteFront() * 0.5f, player->getAbsoluteFront() * portalMaxDistance + player->localTransform.getPosition());
-            physicsWorld->raycast(ray, new RayCastPortal(name, hitPoint));
-            if(name.empty()) return;
-            // get entity with current name and check if it can hold a portal
-            Entity *potentialPortalSurface = player->getWorld()->getEntityByName(name);
+            QueryHit hit;
+            if(!getAimedSurface(hit)) return;
+            // check if the surface can hold a portal
+            Entity *potentialPortalSurface = hit.entity;
             
             // if portal can be placed, place it
             if(potentialPortalSurface->canHoldPortal) {
-                if(!castPortal(potentialPortalSurface, Portal_2, hitPoint)) return;
+                if(!castPortal(potentialPortalSurface, Portal_2, hit.point)) return;
 
-                isPortal2Shot = true;
+                Portal_2->isPlaced = true;
 
                 // if both portals are shot, set the destination of each portal to the other
-                if(isPortal1Shot){
+                if(Portal_1->isPlaced){
                     Portal_1->setDestination(Portal_2);
                     Portal_2->setDestination(Portal_1);
                 }
@@ -12,32 +12,6 @@ namespace r3d = reactphysics3d;
 namespace portal {
     class PortalManager {
     private:
-        // Class Handle portal shooting
-        class RayCastPortal : public r3d::RaycastCallback {
-            std::string& surfaceName;
-            glm::vec3& hitPoint;
-            float distance = FLT_MAX;
-            public:
-            RayCastPortal(std::string& surfaceName, glm::vec3& hitPoint) : surfaceName(surfaceName) , hitPoint(hitPoint){}
-            // Called when a raycast hits a body
-            virtual r3d::decimal notifyRaycastHit(const r3d::RaycastInfo& raycastInfo) override {
-                // Get the name of the body that has been hit
-                if(raycastInfo.body->getCollider(0)->getIsTrigger()){
-                    // if trigger, return 1.0 to continue raycast
-                    return r3d::decimal(1.0);
-                }
-                if(raycastInfo.hitFraction < distance){
-                    distance = raycastInfo.hitFraction;
-                    // update hit point and surface name
-                    surfaceName = *((std::string*)raycastInfo.body->getUserData());
-                    hitPoint = glm::vec3(raycastInfo.worldPoint.x, raycastInfo.worldPoint.y, raycastInfo.worldPoint.z);
-                    // std::cout << "RayCast Hit" << surfaceName << " at " << hitPoint.x << " " << hitPoint.y << " " << hitPoint.z << std::endl;
-                }
-                return r3d::decimal(1.0);
-
-            }
-        };
-
         struct Rectangle {
             glm::vec2 topLeft;
             glm::vec2 topRight;
@@ -62,12 +36,12 @@ namespace portal {
         // Hold portals 
         Portal* Portal_1 = nullptr;
         Portal* Portal_2 = nullptr;
-        bool isPortal1Shot = false;
-        bool isPortal2Shot = false;
         float portalMaxDistance = 100.0f;
         
         // Validates and casts portals
         void checkPortalShot();
+        // Casts a ray in front of the player and returns the closest surface it hits (the triggers and held objects are skipped)
+        bool getAimedSurface(QueryHit& hit);
         // Casts a portal
         bool castPortal(Entity* surface, Portal* portal, glm::vec3 hitPoint);
         
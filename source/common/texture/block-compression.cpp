@@ -0,0 +1,254 @@
+#include "block-compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace portal::block_compression {
+
+    int getBlockSize(Format format){
+        return format == Format::BC1 ? 8 : 16;
+    }
+
+    size_t getCompressedSize(Format format, int width, int height){
+        return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * getBlockSize(format);
+    }
+
+    // Finds two endpoints along the principal axis of the pixels of a block
+    // Only the first "channels" channels of every pixel are considered
+    static void fitEndpoints(const uint8_t block[64], int channels, float low[4], float high[4]){
+        float mean[4] = {0, 0, 0, 0};
+        for(int i = 0; i < 16; i++)
+            for(int c = 0; c < channels; c++)
+                mean[c] += block[4 * i + c] / 16.0f;
+        float covariance[4][4] = {};
+        for(int i = 0; i < 16; i++){
+            for(int a = 0; a < channels; a++){
+                for(int b = 0; b < channels; b++){
+                    covariance[a][b] += (block[4 * i + a] - mean[a]) * (block[4 * i + b] - mean[b]);
+                }
+            }
+        }
+        // A few iterations of the power method are enough to find the direction with the largest variance
+        float axis[4] = {1, 1, 1, 1};
+        for(int iteration = 0; iteration < 8; iteration++){
+            float next[4] = {0, 0, 0, 0};
+            for(int a = 0; a < channels; a++)
+                for(int b = 0; b < channels; b++)
+                    next[a] += covariance[a][b] * axis[b];
+            float length = 0;
+            for(int c = 0; c < channels; c++) length = std::max(length, std::abs(next[c]));
+            // All the pixels are the same, any axis will do
+            if(length < 1e-6f) break;
+            for(int c = 0; c < channels; c++) axis[c] = next[c] / length;
+        }
+        float length = 0;
+        for(int c = 0; c < channels; c++) length += axis[c] * axis[c];
+        length = std::sqrt(length);
+        for(int c = 0; c < channels; c++) axis[c] /= length;
+
+        float minT = 0, maxT = 0;
+        for(int i = 0; i < 16; i++){
+            float t = 0;
+            for(int c = 0; c < channels; c++) t += (block[4 * i + c] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        for(int c = 0; c < channels; c++){
+            low[c] = std::clamp(mean[c] + minT * axis[c], 0.0f, 255.0f);
+            high[c] = std::clamp(mean[c] + maxT * axis[c], 0.0f, 255.0f);
+        }
+    }
+
+    static uint16_t packRGB565(const float color[4]){
+        int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+        int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+        int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackRGB565(uint16_t packed, int color[3]){
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    void encodeBC1(const uint8_t block[64], uint8_t out[8]){
+        float low[4], high[4];
+        fitEndpoints(block, 3, low, high);
+        uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+        // color0 must be larger than color1 to select the 4 colors mode (instead of 3 colors + transparent black)
+        if(color0 < color1) std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if(color0 != color1){
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for(int c = 0; c < 3; c++){
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for(int i = 0; i < 16; i++){
+                int best = 0, bestError = INT32_MAX;
+                for(int p = 0; p < 4; p++){
+                    int error = 0;
+                    for(int c = 0; c < 3; c++){
+                        int difference = block[4 * i + c] - palette[p][c];
+                        error += difference * difference;
+                    }
+                    if(error < bestError){
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+        out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+        out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+        for(int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    // Encodes a single channel of the block (the BC4 block used by BC3 for alpha and twice by BC5)
+    static void encodeSingleChannel(const uint8_t block[64], int channel, uint8_t out[8]){
+        int minimum = 255, maximum = 0;
+        for(int i = 0; i < 16; i++){
+            minimum = std::min(minimum, (int)block[4 * i + channel]);
+            maximum = std::max(maximum, (int)block[4 * i + channel]);
+        }
+        // Since maximum > minimum, the decoder uses the 8 values mode
+        out[0] = (uint8_t)maximum;
+        out[1] = (uint8_t)minimum;
+        uint64_t indices = 0;
+        if(maximum != minimum){
+            int palette[8] = {maximum, minimum};
+            for(int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * maximum + p * minimum) / 7;
+            for(int i = 0; i < 16; i++){
+                int best = 0, bestError = INT32_MAX;
+                for(int p = 0; p < 8; p++){
+                    int error = std::abs(block[4 * i + channel] - palette[p]);
+                    if(error < bestError){
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint64_t)best << (3 * i);
+            }
+        }
+        for(int i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    void encodeBC3(const uint8_t block[64], uint8_t out[16]){
+        encodeSingleChannel(block, 3, out);
+        encodeBC1(block, out + 8);
+    }
+
+    void encodeBC5(const uint8_t block[64], uint8_t out[16]){
+        encodeSingleChannel(block, 0, out);
+        encodeSingleChannel(block, 1, out + 8);
+    }
+
+    // Writes bits starting from the least significant bit of the block (as expected by BC7)
+    struct BitWriter {
+        uint8_t* out;
+        int position = 0;
+        void write(uint32_t value, int bits){
+            for(int i = 0; i < bits; i++, position++){
+                if((value >> i) & 1) out[position >> 3] |= (uint8_t)(1 << (position & 7));
+            }
+        }
+    };
+
+    void encodeBC7(const uint8_t block[64], uint8_t out[16]){
+        // Mode 6 has a single subset with RGBA endpoints (7 bits per channel + a shared bit per endpoint)
+        // and 4 bits indices which gives a good quality for both opaque and transparent blocks
+        static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+        float endpoints[2][4];
+        fitEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+        // Quantize each endpoint picking the shared (parity) bit with the least error
+        int quantized[2][4], parity[2], color[2][4];
+        for(int e = 0; e < 2; e++){
+            float bestError = -1;
+            for(int p = 0; p < 2; p++){
+                int q[4];
+                float error = 0;
+                for(int c = 0; c < 4; c++){
+                    q[c] = std::clamp((int)std::lround((endpoints[e][c] - p) / 2.0f), 0, 127);
+                    float difference = (float)((q[c] << 1) | p) - endpoints[e][c];
+                    error += difference * difference;
+                }
+                if(bestError < 0 || error < bestError){
+                    bestError = error;
+                    parity[e] = p;
+                    std::copy(q, q + 4, quantized[e]);
+                }
+            }
+            for(int c = 0; c < 4; c++) color[e][c] = (quantized[e][c] << 1) | parity[e];
+        }
+
+        int indices[16];
+        for(int i = 0; i < 16; i++){
+            int best = 0, bestError = INT32_MAX;
+            for(int w = 0; w < 16; w++){
+                int error = 0;
+                for(int c = 0; c < 4; c++){
+                    int value = ((64 - weights[w]) * color[0][c] + weights[w] * color[1][c] + 32) >> 6;
+                    int difference = block[4 * i + c] - value;
+                    error += difference * difference;
+                }
+                if(error < bestError){
+                    bestError = error;
+                    best = w;
+                }
+            }
+            indices[i] = best;
+        }
+        // The most significant bit of the first index is implicitly 0, so we swap the endpoints if it is set
+        if(indices[0] & 8){
+            for(int c = 0; c < 4; c++) std::swap(quantized[0][c], quantized[1][c]);
+            std::swap(parity[0], parity[1]);
+            for(int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+        }
+
+        std::memset(out, 0, 16);
+        BitWriter writer{out};
+        writer.write(1 << 6, 7);
+        for(int c = 0; c < 4; c++){
+            writer.write(quantized[0][c], 7);
+            writer.write(quantized[1][c], 7);
+        }
+        writer.write(parity[0], 1);
+        writer.write(parity[1], 1);
+        writer.write(indices[0], 3);
+        for(int i = 1; i < 16; i++) writer.write(indices[i], 4);
+    }
+
+    std::vector<uint8_t> compress(Format format, const uint8_t* rgba, int width, int height){
+        std::vector<uint8_t> result(getCompressedSize(format, width, height));
+        int blockSize = getBlockSize(format);
+        uint8_t* out = result.data();
+        uint8_t block[64];
+        for(int by = 0; by < height; by += 4){
+            for(int bx = 0; bx < width; bx += 4){
+                // Gather the 4x4 block (clamping at the edges of the image)
+                for(int y = 0; y < 4; y++){
+                    for(int x = 0; x < 4; x++){
+                        int sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+                        std::memcpy(block + 4 * (4 * y + x), rgba + 4 * ((size_t)sy * width + sx), 4);
+                    }
+                }
+                switch(format){
+                    case Format::BC1: encodeBC1(block, out); break;
+                    case Format::BC3: encodeBC3(block, out); break;
+                    case Format::BC5: encodeBC5(block, out); break;
+                    case Format::BC7: encodeBC7(block, out); break;
+                }
+                out += blockSize;
+            }
+        }
+        return result;
+    }
+}
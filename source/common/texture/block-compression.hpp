@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace portal::block_compression {
+
+    // The block compressed formats the texture baker can encode
+    // Every format compresses blocks of 4x4 pixels:
+    // - BC1: RGB (8 bytes per block, 4 bits per pixel)
+    // - BC3: RGBA with a separate alpha block (16 bytes per block, 8 bits per pixel)
+    // - BC5: two independent channels (RG) useful for normal maps (16 bytes per block)
+    // - BC7: RGBA with better quality than BC3 (16 bytes per block), only mode 6 is used by the encoder
+    enum class Format {
+        BC1,
+        BC3,
+        BC5,
+        BC7
+    };
+
+    // Returns the size of a single 4x4 block in bytes
+    int getBlockSize(Format format);
+    // Returns the size of a compressed image with the given size in bytes
+    size_t getCompressedSize(Format format, int width, int height);
+
+    // Each of these function encodes a single 4x4 block given as 16 RGBA pixels (row by row)
+    void encodeBC1(const uint8_t block[64], uint8_t out[8]);
+    void encodeBC3(const uint8_t block[64], uint8_t out[16]);
+    void encodeBC5(const uint8_t block[64], uint8_t out[16]);
+    void encodeBC7(const uint8_t block[64], uint8_t out[16]);
+
+    // Compresses an RGBA8 image, the edges of images whose size is not a multiple of 4 are padded by clamping
+    std::vector<uint8_t> compress(Format format, const uint8_t* rgba, int width, int height);
+}
@@ -0,0 +1,63 @@
+#include "staging-ring.hpp"
+
+#include <chrono>
+
+namespace portal {
+
+    StagingRing::StagingRing(size_t slotCount, size_t maxSlotSize) : slots(slotCount), maxSlotSize(maxSlotSize) {
+        for(auto& slot : slots) glGenBuffers(1, &slot.buffer);
+    }
+
+    StagingRing::~StagingRing(){
+        for(auto& slot : slots){
+            if(slot.fence) glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    void* StagingRing::map(size_t size){
+        if(size == 0 || size > maxSlotSize) return nullptr;
+        current = (current + 1) % slots.size();
+        Slot& slot = slots[current];
+        // Wait until the GPU is done reading the previous upload of this slot
+        if(slot.fence){
+            auto start = std::chrono::high_resolution_clock::now();
+            while(glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        // The slots grow to the largest upload they staged
+        if(slot.capacity < size){
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            slot.capacity = size;
+        }
+        // The fence guarantees the GPU is done with the slot, so the driver doesn't need to synchronize
+        void* pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(!pointer){
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return nullptr;
+        }
+        staging = true;
+        stagedBytes += size;
+        return pointer;
+    }
+
+    bool StagingRing::unmap(){
+        if(!staging) return false;
+        if(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE) return true;
+        // The content of the buffer is undefined, nothing reads the slot so it doesn't need a fence
+        staging = false;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+
+    void StagingRing::release(){
+        if(!staging) return;
+        staging = false;
+        slots[current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+}
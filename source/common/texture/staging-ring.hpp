@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace portal {
+
+    // A ring of pixel unpack buffers used to stage the texture uploads
+    // The pixels are copied into the next slot then the texture is filled from the buffer, so the driver copies
+    // them to the GPU asynchronously instead of stalling the upload call. Each slot is fenced after its texture commands
+    // and it is only reused once its fence is signaled, so the copies don't need the driver to synchronize the mapping.
+    // OpenGL 3.3 doesn't have persistent mapping, so the slots are mapped with "glMapBufferRange" (unsynchronized) for each upload.
+    // The buffers are shared objects but the ring binds and maps them, so it must only be used by one thread.
+    class StagingRing {
+        struct Slot {
+            GLuint buffer = 0;
+            size_t capacity = 0;
+            GLsync fence = nullptr;
+        };
+        std::vector<Slot> slots;
+        size_t current = 0;
+        // Uploads larger than this don't go through the ring (the slot would stay that large)
+        size_t maxSlotSize;
+        bool staging = false;
+    public:
+        // The number of bytes staged and the time spent waiting for a slot (in milliseconds)
+        size_t stagedBytes = 0;
+        double waitMilliseconds = 0;
+
+        explicit StagingRing(size_t slotCount = 4, size_t maxSlotSize = 64 << 20);
+        ~StagingRing();
+
+        // Maps "size" bytes of the next slot and returns the pointer to write to (nullptr if the upload is too large)
+        // The slot is bound to GL_PIXEL_UNPACK_BUFFER, so after "unmap", the texture functions read from it using the offsets
+        // into the slot as their pixel pointers
+        void* map(size_t size);
+        // Unmaps the slot (the pixels must be written), it stays bound for the texture functions
+        // Returns false if the content of the slot was lost while it was mapped (e.g. the display mode changed),
+        // the slot is then unbound and the pixels must be uploaded from client memory instead (no "release" is needed)
+        bool unmap();
+        // Fences the slot once the texture functions using it were called and unbinds it
+        void release();
+
+        StagingRing(const StagingRing&) = delete;
+        StagingRing& operator=(const StagingRing&) = delete;
+    };
+
+}
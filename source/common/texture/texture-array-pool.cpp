@@ -0,0 +1,218 @@
+#include "texture-array-pool.hpp"
+#include "../asset-loader.hpp"
+#include "../material/material.hpp"
+#include "../upload-queue.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+#include <tuple>
+
+namespace portal {
+
+    TextureArrayPool::ResolutionClass TextureArrayPool::describe(Texture2D* texture){
+        ResolutionClass result;
+        texture->bind();
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &result.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &result.height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &result.format);
+        GLint maxLevel;
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        Texture2D::unbind();
+        // Unsized formats can't be used for immutable storage
+        if(result.format == GL_RGBA) result.format = GL_RGBA8;
+        if(result.format == GL_RGB) result.format = GL_RGB8;
+        // The textures loaded with mipmaps have a full chain, the others are limited by GL_TEXTURE_MAX_LEVEL
+        GLint fullChain = 1;
+        for(GLint size = std::max(result.width, result.height); size > 1; size /= 2) fullChain++;
+        result.levels = std::min(fullChain, maxLevel + 1);
+        return result;
+    }
+
+    void TextureArrayPool::findMaterials(std::vector<LitMaterial*>& materials, std::set<Texture2D*>& sampledDirectly){
+        for(auto& [name, material] : AssetLoader<Material>::assets){
+            if(auto lit = dynamic_cast<LitMaterial*>(material); lit){
+                auto maps = lit->getMaps();
+                bool complete = std::all_of(maps.begin(), maps.end(), [](Texture2D* map){ return map != nullptr; });
+                if(complete) materials.push_back(lit);
+                else sampledDirectly.insert(maps.begin(), maps.end());
+            } else if(auto textured = dynamic_cast<TexturedMaterial*>(material); textured){
+                sampledDirectly.insert(textured->texture);
+            } else if(auto multi = dynamic_cast<MultiTextureMaterial*>(material); multi){
+                sampledDirectly.insert(multi->texture1);
+                sampledDirectly.insert(multi->texture2);
+            }
+        }
+    }
+
+    void TextureArrayPool::build(UploadQueue* uploads){
+        if(!GLAD_GL_VERSION_4_3 && !GLAD_GL_ARB_copy_image){
+            std::cout << "glCopyImageSubData is not supported, lit materials will bind their maps separately" << std::endl;
+            return;
+        }
+        // Find the lit materials that can use arrays and the textures that other materials sample directly
+        std::vector<LitMaterial*> materials;
+        std::set<Texture2D*> sampledDirectly;
+        findMaterials(materials, sampledDirectly);
+        // Textures packed for an earlier scene (and kept by "retainSharedAssets") may now be sampled directly by a material of this one
+        for(Texture2D* texture : sampledDirectly) restore(texture);
+        if(materials.empty()) return;
+
+        // Group the unique maps by resolution class
+        std::map<ResolutionClass, std::vector<Texture2D*>> groups;
+        for(auto material : materials){
+            for(Texture2D* map : material->getMaps()){
+                if(layers.count(map)) continue;
+                layers[map] = {nullptr, 0};
+                groups[describe(map)].push_back(map);
+            }
+        }
+
+        // The copies run now or in the drains of the queue (the layers are reserved now so the next build can't take them)
+        auto copy = [uploads](Texture2D* texture, Texture2DArray* array, const ResolutionClass& resolution, int layer){
+            if(uploads) uploads->defer([=](){ pack(texture, array, resolution, layer); });
+            else pack(texture, array, resolution, layer);
+        };
+        GLint maxLayers;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        size_t packedCount = 0, reusedCount = 0;
+        for(auto& [resolution, textures] : groups){
+            // The free layers of the arrays of the same class are used first (e.g. the layers of the textures of the previous scene)
+            size_t next = 0;
+            for(auto& pooled : arrays){
+                if(pooled.resolution != resolution) continue;
+                while(next < textures.size() && !pooled.freeLayers.empty()){
+                    copy(textures[next++], pooled.array, resolution, pooled.freeLayers.back());
+                    pooled.freeLayers.pop_back();
+                    reusedCount++;
+                }
+            }
+            // The remaining textures go to new arrays, split if there are more textures than the layers an array can hold
+            while(next < textures.size()){
+                GLsizei count = (GLsizei)std::min(textures.size() - next, (size_t)maxLayers);
+                PooledArray pooled{new Texture2DArray(), resolution, count, {}};
+                pooled.array->bind();
+                glTexStorage3D(GL_TEXTURE_2D_ARRAY, resolution.levels, resolution.format, resolution.width, resolution.height, count);
+                Texture2DArray::unbind();
+                for(GLsizei layer = 0; layer < count; layer++) copy(textures[next++], pooled.array, resolution, (int)layer);
+                arrays.push_back(std::move(pooled));
+            }
+            packedCount += textures.size();
+        }
+
+        if(uploads) uploads->defer(finishBuild);
+        else finishBuild();
+        std::cout << "Packed " << packedCount << " textures of " << materials.size() << " lit materials into "
+                  << arrays.size() << " texture arrays (" << reusedCount << " in the free layers of earlier scenes)" << std::endl;
+    }
+
+    void TextureArrayPool::pack(Texture2D* texture, Texture2DArray* array, const ResolutionClass& resolution, int layer){
+        // The texture may have been deleted before a deferred copy (its entry was then forgotten)
+        if(auto it = layers.find(texture); it == layers.end()){
+            auto pooled = std::find_if(arrays.begin(), arrays.end(), [&](const PooledArray& pooled){ return pooled.array == array; });
+            if(pooled != arrays.end()) pooled->freeLayers.push_back(layer);
+            return;
+        }
+        for(GLint level = 0; level < resolution.levels; level++){
+            glCopyImageSubData(texture->getOpenGLName(), GL_TEXTURE_2D, level, 0, 0, 0,
+                               array->getOpenGLName(), GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                               std::max(1, resolution.width >> level), std::max(1, resolution.height >> level), 1);
+        }
+        layers[texture] = {array, layer, resolution.width, resolution.height, resolution.format, resolution.levels, texture->getBytes()};
+    }
+
+    void TextureArrayPool::finishBuild(){
+        std::vector<LitMaterial*> materials;
+        std::set<Texture2D*> sampledDirectly;
+        findMaterials(materials, sampledDirectly);
+        for(auto material : materials) assign(material);
+        // The texture data now lives in the arrays, so keep the originals only if something else samples them
+        // (a material resolved later can still get them back through "restore")
+        for(auto& [texture, packed] : layers){
+            if(packed.array == nullptr || packed.released || sampledDirectly.count(texture)) continue;
+            texture->releaseStorage();
+            packed.released = true;
+        }
+        // The arrays were created and bound on the active unit, the materials bind theirs again
+        Texture2DArray::forgetBindings();
+    }
+
+    void TextureArrayPool::forget(Texture2D* texture){
+        auto it = layers.find(texture);
+        if(it == layers.end()) return;
+        Layer packed = it->second;
+        layers.erase(it);
+        if(packed.array == nullptr) return;
+        auto pooled = std::find_if(arrays.begin(), arrays.end(), [&](const PooledArray& pooled){ return pooled.array == packed.array; });
+        if(pooled == arrays.end()) return;
+        pooled->freeLayers.push_back(packed.layer);
+        // No material can use an array whose textures were all deleted, so its memory is given back
+        if((GLsizei)pooled->freeLayers.size() == pooled->layerCount){
+            delete pooled->array;
+            arrays.erase(pooled);
+        }
+    }
+
+    size_t TextureArrayPool::getLayerBytes(const Texture2D* texture){
+        auto it = layers.find(const_cast<Texture2D*>(texture));
+        if(it == layers.end() || it->second.array == nullptr) return 0;
+        return it->second.bytes;
+    }
+
+    bool TextureArrayPool::find(Texture2D* texture, Texture2DArray*& array, int& layer){
+        auto it = layers.find(texture);
+        if(it == layers.end() || it->second.array == nullptr) return false;
+        array = it->second.array;
+        layer = it->second.layer;
+        return true;
+    }
+
+    void TextureArrayPool::assign(LitMaterial* material){
+        auto maps = material->getMaps();
+        Texture2DArray* arrays[6];
+        int indices[6];
+        for(size_t i = 0; i < maps.size(); i++){
+            if(!maps[i] || !find(maps[i], arrays[i], indices[i])) return;
+        }
+        for(size_t i = 0; i < maps.size(); i++){
+            material->arrays[i] = arrays[i];
+            material->layers[i] = indices[i];
+        }
+    }
+
+    void TextureArrayPool::restore(Texture2D* texture){
+        auto it = layers.find(texture);
+        if(!texture || it == layers.end() || !it->second.released) return;
+        Layer& packed = it->second;
+        texture->bind();
+        glTexStorage2D(GL_TEXTURE_2D, packed.levels, packed.format, packed.width, packed.height);
+        Texture2D::unbind();
+        for(GLint level = 0; level < packed.levels; level++){
+            glCopyImageSubData(packed.array->getOpenGLName(), GL_TEXTURE_2D_ARRAY, level, 0, 0, packed.layer,
+                               texture->getOpenGLName(), GL_TEXTURE_2D, level, 0, 0, 0,
+                               std::max(1, packed.width >> level), std::max(1, packed.height >> level), 1);
+        }
+        texture->setBytes(packed.bytes);
+        packed.released = false;
+    }
+
+    void TextureArrayPool::restoreSampled(Material* material){
+        if(auto lit = dynamic_cast<LitMaterial*>(material); lit){
+            if(lit->isPacked()) return;
+            for(Texture2D* map : lit->getMaps()) restore(map);
+        } else if(auto textured = dynamic_cast<TexturedMaterial*>(material); textured){
+            restore(textured->texture);
+        } else if(auto multi = dynamic_cast<MultiTextureMaterial*>(material); multi){
+            restore(multi->texture1);
+            restore(multi->texture2);
+        }
+    }
+
+    void TextureArrayPool::clear(){
+        for(auto& pooled : arrays) delete pooled.array;
+        arrays.clear();
+        layers.clear();
+    }
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "texture2d.hpp"
+#include "texture2d-array.hpp"
+
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace portal {
+
+    class Material;
+    class LitMaterial;
+    class UploadQueue;
+
+    // This static class packs the maps of the lit materials into texture arrays
+    // Textures of the same resolution class (size, format and number of mip levels) share an array
+    // and every texture is stored once, so the "default_*" maps used by most materials take a single layer.
+    // Materials using the same arrays can then be drawn one after the other without rebinding any texture,
+    // only the layer indices change between them.
+    class TextureArrayPool {
+        // The resolution class of a texture, only textures with the same class can be layers of the same array
+        struct ResolutionClass {
+            GLint width, height;
+            GLint format;
+            GLint levels;
+            bool operator<(const ResolutionClass& other) const {
+                return std::tie(width, height, format, levels) < std::tie(other.width, other.height, other.format, other.levels);
+            }
+            bool operator==(const ResolutionClass& other) const {
+                return std::tie(width, height, format, levels) == std::tie(other.width, other.height, other.format, other.levels);
+            }
+            bool operator!=(const ResolutionClass& other) const { return !(*this == other); }
+        };
+        struct Layer {
+            Texture2DArray* array;
+            int layer;
+            // The storage the texture had before being packed, used to restore it if the texture has to be sampled directly again
+            GLint width = 0, height = 0, format = 0, levels = 0;
+            size_t bytes = 0;
+            bool released = false;
+        };
+        // An array created by the pool with the layers that no texture uses anymore (they are reused by the next "build")
+        struct PooledArray {
+            Texture2DArray* array;
+            ResolutionClass resolution;
+            GLsizei layerCount;
+            std::vector<int> freeLayers;
+        };
+        // All the arrays created by the pool (owned by the pool), an array is deleted once all its layers are free
+        static inline std::vector<PooledArray> arrays;
+        // The array and layer where each packed texture was copied
+        static inline std::unordered_map<Texture2D*, Layer> layers;
+
+        static ResolutionClass describe(Texture2D* texture);
+        // Finds the lit materials whose maps can be packed and the textures that the other materials sample directly
+        static void findMaterials(std::vector<LitMaterial*>& materials, std::set<Texture2D*>& sampledDirectly);
+        // Copies the texture into the layer reserved for it (the layer is freed if the texture was deleted meanwhile)
+        static void pack(Texture2D* texture, Texture2DArray* array, const ResolutionClass& resolution, int layer);
+        // Makes the lit materials use the layers of their maps and releases the storage of the packed textures
+        // that no material samples directly (the last step of "build")
+        static void finishBuild();
+    public:
+        // Packs the maps of every loaded LitMaterial (they then use the USE_TEXTURE_ARRAY variant of their shader).
+        // The storage of the packed textures is released unless another material type still samples them.
+        // If a queue is given, each texture is copied by an upload deferred to it and the materials are switched to
+        // their layers by the last one, so the copies can be spread over several frames (e.g. by the SceneStreamer)
+        // Requires glCopyImageSubData (OpenGL 4.3 or ARB_copy_image), otherwise the materials are left untouched
+        static void build(UploadQueue* uploads = nullptr);
+        // Finds where the given texture was packed, returns false if it wasn't packed
+        static bool find(Texture2D* texture, Texture2DArray*& array, int& layer);
+        // Makes the material use the layers of its maps if they were all packed (e.g. a material loaded again after being evicted)
+        static void assign(LitMaterial* material);
+        // Copies the layer of a packed texture back into its own storage if it was released (e.g. a texture sampled by
+        // a material loaded after the maps were packed). Does nothing for the textures that still have their storage
+        static void restore(Texture2D* texture);
+        // Restores the storage of the textures the material samples directly (all of them unless it is a packed lit material)
+        static void restoreSampled(Material* material);
+        // Forgets where the texture was packed (before it is deleted), its layer is free to be used by another texture
+        // and its array is deleted if none of its layers is used anymore
+        static void forget(Texture2D* texture);
+        // Returns the bytes the texture uses in its array (0 if it isn't packed)
+        static size_t getLayerBytes(const Texture2D* texture);
+        // Deletes all the arrays
+        static void clear();
+    };
+
+}
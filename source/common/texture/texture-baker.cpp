@@ -0,0 +1,196 @@
+#include "texture-baker.hpp"
+#include "block-compression.hpp"
+
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include <vector>
+
+namespace portal::texture_baker {
+
+    std::string getBakedPath(const std::string& imagePath){
+        return imagePath + ".ptex";
+    }
+
+    // Reads the size and modification time of the source image
+    static bool getSourceStamp(const std::string& imagePath, uint64_t& size, int64_t& time){
+        std::error_code error;
+        size = (uint64_t)std::filesystem::file_size(imagePath, error);
+        if(error) return false;
+        auto writeTime = std::filesystem::last_write_time(imagePath, error);
+        if(error) return false;
+        time = (int64_t)writeTime.time_since_epoch().count();
+        return true;
+    }
+
+    bool isUpToDate(const BakedTextureHeader& header, const std::string& imagePath){
+        uint64_t size;
+        int64_t time;
+        if(!getSourceStamp(imagePath, size, time)) return true;
+        return header.sourceSize == size && header.sourceTime == time;
+    }
+
+    const char* getFormatName(BakedFormat format){
+        switch(format){
+            case BakedFormat::RGBA8: return "RGBA8";
+            case BakedFormat::BC1: return "BC1";
+            case BakedFormat::BC3: return "BC3";
+            case BakedFormat::BC5: return "BC5";
+            case BakedFormat::BC7: return "BC7";
+        }
+        return "unknown";
+    }
+
+    std::vector<uint8_t> downsample(const uint8_t* pixels, int width, int height){
+        int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+        std::vector<uint8_t> result((size_t)nextWidth * nextHeight * 4);
+        for(int y = 0; y < nextHeight; y++){
+            for(int x = 0; x < nextWidth; x++){
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                for(int c = 0; c < 4; c++){
+                    int sum = pixels[4 * ((size_t)y0 * width + x0) + c] + pixels[4 * ((size_t)y0 * width + x1) + c]
+                            + pixels[4 * ((size_t)y1 * width + x0) + c] + pixels[4 * ((size_t)y1 * width + x1) + c];
+                    result[4 * ((size_t)y * nextWidth + x) + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+        return result;
+    }
+
+    static BakedFormat pickFormat(const std::string& imagePath, const std::string& format, const uint8_t* pixels, int width, int height){
+        if(format == "rgba8") return BakedFormat::RGBA8;
+        if(format == "bc1") return BakedFormat::BC1;
+        if(format == "bc3") return BakedFormat::BC3;
+        if(format == "bc5") return BakedFormat::BC5;
+        if(format == "bc7") return BakedFormat::BC7;
+        if(format != "auto") std::cerr << "Unknown texture format: " << format << ", using auto" << std::endl;
+
+        std::string stem = std::filesystem::path(imagePath).stem().string();
+        if(stem.size() >= 7 && stem.compare(stem.size() - 7, 7, "_normal") == 0) return BakedFormat::BC5;
+        for(size_t i = 0; i < (size_t)width * height; i++){
+            if(pixels[4 * i + 3] != 255) return BakedFormat::BC3;
+        }
+        return BakedFormat::BC1;
+    }
+
+    bool bake(const std::string& imagePath, const std::string& format){
+        auto start = std::chrono::high_resolution_clock::now();
+        int width, height, channels;
+        // Same orientation as texture_utils::loadImage so the baked pixels can be uploaded as is
+        stbi_set_flip_vertically_on_load(true);
+        unsigned char* pixels = stbi_load(imagePath.c_str(), &width, &height, &channels, 4);
+        if(pixels == nullptr){
+            std::cerr << "Failed to load image: " << imagePath << std::endl;
+            return false;
+        }
+        BakedFormat bakedFormat = pickFormat(imagePath, format, pixels, width, height);
+
+        // Generate all the levels down to 1x1
+        std::vector<BakedTextureLevel> levels;
+        std::vector<std::vector<uint8_t>> levelData;
+        std::vector<uint8_t> current(pixels, pixels + (size_t)width * height * 4);
+        stbi_image_free(pixels);
+        int levelWidth = width, levelHeight = height;
+        while(true){
+            if(bakedFormat == BakedFormat::RGBA8){
+                levelData.push_back(current);
+            } else {
+                block_compression::Format blockFormat = bakedFormat == BakedFormat::BC1 ? block_compression::Format::BC1 :
+                                                        bakedFormat == BakedFormat::BC3 ? block_compression::Format::BC3 :
+                                                        bakedFormat == BakedFormat::BC5 ? block_compression::Format::BC5 :
+                                                                                          block_compression::Format::BC7;
+                levelData.push_back(block_compression::compress(blockFormat, current.data(), levelWidth, levelHeight));
+            }
+            levels.push_back({(uint32_t)levelWidth, (uint32_t)levelHeight, 0, levelData.back().size()});
+            if(levelWidth == 1 && levelHeight == 1) break;
+            current = downsample(current.data(), levelWidth, levelHeight);
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+        }
+
+        // The level data starts after the level table, every level is aligned to 16 bytes
+        uint64_t offset = sizeof(BakedTextureHeader) + levels.size() * sizeof(BakedTextureLevel);
+        for(auto& level : levels){
+            offset = (offset + 15) & ~(uint64_t)15;
+            level.offset = offset;
+            offset += level.size;
+        }
+
+        BakedTextureHeader header{};
+        std::memcpy(header.magic, BakedTextureMagic, 4);
+        header.version = BakedTextureVersion;
+        header.format = (uint32_t)bakedFormat;
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.levels = (uint32_t)levels.size();
+        getSourceStamp(imagePath, header.sourceSize, header.sourceTime);
+
+        std::string bakedPath = getBakedPath(imagePath);
+        std::ofstream file(bakedPath, std::ios::binary);
+        if(!file){
+            std::cerr << "Couldn't open file: " << bakedPath << std::endl;
+            return false;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)levels.data(), levels.size() * sizeof(BakedTextureLevel));
+        static const char padding[16] = {};
+        for(size_t i = 0; i < levels.size(); i++){
+            file.seekp(0, std::ios::end);
+            uint64_t position = (uint64_t)file.tellp();
+            file.write(padding, levels[i].offset - position);
+            file.write((const char*)levelData[i].data(), levelData[i].size());
+        }
+        file.close();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        double uncompressed = 0, baked = 0;
+        for(auto& level : levels){
+            uncompressed += level.width * level.height * 4.0;
+            baked += level.size;
+        }
+        std::cout << "Baked " << imagePath << " (" << width << "x" << height << ", " << getFormatName(bakedFormat)
+                  << ", " << levels.size() << " levels): " << std::fixed << std::setprecision(2)
+                  << uncompressed / (1024.0 * 1024.0) << " MB -> " << baked / (1024.0 * 1024.0) << " MB in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::defaultfloat << std::endl;
+        return true;
+    }
+
+    // Collects every string in the json that looks like an image path
+    static void collectImages(const nlohmann::json& data, std::set<std::string>& images){
+        if(data.is_object() || data.is_array()){
+            for(auto& item : data) collectImages(item, images);
+        } else if(data.is_string()){
+            std::string value = data.get<std::string>();
+            std::string extension = std::filesystem::path(value).extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if(extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp")
+                images.insert(value);
+        }
+    }
+
+    void bakeAll(const nlohmann::json& config, const std::string& format){
+        auto start = std::chrono::high_resolution_clock::now();
+        std::set<std::string> images;
+        collectImages(config, images);
+        size_t baked = 0;
+        for(auto& image : images){
+            if(bake(image, format)) baked++;
+        }
+        // The menus draw text so they are kept uncompressed (only the mip levels are baked)
+        for(const char* image : {"assets/textures/Loading.png", "assets/textures/menu.png",
+                                 "assets/textures/pause_menu.png", "assets/textures/options_menu.png"}){
+            if(images.count(image) == 0 && bake(image, "rgba8")) baked++;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Baked " << baked << " textures in " << std::fixed << std::setprecision(2)
+                  << std::chrono::duration<double>(end - start).count() << " s" << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <json/json.hpp>
+
+namespace portal::texture_baker {
+
+    // The texture formats that can be stored in a baked texture
+    enum class BakedFormat : uint32_t {
+        RGBA8 = 0,
+        BC1 = 1,
+        BC3 = 2,
+        BC5 = 3,
+        BC7 = 4
+    };
+
+    // A baked texture (".ptex") is a binary file that can be uploaded directly to the GPU:
+    // - The header
+    // - A table of "levels" entries (one per mip level, starting from the base level)
+    // - The data of every level (each level starts at a 16 bytes aligned offset)
+    // The pixels are stored bottom row first (the same as stb_image with vertical flip on load)
+    struct BakedTextureHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t width, height;
+        uint32_t levels;
+        // The size and modification time of the source image, used to detect stale baked files
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    struct BakedTextureLevel {
+        uint32_t width, height;
+        uint64_t offset, size;
+    };
+
+    inline constexpr char BakedTextureMagic[4] = {'P', 'T', 'E', 'X'};
+    inline constexpr uint32_t BakedTextureVersion = 1;
+
+    // Returns the path of the baked file of the given image (the baked file sits next to the image)
+    std::string getBakedPath(const std::string& imagePath);
+    // Returns true if the baked file was created from the current version of the image
+    // If the image doesn't exist anymore, the baked file is considered up to date (so it can be shipped alone)
+    bool isUpToDate(const BakedTextureHeader& header, const std::string& imagePath);
+    // Returns the name of the format (used for logging)
+    const char* getFormatName(BakedFormat format);
+    // Generates the next mip level of RGBA8 pixels using a 2x2 box filter (edges are clamped for odd sizes)
+    std::vector<uint8_t> downsample(const uint8_t* pixels, int width, int height);
+
+    // Bakes a single image with all its mip levels
+    // format can be "rgba8", "bc1", "bc3", "bc5", "bc7" or "auto" where auto picks:
+    //  - BC5 for normal maps (the file name ends with "_normal")
+    //  - BC1 for opaque images
+    //  - BC3 for images with transparency
+    bool bake(const std::string& imagePath, const std::string& format = "auto");
+    // Bakes every image referenced by the application configuration (and the images used by the menus)
+    void bakeAll(const nlohmann::json& config, const std::string& format = "auto");
+}
@@ -1,9 +1,15 @@
 #include "texture-utils.hpp"
+#include "texture-baker.hpp"
+#include "../asset-pack.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 #include <iostream>
+#include <chrono>
+#include <cstring>
+
+#include <glm/common.hpp>
 
 portal::Texture2D* portal::texture_utils::empty(GLenum format, glm::ivec2 size){
     portal::Texture2D* texture = new portal::Texture2D();
@@ -14,48 +20,194 @@ portal::Texture2D* portal::texture_utils::empty(GLenum format, glm::ivec2 size){
     return texture;
 }
 
-portal::Texture2D* portal::texture_utils::loadImage(const std::string& filename, bool generate_mipmap) {
-    glm::ivec2 size;
-    int channels;
-    //Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
-    //We need to till stb to flip images vertically after loading them
-    stbi_set_flip_vertically_on_load(true);
-    //Load image data and retrieve width, height and number of channels in the image
-    //The last argument is the number of channels we want and it can have the following values:
-    //- 0: Keep number of channels the same as in the image file
-    //- 1: Grayscale only
-    //- 2: Grayscale and Alpha
-    //- 3: RGB
-    //- 4: RGB and Alpha (RGBA)
-    //Note: channels (the 4th argument) always returns the original number of channels in the file
-    unsigned char* pixels = stbi_load(filename.c_str(), &size.x, &size.y, &channels, 4);
-    if(pixels == nullptr){
-        std::cerr << "Failed to load image: " << filename << std::endl;
-        return nullptr;
+portal::texture_utils::ImageData::~ImageData(){
+    if(pixels) stbi_image_free(pixels);
+}
+
+// Maps the baked version of the image if it exists, is up to date and its format is supported by the driver
+// Returns false otherwise so the caller falls back to decoding the image
+static bool decodeBakedImage(portal::texture_utils::ImageData& image) {
+    using namespace portal::texture_baker;
+    auto file = std::make_unique<portal::AssetFile>(getBakedPath(image.filename));
+    if(!file->isOpen() || file->getSize() < sizeof(BakedTextureHeader)) return false;
+    BakedTextureHeader header;
+    std::memcpy(&header, file->getData(), sizeof(header));
+    if(std::memcmp(header.magic, BakedTextureMagic, 4) != 0 || header.version != BakedTextureVersion || header.levels == 0){
+        std::cerr << "Invalid baked texture: " << getBakedPath(image.filename) << std::endl;
+        return false;
+    }
+    if(!isUpToDate(header, image.filename)){
+        std::cerr << "Baked texture is older than its image (bake the textures again): " << image.filename << std::endl;
+        return false;
+    }
+    const BakedTextureLevel* levels = (const BakedTextureLevel*)(file->getData() + sizeof(BakedTextureHeader));
+    if(sizeof(BakedTextureHeader) + header.levels * sizeof(BakedTextureLevel) > file->getSize()) return false;
+
+    // The extension flags are set when OpenGL is loaded so they can be read from any thread
+    GLenum internalFormat = GL_RGBA8;
+    bool supported = true;
+    switch((BakedFormat)header.format){
+        case BakedFormat::RGBA8: internalFormat = GL_RGBA8; break;
+        case BakedFormat::BC1: internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; supported = GLAD_GL_EXT_texture_compression_s3tc; break;
+        case BakedFormat::BC3: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; supported = GLAD_GL_EXT_texture_compression_s3tc; break;
+        case BakedFormat::BC5: internalFormat = GL_COMPRESSED_RG_RGTC2; break;
+        case BakedFormat::BC7: internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM; supported = GLAD_GL_ARB_texture_compression_bptc || GLAD_GL_VERSION_4_2; break;
+        default: supported = false;
+    }
+    if(!supported){
+        std::cerr << "Baked texture format " << getFormatName((BakedFormat)header.format) << " is not supported, decoding " << image.filename << std::endl;
+        return false;
     }
+
+    // Without mipmaps, only the base level is uploaded
+    GLint levelCount = image.generateMipmap ? (GLint)header.levels : 1;
+    for(GLint level = 0; level < levelCount; level++){
+        if(levels[level].offset + levels[level].size > file->getSize()) return false;
+    }
+    image.bakedFile = std::move(file);
+    image.bakedFormat = internalFormat;
+    image.bakedLevelCount = levelCount;
+    image.bakedLevels = levels;
+    return true;
+}
+
+std::unique_ptr<portal::texture_utils::ImageData> portal::texture_utils::decodeImage(const std::string& filename, bool generate_mipmap) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto image = std::make_unique<ImageData>();
+    image->filename = filename;
+    image->generateMipmap = generate_mipmap;
+    if(!decodeBakedImage(*image)){
+        int channels;
+        //Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
+        //We need to till stb to flip images vertically after loading them
+        //(the flag is set for the calling thread only since the images are decoded in parallel)
+        stbi_set_flip_vertically_on_load_thread(true);
+        //Load image data and retrieve width, height and number of channels in the image
+        //The last argument is the number of channels we want and it can have the following values:
+        //- 0: Keep number of channels the same as in the image file
+        //- 1: Grayscale only
+        //- 2: Grayscale and Alpha
+        //- 3: RGB
+        //- 4: RGB and Alpha (RGBA)
+        //Note: channels (the 4th argument) always returns the original number of channels in the file
+        //The image is read through "AssetFile" so it can come from the mounted asset pack
+        AssetFile file(filename);
+        if(file.isOpen())
+            image->pixels = stbi_load_from_memory(file.getData(), (int)file.getSize(), &image->size.x, &image->size.y, &channels, 4);
+        if(image->pixels == nullptr){
+            std::cerr << "Failed to load image: " << filename << std::endl;
+            return nullptr;
+        }
+        // Generate the mip levels here so the upload is only copies (instead of "glGenerateMipmap" stalling the context)
+        if(generate_mipmap){
+            const uint8_t* level = image->pixels;
+            glm::ivec2 levelSize = image->size;
+            while(levelSize.x > 1 || levelSize.y > 1){
+                image->mipLevels.push_back(texture_baker::downsample(level, levelSize.x, levelSize.y));
+                level = image->mipLevels.back().data();
+                levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+            }
+        }
+    }
+    image->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return image;
+}
+
+portal::Texture2D* portal::texture_utils::uploadImage(ImageData& image, StagingRing* ring) {
+    using namespace portal::texture_baker;
+    auto start = std::chrono::high_resolution_clock::now();
+    loadStats.textures++;
+
+    // Collect the levels to upload, either from the baked file or from the decoded pixels
+    struct Level {
+        GLsizei width, height;
+        const void* data;
+        size_t size;
+    };
+    std::vector<Level> levels;
+    GLenum internalFormat = GL_RGBA8;
+    if(image.bakedFile){
+        const BakedTextureLevel* bakedLevels = (const BakedTextureLevel*)image.bakedLevels;
+        for(GLint level = 0; level < image.bakedLevelCount; level++){
+            levels.push_back({(GLsizei)bakedLevels[level].width, (GLsizei)bakedLevels[level].height,
+                              image.bakedFile->getData() + bakedLevels[level].offset, (size_t)bakedLevels[level].size});
+        }
+        internalFormat = image.bakedFormat;
+        loadStats.baked++;
+    } else {
+        glm::ivec2 levelSize = image.size;
+        levels.push_back({levelSize.x, levelSize.y, image.pixels, (size_t)levelSize.x * levelSize.y * 4});
+        for(auto& mipLevel : image.mipLevels){
+            levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+            levels.push_back({levelSize.x, levelSize.y, mipLevel.data(), mipLevel.size()});
+        }
+    }
+
+    // Copy all the levels into a slot of the staging ring (each level aligned to 16 bytes), the texture functions
+    // then read from the slot at these offsets instead of the client pointers
+    if(ring){
+        size_t total = 0;
+        for(auto& level : levels) total = ((total + 15) & ~(size_t)15) + level.size;
+        std::vector<size_t> offsets;
+        if(uint8_t* staged = (uint8_t*)ring->map(total); staged){
+            size_t offset = 0;
+            for(auto& level : levels){
+                offset = (offset + 15) & ~(size_t)15;
+                std::memcpy(staged + offset, level.data, level.size);
+                offsets.push_back(offset);
+                offset += level.size;
+            }
+        }
+        // If the slot couldn't be mapped or its content was lost when unmapping, the levels are uploaded from client memory
+        if(!offsets.empty() && ring->unmap()){
+            for(size_t level = 0; level < levels.size(); level++) levels[level].data = (const void*)offsets[level];
+            loadStats.stagedBytes += total;
+        } else {
+            ring = nullptr;
+        }
+    }
+
     // Create a texture
     portal::Texture2D* texture = new portal::Texture2D();
     //Bind the texture such that we upload the image data to its storage
-    //TODO: (Req 5) Finish this function to fill the texture with the data found in "pixels"
-
-    //Bind the texture
     texture->bind();
+    //TODO: (Req 5) Finish this function to fill the texture with the data found in "pixels"
     //Load the image data into the texture using glTexImage2D
     //The arguments are:
     //- GL_TEXTURE_2D: The texture target
-    //- 0: The mipmap level we want to load the image into (0 is the base image level)
-    //- GL_RGBA: The internal format of the texture (RGBA with 8 bits per channel)
-    //- size.x, size.y: The width and height of the image
+    //- level: The mipmap level we want to load the image into (0 is the base image level)
+    //- GL_RGBA8: The internal format of the texture (RGBA with 8 bits per channel)
+    //- width, height: The width and height of the level
     //- 0: Border size (must be 0)
     //- GL_RGBA: The format of the pixel data we are uploading
     //- GL_UNSIGNED_BYTE: The type of the pixel data we are uploading
-    //- pixels: The actual pixel data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    //Generate mipmaps if needed 
-    glGenerateMipmap(GL_TEXTURE_2D);
+    //- data: The actual pixel data (or its offset in the staging buffer)
+    for(GLint level = 0; level < (GLint)levels.size(); level++){
+        if(internalFormat == GL_RGBA8){
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, levels[level].width, levels[level].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data);
+        } else {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, levels[level].width, levels[level].height, 0, (GLsizei)levels[level].size, levels[level].data);
+        }
+        loadStats.bytes += levels[level].size;
+        texture->setBytes(texture->getBytes() + levels[level].size);
+    }
+    //Limit the texture to the uploaded levels so it is complete whatever the minification filter is
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
     //Unbind the texture
     texture->unbind();
-    
-    stbi_image_free(pixels); //Free image data after uploading to GPU
+    if(ring) ring->release();
+
+    //Free the image data after uploading to GPU
+    if(image.pixels) stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.mipLevels.clear();
+    image.bakedFile.reset();
+    loadStats.milliseconds += image.milliseconds + std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
     return texture;
-}
\ No newline at end of file
+}
+
+portal::Texture2D* portal::texture_utils::loadImage(const std::string& filename, bool generate_mipmap) {
+    auto image = decodeImage(filename, generate_mipmap);
+    if(!image) return nullptr;
+    return uploadImage(*image);
+}
@@ -1,14 +1,62 @@
 #pragma once
 
 #include "texture2d.hpp"
+#include "staging-ring.hpp"
+#include "../asset-pack.hpp"
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/vec2.hpp>
 
 namespace portal::texture_utils {
+    // Statistics about the images loaded by "loadImage" (used to report the startup texture cost)
+    struct LoadStats {
+        int textures = 0;
+        int baked = 0;
+        double milliseconds = 0;
+        // Estimated size of the loaded textures on the GPU (including mip levels)
+        size_t bytes = 0;
+        // The bytes uploaded through a staging ring
+        size_t stagedBytes = 0;
+    };
+    inline LoadStats loadStats;
+
+    // The CPU side of an image, ready to be sent to the GPU by "uploadImage"
+    // It holds either the decoded pixels (and their mip levels) or the mip levels of the baked image (pointing into its mapped file)
+    struct ImageData {
+        std::string filename;
+        bool generateMipmap = true;
+        glm::ivec2 size = {0, 0};
+        unsigned char* pixels = nullptr;
+        // The mip levels after the base level of the decoded pixels (generated by the decoding so the upload doesn't have to)
+        std::vector<std::vector<uint8_t>> mipLevels;
+        std::unique_ptr<AssetFile> bakedFile;
+        GLenum bakedFormat = GL_RGBA8;
+        GLint bakedLevelCount = 0;
+        const void* bakedLevels = nullptr;
+        // The time spent reading and decoding the image (added to "loadStats" by the upload)
+        double milliseconds = 0;
+
+        ImageData() = default;
+        ~ImageData();
+        ImageData(const ImageData&) = delete;
+        ImageData& operator=(const ImageData&) = delete;
+    };
+
     // This function create an empty texture with a specific format (useful for framebuffers)
     Texture2D* empty(GLenum format, glm::ivec2 size);
     // This function loads an image and sends its data to the given Texture2D 
+    // If a baked version of the image exists (see texture-baker.hpp), its mip levels are uploaded directly
+    // from the memory mapped file instead of decoding the image and generating the mipmaps on the GPU
     Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
+    // The two halves of "loadImage" so the images can be decoded in parallel:
+    // "decodeImage" doesn't use OpenGL so it can run on any thread (returns nullptr if the image couldn't be read)
+    // "uploadImage" creates the texture, it must run on a thread with an OpenGL context
+    // If a staging ring is given, the levels are copied into it and uploaded from there without stalling
+    std::unique_ptr<ImageData> decodeImage(const std::string& filename, bool generate_mipmap = true);
+    Texture2D* uploadImage(ImageData& image, StagingRing* ring = nullptr);
 }
\ No newline at end of file
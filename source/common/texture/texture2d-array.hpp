@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/gl.h>
+
+namespace portal {
+
+    // This class defines an OpenGL texture which will be used as a GL_TEXTURE_2D_ARRAY
+    // Every layer has the same size, format and number of mip levels
+    class Texture2DArray {
+        // The OpenGL object name of this texture
+        GLuint name = 0;
+        // The array bound to each texture unit through "bindToUnit" (used to skip redundant binds)
+        // Only arrays are tracked since binding a GL_TEXTURE_2D doesn't change the GL_TEXTURE_2D_ARRAY binding of a unit
+        // "bind" and "unbind" change the binding of the active unit which isn't tracked, so they forget all the units
+        static inline const Texture2DArray* boundUnits[16] = {};
+    public:
+        // This constructor creates an OpenGL texture and saves its object name in the member variable "name"
+        Texture2DArray() {
+            glGenTextures(1, &name);
+        };
+
+        // This deconstructor deletes the underlying OpenGL texture
+        ~Texture2DArray() {
+            for(auto& bound : boundUnits)
+                if(bound == this) bound = nullptr;
+            glDeleteTextures(1, &name);
+        }
+
+        // Get the internal OpenGL name of the texture
+        GLuint getOpenGLName() {
+            return name;
+        }
+
+        // This method binds this texture to GL_TEXTURE_2D_ARRAY (of the active texture unit)
+        void bind() const {
+            forgetBindings();
+            glBindTexture(GL_TEXTURE_2D_ARRAY, name);
+        }
+
+        // This method binds this texture to the given texture unit if it is not already bound to it
+        // Returns true if the texture was actually bound
+        bool bindToUnit(GLuint unit) const {
+            if(unit < 16 && boundUnits[unit] == this) return false;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, name);
+            if(unit < 16) boundUnits[unit] = this;
+            return true;
+        }
+
+        // This static method ensures that no texture is bound to GL_TEXTURE_2D_ARRAY
+        static void unbind(){
+            forgetBindings();
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+
+        // Forgets the arrays bound to the texture units so the next "bindToUnit" binds them again
+        // (called when the bindings may have changed without going through "bindToUnit")
+        static void forgetBindings(){
+            for(auto& bound : boundUnits) bound = nullptr;
+        }
+
+        Texture2DArray(const Texture2DArray&) = delete;
+        Texture2DArray& operator=(const Texture2DArray&) = delete;
+    };
+
+}
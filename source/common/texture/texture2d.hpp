@@ -2,12 +2,16 @@
 
 #include <glad/gl.h>
 
+#include <cstddef>
+
 namespace portal {
 
     // This class defined an OpenGL texture which will be used as a GL_TEXTURE_2D
     class Texture2D {
         // The OpenGL object name of this texture 
         GLuint name = 0;
+        // The size of the uploaded levels in bytes (0 for the textures that were not loaded from an image)
+        size_t bytes = 0;
     public:
         // This constructor creates an OpenGL texture and saves its object name in the member variable "name" 
         Texture2D() {
@@ -32,6 +36,18 @@ namespace portal {
             glBindTexture(GL_TEXTURE_2D, name);
         }
 
+        // This method frees the storage of the texture while keeping the object usable (it becomes an empty texture)
+        // It is used when the texture data was copied somewhere else (e.g. into a texture array)
+        void releaseStorage() {
+            glDeleteTextures(1, &name);
+            glGenTextures(1, &name);
+            bytes = 0;
+        }
+
+        // The memory used by the levels uploaded from an image (used by the asset memory budget)
+        size_t getBytes() const { return bytes; }
+        void setBytes(size_t bytes) { this->bytes = bytes; }
+
         // This static method ensures that no texture is bound to GL_TEXTURE_2D
         static void unbind(){
             //TODO: (Req 5) Complete this function
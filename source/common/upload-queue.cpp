@@ -0,0 +1,89 @@
+#include "upload-queue.hpp"
+
+#include <chrono>
+
+namespace portal {
+
+    void UploadQueue::push(std::function<void()> upload){
+        // The uploads run by the owner itself are counted right away (they are not fenced)
+        if(std::this_thread::get_id() == owner){
+            upload();
+            if(completed) (*completed)++;
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            popped.wait(lock, [&]{ return uploads.size() < capacity; });
+            uploads.push_back(std::move(upload));
+        }
+        // Wake the owner if it is waiting for the jobs in "drainUntil"
+        JobSystem::notifyWaiting();
+    }
+
+    void UploadQueue::defer(std::function<void()> upload){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            uploads.push_back(std::move(upload));
+        }
+        JobSystem::notifyWaiting();
+    }
+
+    void UploadQueue::retireFences(bool wait){
+        // Wait for one second at a time (the client wait doesn't accept an infinite timeout)
+        const GLuint64 timeout = wait ? 1000000000ull : 0;
+        while(!fences.empty()){
+            GLenum status = glClientWaitSync(fences.front().first, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+            if(status == GL_TIMEOUT_EXPIRED){
+                if(wait) continue;
+                return;
+            }
+            glDeleteSync(fences.front().first);
+            if(completed) *completed += fences.front().second;
+            fences.pop_front();
+        }
+    }
+
+    size_t UploadQueue::drain(double budget){
+        auto start = std::chrono::high_resolution_clock::now();
+        auto elapsed = [&]{ return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); };
+        size_t count = 0;
+        while(budget <= 0 || elapsed() < budget){
+            std::function<void()> upload;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(uploads.empty()) break;
+                upload = std::move(uploads.front());
+                uploads.pop_front();
+            }
+            popped.notify_one();
+            upload();
+            count++;
+        }
+        if(count > 0){
+            fences.emplace_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), (int)count);
+            glFlush();
+        }
+        retireFences(false);
+        milliseconds += elapsed();
+        return count;
+    }
+
+    void UploadQueue::drainUntil(JobCounter& counter){
+        while(true){
+            // Check the counter first, the uploads pushed before the last job was done are drained below
+            bool done = counter.isDone();
+            if(drain() == 0){
+                if(done) break;
+                JobSystem::waitForAnyJob(1.0);
+            }
+        }
+    }
+
+    void UploadQueue::finish(){
+        if(fences.empty()) return;
+        auto start = std::chrono::high_resolution_clock::now();
+        retireFences(true);
+        milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+}
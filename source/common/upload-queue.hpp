@@ -0,0 +1,61 @@
+#pragma once
+
+#include "job-system.hpp"
+
+#include <glad/gl.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace portal {
+
+    // A bounded queue of GPU uploads run by the thread that owns an OpenGL context
+    // The jobs decode the assets on the worker threads then push the upload of the decoded data here.
+    // The jobs wait while the queue is full, so the decoded data waiting for the GPU stays bounded.
+    // Each drained batch is followed by a fence, the uploads are counted as done once their fence is signaled
+    // (so they are complete when another context uses them)
+    class UploadQueue {
+        std::deque<std::function<void()>> uploads;
+        std::mutex mutex;
+        std::condition_variable popped;
+        size_t capacity;
+        // The thread running the uploads, its pushes run immediately so it never waits on itself
+        std::thread::id owner;
+        // The fences of the drained batches with the number of uploads in each batch
+        std::deque<std::pair<GLsync, int>> fences;
+        // Incremented for every upload once its fence is signaled (e.g. the progress of the loading screen)
+        std::atomic<int>* completed;
+
+        // Counts the uploads of the signaled fences, waits for all of them if "wait" is true
+        void retireFences(bool wait);
+    public:
+        // The total time spent running the uploads (in milliseconds)
+        double milliseconds = 0;
+
+        explicit UploadQueue(std::atomic<int>* completed = nullptr, size_t capacity = 16) : capacity(capacity), completed(completed) {}
+        ~UploadQueue() { finish(); }
+
+        // Makes the calling thread the one running the uploads (its OpenGL context must be current when draining)
+        void bind() { owner = std::this_thread::get_id(); }
+        // Queues an upload (waits while the queue is full), called from the jobs
+        void push(std::function<void()> upload);
+        // Queues an upload to run in a later drain, even from the thread running the uploads (it doesn't wait for the capacity)
+        // Used to split the work of the owner over several drains (e.g. the materials of a preloaded scene)
+        void defer(std::function<void()> upload);
+        // Runs the queued uploads for at most "budget" milliseconds (all of them if the budget is 0) then fences them
+        // Returns the number of uploads that were run
+        size_t drain(double budget = 0);
+        // Drains the queue until all the jobs of the counter are done and their uploads were run
+        void drainUntil(JobCounter& counter);
+        // Waits for the fences of all the drained uploads
+        void finish();
+
+        UploadQueue(const UploadQueue&) = delete;
+        UploadQueue& operator=(const UploadQueue&) = delete;
+    };
+
+}
@@ -4,6 +4,12 @@
 #include <json/json.hpp>
 
 #include <application.hpp>
+#include <texture/texture-baker.hpp>
+#include <mesh/mesh-cache.hpp>
+#include <asset-pack.hpp>
+#include <compiled-scene.hpp>
+#include <chrono>
+#include <filesystem>
 
 #include "states/menu-state.hpp"
 #include "states/play-state.hpp"
@@ -28,18 +34,67 @@ int main(int argc, char** argv) {
     // Default: 0 where the application runs indefinitely until manually closed
     int run_for_frames = args.get<int>("f", 0);
 
-    // Open the config file and exit if failed
-    std::ifstream file_in(config_path);
-    if(!file_in){
-        std::cerr << "Couldn't open file: " << config_path << std::endl;
-        return -1;
+    auto read_start = std::chrono::high_resolution_clock::now();
+    nlohmann::json app_config;
+    // A compiled config (".pscene", see "--compile-scene") holds the config without its world, which is instantiated from its tables
+    std::shared_ptr<portal::CompiledScene> compiled_scene;
+    if(portal::CompiledScene::isCompiled(config_path)){
+        compiled_scene = std::make_shared<portal::CompiledScene>();
+        if(!compiled_scene->load(config_path)) return -1;
+        if(compiled_scene->scenePointer != "/scene"){
+            std::cerr << "The compiled scene is not an app config: " << config_path << std::endl;
+            return -1;
+        }
+        app_config = compiled_scene->document;
+    } else {
+        // Open the config file and exit if failed
+        std::ifstream file_in(config_path);
+        if(!file_in){
+            std::cerr << "Couldn't open file: " << config_path << std::endl;
+            return -1;
+        }
+        // Read the file into a json object then close the file
+        app_config = nlohmann::json::parse(file_in, nullptr, true, true);
+        file_in.close();
+    }
+    std::cout << "Read the config in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - read_start).count()
+              << " ms" << std::endl;
+
+    // bake_textures converts every image used by the configuration to a baked texture (mip levels + block compression)
+    // then exits. The format can be chosen using "--bake-format" (auto, rgba8, bc1, bc3, bc5 or bc7)
+    // Default: false where the application runs normally
+    if(args.get<bool>("bake-textures", false)){
+        portal::texture_baker::bakeAll(app_config, args.get<std::string>("bake-format", "auto"));
+        return 0;
+    }
+
+    // build_pack writes the assets folder (and the cached meshes if they exist) into a single pack then exits
+    // The pack is written to "--pack" (Default: "assets.pak") and can be mounted using "assetPack" in the configuration
+    // verify_pack checks the content of every file of the pack then exits
+    // Default: false where the application runs normally
+    if(args.get<bool>("build-pack", false)){
+        bool built = portal::AssetPack::build({"assets", portal::mesh_cache::cacheFolder}, args.get<std::string>("pack", "assets.pak"));
+        return built ? 0 : -1;
+    }
+    if(args.get<bool>("verify-pack", false)){
+        bool valid = portal::AssetPack::mount(args.get<std::string>("pack", "assets.pak")) && portal::AssetPack::verify();
+        return valid ? 0 : -1;
+    }
+
+    // compile_scene validates the world of the config and writes the compiled config to "--scene-out" then exits
+    // (Default: the config path with the ".pscene" extension), the compiled config can then be given to "-c"
+    // It also compiles scene files (e.g. the "nextScene" of a scene) given to "-c"
+    if(args.get<bool>("compile-scene", false)){
+        if(compiled_scene){
+            std::cerr << "The config is already compiled: " << config_path << std::endl;
+            return -1;
+        }
+        std::string output = args.get<std::string>("scene-out", std::filesystem::path(config_path).replace_extension(".pscene").string());
+        return portal::CompiledScene::compile(app_config, output) ? 0 : -1;
     }
-    // Read the file into a json object then close the file
-    nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
-    file_in.close();
 
     // Create the application
-    portal::Application app(app_config);
+    portal::Application app(app_config, compiled_scene);
     
     // Register all the states of the project in the application
     app.registerState<Menustate>("menu");
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <application.hpp>
-#include <shader/shader.hpp>
+#include <shader/shader-cache.hpp>
 #include <texture/texture2d.hpp>
 #include <texture/texture-utils.hpp>
 #include <material/material.hpp>
@@ -51,10 +51,7 @@ class Menustate: public portal::State {
         // First, we create a material for the menu's background
         menuMaterial = new portal::TexturedMaterial();
         // Here, we load the shader that will be used to draw the background
-        menuMaterial->shader = new portal::ShaderProgram();
-        menuMaterial->shader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
-        menuMaterial->shader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-        menuMaterial->shader->link();
+        menuMaterial->shader = portal::ShaderCache::get("assets/shaders/textured.vert", "assets/shaders/textured.frag");
         // Then we load the menu texture
         menuMaterial->texture = portal::texture_utils::loadImage("assets/textures/menu.png");
         // Initially, the menu material will be black, then it will fade in
@@ -63,10 +60,7 @@ class Menustate: public portal::State {
         // Second, we create a material to highlight the hovered buttons
         highlightMaterial = new portal::TintedMaterial();
         // Since the highlight is not textured, we used the tinted material shaders
-        highlightMaterial->shader = new portal::ShaderProgram();
-        highlightMaterial->shader->attach("assets/shaders/tinted.vert", GL_VERTEX_SHADER);
-        highlightMaterial->shader->attach("assets/shaders/tinted.frag", GL_FRAGMENT_SHADER);
-        highlightMaterial->shader->link();
+        highlightMaterial->shader = portal::ShaderCache::get("assets/shaders/tinted.vert", "assets/shaders/tinted.frag");
         // The tint is white since we will subtract the background color from it to create a negative effect.
         highlightMaterial->tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
         // To create a negative effect, we enable blending, set the equation to be subtract,
@@ -173,9 +167,7 @@ class Menustate: public portal::State {
         // Delete all the allocated resources
         delete rectangle;
         delete menuMaterial->texture;
-        delete menuMaterial->shader;
         delete menuMaterial;
-        delete highlightMaterial->shader;
         delete highlightMaterial;
     }
 };
\ No newline at end of file
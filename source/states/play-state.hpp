@@ -12,6 +12,10 @@
 #include "systems/event.hpp"
 #include "../common/loading-screen.hpp"
 #include "../common/pause-menu.hpp"
+#include "../common/scene-streamer.hpp"
+#include "../common/compiled-scene.hpp"
+
+#include <chrono>
 
 
 // This state shows how to use the ECS framework and deserialization.
@@ -20,15 +24,26 @@ class Playstate: public portal::State {
     portal::World world;
     portal::ForwardRenderer renderer;
     portal::FreeCameraControllerSystem cameraController;
-    portal::MovementSystem* movementSystem;
-    portal::PortalManager* portalManager;
+    // Created with the world (they find its player and portals) and deleted with it in "onDestroy"
+    portal::MovementSystem* movementSystem = nullptr;
+    portal::PortalManager* portalManager = nullptr;
     bool paused = false;
+    // The scene being played, the one of the app config or the one preloaded by the SceneStreamer
+    nlohmann::json sceneConfig;
+    // The compiled world of the scene if it was compiled (its config has no "world" then)
+    std::shared_ptr<portal::CompiledScene> compiledScene;
+    // Set when this state is left for the preloaded scene
+    bool playNextScene = false;
+    // The checkpoint of the world, taken once it is created and by pressing F5, restored by pressing F9
+    portal::WorldSnapshot checkpoint;
     
     
     void loadConfig(const nlohmann::json& config) {
         // If we have assets in the scene config, we deserialize them
+        // Only the assets referenced by the world are loaded, the others are loaded if something resolves them later
         if(config.contains("assets")){
-            portal::deserializeAllAssets(config["assets"]);
+            if(compiledScene) portal::deserializeReferencedAssets(config["assets"], compiledScene->referencedAssets);
+            else portal::deserializeAllAssets(config["assets"], config.contains("world") ? &config["world"] : nullptr);
         }
         if(config.contains("physicsWorld")){
             world.deserialize_physics(config["physicsWorld"], config.contains("onTriggerEvents") ? &config["onTriggerEvents"] : nullptr);
@@ -36,10 +51,15 @@ class Playstate: public portal::State {
     }
 
     void createWorld(const nlohmann::json& config) {
-        // If we have a world in the scene config, we use it to populate our world
-        if(config.contains("world")){
+        // If we have a world in the scene config (or a compiled one), we use it to populate our world
+        auto start = std::chrono::high_resolution_clock::now();
+        if(compiledScene){
+            compiledScene->instantiate(&world);
+        } else if(config.contains("world")){
             world.deserialize(config["world"]);
         }
+        std::cout << "Created " << world.getEntities().size() << " entities from the " << (compiledScene ? "compiled scene" : "json world") << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
         // We initialize the camera controller system since it needs a pointer to the app
         cameraController.enter(getApp());
         // Then we initialize the renderer
@@ -60,28 +80,50 @@ public:
     private:
 
     void onInitialize() override {
-        auto& config = getApp()->getConfig()["scene"];
+        // Play the scene preloaded when the player entered the elevator of the previous one if there is one
+        if(playNextScene){
+            sceneConfig = portal::SceneStreamer::take(compiledScene);
+        } else {
+            sceneConfig = getApp()->getConfig()["scene"];
+            compiledScene = getApp()->getCompiledScene();
+        }
+        playNextScene = false;
+        auto& config = sceneConfig;
+        // "nextScene" (optional) is the path of the scene file preloaded once the player enters the elevator
+        portal::SceneStreamer::setNextScene(config.value("nextScene", ""));
+        // Keep the assets of the previous scene that this one shares, only the others are loaded below
+        if(config.contains("assets")) portal::retainSharedAssets(config["assets"]);
         // This is an example of how to use the loading screen
         // if you want to simply load the scene
-        // Note: this usage makes loaded meshes to be stored in LoadingScreen::meshData
-        // and is transferred in main thread (due to argument callback = nullptr)
+        // Note: this usage makes the loaded meshes to be pushed to LoadingScreen::meshUploads
+        // and created in the main thread while the loading screen is drawn
         portal::LoadingScreen::init(getApp(),
         [&config, this](){
             // A function that updates LoadingScreen::progress
             // Sets LoadingScreen::doneLoading to true when done
-            // set AssetLoader<T>::separateThread to true to load assets in a separate thread
+            // set AssetLoader<T>::separateThread to true to create the meshes in the main thread
             portal::AssetLoader<portal::Mesh>::separateThread = true;
             glfwMakeContextCurrent(getApp()->getSharedWindow());
             loadConfig(config);
             portal::AssetLoader<portal::Mesh>::separateThread = false;
         },
-        [&config](){
+        [&config, this](){
             // This function should be responsible to compute
             // LoadingScreen::total (total number to count in progress bar)
-            portal::LoadingScreen::countTotalAssets(config["assets"]);
+            // The assets kept from the previous scene are not counted since they are not loaded again
+            if(compiledScene)
+                portal::LoadingScreen::countTotalAssets(portal::filterLoadedAssets(compiledScene->referencedAssets));
+            else if(config.contains("world"))
+                portal::LoadingScreen::countTotalAssets(portal::filterLoadedAssets(portal::filterReferencedAssets(config["assets"], config["world"])));
+            else
+                portal::LoadingScreen::countTotalAssets(portal::filterLoadedAssets(config["assets"]));
         }, nullptr);
         portal::LoadingScreen::render();
         createWorld(config);
+        world.takeSnapshot(checkpoint);
+        portal::reportAssetMemory();
+        if(getApp()->getConfig().value("reportPhysics", false))
+            world.getShapeLibrary().report(world.getPhysicsWorld());
         portal::PauseMenu::init(getApp(), &renderer);
     }
 
@@ -100,6 +142,17 @@ public:
         }
 
         if(!paused){
+            // Save or reload the checkpoint before the systems run
+            if(keyboard.justPressed(GLFW_KEY_F5)){
+                world.takeSnapshot(checkpoint);
+                std::cout << "Checkpoint saved (" << checkpoint.data.size() << " bytes)" << std::endl;
+            } else if(keyboard.justPressed(GLFW_KEY_F9)){
+                auto start = std::chrono::high_resolution_clock::now();
+                bool restored = world.restoreSnapshot(checkpoint);
+                double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                if(restored) std::cout << "Checkpoint restored in " << time << " ms" << std::endl;
+                else std::cerr << "The checkpoint doesn't match the world anymore" << std::endl;
+            }
             
             // Here, we just run a bunch of systems to control the world logic
             movementSystem->update(&world, (float)deltaTime);
@@ -123,6 +176,15 @@ public:
             if(!portal::PauseMenu::render())
                 paused = false;
         }
+        // Preload the next scene, it replaces this one once it is loaded and the elevator doors are closed
+        portal::SceneStreamer::update();
+        if(portal::SceneStreamer::isReady() && world.getPlayingAnimations().empty() && !playNextScene){
+            playNextScene = true;
+            getApp()->changeState("play");
+        }
+        // Evict the assets nothing uses anymore if the loaded assets exceed the memory budget
+        // (not while the next scene is preloaded nor until it replaces this one, since its assets are not referenced yet)
+        if(!portal::SceneStreamer::isStreaming() && !portal::SceneStreamer::isReady()) portal::enforceAssetBudget();
     }
 
     void onDestroy() override {
@@ -132,10 +194,18 @@ public:
         renderer.destroy();
         // On exit, we call exit for the camera controller system to make sure that the mouse is unlocked
         cameraController.exit();
+        // Stop the preload if the state is left for something else than the next scene (e.g. back to the menu)
+        if(!playNextScene) portal::SceneStreamer::cancel();
+        // The systems hold pointers into the world, this state creates them again when it is entered for the next scene
+        delete movementSystem;
+        movementSystem = nullptr;
+        delete portalManager;
+        portalManager = nullptr;
         // Clear the world
         world.clear();
-        // and we delete all the loaded assets to free memory on the RAM and the VRAM
-        portal::clearAllAssets();
+        compiledScene.reset();
+        // The assets stay loaded so the next scene can keep the ones it shares (see "retainSharedAssets"),
+        // the application clears them when it exits
         // clean up the pause menu
         portal::PauseMenu::cleanUp();
     }